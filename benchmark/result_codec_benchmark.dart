@@ -0,0 +1,164 @@
+// Measures decoding a query result on the Dart side: the per-row map reply
+// and the columnar reply through the standard method codec and
+// QueryResult.fromJson, against the binary result encoding through
+// QueryResult.fromBinary. Every cell is read once after decoding, so the
+// lazy binary columns pay for their text too.
+//
+// Run with: flutter test benchmark/result_codec_benchmark.dart
+//
+// linux/benchmark/result_shape_benchmark.cc measures the native side (build
+// and encode) of the same shapes.
+
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+const int _columns = 8;
+
+void main() {
+  for (final rows in [10000, 100000, 1000000]) {
+    test('decode $rows x $_columns', () {
+      const codec = StandardMethodCodec();
+      final rowsReply = codec.encodeSuccessEnvelope(_rowsReply(rows));
+      final columnarReply = codec.encodeSuccessEnvelope(_columnarReply(rows));
+      final binaryReply = _binaryReply(rows);
+
+      final results = {
+        'rows': _time(() => QueryResult.fromJson(
+            codec.decodeEnvelope(rowsReply) as Map<dynamic, dynamic>)),
+        'columnar': _time(() => QueryResult.fromJson(
+            codec.decodeEnvelope(columnarReply) as Map<dynamic, dynamic>)),
+        'binary': _time(() => QueryResult.fromBinary(binaryReply)),
+      };
+      final sizes = {
+        'rows': rowsReply.lengthInBytes,
+        'columnar': columnarReply.lengthInBytes,
+        'binary': binaryReply.lengthInBytes,
+      };
+      // ignore: avoid_print
+      print('$rows x $_columns');
+      for (final shape in results.keys) {
+        // ignore: avoid_print
+        print('  ${shape.padRight(9)} decode+read '
+            '${results[shape]!.toStringAsFixed(1).padLeft(8)} ms  '
+            '${sizes[shape].toString().padLeft(10)} bytes');
+      }
+    }, timeout: Timeout.none);
+  }
+}
+
+/// Milliseconds to decode a result and read each of its cells.
+double _time(QueryResult Function() decode) {
+  final watch = Stopwatch()..start();
+  final result = decode();
+  var cells = 0;
+  for (final name in result.columnNames) {
+    if (result.isColumnar) {
+      final column = result.column(name);
+      for (var row = 0; row < result.rowCount; row++) {
+        if (column[row] != null) cells++;
+      }
+    } else {
+      for (final row in result.rows) {
+        if (row[name] != null) cells++;
+      }
+    }
+  }
+  watch.stop();
+  expect(cells, greaterThan(0));
+  return watch.elapsedMicroseconds / 1000;
+}
+
+// Columns cycle through int, double, bool and 16-character text, like the
+// synthetic driver's `types=int,double,bit,text strlen=16`.
+int _kind(int column) => column % 4;
+
+String _name(int column) => 'c${column + 1}';
+
+String _text(int row) =>
+    String.fromCharCodes(List.generate(16, (i) => 0x61 + (row + i) % 26));
+
+Object _cell(int column, int row) => switch (_kind(column)) {
+      0 => row,
+      1 => row + 0.5,
+      2 => row.isOdd,
+      _ => _text(row),
+    };
+
+Map<String, Object> _rowsReply(int rows) => {
+      'rowCount': rows,
+      'columns': [for (var c = 0; c < _columns; c++) _name(c)],
+      'rows': [
+        for (var r = 0; r < rows; r++)
+          {for (var c = 0; c < _columns; c++) _name(c): _cell(c, r)},
+      ],
+    };
+
+Map<String, Object?> _columnarReply(int rows) => {
+      'format': 'columnar',
+      'rowCount': rows,
+      'columns': [for (var c = 0; c < _columns; c++) _name(c)],
+      'columnTypes': [
+        for (var c = 0; c < _columns; c++)
+          const ['int', 'double', 'bool', 'string'][_kind(c)],
+      ],
+      'columnData': [
+        for (var c = 0; c < _columns; c++)
+          switch (_kind(c)) {
+            0 => Int64List.fromList([for (var r = 0; r < rows; r++) r]),
+            1 => Float64List.fromList([for (var r = 0; r < rows; r++) r + 0.5]),
+            2 => Uint8List.fromList([for (var r = 0; r < rows; r++) r & 1]),
+            _ => [for (var r = 0; r < rows; r++) _text(r)],
+          },
+      ],
+      'nulls': List<Object?>.filled(_columns, null),
+    };
+
+/// The same result in the layout of `src/binary_result.h`.
+ByteData _binaryReply(int rows) {
+  final out = BytesBuilder(copy: false);
+  void u32(int value) => out
+      .add((ByteData(4)..setUint32(0, value, Endian.little)).buffer.asUint8List());
+  void pad() => out.add(Uint8List((8 - out.length % 8) % 8));
+
+  out.add(ascii.encode('MSR1'));
+  u32(rows);
+  u32(_columns);
+  u32(0);
+  for (var c = 0; c < _columns; c++) {
+    final name = utf8.encode(_name(c));
+    // bool, int64, double and text are types 0, 1, 2 and 7.
+    out.add([const [1, 2, 0, 7][_kind(c)], _kind(c) == 3 ? 2 : 0, 0, 0]);
+    u32(name.length);
+    out.add(name);
+    pad();
+  }
+  for (var c = 0; c < _columns; c++) {
+    switch (_kind(c)) {
+      case 0:
+        out.add(Int64List.fromList([for (var r = 0; r < rows; r++) r])
+            .buffer
+            .asUint8List());
+      case 1:
+        out.add(Float64List.fromList([for (var r = 0; r < rows; r++) r + 0.5])
+            .buffer
+            .asUint8List());
+      case 2:
+        out.add([for (var r = 0; r < rows; r++) r & 1]);
+      default:
+        final heap = BytesBuilder(copy: false);
+        u32(0);
+        for (var r = 0; r < rows; r++) {
+          heap.add(utf8.encode(_text(r)));
+          u32(heap.length);
+        }
+        pad();
+        out.add(heap.takeBytes());
+    }
+    pad();
+  }
+  return ByteData.sublistView(out.takeBytes());
+}
@@ -1,6 +1,16 @@
+export 'src/batch_result.dart';
+export 'src/call_options.dart';
 export 'src/connection.dart';
 export 'src/query_result.dart';
 export 'src/exceptions.dart';
+export 'src/lob.dart';
+export 'src/pipeline.dart';
+export 'src/pool.dart';
+export 'src/procedure_result.dart';
+export 'src/result_cache.dart';
+export 'src/stats.dart';
+export 'src/statement_cache.dart';
+export 'src/transaction.dart';
 import 'mssql_connect_platform_interface.dart';
 
 class MssqlConnect {
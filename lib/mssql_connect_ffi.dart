@@ -0,0 +1,8 @@
+/// Synchronous access to the native engine through `dart:ffi`, for Linux
+/// and Windows; see [NativeConnection]. Kept out of `mssql_connect.dart` so
+/// that web builds, which have no `dart:ffi`, do not import it.
+library;
+
+export 'src/exceptions.dart';
+export 'src/native_connection.dart';
+export 'src/query_result.dart';
@@ -0,0 +1,63 @@
+/// Outcome of one row of [MsSqlConnection.executeBatch].
+enum BatchRowStatus {
+  success,
+  successWithInfo,
+  error,
+
+  /// Not executed, because an earlier batch failed as a whole.
+  unused,
+}
+
+/// Result of [MsSqlConnection.executeBatch].
+class BatchResult {
+  /// Rows affected across every batch, as reported by the driver.
+  final int rowsAffected;
+
+  /// One status per input row, in input order.
+  final List<BatchRowStatus> statuses;
+
+  /// Diagnostics of the batch that failed as a whole, if any. Rows from that
+  /// batch on are reported as [BatchRowStatus.error] or
+  /// [BatchRowStatus.unused]; earlier batches have already been applied.
+  final String? error;
+
+  BatchResult({
+    required this.rowsAffected,
+    required this.statuses,
+    this.error,
+  });
+
+  factory BatchResult.fromJson(Map<dynamic, dynamic> json) {
+    final codes = (json['statuses'] as List?) ?? const [];
+    return BatchResult(
+      rowsAffected: json['rowsAffected'] ?? 0,
+      statuses: codes
+          .map((code) => code is int && code >= 0 && code < BatchRowStatus.values.length
+              ? BatchRowStatus.values[code]
+              : BatchRowStatus.unused)
+          .toList(growable: false),
+      error: json['error'] as String?,
+    );
+  }
+
+  /// Whether every row was executed without error.
+  bool get succeeded =>
+      error == null &&
+      statuses.every((status) =>
+          status == BatchRowStatus.success ||
+          status == BatchRowStatus.successWithInfo);
+
+  /// Indexes of the rows that failed or were not executed.
+  List<int> get failedRows => [
+        for (var i = 0; i < statuses.length; i++)
+          if (statuses[i] == BatchRowStatus.error ||
+              statuses[i] == BatchRowStatus.unused)
+            i,
+      ];
+
+  @override
+  String toString() {
+    return 'BatchResult(rowsAffected: $rowsAffected, rows: ${statuses.length}, '
+        'failed: ${failedRows.length})';
+  }
+}
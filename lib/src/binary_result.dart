@@ -0,0 +1,210 @@
+import 'dart:collection';
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'query_result.dart';
+
+/// Channel the native side answers binary queries on; see
+/// [MsSqlConnection.queryBinary].
+const String binaryChannelName = 'mssql_connect/binary';
+
+// "MSR1" and "MSE1" read as little-endian 32-bit integers.
+const int _resultMagic = 0x3152534D;
+const int _errorMagic = 0x3145534D;
+
+const int _hasNulls = 1;
+const int _variable = 2;
+
+const List<ColumnType> _types = [
+  ColumnType.boolean,
+  ColumnType.integer,
+  ColumnType.float,
+  ColumnType.decimal,
+  ColumnType.dateTime,
+  ColumnType.time,
+  ColumnType.guid,
+  ColumnType.string,
+  ColumnType.binary,
+];
+
+/// The columns of a message in the binary result encoding, which is laid
+/// out in `src/binary_result.h`.
+///
+/// Nothing is copied up front: numeric columns are typed-list views of the
+/// message (copied only if the message is not 8-byte aligned in memory),
+/// and text and binary cells are read from their column's string heap on
+/// access.
+class BinaryResult {
+  final int rowCount;
+  final List<String> columnNames;
+  final List<ResultColumn> columns;
+
+  BinaryResult._(this.rowCount, this.columnNames, this.columns);
+
+  /// Whether [data] is an error frame rather than a result.
+  static bool isError(ByteData data) =>
+      data.lengthInBytes >= 4 && data.getUint32(0, Endian.little) == _errorMagic;
+
+  /// The code and message of an error frame.
+  static (String, String) readError(ByteData data) {
+    final code = _readString(data, 4);
+    final message = _readString(data, 8 + code.$2);
+    return (code.$1, message.$1);
+  }
+
+  factory BinaryResult.read(ByteData data) {
+    if (data.lengthInBytes < 16 ||
+        data.getUint32(0, Endian.little) != _resultMagic) {
+      throw const FormatException('Not a binary query result');
+    }
+    final rows = data.getUint32(4, Endian.little);
+    final count = data.getUint32(8, Endian.little);
+
+    var offset = 16;
+    final names = <String>[];
+    final types = <int>[];
+    final flags = <int>[];
+    final scales = <int>[];
+    for (var i = 0; i < count; i++) {
+      types.add(data.getUint8(offset));
+      flags.add(data.getUint8(offset + 1));
+      scales.add(data.getInt16(offset + 2, Endian.little));
+      final name = _readString(data, offset + 4);
+      names.add(name.$1);
+      offset = _pad(offset + 8 + name.$2);
+    }
+
+    final columns = <ResultColumn>[];
+    for (var i = 0; i < count; i++) {
+      Uint8List? nullBitmap;
+      if (flags[i] & _hasNulls != 0) {
+        nullBitmap = _bytes(data, offset, (rows + 7) >> 3);
+        offset = _pad(offset + ((rows + 7) >> 3));
+      }
+      final type = types[i] < _types.length ? _types[i] : ColumnType.string;
+      final List<Object> values;
+      if (flags[i] & _variable != 0) {
+        final heap = _pad(offset + (rows + 1) * 4);
+        final end = heap + data.getUint32(offset + rows * 4, Endian.little);
+        values = type == ColumnType.binary
+            ? _HeapBytes(data, offset, heap, rows)
+            : _HeapStrings(data, offset, heap, rows);
+        offset = _pad(end);
+      } else if (type == ColumnType.boolean) {
+        values = _bytes(data, offset, rows);
+        offset = _pad(offset + rows);
+      } else if (type == ColumnType.guid) {
+        values = _FixedBytes(data, offset, 16, rows);
+        offset = _pad(offset + rows * 16);
+      } else {
+        final bytes = _bytes(data, offset, rows * 8);
+        final aligned = bytes.offsetInBytes % 8 == 0
+            ? bytes
+            : Uint8List.fromList(bytes);
+        values = type == ColumnType.float
+            ? aligned.buffer.asFloat64List(aligned.offsetInBytes, rows)
+            : aligned.buffer.asInt64List(aligned.offsetInBytes, rows);
+        offset = _pad(offset + rows * 8);
+      }
+      columns.add(ResultColumn(
+        name: names[i],
+        type: type,
+        values: values,
+        nullBitmap: nullBitmap,
+        scale: scales[i],
+      ));
+    }
+    return BinaryResult._(rows, names, columns);
+  }
+
+  static int _pad(int offset) => (offset + 7) & ~7;
+
+  static Uint8List _bytes(ByteData data, int offset, int length) =>
+      data.buffer.asUint8List(data.offsetInBytes + offset, length);
+
+  /// A u32-length-prefixed UTF-8 string at [offset], and its length.
+  static (String, int) _readString(ByteData data, int offset) {
+    final length = data.getUint32(offset, Endian.little);
+    return (utf8.decode(_bytes(data, offset + 4, length)), length);
+  }
+}
+
+/// Cells of a variable-width column, as views of its string heap.
+class _HeapBytes extends ListBase<Uint8List> {
+  final ByteData _data;
+  final int _offsets;
+  final int _heap;
+  final int _length;
+
+  _HeapBytes(this._data, this._offsets, this._heap, this._length);
+
+  @override
+  int get length => _length;
+
+  @override
+  set length(int newLength) =>
+      throw UnsupportedError('Cannot change the length of a result column');
+
+  @override
+  Uint8List operator [](int index) {
+    RangeError.checkValidIndex(index, this);
+    final start = _data.getUint32(_offsets + index * 4, Endian.little);
+    final end = _data.getUint32(_offsets + index * 4 + 4, Endian.little);
+    return _data.buffer
+        .asUint8List(_data.offsetInBytes + _heap + start, end - start);
+  }
+
+  @override
+  void operator []=(int index, Uint8List value) =>
+      throw UnsupportedError('Cannot modify a result column');
+}
+
+/// Text cells of a variable-width column, decoded from UTF-8 when read.
+class _HeapStrings extends ListBase<String> {
+  final _HeapBytes _bytes;
+
+  _HeapStrings(ByteData data, int offsets, int heap, int length)
+      : _bytes = _HeapBytes(data, offsets, heap, length);
+
+  @override
+  int get length => _bytes.length;
+
+  @override
+  set length(int newLength) =>
+      throw UnsupportedError('Cannot change the length of a result column');
+
+  @override
+  String operator [](int index) => utf8.decode(_bytes[index]);
+
+  @override
+  void operator []=(int index, String value) =>
+      throw UnsupportedError('Cannot modify a result column');
+}
+
+/// Cells of a fixed-width byte column, such as GUIDs.
+class _FixedBytes extends ListBase<Uint8List> {
+  final ByteData _data;
+  final int _offset;
+  final int _width;
+  final int _length;
+
+  _FixedBytes(this._data, this._offset, this._width, this._length);
+
+  @override
+  int get length => _length;
+
+  @override
+  set length(int newLength) =>
+      throw UnsupportedError('Cannot change the length of a result column');
+
+  @override
+  Uint8List operator [](int index) {
+    RangeError.checkValidIndex(index, this);
+    return _data.buffer.asUint8List(
+        _data.offsetInBytes + _offset + index * _width, _width);
+  }
+
+  @override
+  void operator []=(int index, Uint8List value) =>
+      throw UnsupportedError('Cannot modify a result column');
+}
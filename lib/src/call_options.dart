@@ -0,0 +1,80 @@
+import 'package:flutter/services.dart';
+
+import 'exceptions.dart';
+
+/// Cancels the calls it was passed to through [CallOptions.cancelToken].
+///
+/// One token may be shared by several calls: [cancel] stops every one still
+/// in flight, and later calls made with the token fail straight away.
+class CancelToken {
+  static const MethodChannel _channel = MethodChannel('mssql_connect');
+  static int _nextRequestId = 0;
+
+  final Set<int> _requests = {};
+  bool _isCancelled = false;
+
+  bool get isCancelled => _isCancelled;
+
+  /// Cancel the calls made with this token.
+  ///
+  /// A call still waiting behind others on its connection never starts; a
+  /// running statement is interrupted on the server. Either way the call
+  /// fails with a [QueryCancelledException], and its connection stays open
+  /// and ready for the next call.
+  Future<void> cancel() async {
+    if (_isCancelled) {
+      return;
+    }
+    _isCancelled = true;
+    await Future.wait([
+      for (final requestId in _requests.toList())
+        _channel.invokeMethod('cancel', {'requestId': requestId}),
+    ]);
+  }
+}
+
+/// Per-call settings for [MsSqlConnection.query], [MsSqlConnection.execute]
+/// and the other statement calls that take them.
+class CallOptions {
+  /// Fail the call with a [QueryTimeoutException] once its statement has run
+  /// this long. ODBC counts query timeouts in whole seconds, so this is
+  /// rounded up to the next second.
+  final Duration? timeout;
+
+  /// Token whose [CancelToken.cancel] stops the call.
+  final CancelToken? cancelToken;
+
+  /// Serve a query from the native result cache, and store its result there
+  /// for this long on a miss. Only [MsSqlConnection.query] and its columnar
+  /// and binary variants use it, and only once
+  /// [MsSqlConnection.configureResultCache] has given the cache a budget.
+  final Duration? cacheTtl;
+
+  const CallOptions({this.timeout, this.cancelToken, this.cacheTtl});
+
+  /// Runs [call] with [args] plus the native arguments for these options,
+  /// keeping the call cancellable by [cancelToken] until it returns.
+  Future<T> run<T>(
+    Map<String, dynamic> args,
+    Future<T> Function(Map<String, dynamic> args) call,
+  ) async {
+    final token = cancelToken;
+    if (token != null && token._isCancelled) {
+      throw QueryCancelledException('Query was cancelled');
+    }
+    final requestId = token != null ? ++CancelToken._nextRequestId : null;
+    if (requestId != null) {
+      token!._requests.add(requestId);
+    }
+    try {
+      return await call({
+        ...args,
+        if (timeout != null) 'timeoutMs': timeout!.inMilliseconds,
+        if (cacheTtl != null) 'cacheTtlMs': cacheTtl!.inMilliseconds,
+        if (requestId != null) 'requestId': requestId,
+      });
+    } finally {
+      token?._requests.remove(requestId);
+    }
+  }
+}
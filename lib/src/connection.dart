@@ -1,7 +1,18 @@
 import 'dart:async';
 import 'package:flutter/services.dart';
+import 'batch_result.dart';
+import 'binary_result.dart';
+import 'call_options.dart';
 import 'query_result.dart';
 import 'exceptions.dart';
+import 'lob.dart';
+import 'pipeline.dart';
+import 'pool.dart';
+import 'procedure_result.dart';
+import 'result_cache.dart';
+import 'statement_cache.dart';
+import 'stats.dart';
+import 'transaction.dart';
 
 /// Main class for managing MS SQL Server connections
 class MsSqlConnection {
@@ -15,6 +26,19 @@ class MsSqlConnection {
   final int port;
   final bool trustedConnection;
 
+  /// Prepared statements kept per connection; 0 disables the cache.
+  final int statementCacheSize;
+
+  /// Fetch text as UTF-8 instead of transcoding it from UTF-16 when the
+  /// database has a UTF-8 collation and the client code page is UTF-8.
+  /// Ignored otherwise.
+  final bool utf8Text;
+
+  /// How long [connect], [acquire] and [testConnection] wait for the server
+  /// to accept the login, rounded up to whole seconds; null keeps the
+  /// driver's default.
+  final Duration? loginTimeout;
+
   bool _isConnected = false;
   int? _connectionId;
 
@@ -25,6 +49,9 @@ class MsSqlConnection {
     this.password,
     this.port = 1433,
     this.trustedConnection = false,
+    this.statementCacheSize = 32,
+    this.utf8Text = false,
+    this.loginTimeout = const Duration(seconds: 15),
   });
 
   /// Connect to the database
@@ -41,6 +68,9 @@ class MsSqlConnection {
         'password': password ?? '',
         'port': port,
         'trustedConnection': trustedConnection,
+        'statementCacheSize': statementCacheSize,
+        'utf8Text': utf8Text,
+        if (loginTimeout != null) 'loginTimeoutMs': loginTimeout!.inMilliseconds,
       });
 
       if (result is Map) {
@@ -58,60 +88,547 @@ class MsSqlConnection {
     }
   }
 
+  /// Take a connection from the native pool for this target.
+  ///
+  /// The pool is created with [options] on first use. Call [release] (or
+  /// [disconnect]) to hand the connection back instead of closing it.
+  Future<bool> acquire({PoolOptions options = const PoolOptions()}) async {
+    if (_isConnected) {
+      throw ConnectionException('Already connected to database');
+    }
+
+    try {
+      final result = await _channel.invokeMethod('acquire', {
+        'server': server,
+        'database': database,
+        'username': username ?? '',
+        'password': password ?? '',
+        'port': port,
+        'trustedConnection': trustedConnection,
+        'statementCacheSize': statementCacheSize,
+        'utf8Text': utf8Text,
+        if (loginTimeout != null) 'loginTimeoutMs': loginTimeout!.inMilliseconds,
+        ...options.toJson(),
+      });
+
+      if (result is Map) {
+        _isConnected = result['success'] == true;
+        _connectionId = result['connectionId'];
+        return _isConnected;
+      }
+
+      return false;
+    } on PlatformException catch (e) {
+      throw ConnectionException(
+        'Failed to acquire pooled connection',
+        details: e.details as String?,
+      );
+    }
+  }
+
+  /// Return a connection obtained with [acquire] to its pool
+  Future<void> release() async {
+    if (!_isConnected) {
+      return;
+    }
+
+    try {
+      await _channel.invokeMethod('release', {
+        'connectionId': _connectionId,
+      });
+      _isConnected = false;
+      _connectionId = null;
+    } on PlatformException catch (e) {
+      throw ConnectionException('Failed to release connection', details: e.details as String?);
+    }
+  }
+
+  /// Configure the process-wide ODBC environment.
+  ///
+  /// With [connectionPooling] the ODBC driver manager keeps closed
+  /// connections for reuse, which also speeds up plain [connect] calls.
+  /// Changes apply once every open connection has been closed.
+  ///
+  /// With [asyncExecution], [query] and [execute] run their statements in
+  /// ODBC asynchronous mode: two native threads wait on every executing
+  /// statement, so many slow queries on different connections no longer
+  /// each occupy a worker thread. Results are still fetched on the workers.
+  /// Drivers without asynchronous statement support run synchronously as
+  /// before. Applies to calls made after it returns.
+  static Future<void> configureEnvironment({
+    bool connectionPooling = false,
+    PoolMatch match = PoolMatch.strict,
+    bool asyncExecution = false,
+  }) async {
+    await _channel.invokeMethod('configureEnvironment', {
+      'connectionPooling': connectionPooling,
+      'poolMatch': match.name,
+      'asyncExecution': asyncExecution,
+    });
+  }
+
+  /// Counters for every native connection pool
+  static Future<List<PoolStats>> poolStats() async {
+    final result = await _channel.invokeMethod('getPoolStats');
+    if (result is List) {
+      return result
+          .whereType<Map>()
+          .map((pool) => PoolStats.fromJson(pool))
+          .toList();
+    }
+    return [];
+  }
+
+  /// Totals for the prepared statement caches of every connection
+  static Future<StatementCacheStats> statementCacheStats() async {
+    final result = await _channel.invokeMethod('getStatementCacheStats');
+    return StatementCacheStats.fromJson(result is Map ? result : const {});
+  }
+
+  /// Give the native query result cache a budget of [maxBytes], or turn it
+  /// off with zero (the default), which also empties it.
+  ///
+  /// Queries made with [CallOptions.cacheTtl] are then answered from the
+  /// cache while a result for the same target, SQL, parameters and result
+  /// format is fresh. The least recently used results are dropped once
+  /// they take up more than [maxBytes].
+  ///
+  /// The cache cannot see changes made by other clients of the database,
+  /// only writes through this plugin: every [execute], [executeBatch] and
+  /// [queryMulti] drops the cached results of its target that read the
+  /// tables it writes, and a stored procedure drops all of them.
+  static Future<void> configureResultCache({required int maxBytes}) async {
+    await _channel.invokeMethod('configureResultCache', {'maxBytes': maxBytes});
+  }
+
+  /// Drop cached results whose SQL matches [pattern] (`*` matches any run
+  /// of characters, `?` any one; case-insensitive), or that read any of
+  /// [tables], on every target. With neither, the whole cache is emptied.
+  /// Returns the number of results dropped.
+  static Future<int> invalidateResultCache({
+    String? pattern,
+    List<String>? tables,
+  }) async {
+    final result = await _channel.invokeMethod('invalidateResultCache', {
+      if (pattern != null) 'pattern': pattern,
+      if (tables != null) 'tables': tables,
+    });
+    return result is int ? result : 0;
+  }
+
+  /// Counters of the native query result cache
+  static Future<ResultCacheStats> resultCacheStats() async {
+    final result = await _channel.invokeMethod('getResultCacheStats');
+    return ResultCacheStats.fromJson(result is Map ? result : const {});
+  }
+
+  /// Start or stop collecting call statistics, which are off by default.
+  ///
+  /// While on, [connect], [query] and [execute] count their calls, errors,
+  /// rows and result bytes, and time each phase of their native work; see
+  /// [stats]. While off they cost a few nanoseconds each. Counters keep
+  /// their values while collection is off.
+  static Future<void> configureStats({required bool enabled}) async {
+    await _channel.invokeMethod('configureStats', {'enabled': enabled});
+  }
+
+  /// Call statistics of the whole process and of every open connection.
+  /// With [reset] they all start over after being read.
+  static Future<StatsReport> stats({bool reset = false}) async {
+    final result = await _channel.invokeMethod('getStats', {'reset': reset});
+    return StatsReport.fromJson(result is Map ? result : const {});
+  }
+
+  /// Start or stop recording a timeline of every native call, which is off
+  /// by default. With [clear] the spans recorded so far are dropped.
+  ///
+  /// Each call records spans for its time in the worker queue and its
+  /// reply; [query] and [execute] also record preparing the statement,
+  /// executing it, describing the result, every block of rows fetched and
+  /// building the result. The newest 65536 spans are kept. See [dumpTrace].
+  static Future<void> configureTrace({required bool enabled, bool clear = false}) async {
+    await _channel.invokeMethod('configureTrace', {'enabled': enabled, 'clear': clear});
+  }
+
+  /// Write the recorded spans to the local file at [path] as Chrome
+  /// trace-event JSON, to open in chrome://tracing or ui.perfetto.dev.
+  /// Each connection shows up as a process and each call as a track of it,
+  /// labelled with its request id if it was made with a [CancelToken]. With
+  /// [clear] the spans are
+  /// dropped once written. Returns the number of spans written.
+  static Future<int> dumpTrace(String path, {bool clear = false}) async {
+    final result = await _channel.invokeMethod('dumpTrace', {'path': path, 'clear': clear});
+    return result is int ? result : 0;
+  }
+
   /// Execute a SELECT query
-  Future<QueryResult> query(String sql, [List<dynamic>? parameters]) async {
+  ///
+  /// [options] sets a timeout or a [CancelToken] for this call.
+  Future<QueryResult> query(
+    String sql, [
+    List<dynamic>? parameters,
+    CallOptions options = const CallOptions(),
+  ]) async {
     _ensureConnected();
 
     try {
-      final result = await _channel.invokeMethod('query', {
+      final result = await options.run({
         'connectionId': _connectionId,
         'sql': sql,
         'parameters': parameters ?? [],
-      });
+      }, (args) => _channel.invokeMethod('query', args));
+
+      if (result is Map) {
+        return QueryResult.fromJson(result);
+      }
+
+      throw QueryException('Invalid query result format');
+    } on PlatformException catch (e) {
+      throw _queryException('Query execution failed', e.code, e.details as String?);
+    }
+  }
+
+  /// Execute a batch of statements, e.g. `SELECT ...; SELECT ...`, in one
+  /// round trip and receive every result in order.
+  ///
+  /// Each SELECT produces a [QueryResult] with its own columns and rows.
+  /// Statements that return no rows, such as an UPDATE between two SELECTs,
+  /// produce an entry with [QueryResult.rowsAffected] set, unless the batch
+  /// runs with `SET NOCOUNT ON`.
+  Future<List<QueryResult>> queryMulti(
+    String sql, {
+    List<dynamic>? parameters,
+    bool columnar = false,
+    CallOptions options = const CallOptions(),
+  }) async {
+    _ensureConnected();
+
+    try {
+      final result = await options.run({
+        'connectionId': _connectionId,
+        'sql': sql,
+        'parameters': parameters ?? [],
+        if (columnar) 'resultFormat': 'columnar',
+      }, (args) => _channel.invokeMethod('queryMulti', args));
+
+      if (result is Map && result['results'] is List) {
+        return (result['results'] as List)
+            .whereType<Map>()
+            .map((item) => QueryResult.fromJson(item))
+            .toList(growable: false);
+      }
+
+      throw QueryException('Invalid query result format');
+    } on PlatformException catch (e) {
+      throw _queryException('Query execution failed', e.code, e.details as String?);
+    }
+  }
+
+  /// Execute a SELECT query and receive the result column by column.
+  ///
+  /// Column names are sent once and each column arrives as a typed list, which
+  /// is much cheaper to encode and decode than one map per row for large
+  /// results. Read values with [QueryResult.columns]; [QueryResult.rows] still
+  /// works and returns lazy row views.
+  Future<QueryResult> queryColumnar(
+    String sql, [
+    List<dynamic>? parameters,
+    CallOptions options = const CallOptions(),
+  ]) async {
+    _ensureConnected();
+
+    try {
+      final result = await options.run({
+        'connectionId': _connectionId,
+        'sql': sql,
+        'parameters': parameters ?? [],
+        'resultFormat': 'columnar',
+      }, (args) => _channel.invokeMethod('query', args));
 
       if (result is Map) {
         return QueryResult.fromJson(result);
       }
 
       throw QueryException('Invalid query result format');
+    } on PlatformException catch (e) {
+      throw _queryException('Query execution failed', e.code, e.details as String?);
+    }
+  }
+
+  /// Execute a SELECT query and receive the result in the binary result
+  /// encoding, on a channel of its own.
+  ///
+  /// The native side sends the whole result as one byte buffer (a schema
+  /// header, fixed-width column blocks, string heaps and null bitmaps)
+  /// instead of standard-codec values, and nothing is decoded up front:
+  /// numeric columns are views of the buffer and text is decoded when a
+  /// cell is read. The result is columnar, like [queryColumnar]'s.
+  Future<QueryResult> queryBinary(
+    String sql, [
+    List<dynamic>? parameters,
+    CallOptions options = const CallOptions(),
+  ]) async {
+    _ensureConnected();
+
+    final reply = await options.run({
+      'method': 'query',
+      'connectionId': _connectionId,
+      'sql': sql,
+      'parameters': parameters ?? [],
+    }, (args) {
+      return ServicesBinding.instance.defaultBinaryMessenger.send(
+        binaryChannelName,
+        const StandardMessageCodec().encodeMessage(args),
+      );
+    });
+    if (reply == null) {
+      throw QueryException('Binary results are not supported on this platform');
+    }
+    if (BinaryResult.isError(reply)) {
+      final (code, details) = BinaryResult.readError(reply);
+      throw _queryException('Query execution failed', code, details);
+    }
+    return QueryResult.fromBinary(reply);
+  }
+
+  /// Execute a SELECT query and stream its rows in chunks.
+  ///
+  /// The statement stays open on the native side as a cursor and each chunk
+  /// is fetched only when the previous one has been consumed, so memory stays
+  /// bounded by one chunk however large the result is. A chunk holds at most
+  /// [maxRows] rows and, if [maxBytes] is set, stops once it holds about that
+  /// much data. Cancelling the subscription closes the cursor.
+  ///
+  /// Text and binary values come back as [String] and [Uint8List]. With a
+  /// [lobThreshold] (in bytes), a value of the last selected column that is
+  /// longer than that is not read with its row: the cell holds a [LobRef]
+  /// instead and the chunk ends at that row, and [readLob] reads the value
+  /// in pieces. It has to be read before the next chunk is requested.
+  Stream<List<Row>> queryStream(
+    String sql, {
+    List<dynamic>? parameters,
+    int maxRows = 1000,
+    int? maxBytes,
+    int? lobThreshold,
+  }) async* {
+    _ensureConnected();
+    final connectionId = _connectionId;
+
+    final int cursorId;
+    try {
+      final opened = await _channel.invokeMethod('openCursor', {
+        'connectionId': connectionId,
+        'sql': sql,
+        'parameters': parameters ?? [],
+        if (lobThreshold != null) 'lobThreshold': lobThreshold,
+      });
+      cursorId = (opened as Map)['cursorId'] as int;
     } on PlatformException catch (e) {
       throw QueryException('Query execution failed', details: e.details as String?);
     }
+
+    // The native side closes the cursor itself after the last chunk or a
+    // failed fetch.
+    var closed = false;
+    try {
+      while (!closed) {
+        final chunk = await _channel.invokeMethod('fetchNext', {
+          'connectionId': connectionId,
+          'cursorId': cursorId,
+          'maxRows': maxRows,
+          if (maxBytes != null) 'maxBytes': maxBytes,
+        });
+        if (chunk is! Map) {
+          throw QueryException('Invalid query result format');
+        }
+        closed = chunk['done'] == true;
+        final result = QueryResult.fromJson(chunk);
+        if (lobThreshold != null) {
+          for (final row in result.rows) {
+            for (final name in result.columnNames) {
+              final lob = LobRef.fromCell(row[name], connectionId!, cursorId);
+              if (lob != null) {
+                row[name] = lob;
+              }
+            }
+          }
+        }
+        if (result.isNotEmpty) {
+          yield result.rows;
+        }
+      }
+    } on PlatformException catch (e) {
+      closed = true;
+      throw QueryException('Fetching rows failed', details: e.details as String?);
+    } finally {
+      if (!closed) {
+        await _channel.invokeMethod('closeCursor', {
+          'connectionId': connectionId,
+          'cursorId': cursorId,
+        });
+      }
+    }
+  }
+
+  /// Read up to [length] bytes (binary columns) or UTF-16 code units (text
+  /// columns) of [lob] starting at [offset].
+  ///
+  /// Reads must move forward through the value; a text read may return one
+  /// unit less than asked for rather than split a surrogate pair.
+  Future<LobChunk> readLob(LobRef lob, {int offset = 0, int length = 65536}) async {
+    _ensureConnected();
+
+    try {
+      final result = await _channel.invokeMethod('readLob', {
+        'connectionId': lob.connectionId,
+        'cursorId': lob.cursorId,
+        'lobToken': lob.token,
+        'offset': offset,
+        'length': length,
+      });
+      if (result is! Map) {
+        throw QueryException('Invalid LOB result format');
+      }
+      return LobChunk.fromJson(result);
+    } on PlatformException catch (e) {
+      throw QueryException('Reading LOB failed', details: e.details as String?);
+    }
   }
 
   /// Execute INSERT, UPDATE, DELETE commands
-  Future<int> execute(String sql, [List<dynamic>? parameters]) async {
+  ///
+  /// [options] sets a timeout or a [CancelToken] for this call.
+  Future<int> execute(
+    String sql, [
+    List<dynamic>? parameters,
+    CallOptions options = const CallOptions(),
+  ]) async {
     _ensureConnected();
 
     try {
-      final result = await _channel.invokeMethod('execute', {
+      final result = await options.run({
         'connectionId': _connectionId,
         'sql': sql,
         'parameters': parameters ?? [],
-      });
+      }, (args) => _channel.invokeMethod('execute', args));
 
       return result as int? ?? 0;
     } on PlatformException catch (e) {
-      throw QueryException('Execute command failed', details: e.details as String?);
+      throw _queryException('Execute command failed', e.code, e.details as String?);
+    }
+  }
+
+  /// Execute [sql] once for every row of [rows], e.g. a parameterized
+  /// INSERT for a bulk upload.
+  ///
+  /// Each row holds the parameter values for one execution, and every row
+  /// must have the same number of values. Rows are sent as parameter arrays
+  /// of up to [batchSize] rows, one round trip per batch. Rows the server
+  /// rejects are reported in [BatchResult.statuses] and do not stop the
+  /// upload; run the batch in a transaction to make it all-or-nothing.
+  Future<BatchResult> executeBatch(
+    String sql,
+    List<List<Object?>> rows, {
+    int batchSize = 1000,
+  }) async {
+    _ensureConnected();
+
+    try {
+      final result = await _channel.invokeMethod('executeBatch', {
+        'connectionId': _connectionId,
+        'sql': sql,
+        'rows': rows,
+        'batchSize': batchSize,
+      });
+
+      if (result is Map) {
+        return BatchResult.fromJson(result);
+      }
+
+      throw QueryException('Invalid batch result format');
+    } on PlatformException catch (e) {
+      throw QueryException('Batch execution failed', details: e.details as String?);
     }
   }
 
+  /// Run [operations] in order on this connection in one platform channel
+  /// call and receive one result per operation.
+  ///
+  /// Consecutive queries that only read are sent to the server together as
+  /// one batch, so they also share a network round trip; commands, and
+  /// queries that may write, run on their own. Every query must return
+  /// exactly one result set. Statements are prepared once per connection
+  /// and reused, as for [query] and [execute].
+  ///
+  /// If an operation fails, the ones after it are skipped and a
+  /// [PipelineException] carries the results of the ones before it. The
+  /// pipeline is not atomic; run it in a [transaction] for that.
+  Future<List<QueryResult>> pipeline(
+    List<PipelineOp> operations, {
+    bool columnar = false,
+    CallOptions options = const CallOptions(),
+  }) async {
+    _ensureConnected();
+
+    final Object? result;
+    try {
+      result = await options.run({
+        'connectionId': _connectionId,
+        'operations': [for (final operation in operations) operation.toJson()],
+        if (columnar) 'resultFormat': 'columnar',
+      }, (args) => _channel.invokeMethod('pipeline', args));
+    } on PlatformException catch (e) {
+      throw _queryException('Pipeline failed', e.code, e.details as String?);
+    }
+
+    if (result is! Map || result['results'] is! List) {
+      throw QueryException('Invalid pipeline result format');
+    }
+    final results = (result['results'] as List)
+        .whereType<Map>()
+        .map((item) => QueryResult.fromJson(item))
+        .toList(growable: false);
+    final failedIndex = result['failedIndex'];
+    if (failedIndex is int) {
+      throw PipelineException(
+        'Pipeline operation $failedIndex failed',
+        index: failedIndex,
+        code: result['errorCode'] as String? ?? 'QueryError',
+        completed: results,
+        details: result['error'] as String?,
+      );
+    }
+    return results;
+  }
+
   /// Execute a stored procedure
-  Future<QueryResult> executeStoredProcedure(
+  ///
+  /// [parameters] maps the procedure's parameter names (with or without the
+  /// `@`) to values; wrap a value in [OutputParameter] to read it back. The
+  /// call, its result sets, output parameters and return value all come
+  /// back in one reply.
+  Future<ProcedureResult> executeStoredProcedure(
     String procedureName,
-    Map<String, dynamic> parameters,
-  ) async {
+    Map<String, dynamic> parameters, {
+    bool columnar = false,
+  }) async {
     _ensureConnected();
 
     try {
       final result = await _channel.invokeMethod('executeStoredProcedure', {
         'connectionId': _connectionId,
         'procedureName': procedureName,
-        'parameters': parameters,
+        'parameters': [
+          for (final entry in parameters.entries)
+            entry.value is OutputParameter
+                ? (entry.value as OutputParameter).toJson(entry.key)
+                : {'name': entry.key, 'direction': 'in', 'value': entry.value},
+        ],
+        if (columnar) 'resultFormat': 'columnar',
       });
 
       if (result is Map) {
-        return QueryResult.fromJson(result);
+        return ProcedureResult.fromJson(result);
       }
 
       throw QueryException('Invalid stored procedure result format');
@@ -123,6 +640,77 @@ class MsSqlConnection {
     }
   }
 
+  /// Start an explicit transaction on this connection.
+  ///
+  /// Every statement until [commit] or [rollback] runs in it, so a series of
+  /// writes costs the server one log flush instead of one per statement.
+  /// [isolationLevel] applies to this transaction only; null keeps the
+  /// connection's level. Releasing or disconnecting the connection rolls
+  /// back a transaction that is still open.
+  ///
+  /// Queries in a transaction do not use the result cache, and a commit
+  /// drops the cached results of this connection's target.
+  Future<void> beginTransaction([IsolationLevel? isolationLevel]) {
+    return _transactionCall('beginTransaction', {
+      if (isolationLevel != null) 'isolationLevel': isolationLevel.name,
+    });
+  }
+
+  /// Commit the transaction started with [beginTransaction]. If the commit
+  /// fails the transaction stays open and should be rolled back.
+  Future<void> commit() => _transactionCall('commit');
+
+  /// Roll back the transaction started with [beginTransaction].
+  Future<void> rollback() => _transactionCall('rollback');
+
+  /// Mark a point in the current transaction that [rollbackTo] can return
+  /// to. [name] must be a plain identifier of at most 32 characters.
+  Future<void> savepoint(String name) => _transactionCall('savepoint', {'name': name});
+
+  /// Undo everything since the latest [savepoint] called [name], keeping
+  /// the transaction open. Savepoints taken after it are forgotten.
+  Future<void> rollbackTo(String name) => _transactionCall('rollbackTo', {'name': name});
+
+  /// Run [action] in a transaction: commit if it completes, roll back and
+  /// rethrow if it or the commit throws. The error from [action] or
+  /// [commit] is the one rethrown, even if the rollback fails too.
+  Future<T> transaction<T>(
+    Future<T> Function() action, {
+    IsolationLevel? isolationLevel,
+  }) async {
+    await beginTransaction(isolationLevel);
+    final T result;
+    try {
+      result = await action();
+      await commit();
+    } catch (_) {
+      try {
+        await rollback();
+      } catch (_) {
+        // The connection rolls back an open transaction when it is
+        // released or disconnected; the first error is the useful one.
+      }
+      rethrow;
+    }
+    return result;
+  }
+
+  Future<void> _transactionCall(String method, [Map<String, Object?> args = const {}]) async {
+    _ensureConnected();
+
+    try {
+      await _channel.invokeMethod(method, {
+        'connectionId': _connectionId,
+        ...args,
+      });
+    } on PlatformException catch (e) {
+      throw TransactionException(
+        e.message ?? 'Transaction call failed',
+        details: e.details as String?,
+      );
+    }
+  }
+
   /// Disconnect from the database
   Future<void> disconnect() async {
     if (!_isConnected) {
@@ -150,6 +738,7 @@ class MsSqlConnection {
         'password': password ?? '',
         'port': port,
         'trustedConnection': trustedConnection,
+        if (loginTimeout != null) 'loginTimeoutMs': loginTimeout!.inMilliseconds,
       });
 
       return result == true;
@@ -164,6 +753,19 @@ class MsSqlConnection {
   /// Check if connected
   bool get isConnected => _isConnected;
 
+  /// The exception for a failed statement call with native error [code];
+  /// timeouts and cancellations get their own types.
+  static QueryException _queryException(String message, String code, String? details) {
+    switch (code) {
+      case 'Timeout':
+        return QueryTimeoutException('Query timed out', details: details);
+      case 'Cancelled':
+        return QueryCancelledException('Query was cancelled', details: details);
+      default:
+        return QueryException(message, details: details);
+    }
+  }
+
   /// Ensure connection is active
   void _ensureConnected() {
     if (!_isConnected) {
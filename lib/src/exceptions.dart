@@ -25,3 +25,21 @@ class QueryException extends DatabaseException {
   QueryException(String message, {String? details})
     : super(message, details: details);
 }
+
+/// Exception for a statement that ran past its [CallOptions.timeout]
+class QueryTimeoutException extends QueryException {
+  QueryTimeoutException(String message, {String? details})
+    : super(message, details: details);
+}
+
+/// Exception for a call stopped with [CancelToken.cancel]
+class QueryCancelledException extends QueryException {
+  QueryCancelledException(String message, {String? details})
+    : super(message, details: details);
+}
+
+/// Exception for a failed transaction call, e.g. [MsSqlConnection.commit]
+class TransactionException extends DatabaseException {
+  TransactionException(String message, {String? details})
+    : super(message, details: details);
+}
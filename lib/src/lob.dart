@@ -0,0 +1,60 @@
+import 'dart:typed_data';
+
+/// A large value that [MsSqlConnection.queryStream] left on the server
+/// instead of reading it with its row; see its `lobThreshold`.
+///
+/// Read it with [MsSqlConnection.readLob] before asking the stream for the
+/// next chunk: once the cursor moves on the value is gone.
+class LobRef {
+  final int connectionId;
+  final int cursorId;
+  final int token;
+
+  const LobRef({
+    required this.connectionId,
+    required this.cursorId,
+    required this.token,
+  });
+
+  /// The reference encoded by the native side for [value], or null if
+  /// [value] is an ordinary cell.
+  static LobRef? fromCell(Object? value, int connectionId, int cursorId) {
+    if (value is Map && value['lobToken'] is int) {
+      return LobRef(
+        connectionId: connectionId,
+        cursorId: cursorId,
+        token: value['lobToken'] as int,
+      );
+    }
+    return null;
+  }
+
+  @override
+  String toString() => 'LobRef(cursorId: $cursorId, token: $token)';
+}
+
+/// One piece of a value read with [MsSqlConnection.readLob].
+class LobChunk {
+  /// A [Uint8List] for binary columns, a [String] for text columns.
+  final Object data;
+
+  /// Bytes (binary) or UTF-16 code units (text) read; the offset of the
+  /// next read is the previous offset plus [units].
+  final int units;
+
+  /// Whether the value has been read to its end.
+  final bool isEnd;
+
+  const LobChunk({required this.data, required this.units, required this.isEnd});
+
+  factory LobChunk.fromJson(Map<dynamic, dynamic> json) {
+    return LobChunk(
+      data: json['data'] as Object,
+      units: json['units'] as int? ?? 0,
+      isEnd: json['end'] == true,
+    );
+  }
+
+  Uint8List get bytes => data as Uint8List;
+  String get text => data as String;
+}
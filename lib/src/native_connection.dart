@@ -0,0 +1,514 @@
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+import 'exceptions.dart';
+import 'query_result.dart';
+
+// Result codes and column types of src/ffi_api.h.
+const int _ok = 0;
+const int _row = 100;
+const int _done = 101;
+
+const Map<int, String> _typeNames = {
+  1: 'bool',
+  2: 'int',
+  3: 'double',
+  4: 'decimal',
+  5: 'datetime',
+  6: 'time',
+  7: 'guid',
+  8: 'string',
+  9: 'binary',
+};
+
+final class _Connection extends Opaque {}
+
+final class _Statement extends Opaque {}
+
+/// Bindings to the plugin library's C API, loaded once per isolate.
+class _Api {
+  static final _Api instance = _Api(_openLibrary());
+
+  static DynamicLibrary _openLibrary() {
+    if (Platform.isLinux) {
+      return DynamicLibrary.open('libmssql_connect_plugin.so');
+    }
+    if (Platform.isWindows) {
+      return DynamicLibrary.open('mssql_connect_plugin.dll');
+    }
+    throw UnsupportedError(
+      'NativeConnection is not supported on ${Platform.operatingSystem}',
+    );
+  }
+
+  _Api(DynamicLibrary library)
+    : open = library.lookupFunction<
+          Int32 Function(
+            Pointer<Utf8>,
+            Pointer<Utf8>,
+            Pointer<Utf8>,
+            Pointer<Utf8>,
+            Int64,
+            Pointer<Pointer<_Connection>>,
+          ),
+          int Function(
+            Pointer<Utf8>,
+            Pointer<Utf8>,
+            Pointer<Utf8>,
+            Pointer<Utf8>,
+            int,
+            Pointer<Pointer<_Connection>>,
+          )
+        >('mssql_open'),
+      close = library
+          .lookupFunction<
+            Void Function(Pointer<_Connection>),
+            void Function(Pointer<_Connection>)
+          >('mssql_close'),
+      errcode = library
+          .lookupFunction<
+            Pointer<Utf8> Function(Pointer<_Connection>),
+            Pointer<Utf8> Function(Pointer<_Connection>)
+          >('mssql_errcode'),
+      errmsg = library
+          .lookupFunction<
+            Pointer<Utf8> Function(Pointer<_Connection>),
+            Pointer<Utf8> Function(Pointer<_Connection>)
+          >('mssql_errmsg'),
+      prepare = library
+          .lookupFunction<
+            Int32 Function(
+              Pointer<_Connection>,
+              Pointer<Utf8>,
+              Int64,
+              Pointer<Pointer<_Statement>>,
+            ),
+            int Function(
+              Pointer<_Connection>,
+              Pointer<Utf8>,
+              int,
+              Pointer<Pointer<_Statement>>,
+            )
+          >('mssql_prepare'),
+      finalize = library
+          .lookupFunction<
+            Void Function(Pointer<_Statement>),
+            void Function(Pointer<_Statement>)
+          >('mssql_finalize'),
+      reset = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>),
+            int Function(Pointer<_Statement>)
+          >('mssql_reset'),
+      clearBindings = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>),
+            int Function(Pointer<_Statement>)
+          >('mssql_clear_bindings'),
+      bindNull = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>, Int32),
+            int Function(Pointer<_Statement>, int)
+          >('mssql_bind_null'),
+      bindBool = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>, Int32, Int32),
+            int Function(Pointer<_Statement>, int, int)
+          >('mssql_bind_bool'),
+      bindInt64 = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>, Int32, Int64),
+            int Function(Pointer<_Statement>, int, int)
+          >('mssql_bind_int64'),
+      bindDouble = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>, Int32, Double),
+            int Function(Pointer<_Statement>, int, double)
+          >('mssql_bind_double'),
+      bindText = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>, Int32, Pointer<Utf8>, Int32),
+            int Function(Pointer<_Statement>, int, Pointer<Utf8>, int)
+          >('mssql_bind_text'),
+      bindBlob = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>, Int32, Pointer<Uint8>, Int32),
+            int Function(Pointer<_Statement>, int, Pointer<Uint8>, int)
+          >('mssql_bind_blob'),
+      step = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>),
+            int Function(Pointer<_Statement>)
+          >('mssql_step'),
+      changes = library
+          .lookupFunction<
+            Int64 Function(Pointer<_Statement>),
+            int Function(Pointer<_Statement>)
+          >('mssql_changes'),
+      columnCount = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>),
+            int Function(Pointer<_Statement>)
+          >('mssql_column_count'),
+      columnName = library
+          .lookupFunction<
+            Pointer<Utf8> Function(Pointer<_Statement>, Int32),
+            Pointer<Utf8> Function(Pointer<_Statement>, int)
+          >('mssql_column_name'),
+      columnType = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>, Int32),
+            int Function(Pointer<_Statement>, int)
+          >('mssql_column_type'),
+      columnIsNull = library
+          .lookupFunction<
+            Int32 Function(Pointer<_Statement>, Int32),
+            int Function(Pointer<_Statement>, int)
+          >('mssql_column_is_null'),
+      columnInt64 = library
+          .lookupFunction<
+            Int64 Function(Pointer<_Statement>, Int32),
+            int Function(Pointer<_Statement>, int)
+          >('mssql_column_int64'),
+      columnDouble = library
+          .lookupFunction<
+            Double Function(Pointer<_Statement>, Int32),
+            double Function(Pointer<_Statement>, int)
+          >('mssql_column_double'),
+      columnText = library
+          .lookupFunction<
+            Pointer<Utf8> Function(Pointer<_Statement>, Int32, Pointer<Int32>),
+            Pointer<Utf8> Function(Pointer<_Statement>, int, Pointer<Int32>)
+          >('mssql_column_text'),
+      columnBlob = library
+          .lookupFunction<
+            Pointer<Uint8> Function(Pointer<_Statement>, Int32, Pointer<Int32>),
+            Pointer<Uint8> Function(Pointer<_Statement>, int, Pointer<Int32>)
+          >('mssql_column_blob');
+
+  final int Function(
+    Pointer<Utf8>,
+    Pointer<Utf8>,
+    Pointer<Utf8>,
+    Pointer<Utf8>,
+    int,
+    Pointer<Pointer<_Connection>>,
+  )
+  open;
+  final void Function(Pointer<_Connection>) close;
+  final Pointer<Utf8> Function(Pointer<_Connection>) errcode;
+  final Pointer<Utf8> Function(Pointer<_Connection>) errmsg;
+  final int Function(
+    Pointer<_Connection>,
+    Pointer<Utf8>,
+    int,
+    Pointer<Pointer<_Statement>>,
+  )
+  prepare;
+  final void Function(Pointer<_Statement>) finalize;
+  final int Function(Pointer<_Statement>) reset;
+  final int Function(Pointer<_Statement>) clearBindings;
+  final int Function(Pointer<_Statement>, int) bindNull;
+  final int Function(Pointer<_Statement>, int, int) bindBool;
+  final int Function(Pointer<_Statement>, int, int) bindInt64;
+  final int Function(Pointer<_Statement>, int, double) bindDouble;
+  final int Function(Pointer<_Statement>, int, Pointer<Utf8>, int) bindText;
+  final int Function(Pointer<_Statement>, int, Pointer<Uint8>, int) bindBlob;
+  final int Function(Pointer<_Statement>) step;
+  final int Function(Pointer<_Statement>) changes;
+  final int Function(Pointer<_Statement>) columnCount;
+  final Pointer<Utf8> Function(Pointer<_Statement>, int) columnName;
+  final int Function(Pointer<_Statement>, int) columnType;
+  final int Function(Pointer<_Statement>, int) columnIsNull;
+  final int Function(Pointer<_Statement>, int) columnInt64;
+  final double Function(Pointer<_Statement>, int) columnDouble;
+  final Pointer<Utf8> Function(Pointer<_Statement>, int, Pointer<Int32>)
+  columnText;
+  final Pointer<Uint8> Function(Pointer<_Statement>, int, Pointer<Int32>)
+  columnBlob;
+}
+
+/// A connection that calls the native engine synchronously through
+/// `dart:ffi`, without the platform channel's thread hop and message
+/// encoding.
+///
+/// Meant for short, frequent statements such as lookups by key, where the
+/// channel round trip costs more than the query. Every call blocks the
+/// calling isolate until the server answers, so run long statements from a
+/// background isolate, e.g. with `Isolate.run`, or use [MsSqlConnection].
+///
+/// A native connection is separate from the connections of
+/// [MsSqlConnection] and must be used from one isolate only. Supported on
+/// Linux and Windows.
+class NativeConnection {
+  final _Api _api;
+  Pointer<_Connection> _handle;
+
+  NativeConnection._(this._api, this._handle);
+
+  /// Connects to [database] on [server], throwing [ConnectionException] on
+  /// failure.
+  factory NativeConnection.open({
+    required String server,
+    required String database,
+    String? username,
+    String? password,
+    Duration? loginTimeout,
+  }) {
+    final api = _Api.instance;
+    return using((arena) {
+      final out = arena<Pointer<_Connection>>();
+      final result = api.open(
+        server.toNativeUtf8(allocator: arena),
+        database.toNativeUtf8(allocator: arena),
+        (username ?? '').toNativeUtf8(allocator: arena),
+        (password ?? '').toNativeUtf8(allocator: arena),
+        loginTimeout?.inMilliseconds ?? 0,
+        out,
+      );
+      if (result != _ok) {
+        final details = out.value == nullptr
+            ? null
+            : api.errmsg(out.value).toDartString();
+        api.close(out.value);
+        throw ConnectionException(
+          'Failed to connect to database',
+          details: details,
+        );
+      }
+      return NativeConnection._(api, out.value);
+    });
+  }
+
+  bool get isOpen => _handle != nullptr;
+
+  /// Prepares [sql], reusing the connection's cached statement for the same
+  /// text. Call [NativeStatement.close] when done with it.
+  NativeStatement prepare(String sql, {Duration? timeout}) {
+    _ensureOpen();
+    return using((arena) {
+      final out = arena<Pointer<_Statement>>();
+      final result = _api.prepare(
+        _handle,
+        sql.toNativeUtf8(allocator: arena),
+        timeout?.inMilliseconds ?? 0,
+        out,
+      );
+      if (result != _ok) {
+        throw _error('Failed to prepare statement');
+      }
+      return NativeStatement._(this, out.value);
+    });
+  }
+
+  /// Runs [sql] with [parameters] and returns its rows.
+  QueryResult query(
+    String sql, {
+    List<Object?> parameters = const [],
+    Duration? timeout,
+  }) {
+    final statement = prepare(sql, timeout: timeout);
+    try {
+      statement.bind(parameters);
+      return statement.readAll();
+    } finally {
+      statement.close();
+    }
+  }
+
+  /// Runs the command [sql] with [parameters] and returns the rows it
+  /// affected, or -1 when the driver does not report them.
+  int execute(
+    String sql, {
+    List<Object?> parameters = const [],
+    Duration? timeout,
+  }) {
+    final statement = prepare(sql, timeout: timeout);
+    try {
+      statement.bind(parameters);
+      while (statement.step()) {}
+      return statement.changes;
+    } finally {
+      statement.close();
+    }
+  }
+
+  /// Disconnects. Statements of this connection must be closed first.
+  void close() {
+    if (_handle != nullptr) {
+      _api.close(_handle);
+      _handle = nullptr;
+    }
+  }
+
+  void _ensureOpen() {
+    if (_handle == nullptr) {
+      throw ConnectionException('Native connection is closed');
+    }
+  }
+
+  /// The exception for the last failed call; timeouts and cancellations
+  /// get their own types, as with [MsSqlConnection].
+  QueryException _error(String message) {
+    final code = _api.errcode(_handle).toDartString();
+    final details = _api.errmsg(_handle).toDartString();
+    switch (code) {
+      case 'Timeout':
+        return QueryTimeoutException('Query timed out', details: details);
+      case 'Cancelled':
+        return QueryCancelledException('Query was cancelled', details: details);
+      default:
+        return QueryException(message, details: details);
+    }
+  }
+}
+
+/// A prepared statement of a [NativeConnection]
+class NativeStatement {
+  final NativeConnection _connection;
+  Pointer<_Statement> _handle;
+
+  NativeStatement._(this._connection, this._handle);
+
+  _Api get _api => _connection._api;
+
+  /// Sets the ? placeholders, in order, to [parameters]: null, bool, int,
+  /// double, String or [Uint8List]. Only allowed before the first [step]
+  /// or after [reset].
+  void bind(List<Object?> parameters) {
+    _api.clearBindings(_handle);
+    for (var i = 0; i < parameters.length; i++) {
+      final index = i + 1;
+      final value = parameters[i];
+      final int result;
+      if (value == null) {
+        result = _api.bindNull(_handle, index);
+      } else if (value is bool) {
+        result = _api.bindBool(_handle, index, value ? 1 : 0);
+      } else if (value is int) {
+        result = _api.bindInt64(_handle, index, value);
+      } else if (value is double) {
+        result = _api.bindDouble(_handle, index, value);
+      } else if (value is String) {
+        result = using((arena) {
+          final text = value.toNativeUtf8(allocator: arena);
+          return _api.bindText(_handle, index, text, text.length);
+        });
+      } else if (value is Uint8List) {
+        result = using((arena) {
+          final bytes = arena<Uint8>(value.length);
+          bytes.asTypedList(value.length).setAll(0, value);
+          return _api.bindBlob(_handle, index, bytes, value.length);
+        });
+      } else {
+        throw ArgumentError.value(
+          value,
+          'parameters[$i]',
+          'Unsupported parameter type',
+        );
+      }
+      if (result != _ok) {
+        throw StateError('Parameters can only be bound before step()');
+      }
+    }
+  }
+
+  /// Executes the statement on the first call, then moves to the next row.
+  /// Returns false once there are no more rows.
+  bool step() {
+    final result = _api.step(_handle);
+    if (result == _row) {
+      return true;
+    }
+    if (result == _done) {
+      return false;
+    }
+    throw _connection._error('Query execution failed');
+  }
+
+  /// Rows affected by a statement without a result set, once [step] has
+  /// returned false; -1 when the driver does not report them.
+  int get changes => _api.changes(_handle);
+
+  /// Ends the current execution so the statement can run again with new
+  /// parameters.
+  void reset() {
+    _api.reset(_handle);
+  }
+
+  /// Result column names, once [step] has been called.
+  List<String> get columnNames => [
+    for (var i = 0; i < _api.columnCount(_handle); i++)
+      _api.columnName(_handle, i).toDartString(),
+  ];
+
+  /// The cell of [column] in the current row, as [MsSqlConnection.query]
+  /// would return it before decoding by [QueryResult].
+  Object? _rawCell(int column, int type, Pointer<Int32> length) {
+    if (_api.columnIsNull(_handle, column) != 0) {
+      return null;
+    }
+    switch (type) {
+      case 1:
+        return _api.columnInt64(_handle, column) != 0;
+      case 2:
+      case 5:
+      case 6:
+        return _api.columnInt64(_handle, column);
+      case 3:
+        return _api.columnDouble(_handle, column);
+      case 7:
+      case 9:
+        final bytes = _api.columnBlob(_handle, column, length);
+        return Uint8List.fromList(bytes.asTypedList(length.value));
+      default:
+        final text = _api.columnText(_handle, column, length);
+        return text.toDartString(length: length.value);
+    }
+  }
+
+  /// Steps through every remaining row and returns them.
+  QueryResult readAll() {
+    final rows = <Map<String, dynamic>>[];
+    var names = const <String>[];
+    var types = const <String>[];
+    using((arena) {
+      final length = arena<Int32>();
+      var codes = const <int>[];
+      while (step()) {
+        if (rows.isEmpty) {
+          names = columnNames;
+          codes = [
+            for (var i = 0; i < names.length; i++)
+              _api.columnType(_handle, i),
+          ];
+          types = [for (final code in codes) _typeNames[code] ?? 'string'];
+        }
+        rows.add({
+          for (var i = 0; i < names.length; i++)
+            names[i]: _rawCell(i, codes[i], length),
+        });
+      }
+    });
+    if (rows.isEmpty) {
+      names = columnNames;
+    }
+    return QueryResult.fromJson({
+      'rows': rows,
+      'rowCount': rows.length,
+      'columns': names,
+      'columnTypes': types,
+    });
+  }
+
+  /// Returns the statement to its connection's statement cache.
+  void close() {
+    if (_handle != nullptr) {
+      _api.finalize(_handle);
+      _handle = nullptr;
+    }
+  }
+}
@@ -0,0 +1,41 @@
+import 'exceptions.dart';
+import 'query_result.dart';
+
+/// One call of [MsSqlConnection.pipeline].
+class PipelineOp {
+  /// `query` or `execute`.
+  final String op;
+  final String sql;
+  final List<dynamic> parameters;
+
+  /// A query, answered with its result set. It must return exactly one.
+  const PipelineOp.query(this.sql, [this.parameters = const []]) : op = 'query';
+
+  /// A command, answered with a result whose [QueryResult.rowsAffected] is
+  /// set.
+  const PipelineOp.execute(this.sql, [this.parameters = const []]) : op = 'execute';
+
+  Map<String, dynamic> toJson() => {'op': op, 'sql': sql, 'parameters': parameters};
+}
+
+/// Exception for a pipeline operation that failed; the operations after it
+/// did not run.
+class PipelineException extends QueryException {
+  /// Index of the failed operation. When it was combined with the queries
+  /// before it into one batch, the index of the first of them.
+  final int index;
+
+  /// Native error code, e.g. `QueryError`, `Timeout` or `Cancelled`.
+  final String code;
+
+  /// Results of the operations before [index].
+  final List<QueryResult> completed;
+
+  PipelineException(
+    String message, {
+    required this.index,
+    required this.code,
+    required this.completed,
+    String? details,
+  }) : super(message, details: details);
+}
@@ -0,0 +1,102 @@
+/// How the ODBC driver manager matches a request against pooled connections
+/// when driver-manager pooling is enabled.
+enum PoolMatch {
+  /// Only reuse connections whose attributes match exactly.
+  strict,
+
+  /// Allow reuse when non-essential attributes differ.
+  relaxed,
+}
+
+/// Sizing and eviction settings for a native connection pool.
+///
+/// A pool is created for each distinct connection target the first time
+/// [MsSqlConnection.acquire] is called for it; later calls for the same
+/// target reuse that pool and its original options.
+class PoolOptions {
+  /// Connections kept open even while idle.
+  final int minSize;
+
+  /// Upper bound on open connections, idle plus in use.
+  final int maxSize;
+
+  /// Idle connections above [minSize] are closed after this long.
+  final Duration idleTimeout;
+
+  /// Connections are closed instead of reused once this old.
+  /// [Duration.zero] disables the limit.
+  final Duration maxLifetime;
+
+  /// How long [MsSqlConnection.acquire] waits when the pool is exhausted.
+  final Duration acquireTimeout;
+
+  const PoolOptions({
+    this.minSize = 0,
+    this.maxSize = 10,
+    this.idleTimeout = const Duration(minutes: 5),
+    this.maxLifetime = const Duration(minutes: 30),
+    this.acquireTimeout = const Duration(seconds: 30),
+  });
+
+  Map<String, dynamic> toJson() {
+    return {
+      'minPoolSize': minSize,
+      'maxPoolSize': maxSize,
+      'idleTimeoutMs': idleTimeout.inMilliseconds,
+      'maxLifetimeMs': maxLifetime.inMilliseconds,
+      'acquireTimeoutMs': acquireTimeout.inMilliseconds,
+    };
+  }
+}
+
+/// Counters for one native connection pool.
+class PoolStats {
+  /// `username@server/database` of the pool's target.
+  final String target;
+  final int hits;
+  final int waits;
+  final int timeouts;
+  final int creations;
+  final int creationFailures;
+  final int idleEvictions;
+  final int lifetimeEvictions;
+  final int deadEvictions;
+  final int idle;
+  final int inUse;
+
+  PoolStats({
+    required this.target,
+    required this.hits,
+    required this.waits,
+    required this.timeouts,
+    required this.creations,
+    required this.creationFailures,
+    required this.idleEvictions,
+    required this.lifetimeEvictions,
+    required this.deadEvictions,
+    required this.idle,
+    required this.inUse,
+  });
+
+  factory PoolStats.fromJson(Map<dynamic, dynamic> json) {
+    return PoolStats(
+      target: json['target'] ?? '',
+      hits: json['hits'] ?? 0,
+      waits: json['waits'] ?? 0,
+      timeouts: json['timeouts'] ?? 0,
+      creations: json['creations'] ?? 0,
+      creationFailures: json['creationFailures'] ?? 0,
+      idleEvictions: json['idleEvictions'] ?? 0,
+      lifetimeEvictions: json['lifetimeEvictions'] ?? 0,
+      deadEvictions: json['deadEvictions'] ?? 0,
+      idle: json['idle'] ?? 0,
+      inUse: json['inUse'] ?? 0,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'PoolStats($target, hits: $hits, waits: $waits, '
+        'creations: $creations, idle: $idle, inUse: $inUse)';
+  }
+}
@@ -0,0 +1,73 @@
+import 'query_result.dart';
+
+/// Marks a stored procedure argument as an output parameter.
+///
+/// With a [value] the parameter is input/output and [value] is sent in;
+/// otherwise it is output only. Text output values are truncated to [size]
+/// characters.
+class OutputParameter {
+  final ColumnType type;
+  final Object? value;
+  final int size;
+
+  const OutputParameter(this.type, {this.value, this.size = 4000});
+
+  static const Map<ColumnType, String> _typeNames = {
+    ColumnType.boolean: 'bool',
+    ColumnType.integer: 'int',
+    ColumnType.float: 'double',
+    ColumnType.string: 'string',
+    ColumnType.binary: 'binary',
+  };
+
+  Map<String, Object?> toJson(String name) {
+    return {
+      'name': name,
+      'direction': value == null ? 'out' : 'inout',
+      'type': _typeNames[type],
+      'value': value,
+      'size': size,
+    };
+  }
+}
+
+/// Everything a stored procedure call returned.
+class ProcedureResult {
+  /// The procedure's RETURN value, 0 if it returned none.
+  final int returnValue;
+
+  /// Result sets in the order the procedure produced them.
+  final List<QueryResult> resultSets;
+
+  /// Row counts of statements that produced no result set, e.g. the
+  /// INSERTs of a procedure without `SET NOCOUNT ON`.
+  final List<int> rowCounts;
+
+  /// Output and input/output parameters by name, without the `@`.
+  final Map<String, dynamic> outputParameters;
+
+  ProcedureResult({
+    required this.returnValue,
+    required this.resultSets,
+    required this.rowCounts,
+    required this.outputParameters,
+  });
+
+  factory ProcedureResult.fromJson(Map<dynamic, dynamic> json) {
+    final sets = (json['resultSets'] as List?) ?? const [];
+    return ProcedureResult(
+      returnValue: json['returnValue'] ?? 0,
+      resultSets: sets
+          .whereType<Map>()
+          .map((set) => QueryResult.fromJson(set))
+          .toList(growable: false),
+      rowCounts: List<int>.from(json['rowCounts'] ?? const []),
+      outputParameters: Map<String, dynamic>.from(
+          (json['outputParameters'] as Map?) ?? const {}),
+    );
+  }
+
+  /// The first result set, or null if the procedure produced none.
+  QueryResult? get firstResultSet =>
+      resultSets.isEmpty ? null : resultSets.first;
+}
@@ -1,23 +1,190 @@
+import 'dart:collection';
+import 'dart:typed_data';
+
+import 'binary_result.dart';
+
+/// One result row, keyed by column name
+typedef Row = Map<String, dynamic>;
+
+/// Value type of a [ResultColumn] in a columnar result
+///
+/// Cells of the last four types are read as:
+/// - [decimal]: an exact [String] such as `'-12.3400'`, since decimal and
+///   numeric values do not fit a [double] in general;
+/// - [dateTime]: a UTC [DateTime]. SQL Server date and datetime values
+///   carry no time zone, so their fields are taken as they are;
+/// - [time]: a [Duration] since midnight;
+/// - [guid]: an uppercase [String] such as
+///   `'6F9619FF-8B86-D011-B42D-00C04FC964FF'`.
+enum ColumnType {
+  boolean,
+  integer,
+  float,
+  string,
+  binary,
+  decimal,
+  dateTime,
+  time,
+  guid,
+}
+
+const Map<String, ColumnType> _columnTypes = {
+  'bool': ColumnType.boolean,
+  'int': ColumnType.integer,
+  'double': ColumnType.float,
+  'string': ColumnType.string,
+  'binary': ColumnType.binary,
+  'decimal': ColumnType.decimal,
+  'datetime': ColumnType.dateTime,
+  'time': ColumnType.time,
+  'guid': ColumnType.guid,
+};
+
+/// Converts a cell as sent by the native side to its Dart value.
+Object? _decodeCell(ColumnType type, Object? value, int scale) {
+  if (value == null) {
+    return null;
+  }
+  switch (type) {
+    case ColumnType.boolean:
+      return value is int ? value == 1 : value;
+    case ColumnType.decimal:
+      return value is int ? _formatDecimal(value, scale) : value;
+    case ColumnType.dateTime:
+      return value is int
+          ? DateTime.fromMicrosecondsSinceEpoch(value, isUtc: true)
+          : value;
+    case ColumnType.time:
+      return value is int ? Duration(microseconds: value) : value;
+    case ColumnType.guid:
+      return value is Uint8List ? _formatGuid(value) : value;
+    default:
+      return value;
+  }
+}
+
+String _formatDecimal(int unscaled, int scale) {
+  if (scale <= 0) {
+    return unscaled.toString();
+  }
+  final negative = unscaled < 0;
+  var digits = (negative ? -BigInt.from(unscaled) : BigInt.from(unscaled))
+      .toString()
+      .padLeft(scale + 1, '0');
+  digits = '${digits.substring(0, digits.length - scale)}.'
+      '${digits.substring(digits.length - scale)}';
+  return negative ? '-$digits' : digits;
+}
+
+String _formatGuid(Uint8List bytes) {
+  final hex = bytes
+      .map((byte) => byte.toRadixString(16).padLeft(2, '0'))
+      .join()
+      .toUpperCase();
+  return '${hex.substring(0, 8)}-${hex.substring(8, 12)}-'
+      '${hex.substring(12, 16)}-${hex.substring(16, 20)}-${hex.substring(20)}';
+}
+
+/// One column of a columnar query result, stored as a typed list
+class ResultColumn {
+  final String name;
+  final ColumnType type;
+
+  /// The raw cell values: a [Uint8List] of 0/1 for [ColumnType.boolean], an
+  /// [Int64List] for [ColumnType.integer], a [Float64List] for
+  /// [ColumnType.float], a `List<String>` for [ColumnType.string] and a
+  /// `List<Uint8List>` for [ColumnType.binary]. NULL cells hold 0 or an
+  /// empty string or byte list; check [isNull].
+  ///
+  /// [ColumnType.dateTime] and [ColumnType.time] cells are microseconds in
+  /// an [Int64List], [ColumnType.guid] cells 16 bytes each in a
+  /// `List<Uint8List>`, and [ColumnType.decimal] cells either unscaled
+  /// integers in an [Int64List] (see [scale]) or, for precisions above 18,
+  /// a `List<String>`. The [] operator converts them.
+  final List<Object> values;
+
+  /// Digits after the decimal point of [ColumnType.decimal] cells.
+  final int scale;
+
+  /// Bit `row % 8` of byte `row ~/ 8` is set for NULL cells; null when the
+  /// column has no NULLs.
+  final Uint8List? nullBitmap;
+
+  ResultColumn({
+    required this.name,
+    required this.type,
+    required this.values,
+    this.nullBitmap,
+    this.scale = 0,
+  });
+
+  int get length => values.length;
+
+  bool isNull(int row) {
+    final bitmap = nullBitmap;
+    return bitmap != null && (bitmap[row >> 3] >> (row & 7)) & 1 == 1;
+  }
+
+  /// The cell at [row] as a Dart value, or null for NULL
+  dynamic operator [](int row) {
+    if (isNull(row)) {
+      return null;
+    }
+    return _decodeCell(type, values[row], scale);
+  }
+
+  Int64List get ints => values as Int64List;
+  Float64List get doubles => values as Float64List;
+  List<String> get strings => values as List<String>;
+  List<Uint8List> get binaries => values as List<Uint8List>;
+}
+
 /// Represents the result of a SQL query
 class QueryResult {
-  final List<Map<String, dynamic>> rows;
   final int rowCount;
   final List<String> columnNames;
 
+  /// Rows changed by a statement that returned no result set, for the
+  /// entries of [MsSqlConnection.queryMulti] that stand for such statements;
+  /// null for result sets.
+  final int? rowsAffected;
+
+  List<Map<String, dynamic>>? _rows;
+  final List<ResultColumn>? _columns;
+
   QueryResult({
-    required this.rows,
+    required List<Map<String, dynamic>> rows,
     required this.rowCount,
     required this.columnNames,
-  });
+    this.rowsAffected,
+  })  : _rows = rows,
+        _columns = null;
+
+  QueryResult._columnar({
+    required this.rowCount,
+    required this.columnNames,
+    required List<ResultColumn> columns,
+  })  : rowsAffected = null,
+        _columns = columns;
 
   /// Create QueryResult from JSON
   factory QueryResult.fromJson(Map<dynamic, dynamic> json) {
+    if (json['format'] == 'columnar') {
+      return QueryResult._fromColumnar(json);
+    }
+
     final List<dynamic> rowsData = json['rows'] ?? [];
     final List<String> columns = List<String>.from(json['columns'] ?? []);
+    final List<dynamic> types = json['columnTypes'] ?? const [];
 
     final List<Map<String, dynamic>> parsedRows = rowsData.map((row) {
       if (row is Map) {
-        return Map<String, dynamic>.from(row);
+        final parsed = Map<String, dynamic>.from(row);
+        for (var i = 0; i < columns.length && i < types.length; i++) {
+          final type = _columnTypes[types[i]] ?? ColumnType.string;
+          parsed[columns[i]] = _decodeCell(type, parsed[columns[i]], 0);
+        }
+        return parsed;
       }
       return <String, dynamic>{};
     }).toList();
@@ -26,14 +193,93 @@ class QueryResult {
       rows: parsedRows,
       rowCount: json['rowCount'] ?? parsedRows.length,
       columnNames: columns,
+      rowsAffected: json['rowsAffected'] as int?,
+    );
+  }
+
+  /// Create a columnar QueryResult from a message in the binary result
+  /// encoding; see [MsSqlConnection.queryBinary]. Cells are read from
+  /// [data] on access, so it must not be modified afterwards.
+  factory QueryResult.fromBinary(ByteData data) {
+    final result = BinaryResult.read(data);
+    return QueryResult._columnar(
+      rowCount: result.rowCount,
+      columnNames: result.columnNames,
+      columns: result.columns,
+    );
+  }
+
+  factory QueryResult._fromColumnar(Map<dynamic, dynamic> json) {
+    final List<String> names = List<String>.from(json['columns'] ?? []);
+    final List<dynamic> types = json['columnTypes'] ?? [];
+    final List<dynamic> data = json['columnData'] ?? [];
+    final List<dynamic> nulls = json['nulls'] ?? [];
+    final List<dynamic> scales = json['scales'] ?? const [];
+
+    final columns = <ResultColumn>[];
+    for (var i = 0; i < names.length; i++) {
+      final type = _columnTypes[types[i]] ?? ColumnType.string;
+      final raw = data[i];
+      columns.add(ResultColumn(
+        name: names[i],
+        type: type,
+        values: switch (type) {
+          ColumnType.string => List<String>.from(raw as List),
+          ColumnType.binary || ColumnType.guid =>
+            List<Uint8List>.from(raw as List),
+          ColumnType.decimal when raw is! Int64List =>
+            List<String>.from(raw as List),
+          _ => raw as List<Object>,
+        },
+        nullBitmap: i < nulls.length ? nulls[i] as Uint8List? : null,
+        scale: i < scales.length ? scales[i] as int? ?? 0 : 0,
+      ));
+    }
+
+    return QueryResult._columnar(
+      rowCount: json['rowCount'] ?? 0,
+      columnNames: names,
+      columns: columns,
     );
   }
 
+  /// Whether this result stands for a statement without a result set; see
+  /// [rowsAffected]
+  bool get isRowCount => rowsAffected != null;
+
+  /// Whether this result was returned with `resultFormat: 'columnar'`
+  bool get isColumnar => _columns != null;
+
+  /// Rows as maps keyed by column name.
+  ///
+  /// For columnar results these are read-only views over the columns that
+  /// are created on access, so no per-row map is ever materialized.
+  List<Map<String, dynamic>> get rows =>
+      _rows ??= _ColumnarRows(this, _columns!);
+
+  /// Columns of a columnar result, in select order
+  List<ResultColumn> get columns {
+    final columns = _columns;
+    if (columns == null) {
+      throw StateError('Columns are only available for columnar results');
+    }
+    return columns;
+  }
+
+  /// The column called [name] of a columnar result
+  ResultColumn column(String name) {
+    final index = columnNames.indexOf(name);
+    if (index < 0) {
+      throw ArgumentError.value(name, 'name', 'No such column');
+    }
+    return columns[index];
+  }
+
   /// Check if result is empty
-  bool get isEmpty => rows.isEmpty;
+  bool get isEmpty => rowCount == 0;
 
   /// Check if result has data
-  bool get isNotEmpty => rows.isNotEmpty;
+  bool get isNotEmpty => rowCount != 0;
 
   /// Convert to JSON
   Map<String, dynamic> toJson() {
@@ -45,3 +291,56 @@ class QueryResult {
     return 'QueryResult(rowCount: $rowCount, columns: $columnNames)';
   }
 }
+
+class _ColumnarRows extends ListBase<Map<String, dynamic>> {
+  final QueryResult _result;
+  final List<ResultColumn> _columns;
+  final Map<String, int> _indexByName;
+
+  _ColumnarRows(this._result, this._columns)
+      : _indexByName = {
+          for (var i = 0; i < _result.columnNames.length; i++)
+            _result.columnNames[i]: i,
+        };
+
+  @override
+  int get length => _result.rowCount;
+
+  @override
+  set length(int newLength) =>
+      throw UnsupportedError('Cannot change the length of query rows');
+
+  @override
+  Map<String, dynamic> operator [](int index) {
+    RangeError.checkValidIndex(index, this);
+    return _RowView(_result.columnNames, _indexByName, _columns, index);
+  }
+
+  @override
+  void operator []=(int index, Map<String, dynamic> value) =>
+      throw UnsupportedError('Cannot modify query rows');
+}
+
+class _RowView extends UnmodifiableMapBase<String, dynamic> {
+  final List<String> _names;
+  final Map<String, int> _indexByName;
+  final List<ResultColumn> _columns;
+  final int _row;
+
+  _RowView(this._names, this._indexByName, this._columns, this._row);
+
+  @override
+  dynamic operator [](Object? key) {
+    final index = _indexByName[key];
+    return index == null ? null : _columns[index][_row];
+  }
+
+  @override
+  Iterable<String> get keys => _names;
+
+  @override
+  bool containsKey(Object? key) => _indexByName.containsKey(key);
+
+  @override
+  int get length => _names.length;
+}
@@ -0,0 +1,58 @@
+/// Counters for the native query result cache; see
+/// [MsSqlConnection.configureResultCache].
+class ResultCacheStats {
+  final int hits;
+  final int misses;
+
+  /// Results dropped to stay within the byte budget.
+  final int evictions;
+
+  /// Results found past their [CallOptions.cacheTtl].
+  final int expirations;
+
+  /// Results dropped by writes and [MsSqlConnection.invalidateResultCache].
+  final int invalidations;
+
+  /// Results currently cached, the approximate memory they hold and the
+  /// budget for it.
+  final int entries;
+  final int bytes;
+  final int maxBytes;
+
+  /// Fraction of lookups served from the cache, 0 before the first lookup.
+  final double hitRate;
+
+  ResultCacheStats({
+    required this.hits,
+    required this.misses,
+    required this.evictions,
+    required this.expirations,
+    required this.invalidations,
+    required this.entries,
+    required this.bytes,
+    required this.maxBytes,
+    required this.hitRate,
+  });
+
+  factory ResultCacheStats.fromJson(Map<dynamic, dynamic> json) {
+    return ResultCacheStats(
+      hits: json['hits'] ?? 0,
+      misses: json['misses'] ?? 0,
+      evictions: json['evictions'] ?? 0,
+      expirations: json['expirations'] ?? 0,
+      invalidations: json['invalidations'] ?? 0,
+      entries: json['entries'] ?? 0,
+      bytes: json['bytes'] ?? 0,
+      maxBytes: json['maxBytes'] ?? 0,
+      hitRate: (json['hitRate'] ?? 0).toDouble(),
+    );
+  }
+
+  @override
+  String toString() {
+    return 'ResultCacheStats(hits: $hits, misses: $misses, '
+        'evictions: $evictions, expirations: $expirations, '
+        'invalidations: $invalidations, entries: $entries, '
+        'bytes: $bytes/$maxBytes, hitRate: ${hitRate.toStringAsFixed(3)})';
+  }
+}
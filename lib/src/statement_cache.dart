@@ -0,0 +1,36 @@
+/// Counters for the native prepared statement caches.
+///
+/// Every connection keeps its own cache of prepared statements keyed by SQL
+/// text; these totals cover all of them. Queries whose text varies only in
+/// their values should pass the values as parameters so they share one
+/// cached statement.
+class StatementCacheStats {
+  final int hits;
+  final int misses;
+  final int evictions;
+
+  /// Fraction of lookups served from a cache, 0 before the first lookup.
+  final double hitRate;
+
+  StatementCacheStats({
+    required this.hits,
+    required this.misses,
+    required this.evictions,
+    required this.hitRate,
+  });
+
+  factory StatementCacheStats.fromJson(Map<dynamic, dynamic> json) {
+    return StatementCacheStats(
+      hits: json['hits'] ?? 0,
+      misses: json['misses'] ?? 0,
+      evictions: json['evictions'] ?? 0,
+      hitRate: (json['hitRate'] ?? 0).toDouble(),
+    );
+  }
+
+  @override
+  String toString() {
+    return 'StatementCacheStats(hits: $hits, misses: $misses, '
+        'evictions: $evictions, hitRate: ${hitRate.toStringAsFixed(3)})';
+  }
+}
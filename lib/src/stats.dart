@@ -0,0 +1,129 @@
+/// Latency of one phase of a call; see [MsSqlConnection.stats].
+///
+/// Percentiles come from a histogram with 8 buckets per power of two, so
+/// they may overstate the true value by up to an eighth.
+class PhaseStats {
+  final int count;
+  final Duration total;
+  final Duration max;
+  final Duration p50;
+  final Duration p90;
+  final Duration p99;
+  final Duration p999;
+
+  PhaseStats({
+    required this.count,
+    required this.total,
+    required this.max,
+    required this.p50,
+    required this.p90,
+    required this.p99,
+    required this.p999,
+  });
+
+  factory PhaseStats.fromJson(Map<dynamic, dynamic> json) {
+    Duration nanos(String key) => Duration(microseconds: ((json[key] ?? 0) as int) ~/ 1000);
+    return PhaseStats(
+      count: json['count'] ?? 0,
+      total: nanos('totalNs'),
+      max: nanos('maxNs'),
+      p50: nanos('p50Ns'),
+      p90: nanos('p90Ns'),
+      p99: nanos('p99Ns'),
+      p999: nanos('p999Ns'),
+    );
+  }
+
+  /// Mean latency, zero without samples.
+  Duration get mean => count == 0 ? Duration.zero : total ~/ count;
+
+  @override
+  String toString() {
+    return 'PhaseStats(count: $count, mean: $mean, p50: $p50, p99: $p99, '
+        'max: $max)';
+  }
+}
+
+/// Call counters and phase latencies of one connection or of the whole
+/// process.
+class CallStats {
+  /// Calls and failed calls by kind: `connect`, `query` and `execute`.
+  final Map<String, int> calls;
+  final Map<String, int> errors;
+
+  /// Rows fetched by queries plus rows affected by commands.
+  final int rows;
+
+  /// Approximate size of the query results sent to Dart.
+  final int bytes;
+
+  /// Latency by phase: `connect`, `execute` (running the statement),
+  /// `fetch` (reading rows from the driver), `encode` (building the
+  /// result) and `reply` (handing it to Dart).
+  final Map<String, PhaseStats> phases;
+
+  CallStats({
+    required this.calls,
+    required this.errors,
+    required this.rows,
+    required this.bytes,
+    required this.phases,
+  });
+
+  factory CallStats.fromJson(Map<dynamic, dynamic> json) {
+    Map<String, int> counts(Object? value) => {
+          if (value is Map)
+            for (final entry in value.entries) entry.key as String: entry.value as int,
+        };
+    final phases = json['phases'];
+    return CallStats(
+      calls: counts(json['calls']),
+      errors: counts(json['errors']),
+      rows: json['rows'] ?? 0,
+      bytes: json['bytes'] ?? 0,
+      phases: {
+        if (phases is Map)
+          for (final entry in phases.entries)
+            if (entry.value is Map) entry.key as String: PhaseStats.fromJson(entry.value as Map),
+      },
+    );
+  }
+
+  @override
+  String toString() {
+    return 'CallStats(calls: $calls, errors: $errors, rows: $rows, '
+        'bytes: $bytes, phases: $phases)';
+  }
+}
+
+/// The reply of [MsSqlConnection.stats].
+class StatsReport {
+  /// Whether statistics are being collected.
+  final bool enabled;
+
+  /// Totals of every connection, including closed ones and failed connects.
+  final CallStats global;
+
+  /// Statistics of each open connection, by connection id.
+  final Map<int, CallStats> connections;
+
+  StatsReport({
+    required this.enabled,
+    required this.global,
+    required this.connections,
+  });
+
+  factory StatsReport.fromJson(Map<dynamic, dynamic> json) {
+    final global = json['global'];
+    final connections = json['connections'];
+    return StatsReport(
+      enabled: json['enabled'] ?? false,
+      global: CallStats.fromJson(global is Map ? global : const {}),
+      connections: {
+        if (connections is Map)
+          for (final entry in connections.entries)
+            if (entry.value is Map) entry.key as int: CallStats.fromJson(entry.value as Map),
+      },
+    );
+  }
+}
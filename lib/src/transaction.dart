@@ -0,0 +1,11 @@
+/// Isolation level of a transaction started with
+/// [MsSqlConnection.beginTransaction].
+enum IsolationLevel {
+  readUncommitted,
+  readCommitted,
+  repeatableRead,
+  serializable,
+
+  /// Row versioning; the database must have ALLOW_SNAPSHOT_ISOLATION on.
+  snapshot,
+}
@@ -0,0 +1,135 @@
+// Counts heap allocations made while fetching results into ColumnarResult,
+// the way the plugin reads every query, against the synthetic driver.
+//
+// Usage: allocation_benchmark [queries] [rows]
+//
+// Global operator new is replaced with a counting one, so the counts cover
+// the fetcher, the transcoder and the result, but also the driver's own
+// per-statement bookkeeping; the driver allocates nothing per row.
+
+#include <sql.h>
+#include <sqlext.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "columnar_result.h"
+#include "text_encoding.h"
+
+namespace {
+
+std::atomic<uint64_t> g_allocations(0);
+std::atomic<uint64_t> g_allocated_bytes(0);
+
+}  // namespace
+
+void* operator new(size_t size) {
+  ++g_allocations;
+  g_allocated_bytes += size;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using mssql_connect::BlockFetcher;
+using mssql_connect::ColumnarResult;
+
+struct Totals {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+  uint64_t cells = 0;
+  double seconds = 0;
+};
+
+bool RunQuery(SQLHSTMT stmt, const std::string& query, Totals* totals) {
+  std::vector<SQLWCHAR> sql = mssql_connect::Utf8ToUtf16(query);
+  uint64_t allocations = g_allocations;
+  uint64_t bytes = g_allocated_bytes;
+  auto start = std::chrono::steady_clock::now();
+  bool ok = SQL_SUCCEEDED(
+      SQLExecDirectW(stmt, sql.data(), static_cast<SQLINTEGER>(sql.size())));
+  if (ok) {
+    // Scoped like a reply: everything is released before counting stops.
+    BlockFetcher fetcher(stmt);
+    ColumnarResult result;
+    std::string error;
+    ok = fetcher.Bind(&error) &&
+         mssql_connect::ReadColumnar(&fetcher, &result, &error);
+    totals->cells += result.row_count * result.columns.size();
+  }
+  SQLFreeStmt(stmt, SQL_CLOSE);
+  totals->seconds += std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  totals->allocations += g_allocations - allocations;
+  totals->bytes += g_allocated_bytes - bytes;
+  return ok;
+}
+
+bool RunShape(SQLHSTMT stmt, const char* label, const std::string& query,
+              size_t queries) {
+  // One warm-up query, so caches that are filled once do not count.
+  Totals warm_up;
+  if (!RunQuery(stmt, query, &warm_up)) {
+    std::fprintf(stderr, "%s: query failed\n", label);
+    return false;
+  }
+  Totals totals;
+  for (size_t i = 0; i < queries; ++i) {
+    if (!RunQuery(stmt, query, &totals)) {
+      std::fprintf(stderr, "%s: query failed\n", label);
+      return false;
+    }
+  }
+  std::printf(
+      "  %-10s %9.1f allocs/query %6.3f allocs/cell %9.1f KB/query "
+      "%8.3f ms/query\n",
+      label, static_cast<double>(totals.allocations) / queries,
+      static_cast<double>(totals.allocations) / totals.cells,
+      totals.bytes / 1024.0 / queries, totals.seconds * 1e3 / queries);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t queries = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+  size_t rows = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+
+  SQLHENV env;
+  SQLHDBC dbc;
+  SQLHSTMT stmt;
+  SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+  SQLAllocHandle(SQL_HANDLE_DBC, env, &dbc);
+  SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+
+  std::string rows_arg = "SELECT rows=" + std::to_string(rows);
+  std::printf("%zu queries of %zu rows\n", queries, rows);
+  bool ok =
+      RunShape(stmt, "numeric", rows_arg + " cols=4 types=int,double,bigint,decimal",
+               queries) &&
+      RunShape(stmt, "short-text",
+               rows_arg + " cols=4 types=int,text strlen=10", queries) &&
+      RunShape(stmt, "long-text",
+               rows_arg + " cols=4 types=int,text strlen=200", queries) &&
+      RunShape(stmt, "lob",
+               rows_arg + " cols=2 types=int,lob strlen=3000", queries);
+
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+  SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+  SQLFreeHandle(SQL_HANDLE_ENV, env);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+// Measures how many slow queries a few threads can keep in flight: every
+// connection runs the same number of queries against the synthetic driver
+// with a fixed latency, first blocking on a WorkerPool of the plugin's
+// default size, then through an AsyncReactor that executes them in ODBC
+// asynchronous mode on two threads. The blocking pool is capped at one
+// query per thread; the reactor's throughput should keep growing with the
+// number of connections.
+//
+// Usage: async_benchmark [latency_ms] [queries_per_connection]
+
+#include <sql.h>
+#include <sqlext.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "async_reactor.h"
+#include "text_encoding.h"
+#include "worker_pool.h"
+
+namespace {
+
+using mssql_connect::AsyncReactor;
+using mssql_connect::AsyncReactorStats;
+using mssql_connect::WorkerPool;
+
+// One connection and the statement its queries run on.
+struct Connection {
+  SQLHDBC dbc = SQL_NULL_HANDLE;
+  SQLHSTMT stmt = SQL_NULL_HANDLE;
+  size_t remaining = 0;
+};
+
+// Counts down finished connections.
+class Latch {
+ public:
+  explicit Latch(size_t count) : count_(count) {}
+
+  void CountDown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--count_ == 0) {
+      cv_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return count_ == 0; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t count_;
+};
+
+class Harness {
+ public:
+  Harness(size_t connections, unsigned long latency_ms) {
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
+    connections_.resize(connections);
+    for (Connection& connection : connections_) {
+      SQLAllocHandle(SQL_HANDLE_DBC, env_, &connection.dbc);
+      SQLAllocHandle(SQL_HANDLE_STMT, connection.dbc, &connection.stmt);
+    }
+    sql_ = mssql_connect::Utf8ToUtf16(
+        "SELECT rows=1 cols=1 types=int latency=" +
+        std::to_string(latency_ms * 1000));
+  }
+
+  ~Harness() {
+    for (Connection& connection : connections_) {
+      SQLFreeHandle(SQL_HANDLE_STMT, connection.stmt);
+      SQLFreeHandle(SQL_HANDLE_DBC, connection.dbc);
+    }
+    SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  }
+
+  // Each connection's queries run back to back as keyed tasks, the way the
+  // plugin serializes a connection's calls.
+  void RunBlocking(size_t queries) {
+    std::atomic<size_t> failed(0);
+    Latch latch(connections_.size());
+    auto start = std::chrono::steady_clock::now();
+    {
+      WorkerPool pool(WorkerPool::DefaultThreadCount());
+      for (size_t i = 0; i < connections_.size(); ++i) {
+        Connection* connection = &connections_[i];
+        for (size_t q = 0; q < queries; ++q) {
+          pool.Post(static_cast<int64_t>(i), [this, connection, q, queries,
+                                              &failed, &latch]() {
+            if (!SQL_SUCCEEDED(Execute(connection->stmt))) {
+              ++failed;
+            }
+            SQLFreeStmt(connection->stmt, SQL_CLOSE);
+            if (q + 1 == queries) {
+              latch.CountDown();
+            }
+          });
+        }
+      }
+      latch.Wait();
+    }
+    Report("blocking", queries, WorkerPool::DefaultThreadCount(), start,
+           failed);
+  }
+
+  // Each connection submits its next query from the previous one's Done
+  // callback.
+  void RunAsync(size_t queries, AsyncReactorStats* stats) {
+    std::atomic<size_t> failed(0);
+    Latch latch(connections_.size());
+    auto start = std::chrono::steady_clock::now();
+    AsyncReactor::Options options;
+    AsyncReactor reactor(options);
+    std::function<void(Connection*)> submit = [&](Connection* connection) {
+      reactor.Submit(
+          connection->stmt, [this, connection]() {
+            return Execute(connection->stmt);
+          },
+          [&, connection](SQLRETURN ret) {
+            if (!SQL_SUCCEEDED(ret)) {
+              ++failed;
+            }
+            AsyncReactor::EndAsync(connection->stmt);
+            SQLFreeStmt(connection->stmt, SQL_CLOSE);
+            if (--connection->remaining == 0) {
+              latch.CountDown();
+            } else {
+              submit(connection);
+            }
+          });
+    };
+    for (Connection& connection : connections_) {
+      connection.remaining = queries;
+      submit(&connection);
+    }
+    latch.Wait();
+    *stats = reactor.stats();
+    Report("async", queries, reactor.thread_count(), start, failed);
+  }
+
+ private:
+  SQLRETURN Execute(SQLHSTMT stmt) {
+    return SQLExecDirectW(stmt, sql_.data(),
+                          static_cast<SQLINTEGER>(sql_.size()));
+  }
+
+  void Report(const char* label, size_t queries, size_t threads,
+              std::chrono::steady_clock::time_point start,
+              const std::atomic<size_t>& failed) {
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    std::printf("  %-8s %2zu threads %9.1f ms %9.0f queries/s", label,
+                threads, seconds * 1e3,
+                connections_.size() * queries / seconds);
+    if (failed > 0) {
+      std::printf("  (%zu failed)", failed.load());
+    }
+  }
+
+  SQLHENV env_ = SQL_NULL_HANDLE;
+  std::vector<Connection> connections_;
+  std::vector<SQLWCHAR> sql_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned long latency_ms =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20;
+  size_t queries = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+
+  std::printf("%zu queries per connection, %lu ms latency each\n", queries,
+              latency_ms);
+  for (size_t connections : {8, 64, 256}) {
+    Harness harness(connections, latency_ms);
+    std::printf("%zu connections\n", connections);
+    harness.RunBlocking(queries);
+    std::printf("\n");
+    AsyncReactorStats stats;
+    harness.RunAsync(queries, &stats);
+    std::printf("  %llu polls\n",
+                static_cast<unsigned long long>(stats.polls));
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+// Compares inserting rows with one SQLExecute per row against BatchExecutor's
+// parameter arrays, against the synthetic driver.
+//
+// Usage: batch_benchmark [rows] [latency_us]
+//
+// Each execution sleeps |latency_us| in the driver to stand in for the
+// network round trip a real server costs, which is what batching saves.
+
+#include <sql.h>
+#include <sqlext.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "batch_executor.h"
+#include "parameter_binder.h"
+#include "text_encoding.h"
+
+extern "C" uint64_t SyntheticOdbcCallCount();
+extern "C" void SyntheticOdbcResetCallCount();
+
+namespace {
+
+using mssql_connect::BatchExecutor;
+using mssql_connect::BatchResult;
+using mssql_connect::BatchRowStatus;
+using mssql_connect::ParameterBinder;
+using mssql_connect::SqlParameter;
+
+using Rows = std::vector<std::vector<SqlParameter>>;
+
+Rows MakeRows(unsigned long count) {
+  Rows rows(count);
+  for (unsigned long i = 0; i < count; ++i) {
+    rows[i] = {SqlParameter::Int64(i),
+               SqlParameter::Text("device-" + std::to_string(i % 97)),
+               SqlParameter::Double(i * 0.25),
+               i % 11 == 0 ? SqlParameter::Null() : SqlParameter::Bool(i % 2)};
+  }
+  return rows;
+}
+
+bool ExecuteRowByRow(SQLHSTMT stmt, const Rows& rows, int64_t* affected) {
+  ParameterBinder binder;
+  std::string error;
+  for (const auto& row : rows) {
+    if (!binder.Bind(stmt, row, &error) || !SQL_SUCCEEDED(SQLExecute(stmt))) {
+      std::fprintf(stderr, "%s\n", error.c_str());
+      return false;
+    }
+    SQLLEN count = 0;
+    SQLRowCount(stmt, &count);
+    *affected += count;
+  }
+  return true;
+}
+
+bool ExecuteBatches(SQLHSTMT stmt, const Rows& rows, int64_t* affected) {
+  BatchExecutor executor(stmt, BatchExecutor::kDefaultBatchSize);
+  BatchResult result;
+  std::string error;
+  if (!executor.Execute(rows, &result, &error) || !result.error.empty()) {
+    std::fprintf(stderr, "%s%s\n", error.c_str(), result.error.c_str());
+    return false;
+  }
+  if (std::count(result.statuses.begin(), result.statuses.end(),
+                 BatchRowStatus::kSuccess) != (long)rows.size()) {
+    std::fprintf(stderr, "unexpected row status\n");
+    return false;
+  }
+  *affected = result.rows_affected;
+  return true;
+}
+
+bool Run(const char* label, const std::string& query, const Rows& rows,
+         bool (*execute)(SQLHSTMT, const Rows&, int64_t*)) {
+  SQLHENV env;
+  SQLHDBC dbc;
+  SQLHSTMT stmt;
+  SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+  SQLAllocHandle(SQL_HANDLE_DBC, env, &dbc);
+  SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+
+  std::vector<SQLWCHAR> sql = mssql_connect::Utf8ToUtf16(query);
+  SQLPrepareW(stmt, sql.data(), static_cast<SQLINTEGER>(sql.size()));
+  SyntheticOdbcResetCallCount();
+  int64_t affected = 0;
+  auto start = std::chrono::steady_clock::now();
+  bool ok = execute(stmt, rows, &affected);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  uint64_t calls = SyntheticOdbcCallCount();
+
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+  SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+  SQLFreeHandle(SQL_HANDLE_ENV, env);
+  if (!ok) {
+    std::fprintf(stderr, "%s: execute failed\n", label);
+    return false;
+  }
+  if (affected != (int64_t)rows.size()) {
+    std::fprintf(stderr, "%s: %lld rows affected, expected %zu\n", label,
+                 (long long)affected, rows.size());
+    return false;
+  }
+
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::printf("  %-12s %12.0f rows/s %10.3f calls/row\n", label,
+              rows.size() / seconds,
+              static_cast<double>(calls) / std::max<size_t>(rows.size(), 1));
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned long count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+  unsigned long latency = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+  std::string query = "INSERT rows=1 cols=0 latency=" + std::to_string(latency);
+  Rows rows = MakeRows(count);
+
+  std::printf("%lu rows, %lu us per round trip\n", count, latency);
+  if (!Run("row-by-row", query, rows, ExecuteRowByRow) ||
+      !Run("batch", query, rows, ExecuteBatches)) {
+    return 1;
+  }
+  return 0;
+}
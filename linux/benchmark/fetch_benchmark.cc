@@ -0,0 +1,259 @@
+// Compares the row-at-a-time SQLFetch/SQLGetData loop the plugin used to run
+// with BlockFetcher's bound-column rowsets, against the synthetic driver.
+//
+// Usage: fetch_benchmark [rows]
+//
+// Both paths decode every cell into the same UTF-8/numeric form and fold it
+// into a checksum, which must match, so the comparison measures only how the
+// rows are pulled from the driver.
+
+#include <sql.h>
+#include <sqlext.h>
+#include <sqlucode.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "text_encoding.h"
+
+extern "C" uint64_t SyntheticOdbcCallCount();
+extern "C" void SyntheticOdbcResetCallCount();
+
+namespace {
+
+using mssql_connect::BlockFetcher;
+using mssql_connect::CellType;
+
+struct Result {
+  uint64_t rows = 0;
+  uint64_t checksum = 0;
+};
+
+uint64_t Mix(uint64_t checksum, uint64_t value) {
+  return (checksum ^ value) * 1099511628211ULL;
+}
+
+uint64_t HashText(const std::string& text) {
+  return std::hash<std::string>()(text);
+}
+
+// The loop Query used before block fetching: one SQLFetch per row and one
+// SQLGetData per cell (more for long text).
+bool FetchRowByRow(SQLHSTMT stmt, Result* result) {
+  SQLSMALLINT num_cols = 0;
+  SQLNumResultCols(stmt, &num_cols);
+  std::vector<SQLSMALLINT> types(num_cols);
+  for (SQLSMALLINT i = 0; i < num_cols; ++i) {
+    SQLWCHAR name[256];
+    SQLSMALLINT name_length;
+    SQLULEN size;
+    SQLSMALLINT digits;
+    SQLSMALLINT nullable;
+    SQLDescribeColW(stmt, i + 1, name, 256, &name_length, &types[i], &size,
+                    &digits, &nullable);
+  }
+
+  std::vector<SQLWCHAR> buffer(4000);
+  std::vector<SQLWCHAR> wide;
+  while (SQL_SUCCEEDED(SQLFetch(stmt))) {
+    ++result->rows;
+    for (SQLSMALLINT i = 0; i < num_cols; ++i) {
+      SQLUSMALLINT column = i + 1;
+      SQLLEN indicator = 0;
+      SQLRETURN ret;
+      uint64_t value = 0;
+      switch (types[i]) {
+        case SQL_BIT: {
+          unsigned char bit = 0;
+          ret = SQLGetData(stmt, column, SQL_C_BIT, &bit, sizeof(bit), &indicator);
+          value = bit;
+          break;
+        }
+        case SQL_INTEGER: {
+          SQLINTEGER integer = 0;
+          ret = SQLGetData(stmt, column, SQL_C_SLONG, &integer, sizeof(integer),
+                           &indicator);
+          value = static_cast<uint64_t>(integer);
+          break;
+        }
+        case SQL_DOUBLE: {
+          SQLDOUBLE real = 0;
+          ret = SQLGetData(stmt, column, SQL_C_DOUBLE, &real, sizeof(real),
+                           &indicator);
+          value = static_cast<uint64_t>(real * 4);
+          break;
+        }
+        default: {
+          wide.clear();
+          while ((ret = SQLGetData(stmt, column, SQL_C_WCHAR, buffer.data(),
+                                   buffer.size() * sizeof(SQLWCHAR),
+                                   &indicator)) != SQL_NO_DATA) {
+            if (!SQL_SUCCEEDED(ret) || indicator == SQL_NULL_DATA) {
+              break;
+            }
+            size_t chars = indicator == SQL_NO_TOTAL ||
+                                   static_cast<size_t>(indicator) >=
+                                       buffer.size() * sizeof(SQLWCHAR)
+                               ? buffer.size() - 1
+                               : indicator / sizeof(SQLWCHAR);
+            wide.insert(wide.end(), buffer.data(), buffer.data() + chars);
+            if (ret == SQL_SUCCESS) {
+              break;
+            }
+          }
+          if (ret == SQL_NO_DATA) {
+            ret = SQL_SUCCESS;
+          }
+          if (indicator != SQL_NULL_DATA) {
+            value = HashText(mssql_connect::Utf16ToUtf8(wide.data(), wide.size()));
+          }
+          break;
+        }
+      }
+      if (!SQL_SUCCEEDED(ret)) {
+        return false;
+      }
+      result->checksum =
+          Mix(result->checksum, indicator == SQL_NULL_DATA ? 0 : value);
+    }
+  }
+  return true;
+}
+
+bool FetchBlocks(SQLHSTMT stmt, Result* result) {
+  BlockFetcher fetcher(stmt);
+  std::string error;
+  if (!fetcher.Bind(&error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return false;
+  }
+  size_t num_cols = fetcher.columns().size();
+  std::string text;
+  SQLULEN rows = 0;
+  while (fetcher.Next(&rows, &error) && rows > 0) {
+    for (SQLULEN r = 0; r < rows; ++r) {
+      ++result->rows;
+      for (size_t i = 0; i < num_cols; ++i) {
+        uint64_t value = 0;
+        if (!fetcher.IsNull(i, r)) {
+          switch (fetcher.cell_type(i)) {
+            case CellType::kBool:
+              value = fetcher.GetBool(i, r);
+              break;
+            case CellType::kInt32:
+              value = static_cast<uint64_t>(fetcher.GetInt32(i, r));
+              break;
+            case CellType::kInt64:
+              value = static_cast<uint64_t>(fetcher.GetInt64(i, r));
+              break;
+            case CellType::kDouble:
+              value = static_cast<uint64_t>(fetcher.GetDouble(i, r) * 4);
+              break;
+            case CellType::kDecimal:
+              text.clear();
+              fetcher.AppendDecimal(i, r, &text);
+              value = HashText(text);
+              break;
+            case CellType::kDateTime:
+            case CellType::kTime:
+              value = static_cast<uint64_t>(fetcher.GetMicros(i, r));
+              break;
+            case CellType::kGuid: {
+              uint8_t guid[16];
+              fetcher.GetGuid(i, r, guid);
+              value = HashText(std::string(guid, guid + sizeof(guid)));
+              break;
+            }
+            case CellType::kText:
+              text.clear();
+              fetcher.AppendText(i, r, &text);
+              value = HashText(text);
+              break;
+            case CellType::kBinary: {
+              size_t size = 0;
+              const uint8_t* bytes = fetcher.GetBinary(i, r, &size);
+              value = HashText(std::string(bytes, bytes + size));
+              break;
+            }
+          }
+        }
+        result->checksum = Mix(result->checksum, value);
+      }
+    }
+  }
+  if (!error.empty()) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Run(const char* label, const std::string& query,
+         bool (*fetch)(SQLHSTMT, Result*), Result* result) {
+  SQLHENV env;
+  SQLHDBC dbc;
+  SQLHSTMT stmt;
+  SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+  SQLAllocHandle(SQL_HANDLE_DBC, env, &dbc);
+  SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+
+  std::vector<SQLWCHAR> sql(query.begin(), query.end());
+  SyntheticOdbcResetCallCount();
+  auto start = std::chrono::steady_clock::now();
+  bool ok = SQL_SUCCEEDED(
+      SQLExecDirectW(stmt, sql.data(), static_cast<SQLINTEGER>(sql.size())));
+  ok = ok && fetch(stmt, result);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  uint64_t calls = SyntheticOdbcCallCount();
+
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+  SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+  SQLFreeHandle(SQL_HANDLE_ENV, env);
+  if (!ok) {
+    std::fprintf(stderr, "%s: fetch failed\n", label);
+    return false;
+  }
+
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::printf("  %-12s %12.0f rows/s %10.3f calls/row\n", label,
+              result->rows / seconds,
+              static_cast<double>(calls) / std::max<uint64_t>(result->rows, 1));
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned long rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+  const char* shapes[] = {
+      "cols=8 types=int,double,bit,text strlen=24",
+      "cols=8 types=int,double,bit,text strlen=24 nulls=7",
+      "cols=4 types=int,text strlen=200",
+      "cols=4 types=int,text,lob strlen=64",
+  };
+
+  int status = 0;
+  for (const char* shape : shapes) {
+    std::string query = "SELECT rows=" + std::to_string(rows) + " " + shape;
+    std::printf("%s\n", shape);
+    Result row_by_row;
+    Result blocks;
+    if (!Run("row-by-row", query, FetchRowByRow, &row_by_row) ||
+        !Run("block", query, FetchBlocks, &blocks)) {
+      return 1;
+    }
+    if (row_by_row.rows != blocks.rows ||
+        row_by_row.checksum != blocks.checksum) {
+      std::fprintf(stderr, "  results differ between fetch paths\n");
+      status = 1;
+    }
+  }
+  return status;
+}
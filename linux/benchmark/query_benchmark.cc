@@ -0,0 +1,347 @@
+// Google Benchmark suite for the Query hot path against the synthetic
+// driver: fetching rowsets, decoding them into typed columns, transcoding
+// text and encoding the reply for the platform channel.
+//
+// Usage: query_benchmark [--benchmark_filter=<regex>] [other benchmark flags]
+//
+// Every benchmark reports rows/s (items_per_second) and bytes/s of result
+// payload, heap allocations and allocated bytes per iteration (global
+// operator new is replaced with a counting one), and the peak RSS reached
+// while it ran, which is reset between benchmarks through
+// /proc/self/clear_refs. Results are deterministic, so runs on the same
+// machine are comparable; pass --benchmark_format=json to keep a baseline.
+//
+// The Linux channel encodes replies as FlValues with the standard message
+// codec, so the encode benchmarks measure the plugin's own fl_value_adapter;
+// the Windows plugin builds the same shapes as EncodableValues.
+
+#include <benchmark/benchmark.h>
+#include <flutter_linux/flutter_linux.h>
+#include <sql.h>
+#include <sqlext.h>
+#include <sqlucode.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "binary_result.h"
+#include "block_fetcher.h"
+#include "columnar_result.h"
+#include "fl_value_adapter.h"
+#include "text_encoding.h"
+
+namespace {
+
+std::atomic<uint64_t> g_allocations(0);
+std::atomic<uint64_t> g_allocated_bytes(0);
+
+}  // namespace
+
+void* operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using mssql_connect::BlockFetcher;
+using mssql_connect::ColumnarResult;
+using mssql_connect::ResultColumn;
+
+// Result shapes, selected by the second benchmark argument. See
+// synthetic_odbc_driver.cc for the statement syntax.
+const char* const kShapes[] = {
+    // Fixed-size columns only: every column is bound.
+    "cols=8 types=int,bigint,double,bit,decimal,datetime,date,guid",
+    // Short strings next to integers, the common case.
+    "cols=4 types=int,text strlen=32",
+    // Mixed types with NULLs in every tenth row.
+    "cols=8 types=int,double,bit,text,datetime,bin strlen=24 nulls=10",
+    // nvarchar(max): read with SQLGetData one row at a time.
+    "cols=2 types=int,lob strlen=1024",
+};
+const char* const kShapeNames[] = {"fixed", "text", "mixed", "lob"};
+
+std::string Query(const benchmark::State& state) {
+  return "SELECT rows=" + std::to_string(state.range(0)) + " " +
+         kShapes[state.range(1)];
+}
+
+// Statement handles of the linked synthetic driver.
+class Session {
+ public:
+  Session() {
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
+    SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
+    SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt_);
+  }
+
+  ~Session() {
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc_);
+    SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  }
+
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  SQLHSTMT stmt() const { return stmt_; }
+
+  bool Execute(const std::vector<SQLWCHAR>& sql) {
+    SQLFreeStmt(stmt_, SQL_CLOSE);
+    return SQL_SUCCEEDED(SQLExecDirectW(stmt_, const_cast<SQLWCHAR*>(sql.data()),
+                                        static_cast<SQLINTEGER>(sql.size())));
+  }
+
+ private:
+  SQLHENV env_ = SQL_NULL_HANDLE;
+  SQLHDBC dbc_ = SQL_NULL_HANDLE;
+  SQLHSTMT stmt_ = SQL_NULL_HANDLE;
+};
+
+// Reads the whole result of |query| into |result|.
+bool ReadResult(Session* session, const std::string& query,
+                ColumnarResult* result) {
+  if (!session->Execute(mssql_connect::Utf8ToUtf16(query))) {
+    return false;
+  }
+  BlockFetcher fetcher(session->stmt());
+  std::string error;
+  return fetcher.Bind(&error) &&
+         mssql_connect::ReadColumnar(&fetcher, result, &error);
+}
+
+// Bytes of values in |result|, in their decoded form; the bytes/s figure
+// of every benchmark on the same shape refers to this.
+int64_t PayloadBytes(const ColumnarResult& result) {
+  int64_t bytes = 0;
+  for (const ResultColumn& column : result.columns) {
+    bytes += column.bools.size() + column.ints.size() * sizeof(int64_t) +
+             column.doubles.size() * sizeof(double);
+    for (const std::string& text : column.strings) {
+      bytes += text.size();
+    }
+    for (const std::vector<uint8_t>& binary : column.binaries) {
+      bytes += binary.size();
+    }
+  }
+  return bytes;
+}
+
+// Resets the kernel's high-water mark of this process's resident set, so
+// PeakRssBytes() covers only what runs afterwards. Needs Linux 4.0.
+void ResetPeakRss() {
+  if (FILE* file = std::fopen("/proc/self/clear_refs", "w")) {
+    std::fputs("5", file);
+    std::fclose(file);
+  }
+}
+
+int64_t PeakRssBytes() {
+  FILE* file = std::fopen("/proc/self/status", "r");
+  if (!file) {
+    return 0;
+  }
+  char line[256];
+  int64_t kib = 0;
+  while (std::fgets(line, sizeof(line), file)) {
+    if (std::strncmp(line, "VmHWM:", 6) == 0) {
+      kib = std::strtoll(line + 6, nullptr, 10);
+      break;
+    }
+  }
+  std::fclose(file);
+  return kib * 1024;
+}
+
+// Counts allocations and the peak RSS of the benchmark loop it spans, and
+// reports them with the throughput counters.
+class Measurement {
+ public:
+  explicit Measurement(benchmark::State& state) : state_(state) {
+    ResetPeakRss();
+    allocations_ = g_allocations.load(std::memory_order_relaxed);
+    allocated_bytes_ = g_allocated_bytes.load(std::memory_order_relaxed);
+  }
+
+  void Finish(int64_t rows_per_iteration, int64_t bytes_per_iteration) {
+    benchmark::Counter::Flags per_iteration =
+        benchmark::Counter::kAvgIterations;
+    state_.counters["allocs"] = benchmark::Counter(
+        static_cast<double>(g_allocations.load(std::memory_order_relaxed) -
+                            allocations_),
+        per_iteration);
+    state_.counters["alloc_bytes"] = benchmark::Counter(
+        static_cast<double>(
+            g_allocated_bytes.load(std::memory_order_relaxed) -
+            allocated_bytes_),
+        per_iteration, benchmark::Counter::kIs1024);
+    state_.counters["peak_rss"] = benchmark::Counter(
+        static_cast<double>(PeakRssBytes()), benchmark::Counter::kDefaults,
+        benchmark::Counter::kIs1024);
+    state_.SetItemsProcessed(state_.iterations() * rows_per_iteration);
+    state_.SetBytesProcessed(state_.iterations() * bytes_per_iteration);
+  }
+
+ private:
+  benchmark::State& state_;
+  uint64_t allocations_ = 0;
+  uint64_t allocated_bytes_ = 0;
+};
+
+// Executes the query and pulls every rowset, reading no cells.
+void BM_Fetch(benchmark::State& state) {
+  Session session;
+  ColumnarResult sample;
+  if (!ReadResult(&session, Query(state), &sample)) {
+    state.SkipWithError("query failed");
+    return;
+  }
+  std::vector<SQLWCHAR> sql = mssql_connect::Utf8ToUtf16(Query(state));
+  Measurement measurement(state);
+  for (auto _ : state) {
+    session.Execute(sql);
+    BlockFetcher fetcher(session.stmt());
+    std::string error;
+    fetcher.Bind(&error);
+    SQLULEN rows = 0;
+    while (fetcher.Next(&rows, &error) && rows > 0) {
+      benchmark::DoNotOptimize(rows);
+    }
+  }
+  measurement.Finish(sample.row_count, PayloadBytes(sample));
+}
+
+// Executes the query and decodes every cell into typed columns, the way
+// every Query reply starts.
+void BM_Decode(benchmark::State& state) {
+  Session session;
+  ColumnarResult sample;
+  if (!ReadResult(&session, Query(state), &sample)) {
+    state.SkipWithError("query failed");
+    return;
+  }
+  std::vector<SQLWCHAR> sql = mssql_connect::Utf8ToUtf16(Query(state));
+  Measurement measurement(state);
+  for (auto _ : state) {
+    session.Execute(sql);
+    BlockFetcher fetcher(session.stmt());
+    ColumnarResult result;
+    std::string error;
+    fetcher.Bind(&error);
+    mssql_connect::ReadColumnar(&fetcher, &result, &error);
+    benchmark::DoNotOptimize(result.row_count);
+  }
+  measurement.Finish(sample.row_count, PayloadBytes(sample));
+}
+
+// Transcodes 1000 UTF-16 strings of range(0) units each to UTF-8; with
+// range(1) set, one unit in eight is outside ASCII.
+void BM_Transcode(benchmark::State& state) {
+  const size_t kStrings = 1000;
+  size_t length = static_cast<size_t>(state.range(0));
+  std::vector<SQLWCHAR> text(kStrings * length);
+  for (size_t i = 0; i < text.size(); ++i) {
+    text[i] = state.range(1) && i % 8 == 7 ? static_cast<SQLWCHAR>(0x00E9 + i % 16)
+                                           : static_cast<SQLWCHAR>('a' + i % 26);
+  }
+  std::string out;
+  out.reserve(length * 3);
+  Measurement measurement(state);
+  for (auto _ : state) {
+    for (size_t i = 0; i < kStrings; ++i) {
+      out.clear();
+      mssql_connect::AppendUtf16AsUtf8(text.data() + i * length, length, &out);
+      benchmark::DoNotOptimize(out.data());
+    }
+  }
+  measurement.Finish(kStrings, text.size() * sizeof(SQLWCHAR));
+}
+
+// Builds the reply from an already decoded result and encodes it with the
+// standard message codec, as the platform channel does. range(2) picks the
+// shape: 0 per-row maps, 1 columnar, 2 the binary result encoding.
+void BM_Encode(benchmark::State& state) {
+  Session session;
+  ColumnarResult result;
+  if (!ReadResult(&session, Query(state), &result)) {
+    state.SkipWithError("query failed");
+    return;
+  }
+  g_autoptr(FlStandardMessageCodec) codec = fl_standard_message_codec_new();
+  int64_t encoded_bytes = 0;
+  Measurement measurement(state);
+  for (auto _ : state) {
+    if (state.range(2) == 2) {
+      std::vector<uint8_t> buffer;
+      mssql_connect::EncodeBinaryResult(result, &buffer);
+      encoded_bytes = static_cast<int64_t>(buffer.size());
+      continue;
+    }
+    g_autoptr(FlValue) response =
+        state.range(2) == 0 ? mssql_connect::EncodeRows(result)
+                            : mssql_connect::EncodeColumnar(result);
+    g_autoptr(GError) error = nullptr;
+    g_autoptr(GBytes) message = fl_message_codec_encode_message(
+        FL_MESSAGE_CODEC(codec), response, &error);
+    encoded_bytes = message ? static_cast<int64_t>(g_bytes_get_size(message)) : 0;
+  }
+  state.counters["encoded_bytes"] = static_cast<double>(encoded_bytes);
+  measurement.Finish(result.row_count, PayloadBytes(result));
+}
+
+void ShapeArguments(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"rows", "shape"});
+  for (int64_t rows : {1000, 100000}) {
+    for (int64_t shape = 0; shape < 4; ++shape) {
+      benchmark->Args({rows, shape});
+    }
+  }
+}
+
+void EncodeArguments(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"rows", "shape", "reply"});
+  for (int64_t rows : {1000, 100000}) {
+    for (int64_t shape = 0; shape < 3; ++shape) {
+      for (int64_t reply = 0; reply < 3; ++reply) {
+        benchmark->Args({rows, shape, reply});
+      }
+    }
+  }
+}
+
+BENCHMARK(BM_Fetch)->Apply(ShapeArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Decode)->Apply(ShapeArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Transcode)
+    ->ArgNames({"units", "non_ascii"})
+    ->ArgsProduct({{8, 64, 1024}, {0, 1}});
+BENCHMARK(BM_Encode)->Apply(EncodeArguments)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  std::printf("Shapes:\n");
+  for (size_t i = 0; i < sizeof(kShapes) / sizeof(kShapes[0]); ++i) {
+    std::printf("  %zu %-6s %s\n", i, kShapeNames[i], kShapes[i]);
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
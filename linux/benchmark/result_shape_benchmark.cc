@@ -0,0 +1,319 @@
+// Measures building and encoding a query result in the per-row map shape,
+// the columnar shape (resultFormat: 'columnar') and the binary result
+// encoding (queryBinary).
+//
+// Usage: result_shape_benchmark [rows] [cols]
+//
+// Without |rows|, runs 10k, 100k and 1M rows. Each shape runs in its own
+// child process so its peak RSS is reported separately. Rows come from the
+// synthetic driver through BlockFetcher. The map and columnar shapes are
+// built as FlValues and encoded with the standard message codec, which is
+// what the platform channel does with a reply; the binary shape is encoded
+// with EncodeBinaryResult and handed over as GBytes, which is what a binary
+// messenger reply takes. benchmark/result_codec_benchmark.dart measures the
+// Dart side of the same shapes.
+
+#include <flutter_linux/flutter_linux.h>
+#include <sql.h>
+#include <sqlext.h>
+#include <sqlucode.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "binary_result.h"
+#include "block_fetcher.h"
+#include "columnar_result.h"
+
+namespace {
+
+using mssql_connect::BlockFetcher;
+using mssql_connect::CellType;
+using mssql_connect::ColumnarResult;
+using mssql_connect::ResultColumn;
+
+using Clock = std::chrono::steady_clock;
+
+enum class Shape { kRows, kColumnar, kBinary };
+
+struct Timings {
+  double build_seconds = 0;
+  double encode_seconds = 0;
+  size_t encoded_bytes = 0;
+};
+
+FlValue* BuildRows(BlockFetcher* fetcher) {
+  const std::vector<mssql_connect::ColumnDescription>& columns =
+      fetcher->columns();
+  FlValue* rows = fl_value_new_list();
+  std::string text;
+  SQLULEN rowset = 0;
+  std::string error;
+  int64_t row_count = 0;
+  while (fetcher->Next(&rowset, &error) && rowset > 0) {
+    for (SQLULEN r = 0; r < rowset; ++r) {
+      FlValue* row = fl_value_new_map();
+      for (size_t i = 0; i < columns.size(); ++i) {
+        FlValue* value;
+        if (fetcher->IsNull(i, r)) {
+          value = fl_value_new_null();
+        } else {
+          switch (fetcher->cell_type(i)) {
+            case CellType::kBool:
+              value = fl_value_new_bool(fetcher->GetBool(i, r));
+              break;
+            case CellType::kInt32:
+              value = fl_value_new_int(fetcher->GetInt32(i, r));
+              break;
+            case CellType::kInt64:
+              value = fl_value_new_int(fetcher->GetInt64(i, r));
+              break;
+            case CellType::kDateTime:
+            case CellType::kTime:
+              value = fl_value_new_int(fetcher->GetMicros(i, r));
+              break;
+            case CellType::kDouble:
+              value = fl_value_new_float(fetcher->GetDouble(i, r));
+              break;
+            case CellType::kBinary: {
+              size_t size = 0;
+              const uint8_t* bytes = fetcher->GetBinary(i, r, &size);
+              value = fl_value_new_uint8_list(bytes, size);
+              break;
+            }
+            default:
+              text.clear();
+              fetcher->AppendText(i, r, &text);
+              value = fl_value_new_string_sized(text.data(), text.size());
+              break;
+          }
+        }
+        // Like the Windows reply, every row carries its own copy of the
+        // column name.
+        fl_value_set_string_take(row, columns[i].name.c_str(), value);
+      }
+      fl_value_append_take(rows, row);
+      ++row_count;
+    }
+  }
+  FlValue* names = fl_value_new_list();
+  for (const auto& column : columns) {
+    fl_value_append_take(names, fl_value_new_string(column.name.c_str()));
+  }
+  FlValue* response = fl_value_new_map();
+  fl_value_set_string_take(response, "rows", rows);
+  fl_value_set_string_take(response, "rowCount", fl_value_new_int(row_count));
+  fl_value_set_string_take(response, "columns", names);
+  return response;
+}
+
+FlValue* BuildColumnar(BlockFetcher* fetcher) {
+  ColumnarResult result;
+  std::string error;
+  if (!mssql_connect::ReadColumnar(fetcher, &result, &error)) {
+    return fl_value_new_null();
+  }
+  FlValue* names = fl_value_new_list();
+  FlValue* types = fl_value_new_list();
+  FlValue* data = fl_value_new_list();
+  FlValue* nulls = fl_value_new_list();
+  for (ResultColumn& column : result.columns) {
+    fl_value_append_take(names, fl_value_new_string(column.name.c_str()));
+    switch (column.type) {
+      case CellType::kBool:
+        fl_value_append_take(types, fl_value_new_string("bool"));
+        fl_value_append_take(data, fl_value_new_uint8_list(
+                                       column.bools.data(), column.bools.size()));
+        break;
+      case CellType::kInt32:
+      case CellType::kInt64:
+        fl_value_append_take(types, fl_value_new_string("int"));
+        fl_value_append_take(data, fl_value_new_int64_list(
+                                       column.ints.data(), column.ints.size()));
+        break;
+      case CellType::kDouble:
+        fl_value_append_take(types, fl_value_new_string("double"));
+        fl_value_append_take(data,
+                             fl_value_new_float_list(column.doubles.data(),
+                                                     column.doubles.size()));
+        break;
+      case CellType::kBinary: {
+        fl_value_append_take(types, fl_value_new_string("binary"));
+        FlValue* binaries = fl_value_new_list();
+        for (const std::vector<uint8_t>& bytes : column.binaries) {
+          fl_value_append_take(
+              binaries, fl_value_new_uint8_list(bytes.data(), bytes.size()));
+        }
+        fl_value_append_take(data, binaries);
+        break;
+      }
+      default: {
+        fl_value_append_take(types, fl_value_new_string("string"));
+        FlValue* strings = fl_value_new_list();
+        for (const std::string& text : column.strings) {
+          fl_value_append_take(
+              strings, fl_value_new_string_sized(text.data(), text.size()));
+        }
+        fl_value_append_take(data, strings);
+        break;
+      }
+    }
+    fl_value_append_take(
+        nulls, column.null_bitmap.empty()
+                   ? fl_value_new_null()
+                   : fl_value_new_uint8_list(column.null_bitmap.data(),
+                                             column.null_bitmap.size()));
+  }
+  FlValue* response = fl_value_new_map();
+  fl_value_set_string_take(response, "format", fl_value_new_string("columnar"));
+  fl_value_set_string_take(response, "rowCount",
+                           fl_value_new_int(result.row_count));
+  fl_value_set_string_take(response, "columns", names);
+  fl_value_set_string_take(response, "columnTypes", types);
+  fl_value_set_string_take(response, "columnData", data);
+  fl_value_set_string_take(response, "nulls", nulls);
+  return response;
+}
+
+// Builds the reply as FlValues and encodes it with the standard codec.
+bool MeasureCodec(BlockFetcher* fetcher, Shape shape, Timings* timings) {
+  Clock::time_point start = Clock::now();
+  g_autoptr(FlValue) response = shape == Shape::kColumnar
+                                    ? BuildColumnar(fetcher)
+                                    : BuildRows(fetcher);
+  Clock::time_point built = Clock::now();
+
+  g_autoptr(FlStandardMessageCodec) codec = fl_standard_message_codec_new();
+  g_autoptr(GError) codec_error = nullptr;
+  g_autoptr(GBytes) message = fl_message_codec_encode_message(
+      FL_MESSAGE_CODEC(codec), response, &codec_error);
+  Clock::time_point encoded = Clock::now();
+
+  timings->build_seconds = std::chrono::duration<double>(built - start).count();
+  timings->encode_seconds =
+      std::chrono::duration<double>(encoded - built).count();
+  timings->encoded_bytes = message ? g_bytes_get_size(message) : 0;
+  return message != nullptr;
+}
+
+// Reads the result into columns and encodes it in the binary result
+// encoding, handing the buffer to GBytes without a copy.
+bool MeasureBinary(BlockFetcher* fetcher, Timings* timings) {
+  Clock::time_point start = Clock::now();
+  ColumnarResult result;
+  std::string error;
+  if (!mssql_connect::ReadColumnar(fetcher, &result, &error)) {
+    return false;
+  }
+  Clock::time_point built = Clock::now();
+
+  auto* buffer = new std::vector<uint8_t>();
+  mssql_connect::EncodeBinaryResult(result, buffer);
+  g_autoptr(GBytes) message = g_bytes_new_with_free_func(
+      buffer->data(), buffer->size(),
+      [](gpointer data) { delete static_cast<std::vector<uint8_t>*>(data); },
+      buffer);
+  Clock::time_point encoded = Clock::now();
+
+  timings->build_seconds = std::chrono::duration<double>(built - start).count();
+  timings->encode_seconds =
+      std::chrono::duration<double>(encoded - built).count();
+  timings->encoded_bytes = g_bytes_get_size(message);
+  return true;
+}
+
+bool Measure(const std::string& query, Shape shape, Timings* timings) {
+  SQLHENV env;
+  SQLHDBC dbc;
+  SQLHSTMT stmt;
+  SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+  SQLAllocHandle(SQL_HANDLE_DBC, env, &dbc);
+  SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+  std::vector<SQLWCHAR> sql(query.begin(), query.end());
+  if (!SQL_SUCCEEDED(SQLExecDirectW(stmt, sql.data(),
+                                    static_cast<SQLINTEGER>(sql.size())))) {
+    return false;
+  }
+
+  bool ok = true;
+  {
+    BlockFetcher fetcher(stmt);
+    std::string error;
+    if (!fetcher.Bind(&error)) {
+      return false;
+    }
+    ok = shape == Shape::kBinary ? MeasureBinary(&fetcher, timings)
+                                 : MeasureCodec(&fetcher, shape, timings);
+  }
+
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+  SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+  SQLFreeHandle(SQL_HANDLE_ENV, env);
+  return ok;
+}
+
+// Runs one shape in a child process and prints its timings and peak RSS.
+bool RunIsolated(const char* label, const std::string& query, Shape shape) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    Timings timings;
+    bool ok = Measure(query, shape, &timings);
+    ssize_t written = write(fds[1], &timings, sizeof(timings));
+    _exit(ok && written == sizeof(timings) ? 0 : 1);
+  }
+  close(fds[1]);
+  Timings timings;
+  ssize_t got = read(fds[0], &timings, sizeof(timings));
+  close(fds[0]);
+  int status = 0;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0 || got != sizeof(timings)) {
+    std::fprintf(stderr, "%s: run failed\n", label);
+    return false;
+  }
+  std::printf("  %-9s build %8.1f ms  encode %8.1f ms  %10zu bytes  "
+              "peak RSS %8.1f MiB\n",
+              label, timings.build_seconds * 1e3, timings.encode_seconds * 1e3,
+              timings.encoded_bytes, usage.ru_maxrss / 1024.0);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<unsigned long> row_counts = {10000, 100000, 1000000};
+  if (argc > 1) {
+    row_counts = {std::strtoul(argv[1], nullptr, 10)};
+  }
+  unsigned long cols = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+  const char* shapes[] = {
+      "types=int,double,bit,text strlen=16",
+      "types=int,double,bit,text strlen=16 nulls=5",
+  };
+  for (unsigned long rows : row_counts) {
+    for (const char* shape : shapes) {
+      std::string query = "SELECT rows=" + std::to_string(rows) +
+                          " cols=" + std::to_string(cols) + " " + shape;
+      std::printf("%lu x %lu %s\n", rows, cols, shape);
+      if (!RunIsolated("rows", query, Shape::kRows) ||
+          !RunIsolated("columnar", query, Shape::kColumnar) ||
+          !RunIsolated("binary", query, Shape::kBinary)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
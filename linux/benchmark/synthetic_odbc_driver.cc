@@ -0,0 +1,1841 @@
+// A minimal ODBC driver that serves generated result sets, so fetch paths
+// can be measured on Linux without a SQL Server.
+//
+// The statement text describes the result instead of querying anything:
+//
+//   SELECT rows=100000 cols=8 types=int,double,bit,text strlen=32 nulls=10
+//
+//   rows    number of rows (default 1000)
+//   cols    number of columns (default 4)
+//   types   comma-separated column types, repeated to fill |cols|:
+//           int, double, bit, text (nvarchar(strlen)), lob (nvarchar(max)),
+//           bin (varbinary(strlen)), blob (varbinary(max)), bigint,
+//           decimal (decimal(18,4)), numeric (numeric(38,4)), datetime
+//           (datetime2(7)), date, time (time(7)), guid (uniqueidentifier)
+//   strlen  characters or bytes per text, lob, bin or blob value
+//           (default 16)
+//   nulls   every n-th row is NULL in every column; 0 disables (default 0)
+//   latency microseconds each execution sleeps, standing in for a network
+//           round trip or a long-running query (default 0). The sleep ends
+//           early with HY008 when SQLCancel is called from another thread,
+//           or with HYT00 once SQL_ATTR_QUERY_TIMEOUT seconds have passed.
+//           With SQL_ATTR_ASYNC_ENABLE on, the execution returns
+//           SQL_STILL_EXECUTING instead of sleeping until the latency has
+//           passed
+//   fail    every n-th parameter set of an array execution fails; 0
+//           disables (default 0)
+//   params  comma-separated types SQLDescribeParam reports for parameters
+//           1..n, from the same names as types; without it SQLDescribeParam
+//           is not supported
+//   pairs   1 to make text, lob and their SQL_C_WCHAR values out of UTF-16
+//           surrogate pairs (emoji), so strlen counts code units; 0 for
+//           ASCII letters (default 0)
+//   bad     every n-th row cannot be converted: SQLFetch marks it
+//           SQL_ROW_ERROR in the row status array with 22018; 0 disables
+//           (default 0)
+//   edges   1 to give row 0 the smallest value of each non-text type and
+//           row 1 the largest, e.g. INT64_MIN and INT64_MAX or 0001-01-01
+//           and 9999-12-31 23:59:59.9999999, when fetched as their C type;
+//           0 disables (default 0)
+//
+// SQL_C_NUMERIC values have the scale set with SQL_DESC_SCALE on the ARD,
+// or 0 (truncating the fraction) if it was not set after SQLBindCol, as
+// with SQL Server's driver.
+//
+// A statement with cols=0 has no result set and reports |rows| affected
+// rows per parameter set, like an INSERT.
+//
+// Statements separated by ';' form a batch with one result each. The first
+// is current after execution; SQLMoreResults moves to the next one, and
+// reports a statement that cannot be parsed when it gets there, as the
+// server reports errors of later statements. Only the first statement's
+// latency and parameter sets apply.
+//
+// A procedure call escape, {? = call name(?, ...)} or {call name(?, ...)},
+// runs a synthetic procedure without results. Every argument must be named
+// with SQL_DESC_NAME on the IPD, as SQL Server's driver allows. The return
+// value is the number of arguments. An output or input/output argument
+// bound as SQL_C_SBIGINT receives its input (0 if output only) plus the
+// length of its name without the '@'; one bound as SQL_C_WCHAR receives its
+// input followed by that name. A NULL input/output argument stays NULL, and
+// arguments of other types are left as they are.
+//
+// Connections track SQL_ATTR_AUTOCOMMIT, the isolation level and an open
+// transaction count. With autocommit off, the first generated statement
+// starts a transaction, which SQLEndTran ends. The T-SQL the plugin issues
+// for savepoints is understood too: batches of SAVE TRANSACTION name,
+// ROLLBACK TRANSACTION name and SELECT @@TRANCOUNT separated by ';', each
+// optionally guarded by IF @@TRANCOUNT > 0.
+//
+// Values are a pure function of (row, column), so every fetch path sees the
+// same data. The library can be registered with unixODBC as a driver, or
+// linked directly into a benchmark in place of the driver manager.
+// SyntheticOdbcCallCount() reports how many ODBC entry points were called,
+// SyntheticOdbcEndTranCount() how often a connection committed or rolled
+// back, SyntheticOdbcParamType() the SQL type a parameter was bound with,
+// SyntheticOdbcParamData() the buffers it was bound to, and
+// SyntheticOdbcParamsetSize() how many parameter sets each execution of a
+// prepared statement sent.
+
+#include <sql.h>
+#include <sqlext.h>
+#include <sqlucode.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define SYNTHETIC_EXPORT extern "C" __attribute__((visibility("default")))
+
+namespace {
+
+std::atomic<uint64_t> g_calls(0);
+
+enum class ColumnKind {
+  kInt,
+  kDouble,
+  kBit,
+  kText,
+  kLob,
+  kBin,
+  kBlob,
+  kBigint,
+  kDecimal,
+  kNumeric,
+  kDateTime,
+  kDate,
+  kTime,
+  kGuid,
+};
+
+// SQL Server's time(n) type and its C struct, from msodbcsql.h.
+const SQLSMALLINT kSqlSsTime2 = -154;
+const SQLSMALLINT kSqlCSsTime2 = 0x4000;
+struct SsTime2Struct {
+  SQLUSMALLINT hour;
+  SQLUSMALLINT minute;
+  SQLUSMALLINT second;
+  SQLUINTEGER fraction;
+};
+
+// SQL Server's snapshot isolation attribute and level, from msodbcsql.h.
+const SQLINTEGER kCoptSsTxnIsolation = 1227;
+
+// Scale of the decimal and numeric kinds.
+const int kDecimalScale = 4;
+
+struct ResultSpec {
+  SQLULEN rows = 1000;
+  size_t cols = 4;
+  std::vector<ColumnKind> kinds{ColumnKind::kInt, ColumnKind::kDouble,
+                                ColumnKind::kBit, ColumnKind::kText};
+  size_t string_length = 16;
+  SQLULEN null_every = 0;
+  unsigned long latency_us = 0;
+  SQLULEN fail_every = 0;
+  SQLULEN bad_every = 0;
+  bool surrogate_pairs = false;
+  bool edges = false;
+  std::vector<ColumnKind> param_kinds;
+  // Every int cell holds |scalar| instead of a generated value; used for
+  // SELECT @@TRANCOUNT.
+  bool has_scalar = false;
+  SQLINTEGER scalar = 0;
+};
+
+struct Binding {
+  SQLSMALLINT c_type = 0;
+  SQLPOINTER data = nullptr;
+  SQLLEN length = 0;
+  SQLLEN* indicator = nullptr;
+};
+
+struct Parameter {
+  SQLSMALLINT io_type = SQL_PARAM_INPUT;
+  SQLSMALLINT sql_type = SQL_UNKNOWN_TYPE;
+  Binding binding;
+};
+
+struct Handle {
+  explicit Handle(SQLSMALLINT handle_type) : type(handle_type) {}
+  SQLSMALLINT type;
+  std::string sqlstate;
+  std::string message;
+};
+
+// The fields of a descriptor record the driver acts on; the rest are
+// accepted and ignored.
+struct DescriptorRecord {
+  // SQL_DESC_NAME, set on the IPD to bind a procedure argument by name.
+  std::string name;
+  // SQL_DESC_SCALE, set on the ARD for SQL_C_NUMERIC.
+  SQLSMALLINT scale = 0;
+};
+
+struct Descriptor : Handle {
+  Descriptor() : Handle(SQL_HANDLE_DESC) {}
+  // Records 1..n at [0, n).
+  std::vector<DescriptorRecord> records;
+
+  DescriptorRecord* Record(SQLSMALLINT number) {
+    if (records.size() < static_cast<size_t>(number)) {
+      records.resize(number);
+    }
+    return &records[number - 1];
+  }
+};
+
+struct Connection : Handle {
+  Connection() : Handle(SQL_HANDLE_DBC) {}
+  bool autocommit = true;
+  SQLULEN isolation = SQL_TXN_READ_COMMITTED;
+  // Open transactions, as @@TRANCOUNT reports them, and the savepoints
+  // taken in the current one, oldest first.
+  SQLINTEGER trancount = 0;
+  std::vector<std::string> savepoints;
+  uint64_t commits = 0;
+  uint64_t rollbacks = 0;
+};
+
+struct Statement : Handle {
+  explicit Statement(Connection* owner)
+      : Handle(SQL_HANDLE_STMT), connection(owner) {}
+  Connection* connection;
+  ResultSpec spec;
+  bool has_result = false;
+  // First row of the current rowset and of the next one.
+  SQLULEN rowset_start = 0;
+  SQLULEN next_row = 0;
+  bool positioned = false;
+  SQLULEN row_array_size = 1;
+  SQLULEN* rows_fetched = nullptr;
+  SQLUSMALLINT* row_status = nullptr;
+  SQLULEN bind_type = SQL_BIND_BY_COLUMN;
+  std::vector<Binding> bindings;
+  // Characters already returned by SQLGetData, per column.
+  std::vector<size_t> get_data_offsets;
+  // Text given to SQLPrepare, run by SQLExecute.
+  std::vector<SQLWCHAR> prepared;
+  // Statements of the executed batch that SQLMoreResults has not reached.
+  std::vector<std::string> pending;
+  // Parameters do not affect the generated result, except the output
+  // parameters of a procedure call; how each was bound, and the parameter
+  // set count of every execution since SQLPrepare, are kept for the tests.
+  std::vector<Parameter> params;
+  std::vector<SQLULEN> paramset_sizes;
+  Descriptor app_row_desc;
+  Descriptor app_param_desc;
+  Descriptor imp_row_desc;
+  Descriptor imp_param_desc;
+  SQLULEN paramset_size = 1;
+  SQLUSMALLINT* param_status = nullptr;
+  SQLULEN* params_processed = nullptr;
+  SQLLEN row_count = 0;
+  SQLULEN query_timeout = 0;
+  // Set by SQLCancel from another thread while an execution sleeps.
+  std::atomic<bool> cancelled{false};
+  // SQL_ATTR_ASYNC_ENABLE, and when the execution in progress started.
+  bool async = false;
+  bool executing = false;
+  std::chrono::steady_clock::time_point started;
+};
+
+SQLRETURN Fail(Handle* handle, const char* sqlstate, const char* message) {
+  handle->sqlstate = sqlstate;
+  handle->message = message;
+  return SQL_ERROR;
+}
+
+// Waits out an execution's latency. A synchronous statement sleeps a
+// millisecond at a time so that SQLCancel and the query timeout can end it;
+// an asynchronous one returns SQL_STILL_EXECUTING until the latency has
+// passed, checking the same way on every call. Returns SQL_ERROR and sets
+// the statement's diagnostics if cancelled or timed out.
+SQLRETURN Wait(Statement* statement, unsigned long latency_us) {
+  using Clock = std::chrono::steady_clock;
+  if (!statement->executing) {
+    statement->cancelled = false;
+    statement->executing = true;
+    statement->started = Clock::now();
+  }
+  const Clock::time_point end =
+      statement->started + std::chrono::microseconds(latency_us);
+  const Clock::time_point timeout =
+      statement->query_timeout > 0
+          ? statement->started + std::chrono::seconds(statement->query_timeout)
+          : Clock::time_point::max();
+  for (Clock::time_point now = Clock::now();; now = Clock::now()) {
+    SQLRETURN ret = SQL_STILL_EXECUTING;
+    if (statement->cancelled) {
+      ret = Fail(statement, "HY008", "Operation canceled");
+    } else if (now >= timeout) {
+      ret = Fail(statement, "HYT00", "Query timeout expired");
+    } else if (now >= end) {
+      ret = SQL_SUCCESS;
+    }
+    if (ret != SQL_STILL_EXECUTING) {
+      statement->executing = false;
+      return ret;
+    }
+    if (statement->async) {
+      return SQL_STILL_EXECUTING;
+    }
+    std::this_thread::sleep_for(
+        std::min<Clock::duration>(end - now, std::chrono::milliseconds(1)));
+  }
+}
+
+bool ParseKind(const std::string& name, ColumnKind* kind) {
+  if (name == "int") {
+    *kind = ColumnKind::kInt;
+  } else if (name == "double") {
+    *kind = ColumnKind::kDouble;
+  } else if (name == "bit") {
+    *kind = ColumnKind::kBit;
+  } else if (name == "text") {
+    *kind = ColumnKind::kText;
+  } else if (name == "lob") {
+    *kind = ColumnKind::kLob;
+  } else if (name == "bin") {
+    *kind = ColumnKind::kBin;
+  } else if (name == "blob") {
+    *kind = ColumnKind::kBlob;
+  } else if (name == "bigint") {
+    *kind = ColumnKind::kBigint;
+  } else if (name == "decimal") {
+    *kind = ColumnKind::kDecimal;
+  } else if (name == "numeric") {
+    *kind = ColumnKind::kNumeric;
+  } else if (name == "datetime") {
+    *kind = ColumnKind::kDateTime;
+  } else if (name == "date") {
+    *kind = ColumnKind::kDate;
+  } else if (name == "time") {
+    *kind = ColumnKind::kTime;
+  } else if (name == "guid") {
+    *kind = ColumnKind::kGuid;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ParseSpec(const std::string& sql, ResultSpec* spec) {
+  std::istringstream words(sql);
+  std::string word;
+  while (words >> word) {
+    size_t equals = word.find('=');
+    if (equals == std::string::npos) {
+      continue;
+    }
+    std::string key = word.substr(0, equals);
+    std::string value = word.substr(equals + 1);
+    if (key == "rows") {
+      spec->rows = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (key == "cols") {
+      spec->cols = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (key == "strlen") {
+      spec->string_length = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (key == "nulls") {
+      spec->null_every = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (key == "latency") {
+      spec->latency_us = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (key == "fail") {
+      spec->fail_every = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (key == "edges") {
+      spec->edges = std::strtoul(value.c_str(), nullptr, 10) != 0;
+    } else if (key == "pairs") {
+      spec->surrogate_pairs = std::strtoul(value.c_str(), nullptr, 10) != 0;
+    } else if (key == "bad") {
+      spec->bad_every = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (key == "types" || key == "params") {
+      std::vector<ColumnKind>* kinds =
+          key == "types" ? &spec->kinds : &spec->param_kinds;
+      kinds->clear();
+      std::istringstream names(value);
+      std::string name;
+      while (std::getline(names, name, ',')) {
+        ColumnKind kind;
+        if (!ParseKind(name, &kind)) {
+          return false;
+        }
+        kinds->push_back(kind);
+      }
+    }
+  }
+  return !spec->kinds.empty();
+}
+
+ColumnKind KindOf(const ResultSpec& spec, size_t column) {
+  return spec.kinds[column % spec.kinds.size()];
+}
+
+bool IsNullCell(const ResultSpec& spec, SQLULEN row) {
+  return spec.null_every != 0 && row % spec.null_every == spec.null_every - 1;
+}
+
+bool IsBadRow(const ResultSpec& spec, SQLULEN row) {
+  return spec.bad_every != 0 && row % spec.bad_every == spec.bad_every - 1;
+}
+
+// Deterministic cell values.
+SQLINTEGER IntValue(SQLULEN row, size_t column) {
+  return static_cast<SQLINTEGER>(row * (column + 1));
+}
+double DoubleValue(SQLULEN row, size_t column) {
+  return static_cast<double>(row) + 0.25 * static_cast<double>(column + 1);
+}
+unsigned char BitValue(SQLULEN row, size_t column) {
+  return static_cast<unsigned char>((row + column) & 1);
+}
+SQLWCHAR TextChar(const ResultSpec& spec, SQLULEN row, size_t column,
+                  size_t index) {
+  if (spec.surrogate_pairs) {
+    // U+1F600 onwards: a high surrogate, then a low one.
+    return static_cast<SQLWCHAR>(
+        index % 2 == 0 ? 0xD83D : 0xDE00 + (row + column + index / 2) % 26);
+  }
+  return static_cast<SQLWCHAR>('a' + (row + column + index) % 26);
+}
+unsigned char ByteValue(SQLULEN row, size_t column, size_t index) {
+  return static_cast<unsigned char>(row * 31 + column + index);
+}
+int64_t BigintValue(SQLULEN row, size_t column) {
+  return static_cast<int64_t>(row) * 4294967311LL + static_cast<int64_t>(column);
+}
+// Unscaled decimal and numeric values; numeric ones need more than 64 bits.
+unsigned __int128 DecimalMagnitude(ColumnKind kind, SQLULEN row,
+                                   size_t column) {
+  if (kind == ColumnKind::kNumeric) {
+    return (static_cast<unsigned __int128>(row) << 64) + column + 1;
+  }
+  return static_cast<unsigned __int128>(row) * 1234567 + column;
+}
+bool DecimalNegative(SQLULEN row) { return row % 5 == 1; }
+// Seconds since the epoch and nanoseconds of datetime cells, from
+// 2024-01-01.
+int64_t DateTimeSeconds(ColumnKind kind, SQLULEN row, size_t column) {
+  const int64_t kBase = 1704067200;
+  if (kind == ColumnKind::kDate) {
+    return kBase + static_cast<int64_t>(row + column) * 86400;
+  }
+  return kBase + static_cast<int64_t>(row) * 61 + static_cast<int64_t>(column);
+}
+SQLUINTEGER DateTimeNanos(ColumnKind kind, SQLULEN row) {
+  return kind == ColumnKind::kDate ? 0 : static_cast<SQLUINTEGER>(row % 1000) * 1000000;
+}
+int64_t TimeSeconds(SQLULEN row, size_t column) {
+  return static_cast<int64_t>((row * 37 + column) % 86400);
+}
+SQLUINTEGER TimeNanos(SQLULEN row) {
+  return static_cast<SQLUINTEGER>(row % 10000000) * 100;
+}
+SQLGUID GuidValue(SQLULEN row, size_t column) {
+  SQLGUID guid;
+  guid.Data1 = static_cast<unsigned int>(row);
+  guid.Data2 = static_cast<unsigned short>(column);
+  guid.Data3 = static_cast<unsigned short>(0x4000 | (row & 0xFFF));
+  for (int i = 0; i < 8; ++i) {
+    guid.Data4[i] = static_cast<unsigned char>(row * (i + 1));
+  }
+  return guid;
+}
+
+// Civil date of |days| since 1970-01-01.
+void CivilFromDays(int64_t days, int* year, unsigned* month, unsigned* day) {
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  unsigned day_of_era = static_cast<unsigned>(days - era * 146097);
+  unsigned year_of_era =
+      (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+       day_of_era / 146096) / 365;
+  unsigned day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  unsigned mp = (5 * day_of_year + 2) / 153;
+  *day = day_of_year - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  *year = static_cast<int>(year_of_era + era * 400 + (*month <= 2));
+}
+
+SQL_TIMESTAMP_STRUCT TimestampValue(ColumnKind kind, SQLULEN row,
+                                    size_t column) {
+  int64_t seconds = DateTimeSeconds(kind, row, column);
+  int year;
+  unsigned month;
+  unsigned day;
+  CivilFromDays(seconds / 86400, &year, &month, &day);
+  SQL_TIMESTAMP_STRUCT value;
+  value.year = static_cast<SQLSMALLINT>(year);
+  value.month = static_cast<SQLUSMALLINT>(month);
+  value.day = static_cast<SQLUSMALLINT>(day);
+  value.hour = static_cast<SQLUSMALLINT>(seconds % 86400 / 3600);
+  value.minute = static_cast<SQLUSMALLINT>(seconds % 3600 / 60);
+  value.second = static_cast<SQLUSMALLINT>(seconds % 60);
+  value.fraction = DateTimeNanos(kind, row);
+  return value;
+}
+
+// The text SQL Server sends when a typed cell is fetched as a string.
+std::string FormatCell(ColumnKind kind, SQLULEN row, size_t column) {
+  char buffer[64];
+  switch (kind) {
+    case ColumnKind::kBigint:
+      std::snprintf(buffer, sizeof(buffer), "%lld",
+                    static_cast<long long>(BigintValue(row, column)));
+      return buffer;
+    case ColumnKind::kDecimal:
+    case ColumnKind::kNumeric: {
+      unsigned __int128 magnitude = DecimalMagnitude(kind, row, column);
+      std::string digits;
+      do {
+        digits.insert(digits.begin(), static_cast<char>('0' + magnitude % 10));
+        magnitude /= 10;
+      } while (magnitude != 0);
+      while (digits.size() <= static_cast<size_t>(kDecimalScale)) {
+        digits.insert(digits.begin(), '0');
+      }
+      digits.insert(digits.end() - kDecimalScale, '.');
+      return (DecimalNegative(row) ? "-" : "") + digits;
+    }
+    case ColumnKind::kDateTime:
+    case ColumnKind::kDate: {
+      SQL_TIMESTAMP_STRUCT value = TimestampValue(kind, row, column);
+      if (kind == ColumnKind::kDate) {
+        std::snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u", value.year,
+                      value.month, value.day);
+      } else {
+        std::snprintf(buffer, sizeof(buffer),
+                      "%04d-%02u-%02u %02u:%02u:%02u.%07u", value.year,
+                      value.month, value.day, value.hour, value.minute,
+                      value.second, value.fraction / 100);
+      }
+      return buffer;
+    }
+    case ColumnKind::kTime: {
+      int64_t seconds = TimeSeconds(row, column);
+      std::snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d.%07u",
+                    static_cast<int>(seconds / 3600),
+                    static_cast<int>(seconds % 3600 / 60),
+                    static_cast<int>(seconds % 60), TimeNanos(row) / 100);
+      return buffer;
+    }
+    case ColumnKind::kGuid: {
+      SQLGUID guid = GuidValue(row, column);
+      std::snprintf(buffer, sizeof(buffer),
+                    "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+                    guid.Data1, guid.Data2, guid.Data3, guid.Data4[0],
+                    guid.Data4[1], guid.Data4[2], guid.Data4[3],
+                    guid.Data4[4], guid.Data4[5], guid.Data4[6],
+                    guid.Data4[7]);
+      return buffer;
+    }
+    default:
+      return std::string();
+  }
+}
+
+// Writes |text| NUL-terminated as SQL_C_CHAR or SQL_C_WCHAR, truncated to
+// |buffer_bytes|. Returns false if it had to be truncated.
+bool WriteFormatted(const std::string& text, SQLSMALLINT c_type,
+                    SQLPOINTER target, SQLLEN buffer_bytes,
+                    SQLLEN* indicator) {
+  size_t unit = c_type == SQL_C_CHAR ? 1 : sizeof(SQLWCHAR);
+  if (indicator) *indicator = static_cast<SQLLEN>(text.size() * unit);
+  if (buffer_bytes < static_cast<SQLLEN>(unit)) {
+    return text.empty();
+  }
+  size_t count = std::min(text.size(), buffer_bytes / unit - 1);
+  for (size_t i = 0; i < count; ++i) {
+    if (c_type == SQL_C_CHAR) {
+      static_cast<char*>(target)[i] = text[i];
+    } else {
+      static_cast<SQLWCHAR*>(target)[i] = static_cast<SQLWCHAR>(text[i]);
+    }
+  }
+  if (c_type == SQL_C_CHAR) {
+    static_cast<char*>(target)[count] = 0;
+  } else {
+    static_cast<SQLWCHAR*>(target)[count] = 0;
+  }
+  return count == text.size();
+}
+
+std::string Narrow(const SQLWCHAR* text, SQLINTEGER length) {
+  std::string narrow;
+  if (length == SQL_NTS) {
+    while (*text) {
+      narrow.push_back(static_cast<char>(*text++));
+    }
+  } else {
+    for (SQLINTEGER i = 0; i < length; ++i) {
+      narrow.push_back(static_cast<char>(text[i]));
+    }
+  }
+  return narrow;
+}
+
+// Copies the characters of cell text starting at |offset| into a
+// NUL-terminated SQL_C_WCHAR or SQL_C_CHAR buffer of |buffer_bytes|. Returns
+// the number of characters copied.
+size_t CopyText(const ResultSpec& spec, SQLULEN row, size_t column,
+                size_t offset, SQLSMALLINT c_type, SQLPOINTER buffer,
+                SQLLEN buffer_bytes) {
+  size_t length = spec.string_length;
+  size_t unit = c_type == SQL_C_CHAR ? 1 : sizeof(SQLWCHAR);
+  if (buffer_bytes < static_cast<SQLLEN>(unit)) {
+    return 0;
+  }
+  size_t room = buffer_bytes / unit - 1;
+  size_t count = std::min(room, length - offset);
+  for (size_t i = 0; i < count; ++i) {
+    SQLWCHAR c = TextChar(spec, row, column, offset + i);
+    if (c_type == SQL_C_CHAR) {
+      static_cast<char*>(buffer)[i] = static_cast<char>(c);
+    } else {
+      static_cast<SQLWCHAR*>(buffer)[i] = c;
+    }
+  }
+  if (c_type == SQL_C_CHAR) {
+    static_cast<char*>(buffer)[count] = 0;
+  } else {
+    static_cast<SQLWCHAR*>(buffer)[count] = 0;
+  }
+  return count;
+}
+
+// Copies up to |length| bytes of a binary cell starting at |offset| into a
+// SQL_C_BINARY buffer of |buffer_bytes|. Returns the number of bytes copied.
+size_t CopyBytes(SQLULEN row, size_t column, size_t length, size_t offset,
+                 SQLPOINTER buffer, SQLLEN buffer_bytes) {
+  size_t count = std::min(static_cast<size_t>(std::max<SQLLEN>(buffer_bytes, 0)),
+                          length - offset);
+  for (size_t i = 0; i < count; ++i) {
+    static_cast<unsigned char*>(buffer)[i] = ByteValue(row, column, offset + i);
+  }
+  return count;
+}
+
+// The smallest (|high| false) or largest timestamp a kDateTime or kDate
+// cell can hold.
+SQL_TIMESTAMP_STRUCT EdgeTimestamp(ColumnKind kind, bool high) {
+  SQL_TIMESTAMP_STRUCT value;
+  std::memset(&value, 0, sizeof(value));
+  value.year = high ? 9999 : 1;
+  value.month = high ? 12 : 1;
+  value.day = high ? 31 : 1;
+  if (high && kind == ColumnKind::kDateTime) {
+    value.hour = 23;
+    value.minute = 59;
+    value.second = 59;
+    value.fraction = 999999900;
+  }
+  return value;
+}
+
+// Writes the typed cell (row, column) of |spec| as |c_type| into |target|,
+// which holds |buffer_length| bytes, with |numeric_scale| digits after the
+// point for SQL_C_NUMERIC. Returns false if the conversion is not
+// supported; sets |*truncated| when a text conversion did not fit.
+bool WriteTyped(const ResultSpec& spec, SQLULEN row, size_t column,
+                SQLSMALLINT c_type, SQLSMALLINT numeric_scale,
+                SQLPOINTER target, SQLLEN buffer_length, SQLLEN* indicator,
+                bool* truncated) {
+  ColumnKind kind = KindOf(spec, column);
+  // Row 0 holds the smallest value and row 1 the largest.
+  bool edge = spec.edges && row < 2;
+  bool high = row == 1;
+  if (c_type == SQL_C_CHAR || c_type == SQL_C_WCHAR) {
+    std::string text = FormatCell(kind, row, column);
+    if (text.empty()) {
+      return false;
+    }
+    *truncated = !WriteFormatted(text, c_type, target, buffer_length,
+                                 indicator);
+    return true;
+  }
+  switch (kind) {
+    case ColumnKind::kBigint:
+      if (c_type != SQL_C_SBIGINT) {
+        return false;
+      }
+      {
+        SQLBIGINT value = !edge ? BigintValue(row, column)
+                          : high  ? INT64_MAX
+                                  : INT64_MIN;
+        std::memcpy(target, &value, sizeof(value));
+        if (indicator) *indicator = sizeof(value);
+      }
+      return true;
+    case ColumnKind::kDecimal:
+    case ColumnKind::kNumeric:
+      if (c_type != SQL_C_NUMERIC && c_type != SQL_ARD_TYPE) {
+        return false;
+      }
+      {
+        SQL_NUMERIC_STRUCT value;
+        std::memset(&value, 0, sizeof(value));
+        value.precision = kind == ColumnKind::kNumeric ? 38 : 18;
+        value.scale = static_cast<SQLSCHAR>(numeric_scale);
+        value.sign = (edge ? high : !DecimalNegative(row)) ? 1 : 0;
+        unsigned __int128 magnitude = DecimalMagnitude(kind, row, column);
+        if (edge) {
+          // All nines.
+          magnitude = 1;
+          for (int i = 0; i < value.precision; ++i) {
+            magnitude *= 10;
+          }
+          magnitude -= 1;
+        }
+        for (int scale = kDecimalScale; scale > numeric_scale; --scale) {
+          magnitude /= 10;
+        }
+        for (int scale = kDecimalScale; scale < numeric_scale; ++scale) {
+          magnitude *= 10;
+        }
+        for (int i = 0; i < SQL_MAX_NUMERIC_LEN; ++i) {
+          value.val[i] = static_cast<SQLCHAR>(magnitude >> (8 * i));
+        }
+        std::memcpy(target, &value, sizeof(value));
+        if (indicator) *indicator = sizeof(value);
+      }
+      return true;
+    case ColumnKind::kDateTime:
+    case ColumnKind::kDate:
+      if (c_type != SQL_C_TYPE_TIMESTAMP) {
+        return false;
+      }
+      {
+        SQL_TIMESTAMP_STRUCT value = edge ? EdgeTimestamp(kind, high)
+                                          : TimestampValue(kind, row, column);
+        std::memcpy(target, &value, sizeof(value));
+        if (indicator) *indicator = sizeof(value);
+      }
+      return true;
+    case ColumnKind::kTime:
+      if (c_type != kSqlCSsTime2) {
+        return false;
+      }
+      {
+        int64_t seconds = !edge ? TimeSeconds(row, column)
+                          : high  ? 86399
+                                  : 0;
+        SsTime2Struct value;
+        value.hour = static_cast<SQLUSMALLINT>(seconds / 3600);
+        value.minute = static_cast<SQLUSMALLINT>(seconds % 3600 / 60);
+        value.second = static_cast<SQLUSMALLINT>(seconds % 60);
+        value.fraction = !edge ? TimeNanos(row) : high ? 999999900 : 0;
+        std::memcpy(target, &value, sizeof(value));
+        if (indicator) *indicator = sizeof(value);
+      }
+      return true;
+    case ColumnKind::kGuid:
+      if (c_type != SQL_C_GUID) {
+        return false;
+      }
+      {
+        SQLGUID value = GuidValue(row, column);
+        if (edge) {
+          std::memset(&value, high ? 0xFF : 0, sizeof(value));
+        }
+        std::memcpy(target, &value, sizeof(value));
+        if (indicator) *indicator = sizeof(value);
+      }
+      return true;
+    default:
+      break;
+  }
+
+  double numeric;
+  switch (kind) {
+    case ColumnKind::kInt:
+      numeric = spec.has_scalar ? spec.scalar
+                : !edge         ? IntValue(row, column)
+                : high          ? INT32_MAX
+                                : INT32_MIN;
+      break;
+    case ColumnKind::kDouble:
+      numeric = !edge ? DoubleValue(row, column) : high ? DBL_MAX : -DBL_MAX;
+      break;
+    case ColumnKind::kBit:
+      numeric = !edge ? BitValue(row, column) : high ? 1 : 0;
+      break;
+    default:
+      return false;
+  }
+  switch (c_type) {
+    case SQL_C_SLONG:
+    case SQL_C_LONG: {
+      SQLINTEGER value = static_cast<SQLINTEGER>(numeric);
+      std::memcpy(target, &value, sizeof(value));
+      if (indicator) *indicator = sizeof(value);
+      return true;
+    }
+    case SQL_C_DOUBLE: {
+      SQLDOUBLE value = numeric;
+      std::memcpy(target, &value, sizeof(value));
+      if (indicator) *indicator = sizeof(value);
+      return true;
+    }
+    case SQL_C_BIT: {
+      unsigned char value = numeric != 0 ? 1 : 0;
+      std::memcpy(target, &value, sizeof(value));
+      if (indicator) *indicator = sizeof(value);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool IsTextKind(ColumnKind kind) {
+  return kind == ColumnKind::kText || kind == ColumnKind::kLob;
+}
+
+bool IsBinaryKind(ColumnKind kind) {
+  return kind == ColumnKind::kBin || kind == ColumnKind::kBlob;
+}
+
+template <typename T>
+T* As(SQLHANDLE handle) {
+  return static_cast<T*>(handle);
+}
+
+// Makes |spec| the statement's current result, before its first row.
+void StartResult(Statement* statement, const ResultSpec& spec) {
+  statement->spec = spec;
+  statement->has_result = spec.cols > 0;
+  statement->rowset_start = 0;
+  statement->next_row = 0;
+  statement->positioned = false;
+  statement->get_data_offsets.assign(spec.cols, 0);
+}
+
+// The non-blank ';'-separated statements of |sql|.
+std::vector<std::string> SplitBatch(const std::string& sql) {
+  std::vector<std::string> statements;
+  std::istringstream batch(sql);
+  std::string text;
+  while (std::getline(batch, text, ';')) {
+    if (text.find_first_not_of(" \t\r\n") != std::string::npos) {
+      statements.push_back(text);
+    }
+  }
+  return statements;
+}
+
+// SQL_DESC_SCALE of |column| (zero-based) in the statement's ARD.
+SQLSMALLINT ArdScale(Statement* statement, size_t column) {
+  const std::vector<DescriptorRecord>& records =
+      statement->app_row_desc.records;
+  return column < records.size() ? records[column].scale : 0;
+}
+
+void EndTransaction(Connection* connection, SQLSMALLINT completion) {
+  if (connection->trancount > 0) {
+    ++(completion == SQL_COMMIT ? connection->commits : connection->rollbacks);
+  }
+  connection->trancount = 0;
+  connection->savepoints.clear();
+}
+
+// Runs |sql| if it is a batch of transaction statements (see the top of the
+// file), leaving a SELECT @@TRANCOUNT result in |statement|. Returns false
+// if it is not one; otherwise sets |*ret|.
+bool RunTransactionBatch(Statement* statement, const std::string& sql,
+                         SQLRETURN* ret) {
+  if (sql.find("TRANSACTION") == std::string::npos &&
+      sql.find("@@TRANCOUNT") == std::string::npos) {
+    return false;
+  }
+  Connection* connection = statement->connection;
+  *ret = SQL_SUCCESS;
+  std::istringstream batch(sql);
+  std::string text;
+  while (std::getline(batch, text, ';')) {
+    std::istringstream words(text);
+    std::vector<std::string> tokens;
+    std::string word;
+    while (words >> word) {
+      tokens.push_back(word);
+    }
+    if (tokens.size() >= 4 && tokens[0] == "IF" &&
+        tokens[1] == "@@TRANCOUNT" && tokens[2] == ">" && tokens[3] == "0") {
+      tokens.erase(tokens.begin(), tokens.begin() + 4);
+      if (connection->trancount == 0) {
+        continue;
+      }
+    }
+    if (tokens.empty()) {
+      continue;
+    }
+    if (tokens.size() == 3 && tokens[0] == "SAVE" &&
+        tokens[1] == "TRANSACTION") {
+      if (connection->trancount == 0) {
+        *ret = Fail(statement, "25000", "No transaction is active");
+        return true;
+      }
+      connection->savepoints.push_back(tokens[2]);
+    } else if (tokens.size() == 3 && tokens[0] == "ROLLBACK" &&
+               tokens[1] == "TRANSACTION") {
+      std::vector<std::string>& savepoints = connection->savepoints;
+      auto it = std::find(savepoints.rbegin(), savepoints.rend(), tokens[2]);
+      if (connection->trancount == 0 || it == savepoints.rend()) {
+        *ret = Fail(statement, "25000",
+                    "No transaction or savepoint of that name was found");
+        return true;
+      }
+      // The savepoint itself stays usable.
+      savepoints.erase(it.base(), savepoints.end());
+    } else if (tokens.size() == 2 && tokens[0] == "SELECT" &&
+               tokens[1] == "@@TRANCOUNT") {
+      ResultSpec spec;
+      spec.rows = 1;
+      spec.cols = 1;
+      spec.kinds = {ColumnKind::kInt};
+      spec.has_scalar = true;
+      spec.scalar = connection->trancount;
+      StartResult(statement, spec);
+    } else {
+      *ret = Fail(statement, "42000", "Unsupported transaction statement");
+      return true;
+    }
+  }
+  statement->row_count = -1;
+  return true;
+}
+
+// Sets output argument |param| of a synthetic procedure, named |name|.
+void WriteProcedureOutput(const std::string& name, Parameter* param) {
+  Binding& binding = param->binding;
+  bool has_input = param->io_type == SQL_PARAM_INPUT_OUTPUT;
+  if (!binding.data ||
+      (has_input && binding.indicator &&
+       *binding.indicator == SQL_NULL_DATA)) {
+    return;
+  }
+  switch (binding.c_type) {
+    case SQL_C_SBIGINT: {
+      SQLBIGINT value = 0;
+      if (has_input) {
+        std::memcpy(&value, binding.data, sizeof(value));
+      }
+      value += static_cast<SQLBIGINT>(name.size());
+      std::memcpy(binding.data, &value, sizeof(value));
+      if (binding.indicator) *binding.indicator = sizeof(value);
+      break;
+    }
+    case SQL_C_WCHAR: {
+      SQLWCHAR* buffer = static_cast<SQLWCHAR*>(binding.data);
+      std::vector<SQLWCHAR> text;
+      if (has_input && binding.indicator) {
+        text.assign(buffer, buffer + *binding.indicator / sizeof(SQLWCHAR));
+      }
+      text.insert(text.end(), name.begin(), name.end());
+      size_t capacity = binding.length / sizeof(SQLWCHAR);
+      if (capacity > 0) {
+        size_t count = std::min(text.size(), capacity - 1);
+        std::copy(text.begin(), text.begin() + count, buffer);
+        buffer[count] = 0;
+      }
+      if (binding.indicator) {
+        *binding.indicator =
+            static_cast<SQLLEN>(text.size() * sizeof(SQLWCHAR));
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+// Runs |sql| if it is a procedure call escape (see the top of the file).
+// Returns false if it is not one; otherwise sets |*ret|.
+bool RunProcedureCall(Statement* statement, const std::string& sql,
+                      SQLRETURN* ret) {
+  size_t start = sql.find_first_not_of(" \t\r\n");
+  size_t call = sql.find("call ");
+  if (start == std::string::npos || sql[start] != '{' ||
+      call == std::string::npos) {
+    return false;
+  }
+  bool has_return = sql.find('?') < call;
+  size_t first = has_return ? 1 : 0;
+  size_t arguments =
+      std::count(sql.begin() + static_cast<std::ptrdiff_t>(call), sql.end(),
+                 '?');
+  std::vector<Parameter>& params = statement->params;
+  if (params.size() < first + arguments) {
+    *ret = Fail(statement, "07002", "COUNT field incorrect");
+    return true;
+  }
+  std::vector<DescriptorRecord>& records = statement->imp_param_desc.records;
+  for (size_t i = first; i < first + arguments; ++i) {
+    if (i >= records.size() || records[i].name.size() < 2 ||
+        records[i].name[0] != '@') {
+      *ret = Fail(statement, "42000",
+                  "Synthetic procedure arguments must be named");
+      return true;
+    }
+  }
+
+  for (size_t i = first; i < first + arguments; ++i) {
+    if (params[i].io_type != SQL_PARAM_INPUT) {
+      WriteProcedureOutput(records[i].name.substr(1), &params[i]);
+    }
+  }
+  if (has_return) {
+    Binding& binding = params[0].binding;
+    if (binding.data &&
+        (binding.c_type == SQL_C_SLONG || binding.c_type == SQL_C_LONG)) {
+      SQLINTEGER value = static_cast<SQLINTEGER>(arguments);
+      std::memcpy(binding.data, &value, sizeof(value));
+      if (binding.indicator) *binding.indicator = sizeof(value);
+    }
+  }
+  statement->has_result = false;
+  statement->row_count = -1;
+  *ret = SQL_SUCCESS;
+  return true;
+}
+
+SQLRETURN SetConnectAttr(SQLHDBC dbc, SQLINTEGER attribute, SQLPOINTER value) {
+  Connection* connection = As<Connection>(dbc);
+  connection->sqlstate.clear();
+  SQLULEN number = reinterpret_cast<SQLULEN>(value);
+  switch (attribute) {
+    case SQL_ATTR_AUTOCOMMIT:
+      // Turning autocommit back on commits the open transaction.
+      if (number == SQL_AUTOCOMMIT_ON) {
+        EndTransaction(connection, SQL_COMMIT);
+      }
+      connection->autocommit = number == SQL_AUTOCOMMIT_ON;
+      break;
+    case SQL_ATTR_TXN_ISOLATION:
+    case kCoptSsTxnIsolation:
+      if (connection->trancount > 0) {
+        return Fail(connection, "HY011", "Attribute cannot be set now");
+      }
+      connection->isolation = number;
+      break;
+    default:
+      break;
+  }
+  return SQL_SUCCESS;
+}
+
+// The SQL type, size and decimal digits a column or parameter of |kind| is
+// described with.
+void DescribeKind(ColumnKind kind, size_t string_length, SQLSMALLINT* type,
+                  SQLULEN* size, SQLSMALLINT* digits) {
+  *type = SQL_UNKNOWN_TYPE;
+  *size = 0;
+  *digits = 0;
+  switch (kind) {
+    case ColumnKind::kInt:
+      *type = SQL_INTEGER;
+      *size = 10;
+      break;
+    case ColumnKind::kDouble:
+      *type = SQL_DOUBLE;
+      *size = 15;
+      break;
+    case ColumnKind::kBit:
+      *type = SQL_BIT;
+      *size = 1;
+      break;
+    case ColumnKind::kText:
+      *type = SQL_WVARCHAR;
+      *size = string_length;
+      break;
+    case ColumnKind::kLob:
+      *type = SQL_WLONGVARCHAR;
+      *size = 0;
+      break;
+    case ColumnKind::kBin:
+      *type = SQL_VARBINARY;
+      *size = string_length;
+      break;
+    case ColumnKind::kBlob:
+      *type = SQL_LONGVARBINARY;
+      *size = 0;
+      break;
+    case ColumnKind::kBigint:
+      *type = SQL_BIGINT;
+      *size = 19;
+      break;
+    case ColumnKind::kDecimal:
+      *type = SQL_DECIMAL;
+      *size = 18;
+      *digits = kDecimalScale;
+      break;
+    case ColumnKind::kNumeric:
+      *type = SQL_NUMERIC;
+      *size = 38;
+      *digits = kDecimalScale;
+      break;
+    case ColumnKind::kDateTime:
+      *type = SQL_TYPE_TIMESTAMP;
+      *size = 27;
+      *digits = 7;
+      break;
+    case ColumnKind::kDate:
+      *type = SQL_TYPE_DATE;
+      *size = 10;
+      break;
+    case ColumnKind::kTime:
+      *type = kSqlSsTime2;
+      *size = 16;
+      *digits = 7;
+      break;
+    case ColumnKind::kGuid:
+      *type = SQL_GUID;
+      *size = 36;
+      break;
+  }
+}
+
+}  // namespace
+
+SYNTHETIC_EXPORT uint64_t SyntheticOdbcCallCount() { return g_calls.load(); }
+
+SYNTHETIC_EXPORT void SyntheticOdbcResetCallCount() { g_calls = 0; }
+
+SYNTHETIC_EXPORT SQLSMALLINT SyntheticOdbcParamType(SQLHSTMT stmt,
+                                                   SQLUSMALLINT number) {
+  Statement* statement = As<Statement>(stmt);
+  return number >= 1 && number <= statement->params.size()
+             ? statement->params[number - 1].sql_type
+             : static_cast<SQLSMALLINT>(SQL_UNKNOWN_TYPE);
+}
+
+// The C type, buffer, element size and indicators parameter |number| was
+// bound with; null if it is not bound.
+SYNTHETIC_EXPORT SQLPOINTER SyntheticOdbcParamData(SQLHSTMT stmt,
+                                                   SQLUSMALLINT number,
+                                                   SQLSMALLINT* c_type,
+                                                   SQLLEN* element_size,
+                                                   SQLLEN** indicators) {
+  Statement* statement = As<Statement>(stmt);
+  if (number < 1 || number > statement->params.size()) {
+    return nullptr;
+  }
+  const Binding& binding = statement->params[number - 1].binding;
+  *c_type = binding.c_type;
+  *element_size = binding.length;
+  *indicators = binding.indicator;
+  return binding.data;
+}
+
+// SQL_ATTR_PARAMSET_SIZE of the |execution|-th SQLExecute since SQLPrepare,
+// counting from 0; 0 past the last one.
+SYNTHETIC_EXPORT SQLULEN SyntheticOdbcParamsetSize(SQLHSTMT stmt,
+                                                   size_t execution) {
+  Statement* statement = As<Statement>(stmt);
+  return execution < statement->paramset_sizes.size()
+             ? statement->paramset_sizes[execution]
+             : 0;
+}
+
+SYNTHETIC_EXPORT uint64_t SyntheticOdbcEndTranCount(SQLHDBC dbc,
+                                                    SQLSMALLINT completion) {
+  Connection* connection = As<Connection>(dbc);
+  return completion == SQL_COMMIT ? connection->commits
+                                  : connection->rollbacks;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLAllocHandle(SQLSMALLINT handle_type,
+                                          SQLHANDLE input_handle,
+                                          SQLHANDLE* output_handle) {
+  ++g_calls;
+  switch (handle_type) {
+    case SQL_HANDLE_ENV:
+      *output_handle = new Handle(handle_type);
+      return SQL_SUCCESS;
+    case SQL_HANDLE_DBC:
+      *output_handle = new Connection();
+      return SQL_SUCCESS;
+    case SQL_HANDLE_STMT:
+      *output_handle = new Statement(As<Connection>(input_handle));
+      return SQL_SUCCESS;
+    default:
+      return SQL_ERROR;
+  }
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLFreeHandle(SQLSMALLINT handle_type,
+                                         SQLHANDLE handle) {
+  ++g_calls;
+  if (handle_type == SQL_HANDLE_STMT) {
+    delete As<Statement>(handle);
+  } else if (handle_type == SQL_HANDLE_DBC) {
+    delete As<Connection>(handle);
+  } else {
+    delete As<Handle>(handle);
+  }
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLSetEnvAttr(SQLHENV, SQLINTEGER, SQLPOINTER,
+                                         SQLINTEGER) {
+  ++g_calls;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLSetConnectAttr(SQLHDBC dbc,
+                                             SQLINTEGER attribute,
+                                             SQLPOINTER value, SQLINTEGER) {
+  ++g_calls;
+  return SetConnectAttr(dbc, attribute, value);
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLSetConnectAttrW(SQLHDBC dbc,
+                                              SQLINTEGER attribute,
+                                              SQLPOINTER value, SQLINTEGER) {
+  ++g_calls;
+  return SetConnectAttr(dbc, attribute, value);
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLGetConnectAttr(SQLHDBC dbc, SQLINTEGER attribute,
+                                             SQLPOINTER value, SQLINTEGER,
+                                             SQLINTEGER*) {
+  ++g_calls;
+  Connection* connection = As<Connection>(dbc);
+  if (!value) {
+    return SQL_ERROR;
+  }
+  switch (attribute) {
+    case SQL_ATTR_TXN_ISOLATION:
+      *static_cast<SQLUINTEGER*>(value) =
+          static_cast<SQLUINTEGER>(connection->isolation);
+      return SQL_SUCCESS;
+    case SQL_ATTR_AUTOCOMMIT:
+      *static_cast<SQLUINTEGER*>(value) =
+          connection->autocommit ? SQL_AUTOCOMMIT_ON : SQL_AUTOCOMMIT_OFF;
+      return SQL_SUCCESS;
+    default:
+      return SQL_ERROR;
+  }
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLEndTran(SQLSMALLINT handle_type,
+                                      SQLHANDLE handle,
+                                      SQLSMALLINT completion) {
+  ++g_calls;
+  if (handle_type == SQL_HANDLE_DBC) {
+    EndTransaction(As<Connection>(handle), completion);
+  }
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLDriverConnect(SQLHDBC, SQLHWND, SQLCHAR*,
+                                            SQLSMALLINT, SQLCHAR*, SQLSMALLINT,
+                                            SQLSMALLINT* out_length,
+                                            SQLUSMALLINT) {
+  ++g_calls;
+  if (out_length) *out_length = 0;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLDriverConnectW(SQLHDBC, SQLHWND, SQLWCHAR*,
+                                             SQLSMALLINT, SQLWCHAR*,
+                                             SQLSMALLINT,
+                                             SQLSMALLINT* out_length,
+                                             SQLUSMALLINT) {
+  ++g_calls;
+  if (out_length) *out_length = 0;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLDisconnect(SQLHDBC) {
+  ++g_calls;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLGetInfoW(SQLHDBC, SQLUSMALLINT, SQLPOINTER value,
+                                       SQLSMALLINT buffer_length,
+                                       SQLSMALLINT* string_length) {
+  ++g_calls;
+  // Every string-valued info type is answered with an empty string and every
+  // numeric one with zero ("not supported").
+  if (value && buffer_length >= static_cast<SQLSMALLINT>(sizeof(SQLUINTEGER))) {
+    std::memset(value, 0, sizeof(SQLUINTEGER));
+  }
+  if (string_length) *string_length = 0;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLGetInfo(SQLHDBC dbc, SQLUSMALLINT info_type,
+                                      SQLPOINTER value,
+                                      SQLSMALLINT buffer_length,
+                                      SQLSMALLINT* string_length) {
+  return SQLGetInfoW(dbc, info_type, value, buffer_length, string_length);
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLExecDirectW(SQLHSTMT stmt, SQLWCHAR* text,
+                                          SQLINTEGER length) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  statement->sqlstate.clear();
+  statement->pending.clear();
+  std::string sql = Narrow(text, length);
+  SQLRETURN batch_ret;
+  if (RunTransactionBatch(statement, sql, &batch_ret) ||
+      RunProcedureCall(statement, sql, &batch_ret)) {
+    return batch_ret;
+  }
+  std::vector<std::string> batch = SplitBatch(sql);
+  ResultSpec spec;
+  if (batch.empty() || !ParseSpec(batch[0], &spec)) {
+    return Fail(statement, "42000", "Unknown column type in synthetic query");
+  }
+  if (spec.latency_us > 0) {
+    SQLRETURN ret = Wait(statement, spec.latency_us);
+    if (ret != SQL_SUCCESS) {
+      return ret;
+    }
+  }
+  Connection* connection = statement->connection;
+  if (!connection->autocommit && connection->trancount == 0) {
+    connection->trancount = 1;
+  }
+  StartResult(statement, spec);
+  statement->pending.assign(batch.begin() + 1, batch.end());
+
+  // Every parameter set runs; the failing ones affect no rows.
+  SQLULEN failed = 0;
+  for (SQLULEN i = 0; i < statement->paramset_size; ++i) {
+    bool fail = spec.fail_every != 0 && (i + 1) % spec.fail_every == 0;
+    failed += fail ? 1 : 0;
+    if (statement->param_status) {
+      statement->param_status[i] = fail ? SQL_PARAM_ERROR : SQL_PARAM_SUCCESS;
+    }
+  }
+  if (statement->params_processed) {
+    *statement->params_processed = statement->paramset_size;
+  }
+  statement->row_count =
+      static_cast<SQLLEN>(spec.rows * (statement->paramset_size - failed));
+  if (failed > 0) {
+    statement->sqlstate = "23000";
+    statement->message = "Synthetic parameter set failure";
+    return failed == statement->paramset_size ? SQL_ERROR
+                                              : SQL_SUCCESS_WITH_INFO;
+  }
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLExecDirect(SQLHSTMT stmt, SQLCHAR* text,
+                                         SQLINTEGER length) {
+  std::vector<SQLWCHAR> wide;
+  size_t count = length == SQL_NTS ? std::strlen(reinterpret_cast<char*>(text))
+                                   : static_cast<size_t>(length);
+  wide.assign(text, text + count);
+  return SQLExecDirectW(stmt, wide.data(), static_cast<SQLINTEGER>(count));
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLPrepareW(SQLHSTMT stmt, SQLWCHAR* text,
+                                       SQLINTEGER length) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  size_t count = 0;
+  if (length == SQL_NTS) {
+    while (text[count] != 0) ++count;
+  } else {
+    count = static_cast<size_t>(length);
+  }
+  statement->prepared.assign(text, text + count);
+  statement->has_result = false;
+  statement->paramset_sizes.clear();
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLExecute(SQLHSTMT stmt) {
+  Statement* statement = As<Statement>(stmt);
+  if (statement->prepared.empty()) {
+    ++g_calls;
+    return Fail(statement, "HY010", "Statement is not prepared");
+  }
+  statement->paramset_sizes.push_back(statement->paramset_size);
+  return SQLExecDirectW(stmt, statement->prepared.data(),
+                        static_cast<SQLINTEGER>(statement->prepared.size()));
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLBindParameter(
+    SQLHSTMT stmt, SQLUSMALLINT number, SQLSMALLINT io_type, SQLSMALLINT c_type,
+    SQLSMALLINT sql_type, SQLULEN, SQLSMALLINT, SQLPOINTER data,
+    SQLLEN buffer_length, SQLLEN* indicator) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  if (number == 0) {
+    return Fail(statement, "07009", "Invalid parameter number");
+  }
+  if (statement->params.size() < number) {
+    statement->params.resize(number);
+  }
+  Parameter& param = statement->params[number - 1];
+  param.io_type = io_type;
+  param.sql_type = sql_type;
+  param.binding = Binding{c_type, data, buffer_length, indicator};
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLDescribeParam(SQLHSTMT stmt, SQLUSMALLINT number,
+                                            SQLSMALLINT* data_type,
+                                            SQLULEN* parameter_size,
+                                            SQLSMALLINT* decimal_digits,
+                                            SQLSMALLINT* nullable) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  const std::vector<SQLWCHAR>& text = statement->prepared;
+  ResultSpec spec;
+  if (text.empty() ||
+      !ParseSpec(Narrow(text.data(), (SQLINTEGER)text.size()), &spec) ||
+      spec.param_kinds.empty()) {
+    return Fail(statement, "IM001", "Driver does not support this function");
+  }
+  if (number == 0) {
+    return Fail(statement, "07009", "Invalid descriptor index");
+  }
+  SQLSMALLINT type;
+  SQLULEN size;
+  SQLSMALLINT digits;
+  DescribeKind(spec.param_kinds[(number - 1) % spec.param_kinds.size()],
+               spec.string_length, &type, &size, &digits);
+  if (data_type) *data_type = type;
+  if (parameter_size) *parameter_size = size;
+  if (decimal_digits) *decimal_digits = digits;
+  if (nullable) *nullable = SQL_NULLABLE;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLNumResultCols(SQLHSTMT stmt, SQLSMALLINT* count) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  *count = statement->has_result
+               ? static_cast<SQLSMALLINT>(statement->spec.cols)
+               : 0;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLRowCount(SQLHSTMT stmt, SQLLEN* count) {
+  ++g_calls;
+  *count = As<Statement>(stmt)->row_count;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLDescribeColW(
+    SQLHSTMT stmt, SQLUSMALLINT column, SQLWCHAR* name,
+    SQLSMALLINT buffer_length, SQLSMALLINT* name_length, SQLSMALLINT* data_type,
+    SQLULEN* column_size, SQLSMALLINT* decimal_digits, SQLSMALLINT* nullable) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  if (!statement->has_result || column == 0 ||
+      column > statement->spec.cols) {
+    return Fail(statement, "07009", "Invalid descriptor index");
+  }
+  std::string label = "c" + std::to_string(column);
+  if (name && buffer_length > 0) {
+    size_t count = std::min<size_t>(label.size(), buffer_length - 1);
+    for (size_t i = 0; i < count; ++i) {
+      name[i] = static_cast<SQLWCHAR>(label[i]);
+    }
+    name[count] = 0;
+  }
+  if (name_length) *name_length = static_cast<SQLSMALLINT>(label.size());
+
+  SQLSMALLINT type = SQL_UNKNOWN_TYPE;
+  SQLULEN size = 0;
+  SQLSMALLINT digits = 0;
+  DescribeKind(KindOf(statement->spec, column - 1),
+               statement->spec.string_length, &type, &size, &digits);
+  if (data_type) *data_type = type;
+  if (column_size) *column_size = size;
+  if (decimal_digits) *decimal_digits = digits;
+  if (nullable) {
+    *nullable = statement->spec.null_every != 0 ? SQL_NULLABLE : SQL_NO_NULLS;
+  }
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLSetStmtAttr(SQLHSTMT stmt, SQLINTEGER attribute,
+                                          SQLPOINTER value, SQLINTEGER) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  switch (attribute) {
+    case SQL_ATTR_ROW_ARRAY_SIZE:
+      statement->row_array_size =
+          std::max<SQLULEN>(1, reinterpret_cast<SQLULEN>(value));
+      return SQL_SUCCESS;
+    case SQL_ATTR_ROWS_FETCHED_PTR:
+      statement->rows_fetched = static_cast<SQLULEN*>(value);
+      return SQL_SUCCESS;
+    case SQL_ATTR_ROW_STATUS_PTR:
+      statement->row_status = static_cast<SQLUSMALLINT*>(value);
+      return SQL_SUCCESS;
+    case SQL_ATTR_ROW_BIND_TYPE:
+      statement->bind_type = reinterpret_cast<SQLULEN>(value);
+      return SQL_SUCCESS;
+    case SQL_ATTR_PARAMSET_SIZE:
+      statement->paramset_size =
+          std::max<SQLULEN>(1, reinterpret_cast<SQLULEN>(value));
+      return SQL_SUCCESS;
+    case SQL_ATTR_PARAM_STATUS_PTR:
+      statement->param_status = static_cast<SQLUSMALLINT*>(value);
+      return SQL_SUCCESS;
+    case SQL_ATTR_PARAMS_PROCESSED_PTR:
+      statement->params_processed = static_cast<SQLULEN*>(value);
+      return SQL_SUCCESS;
+    case SQL_ATTR_QUERY_TIMEOUT:
+      statement->query_timeout = reinterpret_cast<SQLULEN>(value);
+      return SQL_SUCCESS;
+    case SQL_ATTR_ASYNC_ENABLE:
+      statement->async =
+          reinterpret_cast<SQLULEN>(value) == SQL_ASYNC_ENABLE_ON;
+      return SQL_SUCCESS;
+    default:
+      return SQL_SUCCESS;
+  }
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLGetStmtAttr(SQLHSTMT stmt, SQLINTEGER attribute,
+                                          SQLPOINTER value, SQLINTEGER,
+                                          SQLINTEGER*) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  Descriptor* descriptor;
+  switch (attribute) {
+    case SQL_ATTR_APP_ROW_DESC:
+      descriptor = &statement->app_row_desc;
+      break;
+    case SQL_ATTR_APP_PARAM_DESC:
+      descriptor = &statement->app_param_desc;
+      break;
+    case SQL_ATTR_IMP_ROW_DESC:
+      descriptor = &statement->imp_row_desc;
+      break;
+    case SQL_ATTR_IMP_PARAM_DESC:
+      descriptor = &statement->imp_param_desc;
+      break;
+    default:
+      return Fail(statement, "HY092", "Unsupported attribute");
+  }
+  *static_cast<SQLHDESC*>(value) = descriptor;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLSetDescFieldW(SQLHDESC desc, SQLSMALLINT record,
+                                            SQLSMALLINT field, SQLPOINTER value,
+                                            SQLINTEGER length) {
+  ++g_calls;
+  Descriptor* descriptor = As<Descriptor>(desc);
+  descriptor->sqlstate.clear();
+  if (field == SQL_DESC_NAME) {
+    if (record < 1) {
+      return Fail(descriptor, "07009", "Invalid descriptor index");
+    }
+    descriptor->Record(record)->name = Narrow(
+        static_cast<SQLWCHAR*>(value),
+        length == SQL_NTS ? SQL_NTS
+                          : length / static_cast<SQLINTEGER>(sizeof(SQLWCHAR)));
+  } else if (field == SQL_DESC_SCALE) {
+    if (record < 1) {
+      return Fail(descriptor, "07009", "Invalid descriptor index");
+    }
+    descriptor->Record(record)->scale =
+        static_cast<SQLSMALLINT>(reinterpret_cast<SQLLEN>(value));
+  }
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLSetStmtAttrW(SQLHSTMT stmt, SQLINTEGER attribute,
+                                           SQLPOINTER value,
+                                           SQLINTEGER length) {
+  return SQLSetStmtAttr(stmt, attribute, value, length);
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLBindCol(SQLHSTMT stmt, SQLUSMALLINT column,
+                                      SQLSMALLINT c_type, SQLPOINTER data,
+                                      SQLLEN length, SQLLEN* indicator) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  if (column == 0) {
+    return Fail(statement, "07009", "Bookmarks are not supported");
+  }
+  if (statement->bindings.size() < column) {
+    statement->bindings.resize(column);
+  }
+  statement->bindings[column - 1] = Binding{c_type, data, length, indicator};
+  // Binding resets the record's numeric scale.
+  *statement->app_row_desc.Record(column) = DescriptorRecord();
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLFreeStmt(SQLHSTMT stmt, SQLUSMALLINT option) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  if (option == SQL_UNBIND) {
+    statement->bindings.clear();
+  } else if (option == SQL_CLOSE) {
+    statement->has_result = false;
+    statement->pending.clear();
+  } else if (option == SQL_RESET_PARAMS) {
+    statement->params.clear();
+    statement->imp_param_desc.records.clear();
+  }
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLCancel(SQLHSTMT stmt) {
+  ++g_calls;
+  As<Statement>(stmt)->cancelled = true;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLCloseCursor(SQLHSTMT stmt) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  statement->has_result = false;
+  statement->pending.clear();
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLMoreResults(SQLHSTMT stmt) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  statement->sqlstate.clear();
+  statement->has_result = false;
+  if (statement->pending.empty()) {
+    return SQL_NO_DATA;
+  }
+  std::string sql = statement->pending.front();
+  statement->pending.erase(statement->pending.begin());
+  ResultSpec spec;
+  if (!ParseSpec(sql, &spec)) {
+    statement->pending.clear();
+    return Fail(statement, "42000", "Unknown column type in synthetic query");
+  }
+  StartResult(statement, spec);
+  statement->row_count = static_cast<SQLLEN>(spec.rows);
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLFetch(SQLHSTMT stmt) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  statement->sqlstate.clear();
+  if (!statement->has_result) {
+    return Fail(statement, "24000", "Invalid cursor state");
+  }
+  if (statement->bind_type != SQL_BIND_BY_COLUMN) {
+    return Fail(statement, "HYC00", "Row-wise binding is not supported");
+  }
+  const ResultSpec& spec = statement->spec;
+  SQLULEN start = statement->next_row;
+  SQLULEN count = start >= spec.rows
+                      ? 0
+                      : std::min(statement->row_array_size, spec.rows - start);
+  if (statement->rows_fetched) *statement->rows_fetched = count;
+  if (count == 0) {
+    statement->positioned = false;
+    return SQL_NO_DATA;
+  }
+  statement->rowset_start = start;
+  statement->next_row = start + count;
+  statement->positioned = true;
+  std::fill(statement->get_data_offsets.begin(),
+            statement->get_data_offsets.end(), 0);
+
+  std::vector<SQLUSMALLINT> status(count, SQL_ROW_SUCCESS);
+  SQLULEN bad_rows = 0;
+  for (SQLULEN r = 0; r < count; ++r) {
+    if (IsBadRow(spec, start + r)) {
+      status[r] = SQL_ROW_ERROR;
+      ++bad_rows;
+    }
+  }
+  for (size_t column = 0;
+       column < statement->bindings.size() && column < spec.cols; ++column) {
+    const Binding& binding = statement->bindings[column];
+    if (!binding.data && !binding.indicator) {
+      continue;
+    }
+    ColumnKind kind = KindOf(spec, column);
+    for (SQLULEN r = 0; r < count; ++r) {
+      SQLULEN row = start + r;
+      if (status[r] == SQL_ROW_ERROR) {
+        continue;
+      }
+      // Set when this cell is truncated.
+      SQLUSMALLINT& row_status = status[r];
+      SQLLEN* indicator = binding.indicator ? binding.indicator + r : nullptr;
+      if (IsNullCell(spec, row)) {
+        if (!indicator) {
+          return Fail(statement, "22002", "Indicator variable required");
+        }
+        *indicator = SQL_NULL_DATA;
+        continue;
+      }
+      char* target = static_cast<char*>(binding.data) + r * binding.length;
+      if (IsTextKind(kind)) {
+        size_t unit = binding.c_type == SQL_C_CHAR ? 1 : sizeof(SQLWCHAR);
+        size_t copied = CopyText(spec, row, column, 0, binding.c_type, target,
+                                 binding.length);
+        if (copied < spec.string_length) {
+          row_status = SQL_ROW_SUCCESS_WITH_INFO;
+        }
+        if (indicator) *indicator = spec.string_length * unit;
+      } else if (IsBinaryKind(kind)) {
+        if (binding.c_type != SQL_C_BINARY) {
+          return Fail(statement, "07006", "Restricted data type conversion");
+        }
+        size_t copied = CopyBytes(row, column, spec.string_length, 0, target,
+                                  binding.length);
+        if (copied < spec.string_length) {
+          row_status = SQL_ROW_SUCCESS_WITH_INFO;
+        }
+        if (indicator) *indicator = spec.string_length;
+      } else {
+        bool truncated = false;
+        if (!WriteTyped(spec, row, column, binding.c_type,
+                        ArdScale(statement, column), target, binding.length,
+                        indicator, &truncated)) {
+          return Fail(statement, "07006", "Restricted data type conversion");
+        }
+        if (truncated) {
+          row_status = SQL_ROW_SUCCESS_WITH_INFO;
+        }
+      }
+    }
+  }
+  if (statement->row_status) {
+    std::copy(status.begin(), status.end(), statement->row_status);
+  }
+  if (bad_rows == count) {
+    return Fail(statement, "22018", "Invalid character value for cast specification");
+  }
+  if (bad_rows > 0) {
+    statement->sqlstate = "22018";
+    statement->message = "Invalid character value for cast specification";
+    return SQL_SUCCESS_WITH_INFO;
+  }
+  if (std::find(status.begin(), status.end(), SQL_ROW_SUCCESS_WITH_INFO) !=
+      status.end()) {
+    statement->sqlstate = "01004";
+    statement->message = "String data, right truncated";
+    return SQL_SUCCESS_WITH_INFO;
+  }
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLGetData(SQLHSTMT stmt, SQLUSMALLINT column,
+                                      SQLSMALLINT c_type, SQLPOINTER value,
+                                      SQLLEN buffer_length,
+                                      SQLLEN* indicator) {
+  ++g_calls;
+  Statement* statement = As<Statement>(stmt);
+  const ResultSpec& spec = statement->spec;
+  if (!statement->positioned) {
+    return Fail(statement, "24000", "Invalid cursor state");
+  }
+  if (column == 0 || column > spec.cols) {
+    return Fail(statement, "07009", "Invalid descriptor index");
+  }
+  if (statement->row_array_size != 1) {
+    return Fail(statement, "HYC00", "SQLGetData requires a rowset size of 1");
+  }
+  size_t index = column - 1;
+  SQLULEN row = statement->rowset_start;
+  size_t& offset = statement->get_data_offsets[index];
+  if (offset == SIZE_MAX) {
+    return SQL_NO_DATA;
+  }
+  if (IsNullCell(spec, row)) {
+    offset = SIZE_MAX;
+    if (!indicator) {
+      return Fail(statement, "22002", "Indicator variable required");
+    }
+    *indicator = SQL_NULL_DATA;
+    return SQL_SUCCESS;
+  }
+
+  ColumnKind kind = KindOf(spec, index);
+  if (IsBinaryKind(kind)) {
+    if (c_type != SQL_C_BINARY) {
+      return Fail(statement, "07006", "Restricted data type conversion");
+    }
+    size_t remaining = spec.string_length - offset;
+    size_t copied = CopyBytes(row, index, spec.string_length, offset, value,
+                              buffer_length);
+    if (indicator) *indicator = remaining;
+    if (copied < remaining) {
+      offset += copied;
+      return SQL_SUCCESS_WITH_INFO;
+    }
+    offset = SIZE_MAX;
+    return SQL_SUCCESS;
+  }
+  if (!IsTextKind(kind)) {
+    offset = SIZE_MAX;
+    bool truncated = false;
+    // Only SQL_ARD_TYPE uses the ARD's scale.
+    SQLSMALLINT scale = c_type == SQL_ARD_TYPE ? ArdScale(statement, index) : 0;
+    if (!WriteTyped(spec, row, index, c_type, scale, value, buffer_length,
+                    indicator, &truncated)) {
+      return Fail(statement, "07006", "Restricted data type conversion");
+    }
+    return truncated ? SQL_SUCCESS_WITH_INFO : SQL_SUCCESS;
+  }
+
+  size_t unit = c_type == SQL_C_CHAR ? 1 : sizeof(SQLWCHAR);
+  size_t remaining = spec.string_length - offset;
+  size_t copied =
+      CopyText(spec, row, index, offset, c_type, value, buffer_length);
+  if (indicator) *indicator = remaining * unit;
+  if (copied < remaining) {
+    offset += copied;
+    return SQL_SUCCESS_WITH_INFO;
+  }
+  offset = SIZE_MAX;
+  return SQL_SUCCESS;
+}
+
+SYNTHETIC_EXPORT SQLRETURN SQLGetDiagRecW(SQLSMALLINT, SQLHANDLE handle,
+                                          SQLSMALLINT record,
+                                          SQLWCHAR* sqlstate,
+                                          SQLINTEGER* native_error,
+                                          SQLWCHAR* message,
+                                          SQLSMALLINT buffer_length,
+                                          SQLSMALLINT* text_length) {
+  ++g_calls;
+  Handle* target = As<Handle>(handle);
+  if (record != 1 || target->sqlstate.empty()) {
+    return SQL_NO_DATA;
+  }
+  if (sqlstate) {
+    for (size_t i = 0; i < 5; ++i) {
+      sqlstate[i] = static_cast<SQLWCHAR>(target->sqlstate[i]);
+    }
+    sqlstate[5] = 0;
+  }
+  if (native_error) *native_error = 0;
+  if (message && buffer_length > 0) {
+    size_t count =
+        std::min<size_t>(target->message.size(), buffer_length - 1);
+    for (size_t i = 0; i < count; ++i) {
+      message[i] = static_cast<SQLWCHAR>(target->message[i]);
+    }
+    message[count] = 0;
+  }
+  if (text_length) {
+    *text_length = static_cast<SQLSMALLINT>(target->message.size());
+  }
+  return SQL_SUCCESS;
+}
@@ -0,0 +1,167 @@
+// Measures UTF-16 to UTF-8 transcoding of cell text: the scalar loop the
+// fetch path used before, against AppendUtf16AsUtf8 with its vectorized
+// ASCII scan, on ASCII, Latin-1 and CJK text. Then compares fetching a
+// text-heavy result from the synthetic driver as SQL_C_WCHAR (transcoded)
+// and as SQL_C_CHAR (copied).
+//
+// Usage: text_encoding_benchmark [cells] [chars_per_cell]
+
+#include <sql.h>
+#include <sqlext.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "text_encoding.h"
+
+namespace {
+
+using mssql_connect::BlockFetcher;
+
+// Keeps the conversions from being optimized away.
+volatile size_t g_sink = 0;
+
+// The per-unit push_back conversion AppendUtf16AsUtf8 replaced.
+void ScalarUtf16ToUtf8(const SQLWCHAR* text, size_t length, std::string* out) {
+  for (size_t i = 0; i < length; ++i) {
+    uint32_t c = text[i];
+    if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length &&
+        text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF) {
+      c = 0x10000 + ((c - 0xD800) << 10) + (text[++i] - 0xDC00);
+    } else if (c >= 0xD800 && c <= 0xDFFF) {
+      c = 0xFFFD;
+    }
+    if (c < 0x80) {
+      out->push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+      out->push_back(static_cast<char>(0xC0 | (c >> 6)));
+      out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+      out->push_back(static_cast<char>(0xE0 | (c >> 12)));
+      out->push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+      out->push_back(static_cast<char>(0xF0 | (c >> 18)));
+      out->push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+  }
+}
+
+// |cells| values of |chars| units each, drawn from [first, first + span).
+std::vector<std::vector<SQLWCHAR>> MakeCells(size_t cells, size_t chars,
+                                             SQLWCHAR first, SQLWCHAR span) {
+  std::vector<std::vector<SQLWCHAR>> result(cells);
+  for (size_t i = 0; i < cells; ++i) {
+    result[i].resize(chars);
+    for (size_t j = 0; j < chars; ++j) {
+      result[i][j] = static_cast<SQLWCHAR>(first + (i * 7 + j) % span);
+    }
+  }
+  return result;
+}
+
+template <typename Convert>
+double UnitsPerSecond(const std::vector<std::vector<SQLWCHAR>>& cells,
+                      Convert convert) {
+  size_t units = 0;
+  std::string out;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& cell : cells) {
+    out.clear();
+    convert(cell.data(), cell.size(), &out);
+    g_sink = g_sink + out.size();
+    units += cell.size();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return units / seconds;
+}
+
+void RunTranscode(const char* label,
+                  const std::vector<std::vector<SQLWCHAR>>& cells) {
+  double scalar = UnitsPerSecond(cells, ScalarUtf16ToUtf8);
+  double vectorized = UnitsPerSecond(cells, mssql_connect::AppendUtf16AsUtf8);
+  std::printf("  %-8s scalar %8.0f Munits/s  simd %8.0f Munits/s\n", label,
+              scalar / 1e6, vectorized / 1e6);
+}
+
+bool RunFetch(const char* label, const std::string& query, bool utf8_text) {
+  SQLHENV env;
+  SQLHDBC dbc;
+  SQLHSTMT stmt;
+  SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+  SQLAllocHandle(SQL_HANDLE_DBC, env, &dbc);
+  SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+
+  std::vector<SQLWCHAR> sql = mssql_connect::Utf8ToUtf16(query);
+  bool ok = SQL_SUCCEEDED(
+      SQLExecDirectW(stmt, sql.data(), static_cast<SQLINTEGER>(sql.size())));
+  size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  {
+    BlockFetcher fetcher(stmt);
+    fetcher.set_utf8_text(utf8_text);
+    std::string error;
+    std::string text;
+    ok = ok && fetcher.Bind(&error);
+    SQLULEN rows = 0;
+    while (ok && fetcher.Next(&rows, &error) && rows > 0) {
+      for (SQLULEN r = 0; r < rows; ++r) {
+        for (size_t i = 0; i < fetcher.columns().size(); ++i) {
+          text.clear();
+          fetcher.AppendText(i, r, &text);
+          bytes += text.size();
+        }
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+  SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+  SQLFreeHandle(SQL_HANDLE_ENV, env);
+  if (!ok) {
+    std::fprintf(stderr, "%s: fetch failed\n", label);
+    return false;
+  }
+  std::printf("  %-8s %8.0f MB/s of UTF-8\n", label, bytes / seconds / 1e6);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t cells = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+  size_t chars = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+
+  std::printf("transcoding %zu cells of %zu units\n", cells, chars);
+  RunTranscode("ascii", MakeCells(cells, chars, 0x20, 0x5F));
+  RunTranscode("latin-1", MakeCells(cells, chars, 0xA0, 0x60));
+  RunTranscode("cjk", MakeCells(cells, chars, 0x4E00, 0x5000));
+  // Mostly ASCII with an accented letter here and there, like names.
+  auto mixed = MakeCells(cells, chars, 0x61, 0x1A);
+  for (auto& cell : mixed) {
+    if (!cell.empty()) {
+      cell[cell.size() / 2] = 0xE9;
+    }
+  }
+  RunTranscode("mixed", mixed);
+
+  std::string query = "SELECT rows=" + std::to_string(cells / 4) +
+                      " cols=4 types=text strlen=" + std::to_string(chars);
+  std::printf("fetching %zu rows of 4 text columns\n", cells / 4);
+  if (!RunFetch("wchar", query, false) || !RunFetch("utf-8", query, true)) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,337 @@
+#include "fl_value_adapter.h"
+
+#include <utility>
+
+#include "scratch_pool.h"
+
+namespace mssql_connect {
+
+namespace {
+
+// The value of |key|, or nullptr when |map| is not a map or has no such key.
+FlValue* Lookup(FlValue* map, const char* key) {
+  if (map == nullptr || fl_value_get_type(map) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  return fl_value_lookup_string(map, key);
+}
+
+FlValue* NewString(const std::string& text) {
+  return fl_value_new_string_sized(text.data(), text.size());
+}
+
+FlValue* StringList(const std::vector<std::string>& strings) {
+  FlValue* list = fl_value_new_list();
+  for (const std::string& text : strings) {
+    fl_value_append_take(list, NewString(text));
+  }
+  return list;
+}
+
+// Cell |row| of |column|; see EncodeRows().
+FlValue* CellValue(const ResultColumn& column, size_t row) {
+  if (column.IsNull(row)) {
+    return fl_value_new_null();
+  }
+  switch (column.type) {
+    case CellType::kBool:
+      return fl_value_new_bool(column.bools[row] != 0);
+    case CellType::kInt32:
+    case CellType::kInt64:
+    case CellType::kDateTime:
+    case CellType::kTime:
+      return fl_value_new_int(column.ints[row]);
+    case CellType::kDouble:
+      return fl_value_new_float(column.doubles[row]);
+    case CellType::kDecimal: {
+      if (column.decimal_text) {
+        return NewString(column.strings[row]);
+      }
+      std::string text;
+      AppendScaledDecimal(column.ints[row], column.scale, &text);
+      return NewString(text);
+    }
+    case CellType::kGuid:
+    case CellType::kBinary:
+      return fl_value_new_uint8_list(column.binaries[row].data(),
+                                     column.binaries[row].size());
+    case CellType::kText:
+      break;
+  }
+  return NewString(column.strings[row]);
+}
+
+// Cell |row| of |column| of the fetcher's current rowset; see EncodeRows().
+FlValue* CellValue(const BlockFetcher& fetcher, size_t column, size_t row) {
+  if (fetcher.IsNull(column, row)) {
+    return fl_value_new_null();
+  }
+  switch (fetcher.cell_type(column)) {
+    case CellType::kBool:
+      return fl_value_new_bool(fetcher.GetBool(column, row));
+    case CellType::kInt32:
+      return fl_value_new_int(fetcher.GetInt32(column, row));
+    case CellType::kInt64:
+      return fl_value_new_int(fetcher.GetInt64(column, row));
+    case CellType::kDateTime:
+    case CellType::kTime:
+      return fl_value_new_int(fetcher.GetMicros(column, row));
+    case CellType::kDouble:
+      return fl_value_new_float(fetcher.GetDouble(column, row));
+    case CellType::kGuid: {
+      uint8_t guid[16];
+      fetcher.GetGuid(column, row, guid);
+      return fl_value_new_uint8_list(guid, sizeof(guid));
+    }
+    case CellType::kBinary: {
+      size_t size = 0;
+      const uint8_t* bytes = fetcher.GetBinary(column, row, &size);
+      return fl_value_new_uint8_list(bytes, size);
+    }
+    case CellType::kDecimal:
+    case CellType::kText:
+      break;
+  }
+  // Formatted into the scratch string and copied out at its final size;
+  // see ScratchPool::text().
+  std::string* scratch = ScratchPool::ForThisThread().text();
+  scratch->clear();
+  if (fetcher.cell_type(column) == CellType::kDecimal) {
+    fetcher.AppendDecimal(column, row, scratch);
+  } else {
+    fetcher.AppendText(column, row, scratch);
+  }
+  return NewString(*scratch);
+}
+
+}  // namespace
+
+std::string GetStringFromMap(FlValue* map, const char* key) {
+  FlValue* value = Lookup(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return "";
+  }
+  return fl_value_get_string(value);
+}
+
+int64_t GetIntFromMap(FlValue* map, const char* key, int64_t default_value) {
+  FlValue* value = Lookup(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return default_value;
+  }
+  return fl_value_get_int(value);
+}
+
+bool GetBoolFromMap(FlValue* map, const char* key, bool default_value) {
+  FlValue* value = Lookup(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_BOOL) {
+    return default_value;
+  }
+  return fl_value_get_bool(value);
+}
+
+SQLULEN GetSecondsFromMap(FlValue* map, const char* key) {
+  return TimeoutSeconds(GetIntFromMap(map, key, 0));
+}
+
+ConnectOptions ReadConnectOptions(FlValue* args) {
+  ConnectOptions options;
+  options.server = GetStringFromMap(args, "server");
+  options.database = GetStringFromMap(args, "database");
+  options.username = GetStringFromMap(args, "username");
+  options.password = GetStringFromMap(args, "password");
+  options.login_timeout = GetSecondsFromMap(args, "loginTimeoutMs");
+  options.utf8_text = GetBoolFromMap(args, "utf8Text", false);
+  int64_t capacity = GetIntFromMap(args, "statementCacheSize",
+                                   StatementCache::kDefaultCapacity);
+  options.statement_cache_size = capacity < 0 ? 0 : (size_t)capacity;
+  return options;
+}
+
+bool ReadParameters(FlValue* args, std::vector<SqlParameter>* params,
+                    std::string* error) {
+  params->clear();
+  FlValue* list = Lookup(args, "parameters");
+  if (list == nullptr || fl_value_get_type(list) == FL_VALUE_TYPE_NULL) {
+    return true;
+  }
+  if (fl_value_get_type(list) != FL_VALUE_TYPE_LIST) {
+    *error = "parameters must be a list";
+    return false;
+  }
+  return ReadParameterList(list, params, error);
+}
+
+bool ReadParameterList(FlValue* list, std::vector<SqlParameter>* params,
+                       std::string* error) {
+  params->clear();
+  size_t length = fl_value_get_length(list);
+  params->reserve(length);
+  for (size_t i = 0; i < length; ++i) {
+    FlValue* value = fl_value_get_list_value(list, i);
+    switch (fl_value_get_type(value)) {
+      case FL_VALUE_TYPE_NULL:
+        params->push_back(SqlParameter::Null());
+        break;
+      case FL_VALUE_TYPE_BOOL:
+        params->push_back(SqlParameter::Bool(fl_value_get_bool(value)));
+        break;
+      case FL_VALUE_TYPE_INT:
+        params->push_back(SqlParameter::Int64(fl_value_get_int(value)));
+        break;
+      case FL_VALUE_TYPE_FLOAT:
+        params->push_back(SqlParameter::Double(fl_value_get_float(value)));
+        break;
+      case FL_VALUE_TYPE_STRING:
+        params->push_back(SqlParameter::Text(fl_value_get_string(value)));
+        break;
+      case FL_VALUE_TYPE_UINT8_LIST: {
+        const uint8_t* bytes = fl_value_get_uint8_list(value);
+        params->push_back(SqlParameter::Binary(
+            std::vector<uint8_t>(bytes, bytes + fl_value_get_length(value))));
+        break;
+      }
+      default:
+        *error = "Unsupported type for parameter " + std::to_string(i + 1);
+        return false;
+    }
+  }
+  return true;
+}
+
+FlValue* EncodeRows(const ColumnarResult& columnar) {
+  FlValue* names = fl_value_new_list();
+  FlValue* types = fl_value_new_list();
+  for (const ResultColumn& column : columnar.columns) {
+    fl_value_append_take(names, NewString(column.name));
+    fl_value_append_take(types, fl_value_new_string(CellTypeName(column.type)));
+  }
+
+  FlValue* rows = fl_value_new_list();
+  for (size_t r = 0; r < columnar.row_count; ++r) {
+    FlValue* row = fl_value_new_map();
+    for (size_t i = 0; i < columnar.columns.size(); ++i) {
+      fl_value_set_take(row, fl_value_ref(fl_value_get_list_value(names, i)),
+                        CellValue(columnar.columns[i], r));
+    }
+    fl_value_append_take(rows, row);
+  }
+
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "rows", rows);
+  fl_value_set_string_take(map, "rowCount", fl_value_new_int(columnar.row_count));
+  fl_value_set_string_take(map, "columns", names);
+  fl_value_set_string_take(map, "columnTypes", types);
+  return map;
+}
+
+FlValue* EncodeColumnar(const ColumnarResult& columnar) {
+  FlValue* names = fl_value_new_list();
+  FlValue* types = fl_value_new_list();
+  FlValue* data = fl_value_new_list();
+  FlValue* nulls = fl_value_new_list();
+  FlValue* scales = fl_value_new_list();
+  for (const ResultColumn& column : columnar.columns) {
+    fl_value_append_take(names, NewString(column.name));
+    fl_value_append_take(types, fl_value_new_string(CellTypeName(column.type)));
+    fl_value_append_take(scales, fl_value_new_int(column.scale));
+    switch (column.type) {
+      case CellType::kBool:
+        fl_value_append_take(data, fl_value_new_uint8_list(column.bools.data(),
+                                                           column.bools.size()));
+        break;
+      case CellType::kInt32:
+      case CellType::kInt64:
+      case CellType::kDateTime:
+      case CellType::kTime:
+        fl_value_append_take(data, fl_value_new_int64_list(column.ints.data(),
+                                                           column.ints.size()));
+        break;
+      case CellType::kDouble:
+        fl_value_append_take(data, fl_value_new_float_list(column.doubles.data(),
+                                                           column.doubles.size()));
+        break;
+      case CellType::kDecimal:
+        fl_value_append_take(data, column.decimal_text
+                                       ? StringList(column.strings)
+                                       : fl_value_new_int64_list(column.ints.data(),
+                                                                 column.ints.size()));
+        break;
+      case CellType::kText:
+        fl_value_append_take(data, StringList(column.strings));
+        break;
+      case CellType::kGuid:
+      case CellType::kBinary: {
+        FlValue* binaries = fl_value_new_list();
+        for (const std::vector<uint8_t>& bytes : column.binaries) {
+          fl_value_append_take(binaries,
+                               fl_value_new_uint8_list(bytes.data(), bytes.size()));
+        }
+        fl_value_append_take(data, binaries);
+        break;
+      }
+    }
+    fl_value_append_take(nulls, column.null_bitmap.empty()
+                                    ? fl_value_new_null()
+                                    : fl_value_new_uint8_list(column.null_bitmap.data(),
+                                                              column.null_bitmap.size()));
+  }
+
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "format", fl_value_new_string("columnar"));
+  fl_value_set_string_take(map, "rowCount", fl_value_new_int(columnar.row_count));
+  fl_value_set_string_take(map, "columns", names);
+  fl_value_set_string_take(map, "columnTypes", types);
+  fl_value_set_string_take(map, "columnData", data);
+  fl_value_set_string_take(map, "nulls", nulls);
+  fl_value_set_string_take(map, "scales", scales);
+  return map;
+}
+
+RowsSink::~RowsSink() {
+  for (FlValue* value : {names_, types_, rows_, reply_}) {
+    if (value != nullptr) {
+      fl_value_unref(value);
+    }
+  }
+}
+
+void RowsSink::Start(const BlockFetcher& fetcher) {
+  names_ = fl_value_new_list();
+  types_ = fl_value_new_list();
+  rows_ = fl_value_new_list();
+  const std::vector<ColumnDescription>& columns = fetcher.columns();
+  for (size_t i = 0; i < columns.size(); ++i) {
+    fl_value_append_take(names_, NewString(columns[i].name));
+    fl_value_append_take(types_,
+                         fl_value_new_string(CellTypeName(fetcher.cell_type(i))));
+  }
+}
+
+void RowsSink::AddRow(const BlockFetcher& fetcher, size_t row) {
+  FlValue* map = fl_value_new_map();
+  size_t columns = fl_value_get_length(names_);
+  for (size_t i = 0; i < columns; ++i) {
+    fl_value_set_take(map, fl_value_ref(fl_value_get_list_value(names_, i)),
+                      CellValue(fetcher, i, row));
+  }
+  fl_value_append_take(rows_, map);
+  ++row_count_;
+}
+
+void RowsSink::Finish() {
+  reply_ = fl_value_new_map();
+  fl_value_set_string_take(reply_, "rows", rows_);
+  fl_value_set_string_take(reply_, "rowCount", fl_value_new_int(row_count_));
+  fl_value_set_string_take(reply_, "columns", names_);
+  fl_value_set_string_take(reply_, "columnTypes", types_);
+  rows_ = names_ = types_ = nullptr;
+}
+
+FlValue* RowsSink::TakeReply() {
+  FlValue* reply = reply_;
+  reply_ = nullptr;
+  return reply;
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,72 @@
+#ifndef FLUTTER_PLUGIN_FL_VALUE_ADAPTER_H_
+#define FLUTTER_PLUGIN_FL_VALUE_ADAPTER_H_
+
+#include <flutter_linux/flutter_linux.h>
+#include <sql.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "columnar_result.h"
+#include "parameter_binder.h"
+#include "session.h"
+
+namespace mssql_connect {
+
+// Translates between the Linux channel's FlValues and the types of the
+// shared core (see session.h). windows/encodable_value_adapter.h does the
+// same for EncodableValues; both build identical reply shapes.
+
+// Map arguments, or |default_value| when |map| is not a map or the key is
+// absent or of another type.
+std::string GetStringFromMap(FlValue* map, const char* key);
+int64_t GetIntFromMap(FlValue* map, const char* key, int64_t default_value);
+bool GetBoolFromMap(FlValue* map, const char* key, bool default_value);
+// A millisecond argument such as "timeoutMs" in whole seconds; see
+// TimeoutSeconds().
+SQLULEN GetSecondsFromMap(FlValue* map, const char* key);
+
+// The arguments of connect.
+ConnectOptions ReadConnectOptions(FlValue* args);
+
+// Converts the "parameters" list of |args|, or |list|, into values for
+// SQLBindParameter. Returns false and fills |error| on an unsupported value.
+bool ReadParameters(FlValue* args, std::vector<SqlParameter>* params,
+                    std::string* error);
+bool ReadParameterList(FlValue* list, std::vector<SqlParameter>* params,
+                       std::string* error);
+
+// The reply to a query: one map per row, or with resultFormat 'columnar'
+// one typed list per column. The caller owns the returned value.
+FlValue* EncodeRows(const ColumnarResult& columnar);
+FlValue* EncodeColumnar(const ColumnarResult& columnar);
+
+// Builds the EncodeRows() shape while the result is fetched, one map per
+// row straight from the fetcher's rowsets; see Session::Query().
+class RowsSink : public ResultSink {
+ public:
+  RowsSink() = default;
+  ~RowsSink() override;
+
+  RowsSink(const RowsSink&) = delete;
+  RowsSink& operator=(const RowsSink&) = delete;
+
+  void Start(const BlockFetcher& fetcher) override;
+  void AddRow(const BlockFetcher& fetcher, size_t row) override;
+  void Finish() override;
+
+  // The reply, once finished. The caller owns the returned value.
+  FlValue* TakeReply();
+
+ private:
+  FlValue* names_ = nullptr;
+  FlValue* types_ = nullptr;
+  FlValue* rows_ = nullptr;
+  size_t row_count_ = 0;
+  FlValue* reply_ = nullptr;
+};
+
+}  // namespace mssql_connect
+
+#endif  // FLUTTER_PLUGIN_FL_VALUE_ADAPTER_H_
@@ -5,15 +5,293 @@
 #include <sys/utsname.h>
 
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "binary_result.h"
+#include "columnar_result.h"
+#include "fl_value_adapter.h"
+#include "metrics.h"
 #include "mssql_connect_plugin_private.h"
+#include "request_registry.h"
+#include "session.h"
+#include "worker_pool.h"
 
 #define MSSQL_CONNECT_PLUGIN(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST((obj), mssql_connect_plugin_get_type(), \
                               MssqlConnectPlugin))
 
+namespace mssql_connect {
+namespace {
+
+// The native state behind one plugin instance: the open sessions and the
+// workers their calls run on. Method calls are answered on the platform
+// thread; everything that talks to the driver runs on |workers|, keyed by
+// connection id so a connection's calls never overlap.
+struct Backend {
+  Backend() : workers(WorkerPool::DefaultThreadCount()) {}
+
+  // Joins the workers before the state their tasks use is destroyed.
+  ~Backend() { workers.Stop(); }
+
+  std::shared_ptr<Session> FindSession(int64_t connection_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(connection_id);
+    return it == sessions.end() ? nullptr : it->second;
+  }
+
+  RequestRegistry requests;
+  std::mutex mutex;
+  int64_t next_connection_id = 0;
+  std::unordered_map<int64_t, std::shared_ptr<Session>> sessions;
+  // Last, so that it is also the first member destroyed.
+  WorkerPool workers;
+};
+
+using MethodHandler = FlMethodResponse* (*)(Backend* backend, FlValue* args);
+
+FlMethodResponse* Success(FlValue* result) {
+  g_autoptr(FlValue) value = result;
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+}
+
+FlMethodResponse* Error(const std::string& code, const std::string& message,
+                        const std::string& details = std::string()) {
+  g_autoptr(FlValue) value =
+      details.empty() ? nullptr : fl_value_new_string(details.c_str());
+  return FL_METHOD_RESPONSE(
+      fl_method_error_response_new(code.c_str(), message.c_str(), value));
+}
+
+FlMethodResponse* Error(const SessionError& error) {
+  return Error(error.code, error.message, error.details);
+}
+
+// Runs on a worker.
+FlMethodResponse* Connect(Backend* backend, FlValue* args) {
+  // Counted in the new connection's statistics, which also feed the
+  // process-wide ones; a failed connect only shows up in the latter.
+  SessionError error;
+  std::unique_ptr<Session> session = Session::Open(
+      ReadConnectOptions(args), std::make_shared<Metrics>(&Metrics::Global()),
+      &error);
+  if (!session) {
+    return Error(error);
+  }
+  int64_t connection_id;
+  {
+    std::lock_guard<std::mutex> lock(backend->mutex);
+    connection_id = ++backend->next_connection_id;
+    backend->sessions[connection_id] = std::move(session);
+  }
+  FlValue* response = fl_value_new_map();
+  fl_value_set_string_take(response, "connectionId",
+                           fl_value_new_int(connection_id));
+  fl_value_set_string_take(response, "success", fl_value_new_bool(true));
+  return Success(response);
+}
+
+// Runs on a worker.
+FlMethodResponse* Disconnect(Backend* backend, FlValue* args) {
+  std::shared_ptr<Session> session;
+  {
+    std::lock_guard<std::mutex> lock(backend->mutex);
+    auto it = backend->sessions.find(GetIntFromMap(args, "connectionId", -1));
+    if (it == backend->sessions.end()) {
+      return Error("InvalidConnection", "Invalid connection ID");
+    }
+    session = std::move(it->second);
+    backend->sessions.erase(it);
+  }
+  // Disconnects outside the lock, once no other call holds the session.
+  session.reset();
+  return Success(fl_value_new_bool(true));
+}
+
+StatementOptions ReadStatementOptions(Backend* backend, FlValue* args) {
+  StatementOptions options;
+  options.timeout = GetSecondsFromMap(args, "timeoutMs");
+  options.requests = &backend->requests;
+  options.request_id = static_cast<int>(GetIntFromMap(args, "requestId", 0));
+  return options;
+}
+
+// Runs on a worker.
+FlMethodResponse* Query(Backend* backend, FlValue* args) {
+  std::shared_ptr<Session> session =
+      backend->FindSession(GetIntFromMap(args, "connectionId", -1));
+  if (!session) {
+    return Error("InvalidConnection", "Invalid connection ID");
+  }
+  std::string sql = GetStringFromMap(args, "sql");
+  if (sql.empty()) {
+    return Error("InvalidQuery", "SQL query cannot be empty");
+  }
+  std::vector<SqlParameter> params;
+  std::string error_message;
+  if (!ReadParameters(args, &params, &error_message)) {
+    return Error("InvalidArguments", error_message);
+  }
+
+  Metrics* metrics = session->metrics();
+  if (metrics) {
+    metrics->CountCall(CallKind::kQuery);
+  }
+  // The columnar shape is column-major, so its typed lists are built once
+  // the whole result is in; the other shapes are encoded as the rows are
+  // fetched.
+  std::string format = GetStringFromMap(args, "resultFormat");
+  std::vector<uint8_t> bytes;
+  BinaryResultSink binary_sink(&bytes);
+  ColumnarResult columnar;
+  ColumnarSink columnar_sink(&columnar);
+  RowsSink rows_sink;
+  ResultSink* sink = &rows_sink;
+  if (format == "binary") {
+    sink = &binary_sink;
+  } else if (format == "columnar") {
+    sink = &columnar_sink;
+  }
+  SessionError error;
+  if (!session->Query(sql, params, ReadStatementOptions(backend, args), sink,
+                      &error)) {
+    if (metrics) {
+      metrics->CountError(CallKind::kQuery);
+    }
+    return Error(error);
+  }
+
+  if (format == "binary") {
+    if (metrics) {
+      metrics->AddBytes(bytes.size());
+    }
+    return Success(fl_value_new_uint8_list(bytes.data(), bytes.size()));
+  }
+  if (format == "columnar") {
+    PhaseTimer encode_timer(metrics, Phase::kEncode);
+    return Success(EncodeColumnar(columnar));
+  }
+  return Success(rows_sink.TakeReply());
+}
+
+// Runs on a worker.
+FlMethodResponse* Execute(Backend* backend, FlValue* args) {
+  std::shared_ptr<Session> session =
+      backend->FindSession(GetIntFromMap(args, "connectionId", -1));
+  if (!session) {
+    return Error("InvalidConnection", "Invalid connection ID");
+  }
+  std::string sql = GetStringFromMap(args, "sql");
+  if (sql.empty()) {
+    return Error("InvalidCommand", "SQL command cannot be empty");
+  }
+  std::vector<SqlParameter> params;
+  std::string error_message;
+  if (!ReadParameters(args, &params, &error_message)) {
+    return Error("InvalidArguments", error_message);
+  }
+
+  Metrics* metrics = session->metrics();
+  if (metrics) {
+    metrics->CountCall(CallKind::kExecute);
+  }
+  int64_t rows_affected = 0;
+  SessionError error;
+  if (!session->Execute(sql, params, ReadStatementOptions(backend, args),
+                        &rows_affected, &error)) {
+    if (metrics) {
+      metrics->CountError(CallKind::kExecute);
+    }
+    return Error(error);
+  }
+  return Success(fl_value_new_int(rows_affected));
+}
+
+struct PendingReply {
+  FlMethodCall* method_call;
+  FlMethodResponse* response;
+};
+
+// Holds a reference to a method call until its task hands it to a reply.
+// A task that WorkerPool::Stop() drops, or that a stopped pool refuses, is
+// destroyed on the platform thread without having run; the call is then
+// answered with an error instead of being left waiting.
+class PendingCall {
+ public:
+  explicit PendingCall(FlMethodCall* method_call)
+      : method_call_(FL_METHOD_CALL(g_object_ref(method_call))) {}
+
+  ~PendingCall() {
+    if (method_call_ == nullptr) {
+      return;
+    }
+    g_autoptr(FlMethodResponse) response =
+        Error("Disposed", "The plugin was disposed before the call ran");
+    fl_method_call_respond(method_call_, response, nullptr);
+    g_object_unref(method_call_);
+  }
+
+  PendingCall(const PendingCall&) = delete;
+  PendingCall& operator=(const PendingCall&) = delete;
+
+  FlMethodCall* get() const { return method_call_; }
+
+  // Gives up ownership of the reference, to a PendingReply.
+  FlMethodCall* Release() {
+    FlMethodCall* method_call = method_call_;
+    method_call_ = nullptr;
+    return method_call;
+  }
+
+ private:
+  FlMethodCall* method_call_;
+};
+
+gboolean SendReply(gpointer data) {
+  std::unique_ptr<PendingReply> reply(static_cast<PendingReply*>(data));
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(reply->method_call, reply->response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+  g_object_unref(reply->response);
+  g_object_unref(reply->method_call);
+  return G_SOURCE_REMOVE;
+}
+
+// Runs |handler| on a worker and answers |method_call| with its response
+// back on the platform thread.
+void RunOnWorker(Backend* backend, MethodHandler handler,
+                 FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  int64_t connection_id = GetIntFromMap(args, "connectionId", -1);
+  int request_id = static_cast<int>(GetIntFromMap(args, "requestId", 0));
+  // A call with a request id can be cancelled from the time it is queued.
+  backend->requests.Add(request_id);
+  auto call = std::make_shared<PendingCall>(method_call);
+  auto task = [backend, handler, call, request_id]() {
+    FlMethodResponse* response =
+        handler(backend, fl_method_call_get_args(call->get()));
+    backend->requests.Remove(request_id);
+    g_idle_add(SendReply, new PendingReply{call->Release(), response});
+  };
+  if (connection_id >= 0) {
+    backend->workers.Post(connection_id, std::move(task));
+  } else {
+    backend->workers.Post(std::move(task));
+  }
+}
+
+}  // namespace
+}  // namespace mssql_connect
+
 struct _MssqlConnectPlugin {
   GObject parent_instance;
+
+  mssql_connect::Backend* backend;
 };
 
 G_DEFINE_TYPE(MssqlConnectPlugin, mssql_connect_plugin, g_object_get_type())
@@ -28,6 +306,28 @@ static void mssql_connect_plugin_handle_method_call(
 
   if (strcmp(method, "getPlatformVersion") == 0) {
     response = get_platform_version();
+  } else if (strcmp(method, "connect") == 0) {
+    mssql_connect::RunOnWorker(self->backend, mssql_connect::Connect,
+                               method_call);
+    return;
+  } else if (strcmp(method, "disconnect") == 0) {
+    mssql_connect::RunOnWorker(self->backend, mssql_connect::Disconnect,
+                               method_call);
+    return;
+  } else if (strcmp(method, "query") == 0) {
+    mssql_connect::RunOnWorker(self->backend, mssql_connect::Query,
+                               method_call);
+    return;
+  } else if (strcmp(method, "execute") == 0) {
+    mssql_connect::RunOnWorker(self->backend, mssql_connect::Execute,
+                               method_call);
+    return;
+  } else if (strcmp(method, "cancel") == 0) {
+    int request_id = static_cast<int>(mssql_connect::GetIntFromMap(
+        fl_method_call_get_args(method_call), "requestId", 0));
+    g_autoptr(FlValue) result =
+        fl_value_new_bool(self->backend->requests.Cancel(request_id));
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
   } else {
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
   }
@@ -44,6 +344,12 @@ FlMethodResponse* get_platform_version() {
 }
 
 static void mssql_connect_plugin_dispose(GObject* object) {
+  MssqlConnectPlugin* self = MSSQL_CONNECT_PLUGIN(object);
+  // Waits for running calls, answers the queued ones with an error, then
+  // closes the sessions. Replies already queued for the platform thread
+  // hold their own references.
+  delete self->backend;
+  self->backend = nullptr;
   G_OBJECT_CLASS(mssql_connect_plugin_parent_class)->dispose(object);
 }
 
@@ -51,7 +357,9 @@ static void mssql_connect_plugin_class_init(MssqlConnectPluginClass* klass) {
   G_OBJECT_CLASS(klass)->dispose = mssql_connect_plugin_dispose;
 }
 
-static void mssql_connect_plugin_init(MssqlConnectPlugin* self) {}
+static void mssql_connect_plugin_init(MssqlConnectPlugin* self) {
+  self->backend = new mssql_connect::Backend();
+}
 
 static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
                            gpointer user_data) {
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_reactor.h"
+#include "odbc_error.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// Statements on one synthetic connection; the driver returns
+// SQL_STILL_EXECUTING until a statement's latency has passed.
+class AsyncReactorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
+    SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
+  }
+
+  void TearDown() override {
+    for (SQLHSTMT stmt : statements_) {
+      SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    }
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc_);
+    SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  }
+
+  SQLHSTMT NewStatement() {
+    SQLHSTMT stmt = SQL_NULL_HSTMT;
+    SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt);
+    statements_.push_back(stmt);
+    return stmt;
+  }
+
+  // Submits |sql| on |stmt| and records its final return code.
+  void Submit(AsyncReactor* reactor, SQLHSTMT stmt, const std::string& sql) {
+    auto text = std::make_shared<std::vector<SQLWCHAR>>(Utf8ToUtf16(sql));
+    reactor->Submit(
+        stmt,
+        [stmt, text]() {
+          return SQLExecDirectW(stmt, text->data(), (SQLINTEGER)text->size());
+        },
+        [this, stmt](SQLRETURN ret) {
+          std::string state = SQL_SUCCEEDED(ret)
+                                  ? std::string()
+                                  : GetOdbcSqlState(SQL_HANDLE_STMT, stmt);
+          std::lock_guard<std::mutex> lock(mutex_);
+          results_.push_back(ret);
+          states_.push_back(state);
+          done_cv_.notify_all();
+        });
+  }
+
+  bool WaitFor(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return done_cv_.wait_for(lock, std::chrono::seconds(5),
+                             [&]() { return results_.size() >= count; });
+  }
+
+  SQLHENV env_ = SQL_NULL_HENV;
+  SQLHDBC dbc_ = SQL_NULL_HDBC;
+  std::vector<SQLHSTMT> statements_;
+
+  std::mutex mutex_;
+  std::condition_variable done_cv_;
+  std::vector<SQLRETURN> results_;
+  std::vector<std::string> states_;
+};
+
+}  // namespace
+
+TEST_F(AsyncReactorTest, FinishesStatementsThatCompleteLater) {
+  AsyncReactor::Options options;
+  options.thread_count = 1;
+  AsyncReactor reactor(options);
+
+  // More executions than threads, all waiting at once.
+  for (int i = 0; i < 4; ++i) {
+    Submit(&reactor, NewStatement(),
+           "SELECT rows=1 cols=1 types=int latency=20000");
+  }
+  ASSERT_TRUE(WaitFor(4));
+  for (SQLRETURN ret : results_) {
+    EXPECT_EQ(ret, SQL_SUCCESS);
+  }
+  // An execution stops counting as in flight once its callback returns.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (reactor.stats().in_flight > 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  AsyncReactorStats stats = reactor.stats();
+  EXPECT_EQ(stats.submitted, 4u);
+  EXPECT_EQ(stats.synchronous, 0u);
+  EXPECT_EQ(stats.in_flight, 0u);
+  EXPECT_GT(stats.polls, 0u);
+
+  // The statement is usable synchronously once switched back.
+  SQLHSTMT stmt = statements_.front();
+  AsyncReactor::EndAsync(stmt);
+  SQLSMALLINT columns = 0;
+  SQLNumResultCols(stmt, &columns);
+  EXPECT_EQ(columns, 1);
+}
+
+TEST_F(AsyncReactorTest, CompletesInlineWhenTheCallFinishesAtOnce) {
+  AsyncReactor reactor(AsyncReactor::Options{});
+  Submit(&reactor, NewStatement(), "SELECT rows=1 cols=1 types=int");
+  // Reported before Submit() returned, without a reactor thread.
+  EXPECT_EQ(results_.size(), 1u);
+  EXPECT_EQ(results_[0], SQL_SUCCESS);
+  EXPECT_EQ(reactor.stats().in_flight, 0u);
+}
+
+TEST_F(AsyncReactorTest, ReportsCancellation) {
+  AsyncReactor reactor(AsyncReactor::Options{});
+  SQLHSTMT stmt = NewStatement();
+  Submit(&reactor, stmt, "SELECT rows=1 cols=1 types=int latency=5000000");
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  SQLCancel(stmt);
+  ASSERT_TRUE(WaitFor(1));
+  EXPECT_EQ(results_[0], SQL_ERROR);
+  EXPECT_EQ(states_[0], "HY008");
+}
+
+TEST_F(AsyncReactorTest, CancelsExecutionsOnShutdown) {
+  {
+    AsyncReactor reactor(AsyncReactor::Options{});
+    Submit(&reactor, NewStatement(),
+           "SELECT rows=1 cols=1 types=int latency=5000000");
+  }
+  // The destructor waited for the driver to acknowledge the cancel.
+  ASSERT_EQ(results_.size(), 1u);
+  EXPECT_EQ(results_[0], SQL_ERROR);
+  EXPECT_EQ(states_[0], "HY008");
+}
+
+}  // namespace test
+}  // namespace mssql_connect
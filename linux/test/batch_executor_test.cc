@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "batch_executor.h"
+#include "parameter_binder.h"
+#include "text_encoding.h"
+
+// Exported by the synthetic driver.
+extern "C" SQLSMALLINT SyntheticOdbcParamType(SQLHSTMT stmt,
+                                              SQLUSMALLINT number);
+extern "C" SQLPOINTER SyntheticOdbcParamData(SQLHSTMT stmt,
+                                             SQLUSMALLINT number,
+                                             SQLSMALLINT* c_type,
+                                             SQLLEN* element_size,
+                                             SQLLEN** indicators);
+extern "C" SQLULEN SyntheticOdbcParamsetSize(SQLHSTMT stmt, size_t execution);
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+using Rows = std::vector<std::vector<SqlParameter>>;
+using Status = BatchRowStatus;
+
+// One statement on a synthetic connection; see
+// linux/benchmark/synthetic_odbc_driver.cc for the statement syntax.
+class BatchExecutorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
+    SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
+    SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt_);
+  }
+
+  void TearDown() override {
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc_);
+    SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  }
+
+  void Prepare(const std::string& sql) {
+    std::vector<SQLWCHAR> text = Utf8ToUtf16(sql);
+    ASSERT_TRUE(SQL_SUCCEEDED(
+        SQLPrepareW(stmt_, text.data(), (SQLINTEGER)text.size())));
+  }
+
+  // Parameter set counts of the executions since Prepare().
+  std::vector<SQLULEN> ParamsetSizes() {
+    std::vector<SQLULEN> sizes;
+    while (SQLULEN size = SyntheticOdbcParamsetSize(stmt_, sizes.size())) {
+      sizes.push_back(size);
+    }
+    return sizes;
+  }
+
+  SQLHENV env_ = SQL_NULL_HENV;
+  SQLHDBC dbc_ = SQL_NULL_HDBC;
+  SQLHSTMT stmt_ = SQL_NULL_HSTMT;
+};
+
+Rows IntRows(size_t count) {
+  Rows rows;
+  for (size_t i = 0; i < count; ++i) {
+    rows.push_back({SqlParameter::Int64(static_cast<int64_t>(i))});
+  }
+  return rows;
+}
+
+}  // namespace
+
+TEST_F(BatchExecutorTest, BindsMixedIntegersAndDoublesAsDoubles) {
+  Prepare("INSERT rows=1 cols=0");
+  Rows rows = {
+      {SqlParameter::Int64(1)},
+      {SqlParameter::Double(2.5)},
+      {SqlParameter::Null()},
+  };
+  ParameterArrayBinder binder;
+  std::string error;
+  ASSERT_TRUE(binder.Bind(stmt_, rows, 0, rows.size(), &error)) << error;
+  EXPECT_EQ(SyntheticOdbcParamType(stmt_, 1), SQL_DOUBLE);
+
+  SQLSMALLINT c_type = 0;
+  SQLLEN element_size = 0;
+  SQLLEN* indicators = nullptr;
+  const SQLDOUBLE* values = static_cast<const SQLDOUBLE*>(
+      SyntheticOdbcParamData(stmt_, 1, &c_type, &element_size, &indicators));
+  ASSERT_NE(values, nullptr);
+  EXPECT_EQ(c_type, SQL_C_DOUBLE);
+  EXPECT_EQ(element_size, (SQLLEN)sizeof(SQLDOUBLE));
+  EXPECT_EQ(values[0], 1.0);
+  EXPECT_EQ(values[1], 2.5);
+  EXPECT_EQ(indicators[0], 0);
+  EXPECT_EQ(indicators[1], 0);
+  EXPECT_EQ(indicators[2], SQL_NULL_DATA);
+}
+
+TEST_F(BatchExecutorTest, RejectsColumnsOfDifferentTypes) {
+  Prepare("INSERT rows=1 cols=0");
+  Rows rows = {{SqlParameter::Int64(1)}, {SqlParameter::Text("a")}};
+  ParameterArrayBinder binder;
+  std::string error;
+  EXPECT_FALSE(binder.Bind(stmt_, rows, 0, rows.size(), &error));
+  EXPECT_EQ(error, "Parameter 1 has values of different types");
+}
+
+TEST_F(BatchExecutorTest, RejectsRowsOfDifferentWidths) {
+  Prepare("INSERT rows=1 cols=0");
+  Rows rows = {
+      {SqlParameter::Int64(1), SqlParameter::Int64(2)},
+      {SqlParameter::Int64(3)},
+  };
+  BatchExecutor executor(stmt_, BatchExecutor::kDefaultBatchSize);
+  BatchResult result;
+  std::string error;
+  EXPECT_FALSE(executor.Execute(rows, &result, &error));
+  EXPECT_EQ(error, "Row 2 has 1 values, expected 2");
+  // Nothing was sent.
+  EXPECT_TRUE(ParamsetSizes().empty());
+}
+
+TEST_F(BatchExecutorTest, SplitsRowsIntoBatchesOfTheBatchSize) {
+  Prepare("INSERT rows=1 cols=0");
+  BatchExecutor executor(stmt_, 2);
+  BatchResult result;
+  std::string error;
+  ASSERT_TRUE(executor.Execute(IntRows(5), &result, &error)) << error;
+  EXPECT_EQ(ParamsetSizes(), (std::vector<SQLULEN>{2, 2, 1}));
+  EXPECT_EQ(result.rows_affected, 5);
+  EXPECT_EQ(result.statuses, std::vector<Status>(5, Status::kSuccess));
+}
+
+TEST_F(BatchExecutorTest, SplitsBatchesThatWouldExceedTheByteLimit) {
+  Prepare("INSERT rows=1 cols=0");
+  // Each element takes a bit over 6 MB as UTF-16, so two fit in
+  // kMaxBatchBytes and three do not.
+  Rows rows(5, {SqlParameter::Text(std::string(3 * 1024 * 1024, 'x'))});
+  ASSERT_LT(2 * ParameterArrayBinder::ElementBytes(rows[0][0]),
+            BatchExecutor::kMaxBatchBytes);
+  ASSERT_GT(3 * ParameterArrayBinder::ElementBytes(rows[0][0]),
+            BatchExecutor::kMaxBatchBytes);
+  BatchExecutor executor(stmt_, BatchExecutor::kDefaultBatchSize);
+  BatchResult result;
+  std::string error;
+  ASSERT_TRUE(executor.Execute(rows, &result, &error)) << error;
+  EXPECT_EQ(ParamsetSizes(), (std::vector<SQLULEN>{2, 2, 1}));
+  EXPECT_EQ(result.rows_affected, 5);
+}
+
+TEST_F(BatchExecutorTest, ReportsRowsTheDriverRejects) {
+  // Every third parameter set of each execution fails.
+  Prepare("INSERT rows=2 cols=0 fail=3");
+  BatchExecutor executor(stmt_, 4);
+  BatchResult result;
+  std::string error;
+  ASSERT_TRUE(executor.Execute(IntRows(7), &result, &error)) << error;
+  EXPECT_EQ(ParamsetSizes(), (std::vector<SQLULEN>{4, 3}));
+  EXPECT_EQ(result.statuses,
+            (std::vector<Status>{Status::kSuccess, Status::kSuccess,
+                                 Status::kError, Status::kSuccess,
+                                 Status::kSuccess, Status::kSuccess,
+                                 Status::kError}));
+  EXPECT_EQ(result.rows_affected, 2 * 5);
+  EXPECT_TRUE(result.error.empty()) << result.error;
+}
+
+TEST_F(BatchExecutorTest, StopsAtABatchThatFailsAsAWhole) {
+  // The driver rejects the statement before running any parameter set.
+  Prepare("INSERT rows=1 cols=0 types=unknown");
+  BatchExecutor executor(stmt_, 2);
+  BatchResult result;
+  std::string error;
+  ASSERT_TRUE(executor.Execute(IntRows(5), &result, &error)) << error;
+  EXPECT_EQ(ParamsetSizes(), std::vector<SQLULEN>{2});
+  EXPECT_EQ(result.statuses,
+            (std::vector<Status>{Status::kError, Status::kError,
+                                 Status::kUnused, Status::kUnused,
+                                 Status::kUnused}));
+  EXPECT_EQ(result.rows_affected, 0);
+  EXPECT_NE(result.error.find("42000"), std::string::npos) << result.error;
+}
+
+}  // namespace test
+}  // namespace mssql_connect
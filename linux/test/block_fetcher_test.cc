@@ -0,0 +1,370 @@
+#include <gtest/gtest.h>
+
+#include <cfloat>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "columnar_result.h"
+#include "result_cursor.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// One statement on a synthetic connection; see
+// linux/benchmark/synthetic_odbc_driver.cc for the statement syntax.
+class BlockFetcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
+    SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
+    SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt_);
+  }
+
+  void TearDown() override {
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc_);
+    SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  }
+
+  SQLRETURN Run(const std::string& sql) { return Run(stmt_, sql); }
+
+  SQLRETURN Run(SQLHSTMT stmt, const std::string& sql) {
+    std::vector<SQLWCHAR> text = Utf8ToUtf16(sql);
+    return SQLExecDirectW(stmt, text.data(), (SQLINTEGER)text.size());
+  }
+
+  // Runs |sql| and binds |fetcher| to its result, leaving last-column
+  // values over 100 bytes in the driver.
+  void RunLazy(const std::string& sql, BlockFetcher* fetcher) {
+    ASSERT_TRUE(SQL_SUCCEEDED(Run(sql)));
+    fetcher->set_lob_threshold(100);
+    std::string error;
+    ASSERT_TRUE(fetcher->Bind(&error)) << error;
+  }
+
+  SQLHENV env_ = SQL_NULL_HENV;
+  SQLHDBC dbc_ = SQL_NULL_HDBC;
+  SQLHSTMT stmt_ = SQL_NULL_HSTMT;
+};
+
+// The driver's ASCII text: units [offset, offset + length) of the value in
+// (row, column).
+std::string Letters(size_t row, size_t column, size_t offset, size_t length) {
+  std::string text;
+  for (size_t i = offset; i < offset + length; ++i) {
+    text.push_back(static_cast<char>('a' + (row + column + i) % 26));
+  }
+  return text;
+}
+
+std::string Decimal(const BlockFetcher& fetcher, size_t column, size_t row) {
+  std::string text;
+  fetcher.AppendDecimal(column, row, &text);
+  return text;
+}
+
+std::vector<uint8_t> Guid(const BlockFetcher& fetcher, size_t column,
+                          size_t row) {
+  std::vector<uint8_t> bytes(16);
+  fetcher.GetGuid(column, row, bytes.data());
+  return bytes;
+}
+
+}  // namespace
+
+TEST_F(BlockFetcherTest, ReadColumnarFailsWhenAFetchFails) {
+  ASSERT_TRUE(SQL_SUCCEEDED(Run("SELECT rows=10 cols=1 types=int")));
+  BlockFetcher fetcher(stmt_);
+  std::string error;
+  ASSERT_TRUE(fetcher.Bind(&error)) << error;
+  // The cursor is gone, so the first fetch fails.
+  SQLFreeStmt(stmt_, SQL_CLOSE);
+
+  ColumnarResult result;
+  EXPECT_FALSE(ReadColumnar(&fetcher, &result, &error));
+  EXPECT_NE(error.find("24000"), std::string::npos) << error;
+}
+
+TEST_F(BlockFetcherTest, FailsOnRowsTheDriverMarksAsErrors) {
+  ASSERT_TRUE(SQL_SUCCEEDED(Run("SELECT rows=10 cols=1 types=int bad=5")));
+  BlockFetcher fetcher(stmt_);
+  std::string error;
+  ASSERT_TRUE(fetcher.Bind(&error)) << error;
+  SQLULEN rows = 0;
+  EXPECT_FALSE(fetcher.Next(&rows, &error));
+  EXPECT_EQ(rows, 0u);
+  EXPECT_EQ(error.find("Row 5 "), 0u) << error;
+  EXPECT_NE(error.find("22018"), std::string::npos) << error;
+}
+
+TEST_F(BlockFetcherTest, FailsWhenBoundValuesAreTruncated) {
+  ASSERT_TRUE(SQL_SUCCEEDED(Run("SELECT rows=3 cols=2 types=int,text strlen=16")));
+  // A stale description: the text column is narrower than its values.
+  std::vector<ColumnDescription> columns(2);
+  columns[0].sql_type = SQL_INTEGER;
+  columns[1].sql_type = SQL_WVARCHAR;
+  columns[1].column_size = 4;
+  BlockFetcher fetcher(stmt_);
+  std::string error;
+  ASSERT_TRUE(fetcher.Bind(columns, &error)) << error;
+  SQLULEN rows = 0;
+  EXPECT_FALSE(fetcher.Next(&rows, &error));
+  EXPECT_NE(error.find("01004"), std::string::npos) << error;
+}
+
+TEST_F(BlockFetcherTest, StreamsLobTextForwardOnly) {
+  BlockFetcher fetcher(stmt_);
+  RunLazy("SELECT rows=2 cols=2 types=int,lob strlen=20000", &fetcher);
+  std::string error;
+  SQLULEN rows = 0;
+  ASSERT_TRUE(fetcher.Next(&rows, &error)) << error;
+  ASSERT_EQ(rows, 1u);
+  EXPECT_FALSE(fetcher.IsLob(0));
+  ASSERT_TRUE(fetcher.IsLob(1));
+
+  std::string text;
+  size_t units = 0;
+  bool end = true;
+  ASSERT_TRUE(fetcher.ReadLobText(0, 10, &text, &units, &end, &error)) << error;
+  EXPECT_EQ(text, Letters(0, 1, 0, 10));
+  EXPECT_EQ(units, 10u);
+  EXPECT_FALSE(end);
+
+  // What was returned is gone.
+  EXPECT_FALSE(fetcher.ReadLobText(5, 10, &text, &units, &end, &error));
+  EXPECT_NE(error.find("already been read"), std::string::npos) << error;
+
+  // Skipping ahead reads past the data in between.
+  ASSERT_TRUE(fetcher.ReadLobText(12000, 100, &text, &units, &end, &error))
+      << error;
+  EXPECT_EQ(text, Letters(0, 1, 12000, 100));
+  EXPECT_FALSE(end);
+
+  // |end| is set by the read that reaches the end, even a short one.
+  ASSERT_TRUE(fetcher.ReadLobText(19990, 100, &text, &units, &end, &error))
+      << error;
+  EXPECT_EQ(text, Letters(0, 1, 19990, 10));
+  EXPECT_EQ(units, 10u);
+  EXPECT_TRUE(end);
+  ASSERT_TRUE(fetcher.ReadLobText(20000, 10, &text, &units, &end, &error))
+      << error;
+  EXPECT_EQ(units, 0u);
+  EXPECT_TRUE(end);
+
+  // The next row starts over.
+  ASSERT_TRUE(fetcher.Next(&rows, &error)) << error;
+  ASSERT_EQ(rows, 1u);
+  ASSERT_TRUE(fetcher.ReadLobText(0, 20000, &text, &units, &end, &error))
+      << error;
+  EXPECT_EQ(text, Letters(1, 1, 0, 20000));
+  EXPECT_TRUE(end);
+}
+
+TEST_F(BlockFetcherTest, StreamsLobBytes) {
+  BlockFetcher fetcher(stmt_);
+  RunLazy("SELECT rows=1 cols=1 types=blob strlen=10000", &fetcher);
+  std::string error;
+  SQLULEN rows = 0;
+  ASSERT_TRUE(fetcher.Next(&rows, &error)) << error;
+  ASSERT_TRUE(fetcher.IsLob(0));
+
+  std::vector<uint8_t> bytes;
+  bool end = true;
+  ASSERT_TRUE(fetcher.ReadLobBytes(0, 300, &bytes, &end, &error)) << error;
+  ASSERT_EQ(bytes.size(), 300u);
+  EXPECT_EQ(bytes[299], static_cast<uint8_t>(299));
+  EXPECT_FALSE(end);
+  ASSERT_TRUE(fetcher.ReadLobBytes(9950, 100, &bytes, &end, &error)) << error;
+  ASSERT_EQ(bytes.size(), 50u);
+  EXPECT_EQ(bytes[0], static_cast<uint8_t>(9950));
+  EXPECT_TRUE(end);
+}
+
+TEST_F(BlockFetcherTest, KeepsSurrogatePairsTogether) {
+  BlockFetcher fetcher(stmt_);
+  RunLazy("SELECT rows=1 cols=1 types=lob strlen=20000 pairs=1", &fetcher);
+  std::string error;
+  SQLULEN rows = 0;
+  ASSERT_TRUE(fetcher.Next(&rows, &error)) << error;
+  ASSERT_TRUE(fetcher.IsLob(0));
+
+  // Three units end in the middle of the second pair, which is left for
+  // the next read.
+  std::string text;
+  size_t units = 0;
+  bool end = true;
+  ASSERT_TRUE(fetcher.ReadLobText(0, 3, &text, &units, &end, &error)) << error;
+  EXPECT_EQ(units, 2u);
+  EXPECT_EQ(text, "\xF0\x9F\x98\x80");  // U+1F600
+  ASSERT_TRUE(fetcher.ReadLobText(units, 2, &text, &units, &end, &error))
+      << error;
+  EXPECT_EQ(units, 2u);
+  EXPECT_EQ(text, "\xF0\x9F\x98\x81");  // U+1F601
+  EXPECT_FALSE(end);
+}
+
+TEST_F(BlockFetcherTest, ReadsShortValuesWithTheRow) {
+  BlockFetcher fetcher(stmt_);
+  RunLazy("SELECT rows=1 cols=1 types=lob strlen=40", &fetcher);
+  std::string error;
+  SQLULEN rows = 0;
+  ASSERT_TRUE(fetcher.Next(&rows, &error)) << error;
+  EXPECT_FALSE(fetcher.IsLob(0));
+  std::string text;
+  fetcher.AppendText(0, 0, &text);
+  EXPECT_EQ(text, Letters(0, 0, 0, 40));
+
+  size_t units = 0;
+  bool end = false;
+  EXPECT_FALSE(fetcher.ReadLobText(0, 10, &text, &units, &end, &error));
+}
+
+TEST_F(BlockFetcherTest, EndsCursorChunksAtLobRows) {
+  SQLHSTMT stmt = SQL_NULL_HSTMT;
+  SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt);
+  // Every other row is NULL, so only rows 0 and 2 hold a LOB.
+  ASSERT_TRUE(SQL_SUCCEEDED(
+      Run(stmt, "SELECT rows=3 cols=2 types=int,lob strlen=20000 nulls=2")));
+  ResultCursor cursor(stmt);
+  cursor.set_lob_threshold(100);
+  std::string error;
+  ASSERT_TRUE(cursor.Bind(&error)) << error;
+
+  ColumnarResult chunk;
+  ASSERT_TRUE(cursor.Fetch(10, 0, &chunk, &error)) << error;
+  ASSERT_EQ(chunk.row_count, 1u);
+  EXPECT_EQ(chunk.columns[1].lob_rows, std::vector<size_t>{0});
+  EXPECT_FALSE(cursor.done());
+  std::string text;
+  size_t units = 0;
+  bool end = false;
+  ASSERT_TRUE(cursor.lob()->ReadLobText(19998, 2, &text, &units, &end, &error))
+      << error;
+  EXPECT_EQ(text, Letters(0, 1, 19998, 2));
+  EXPECT_TRUE(end);
+
+  ASSERT_TRUE(cursor.Fetch(10, 0, &chunk, &error)) << error;
+  ASSERT_EQ(chunk.row_count, 2u);
+  EXPECT_EQ(chunk.columns[1].lob_rows, std::vector<size_t>{1});
+  ASSERT_TRUE(cursor.lob()->ReadLobText(0, 5, &text, &units, &end, &error))
+      << error;
+  EXPECT_EQ(text, Letters(2, 1, 0, 5));
+
+  ASSERT_TRUE(cursor.Fetch(10, 0, &chunk, &error)) << error;
+  EXPECT_EQ(chunk.row_count, 0u);
+  EXPECT_TRUE(cursor.done());
+}
+
+TEST_F(BlockFetcherTest, DecodesEachTypeAtItsLimits) {
+  // Row 0 holds each type's smallest value and row 1 its largest.
+  ASSERT_TRUE(SQL_SUCCEEDED(
+      Run("SELECT rows=2 cols=10 edges=1 types=int,double,bit,bigint,decimal,"
+          "numeric,datetime,date,time,guid")));
+  BlockFetcher fetcher(stmt_);
+  std::string error;
+  ASSERT_TRUE(fetcher.Bind(&error)) << error;
+  SQLULEN rows = 0;
+  ASSERT_TRUE(fetcher.Next(&rows, &error)) << error;
+  ASSERT_EQ(rows, 2u);
+
+  EXPECT_EQ(fetcher.cell_type(0), CellType::kInt32);
+  EXPECT_EQ(fetcher.GetInt32(0, 0), INT32_MIN);
+  EXPECT_EQ(fetcher.GetInt32(0, 1), INT32_MAX);
+  EXPECT_EQ(fetcher.cell_type(1), CellType::kDouble);
+  EXPECT_EQ(fetcher.GetDouble(1, 0), -DBL_MAX);
+  EXPECT_EQ(fetcher.GetDouble(1, 1), DBL_MAX);
+  EXPECT_EQ(fetcher.cell_type(2), CellType::kBool);
+  EXPECT_FALSE(fetcher.GetBool(2, 0));
+  EXPECT_TRUE(fetcher.GetBool(2, 1));
+  EXPECT_EQ(fetcher.cell_type(3), CellType::kInt64);
+  EXPECT_EQ(fetcher.GetInt64(3, 0), INT64_MIN);
+  EXPECT_EQ(fetcher.GetInt64(3, 1), INT64_MAX);
+
+  // decimal(18,4) fits in 64 bits once unscaled; numeric(38,4) does not.
+  EXPECT_EQ(fetcher.cell_type(4), CellType::kDecimal);
+  EXPECT_EQ(fetcher.decimal_scale(4), 4);
+  int64_t unscaled = 0;
+  ASSERT_TRUE(fetcher.GetDecimal(4, 0, &unscaled));
+  EXPECT_EQ(unscaled, -999999999999999999);
+  ASSERT_TRUE(fetcher.GetDecimal(4, 1, &unscaled));
+  EXPECT_EQ(unscaled, 999999999999999999);
+  EXPECT_EQ(Decimal(fetcher, 4, 1), "99999999999999.9999");
+  EXPECT_FALSE(fetcher.GetDecimal(5, 1, &unscaled));
+  EXPECT_EQ(Decimal(fetcher, 5, 0),
+            "-" + std::string(34, '9') + "." + std::string(4, '9'));
+  EXPECT_EQ(Decimal(fetcher, 5, 1),
+            std::string(34, '9') + "." + std::string(4, '9'));
+
+  // Microseconds since the epoch; 100 ns ticks are truncated.
+  const int64_t kYear1 = -62135596800LL * 1000000;
+  EXPECT_EQ(fetcher.cell_type(6), CellType::kDateTime);
+  EXPECT_EQ(fetcher.GetMicros(6, 0), kYear1);
+  EXPECT_EQ(fetcher.GetMicros(6, 1), 253402300799LL * 1000000 + 999999);
+  EXPECT_EQ(fetcher.cell_type(7), CellType::kDateTime);
+  EXPECT_EQ(fetcher.GetMicros(7, 0), kYear1);
+  EXPECT_EQ(fetcher.GetMicros(7, 1), 253402214400LL * 1000000);
+  EXPECT_EQ(fetcher.cell_type(8), CellType::kTime);
+  EXPECT_EQ(fetcher.GetMicros(8, 0), 0);
+  EXPECT_EQ(fetcher.GetMicros(8, 1), 86399LL * 1000000 + 999999);
+
+  EXPECT_EQ(fetcher.cell_type(9), CellType::kGuid);
+  EXPECT_EQ(Guid(fetcher, 9, 0), std::vector<uint8_t>(16, 0x00));
+  EXPECT_EQ(Guid(fetcher, 9, 1), std::vector<uint8_t>(16, 0xFF));
+}
+
+TEST_F(BlockFetcherTest, ReadsTypedColumnsIntoColumnarResults) {
+  ASSERT_TRUE(SQL_SUCCEEDED(
+      Run("SELECT rows=3 cols=5 types=decimal,numeric,datetime,time,guid")));
+  BlockFetcher fetcher(stmt_);
+  std::string error;
+  ASSERT_TRUE(fetcher.Bind(&error)) << error;
+  ColumnarResult result;
+  ASSERT_TRUE(ReadColumnar(&fetcher, &result, &error)) << error;
+  ASSERT_EQ(result.row_count, 3u);
+
+  // The scale set on the ARD is used; the driver would otherwise drop the
+  // fraction. Row 1 is negative.
+  const ResultColumn& decimal = result.columns[0];
+  EXPECT_FALSE(decimal.decimal_text);
+  EXPECT_EQ(decimal.scale, 4);
+  EXPECT_EQ(decimal.ints, (std::vector<int64_t>{0, -1234567, 2469134}));
+
+  // Precision above 18 is kept as exact text.
+  const ResultColumn& numeric = result.columns[1];
+  EXPECT_TRUE(numeric.decimal_text);
+  ASSERT_EQ(numeric.strings.size(), 3u);
+  EXPECT_EQ(numeric.strings[0], "0.0002");
+  EXPECT_EQ(numeric.strings[1], "-1844674407370955.1618");  // -(2^64 + 2)
+
+  // 2024-01-01 00:00:00 plus 61 s and 1 ms per row, plus the column.
+  const int64_t kBase = 1704067200LL * 1000000;
+  EXPECT_EQ(result.columns[2].ints[1], kBase + 63 * 1000000 + 1000);
+  // time(7): 37 s per row plus the column; 100 ns per row is truncated.
+  EXPECT_EQ(result.columns[3].ints[2], 77 * 1000000);
+
+  // Data1, Data2 and Data3 most significant byte first, then Data4.
+  ASSERT_EQ(result.columns[4].binaries.size(), 3u);
+  EXPECT_EQ(result.columns[4].binaries[1],
+            (std::vector<uint8_t>{0x00, 0x00, 0x00, 0x01, 0x00, 0x04, 0x40,
+                                  0x01, 1, 2, 3, 4, 5, 6, 7, 8}));
+}
+
+TEST_F(BlockFetcherTest, ReadsUnboundDecimalsWithTheArdScale) {
+  // The LOB leaves the decimal after it to SQLGetData.
+  ASSERT_TRUE(
+      SQL_SUCCEEDED(Run("SELECT rows=2 cols=2 types=lob,decimal strlen=10")));
+  BlockFetcher fetcher(stmt_);
+  std::string error;
+  ASSERT_TRUE(fetcher.Bind(&error)) << error;
+  ColumnarResult result;
+  ASSERT_TRUE(ReadColumnar(&fetcher, &result, &error)) << error;
+  EXPECT_EQ(result.columns[1].ints, (std::vector<int64_t>{1, -1234568}));
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+
+#include "columnar_result.h"
+
+namespace mssql_connect {
+namespace test {
+
+std::string ScaledDecimal(int64_t unscaled, int scale) {
+  std::string text;
+  AppendScaledDecimal(unscaled, scale, &text);
+  return text;
+}
+
+TEST(AppendScaledDecimal, PlacesThePoint) {
+  EXPECT_EQ(ScaledDecimal(123400, 4), "12.3400");
+  EXPECT_EQ(ScaledDecimal(-123400, 4), "-12.3400");
+  EXPECT_EQ(ScaledDecimal(42, 0), "42");
+}
+
+TEST(AppendScaledDecimal, PadsSmallValues) {
+  EXPECT_EQ(ScaledDecimal(12, 4), "0.0012");
+  EXPECT_EQ(ScaledDecimal(-5, 2), "-0.05");
+  EXPECT_EQ(ScaledDecimal(0, 2), "0.00");
+}
+
+TEST(AppendScaledDecimal, HandlesExtremes) {
+  EXPECT_EQ(ScaledDecimal(INT64_MIN, 0), "-9223372036854775808");
+  EXPECT_EQ(ScaledDecimal(INT64_MAX, 18), "9.223372036854775807");
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,343 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connection_pool.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// Hands out fake handles and records what the pool does with them.
+class FakeFactory : public ConnectionPool::Factory {
+ public:
+  struct State {
+    std::atomic<int> opened{0};
+    std::atomic<int> closed{0};
+    std::atomic<bool> fail_open{false};
+    std::set<ConnectionPool::Handle> dead;
+  };
+
+  explicit FakeFactory(State* state) : state_(state) {}
+
+  ConnectionPool::Handle Open(std::string* error) override {
+    if (state_->fail_open) {
+      *error = "login failed";
+      return nullptr;
+    }
+    return reinterpret_cast<ConnectionPool::Handle>(
+        static_cast<intptr_t>(++state_->opened));
+  }
+
+  bool IsAlive(ConnectionPool::Handle handle) override {
+    return state_->dead.count(handle) == 0;
+  }
+
+  void Close(ConnectionPool::Handle handle) override { ++state_->closed; }
+
+ private:
+  State* state_;
+};
+
+ConnectionPoolOptions SmallPool() {
+  ConnectionPoolOptions options;
+  options.max_size = 2;
+  options.acquire_timeout = std::chrono::milliseconds(50);
+  return options;
+}
+
+}  // namespace
+
+TEST(NormalizeConnectionString, IgnoresKeyOrderCaseAndWhitespace) {
+  EXPECT_EQ(NormalizeConnectionString("SERVER=db;Database=app;UID=sa"),
+            NormalizeConnectionString(" uid=sa ; DATABASE = app;server=db;"));
+}
+
+TEST(NormalizeConnectionString, KeepsBracedValuesIntact) {
+  EXPECT_EQ(NormalizeConnectionString(
+                "DRIVER={ODBC Driver 18 for SQL Server};PWD={a;b}"),
+            "driver={ODBC Driver 18 for SQL Server};pwd={a;b};");
+}
+
+TEST(NormalizeConnectionString, KeepsValueCase) {
+  EXPECT_NE(NormalizeConnectionString("PWD=Secret"),
+            NormalizeConnectionString("PWD=secret"));
+}
+
+TEST(ConnectionPool, ReusesReleasedConnections) {
+  FakeFactory::State state;
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), SmallPool());
+
+  std::string error;
+  ConnectionPool::Handle first = pool.Acquire(&error);
+  ASSERT_NE(first, nullptr);
+  pool.Release(first);
+  ConnectionPool::Handle second = pool.Acquire(&error);
+  EXPECT_EQ(second, first);
+  pool.Release(second);
+
+  ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(stats.creations, 1u);
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.idle, 1u);
+  EXPECT_EQ(stats.in_use, 0u);
+}
+
+TEST(ConnectionPool, TimesOutWhenExhausted) {
+  FakeFactory::State state;
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), SmallPool());
+
+  std::string error;
+  ConnectionPool::Handle a = pool.Acquire(&error);
+  ConnectionPool::Handle b = pool.Acquire(&error);
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  EXPECT_EQ(pool.Acquire(&error), nullptr);
+  EXPECT_FALSE(error.empty());
+
+  ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(stats.waits, 1u);
+  EXPECT_EQ(stats.timeouts, 1u);
+  pool.Release(a);
+  pool.Release(b);
+}
+
+TEST(ConnectionPool, WaiterGetsReleasedConnection) {
+  FakeFactory::State state;
+  ConnectionPoolOptions options = SmallPool();
+  options.max_size = 1;
+  options.acquire_timeout = std::chrono::seconds(5);
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), options);
+
+  std::string error;
+  ConnectionPool::Handle held = pool.Acquire(&error);
+  std::thread releaser([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pool.Release(held);
+  });
+  ConnectionPool::Handle waited = pool.Acquire(&error);
+  releaser.join();
+  EXPECT_EQ(waited, held);
+  EXPECT_EQ(pool.stats().waits, 1u);
+  pool.Release(waited);
+}
+
+TEST(ConnectionPool, ReplacesDeadConnections) {
+  FakeFactory::State state;
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), SmallPool());
+
+  std::string error;
+  ConnectionPool::Handle first = pool.Acquire(&error);
+  pool.Release(first);
+  state.dead.insert(first);
+
+  ConnectionPool::Handle second = pool.Acquire(&error);
+  EXPECT_NE(second, first);
+  EXPECT_EQ(pool.stats().dead_evictions, 1u);
+  EXPECT_EQ(state.closed, 1);
+  pool.Release(second);
+}
+
+TEST(ConnectionPool, EvictsIdleConnectionsAboveMinimum) {
+  FakeFactory::State state;
+  ConnectionPoolOptions options = SmallPool();
+  options.min_size = 1;
+  options.idle_timeout = std::chrono::milliseconds(0);
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), options);
+
+  pool.Prewarm();
+  EXPECT_EQ(pool.stats().idle, 1u);
+
+  std::string error;
+  ConnectionPool::Handle a = pool.Acquire(&error);
+  ConnectionPool::Handle b = pool.Acquire(&error);
+  pool.Release(a);
+  pool.Release(b);
+  pool.EvictExpired();
+
+  ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(stats.idle, 1u);
+  EXPECT_EQ(stats.idle_evictions, 1u);
+}
+
+TEST(ConnectionPool, ClosesConnectionsPastMaxLifetime) {
+  FakeFactory::State state;
+  ConnectionPoolOptions options = SmallPool();
+  options.max_lifetime = std::chrono::milliseconds(1);
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), options);
+
+  std::string error;
+  ConnectionPool::Handle handle = pool.Acquire(&error);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  pool.Release(handle);
+
+  ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(stats.lifetime_evictions, 1u);
+  EXPECT_EQ(stats.idle, 0u);
+  EXPECT_EQ(state.closed, 1);
+}
+
+TEST(ConnectionPool, FailedOpenFreesItsSlot) {
+  FakeFactory::State state;
+  state.fail_open = true;
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), SmallPool());
+
+  std::string error;
+  EXPECT_EQ(pool.Acquire(&error), nullptr);
+  EXPECT_EQ(error, "login failed");
+  EXPECT_EQ(pool.stats().creation_failures, 1u);
+
+  state.fail_open = false;
+  ConnectionPool::Handle handle = pool.Acquire(&error);
+  EXPECT_NE(handle, nullptr);
+  pool.Release(handle);
+}
+
+TEST(ConnectionPool, QueuesAsyncAcquiresUntilRelease) {
+  FakeFactory::State state;
+  ConnectionPoolOptions options = SmallPool();
+  options.max_size = 1;
+  options.acquire_timeout = std::chrono::seconds(5);
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), options);
+
+  // More waiters than connections; none of them blocks.
+  std::vector<ConnectionPool::Handle> acquired;
+  for (int i = 0; i < 4; ++i) {
+    pool.AcquireAsync(nullptr, [&](ConnectionPool::Handle handle,
+                                   const std::string& error) {
+      EXPECT_TRUE(error.empty());
+      acquired.push_back(handle);
+    });
+  }
+  ASSERT_EQ(acquired.size(), 1u);
+  EXPECT_EQ(pool.stats().waiting, 3u);
+  EXPECT_EQ(pool.stats().waits, 3u);
+
+  // Each release hands the connection straight to the next waiter.
+  for (size_t i = 1; i < 4; ++i) {
+    pool.Release(acquired.back());
+    ASSERT_EQ(acquired.size(), i + 1);
+    EXPECT_EQ(acquired.back(), acquired.front());
+  }
+  pool.Release(acquired.back());
+
+  ConnectionPoolStats stats = pool.stats();
+  EXPECT_EQ(stats.creations, 1u);
+  EXPECT_EQ(stats.waiting, 0u);
+  EXPECT_EQ(stats.idle, 1u);
+}
+
+TEST(ConnectionPool, TimesOutQueuedAcquires) {
+  FakeFactory::State state;
+  ConnectionPoolOptions options = SmallPool();
+  options.max_size = 1;
+  options.acquire_timeout = std::chrono::milliseconds(0);
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), options);
+
+  std::string error;
+  ConnectionPool::Handle held = pool.Acquire(&error);
+  ASSERT_NE(held, nullptr);
+  std::string waiter_error;
+  bool called = false;
+  pool.AcquireAsync(nullptr, [&](ConnectionPool::Handle handle,
+                                 const std::string& error) {
+    called = true;
+    EXPECT_EQ(handle, nullptr);
+    waiter_error = error;
+  });
+  EXPECT_FALSE(called);
+
+  pool.EvictExpired();
+  EXPECT_TRUE(called);
+  EXPECT_EQ(waiter_error, "Timed out waiting for a pooled connection");
+  EXPECT_EQ(pool.stats().timeouts, 1u);
+  pool.Release(held);
+}
+
+TEST(ConnectionPool, CancelsWaitersOfOneOwner) {
+  FakeFactory::State state;
+  ConnectionPoolOptions options = SmallPool();
+  options.max_size = 1;
+  options.acquire_timeout = std::chrono::seconds(5);
+  ConnectionPool pool(std::make_unique<FakeFactory>(&state), options);
+
+  std::string error;
+  ConnectionPool::Handle held = pool.Acquire(&error);
+  int leaving = 0;
+  int staying = 0;
+  std::string cancel_error;
+  ConnectionPool::Handle replacement = nullptr;
+  pool.AcquireAsync(&leaving, [&](ConnectionPool::Handle handle,
+                                  const std::string& error) {
+    ++leaving;
+    EXPECT_EQ(handle, nullptr);
+    cancel_error = error;
+  });
+  pool.AcquireAsync(&staying, [&](ConnectionPool::Handle handle,
+                                  const std::string&) {
+    ++staying;
+    replacement = handle;
+  });
+
+  pool.CancelWaiters(&leaving);
+  EXPECT_EQ(leaving, 1);
+  EXPECT_FALSE(cancel_error.empty());
+  EXPECT_EQ(staying, 0);
+
+  // A discarded connection's slot opens a new one for the next waiter.
+  pool.Discard(held);
+  EXPECT_EQ(staying, 1);
+  EXPECT_NE(replacement, nullptr);
+  EXPECT_NE(replacement, held);
+  EXPECT_EQ(pool.stats().creations, 2u);
+  pool.Release(replacement);
+}
+
+TEST(ConnectionPoolRegistry, ReturnsOnePoolPerKey) {
+  FakeFactory::State state;
+  ConnectionPoolRegistry registry;
+  int created = 0;
+  auto create = [&]() {
+    ++created;
+    return std::make_shared<ConnectionPool>(
+        std::make_unique<FakeFactory>(&state), SmallPool());
+  };
+  std::shared_ptr<ConnectionPool> pool = registry.GetOrCreate("a", "app@db", create);
+  EXPECT_EQ(registry.GetOrCreate("a", "app@db", create), pool);
+  EXPECT_NE(registry.GetOrCreate("b", "app@other", create), pool);
+  EXPECT_EQ(created, 2);
+  EXPECT_EQ(registry.Snapshot().size(), 2u);
+}
+
+TEST(ConnectionPoolRegistry, SweepsIdleConnectionsOfQuietPools) {
+  FakeFactory::State state;
+  ConnectionPoolRegistry registry(std::chrono::milliseconds(5));
+  ConnectionPoolOptions options = SmallPool();
+  options.idle_timeout = std::chrono::milliseconds(20);
+  std::shared_ptr<ConnectionPool> pool = registry.GetOrCreate("a", "app@db", [&]() {
+    return std::make_shared<ConnectionPool>(std::make_unique<FakeFactory>(&state),
+                                            options);
+  });
+
+  std::string error;
+  pool->Release(pool->Acquire(&error));
+  EXPECT_EQ(pool->stats().idle, 1u);
+
+  // Nothing touches the pool again; the registry's sweeps close the
+  // connection.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (state.closed == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(state.closed, 1);
+  EXPECT_EQ(pool->stats().idle_evictions, 1u);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "ffi_api.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// Runs against the synthetic driver, like session_test.cc.
+class FfiApiTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(mssql_open("localhost", "test", "", "", 0, &connection_), MSSQL_OK)
+        << mssql_errmsg(connection_);
+  }
+
+  void TearDown() override { mssql_close(connection_); }
+
+  mssql_statement* Prepare(const char* sql, int64_t timeout_ms = 0) {
+    mssql_statement* statement = nullptr;
+    EXPECT_EQ(mssql_prepare(connection_, sql, timeout_ms, &statement), MSSQL_OK)
+        << mssql_errmsg(connection_);
+    return statement;
+  }
+
+  mssql_connection* connection_ = nullptr;
+};
+
+}  // namespace
+
+TEST_F(FfiApiTest, StepsThroughRows) {
+  mssql_statement* statement =
+      Prepare("SELECT rows=300 cols=2 types=int,text strlen=3 nulls=100");
+  ASSERT_NE(statement, nullptr);
+
+  int rows = 0;
+  while (mssql_step(statement) == MSSQL_ROW) {
+    if (rows == 0) {
+      ASSERT_EQ(mssql_column_count(statement), 2);
+      EXPECT_STREQ(mssql_column_name(statement, 0), "c1");
+      EXPECT_EQ(mssql_column_type(statement, 0), MSSQL_TYPE_INT);
+      EXPECT_EQ(mssql_column_type(statement, 1), MSSQL_TYPE_TEXT);
+    }
+    if (rows % 100 == 99) {
+      EXPECT_TRUE(mssql_column_is_null(statement, 1));
+      EXPECT_EQ(mssql_column_text(statement, 1, nullptr), nullptr);
+    } else {
+      EXPECT_FALSE(mssql_column_is_null(statement, 0));
+      EXPECT_EQ(mssql_column_int64(statement, 0), rows);
+      EXPECT_EQ(mssql_column_double(statement, 0), rows);
+      int32_t length = 0;
+      const char* text = mssql_column_text(statement, 1, &length);
+      ASSERT_NE(text, nullptr);
+      EXPECT_EQ(length, 3);
+      EXPECT_EQ(text[0], 'a' + (rows + 1) % 26);
+    }
+    ++rows;
+  }
+  // Spans more than one rowset.
+  EXPECT_EQ(rows, 300);
+  EXPECT_EQ(mssql_step(statement), MSSQL_DONE);
+  EXPECT_STREQ(mssql_errcode(connection_), "");
+  mssql_finalize(statement);
+}
+
+TEST_F(FfiApiTest, BindsAndReruns) {
+  mssql_statement* statement = Prepare("SELECT rows=2 cols=1 types=int");
+  ASSERT_NE(statement, nullptr);
+  EXPECT_EQ(mssql_bind_int64(statement, 1, 42), MSSQL_OK);
+  EXPECT_EQ(mssql_bind_text(statement, 3, "name", -1), MSSQL_OK);
+  EXPECT_EQ(mssql_bind_blob(statement, 2, "\x01\x02", 2), MSSQL_OK);
+  EXPECT_EQ(mssql_bind_int64(statement, 0, 1), MSSQL_MISUSE);
+
+  EXPECT_EQ(mssql_step(statement), MSSQL_ROW);
+  EXPECT_EQ(mssql_bind_null(statement, 1), MSSQL_MISUSE);
+  EXPECT_EQ(mssql_reset(statement), MSSQL_OK);
+  EXPECT_EQ(mssql_bind_double(statement, 1, 1.5), MSSQL_OK);
+  EXPECT_EQ(mssql_step(statement), MSSQL_ROW);
+  EXPECT_EQ(mssql_step(statement), MSSQL_ROW);
+  EXPECT_EQ(mssql_step(statement), MSSQL_DONE);
+  mssql_finalize(statement);
+}
+
+TEST_F(FfiApiTest, ReportsChanges) {
+  mssql_statement* statement = Prepare("INSERT rows=5 cols=0");
+  ASSERT_NE(statement, nullptr);
+  EXPECT_EQ(mssql_step(statement), MSSQL_DONE);
+  EXPECT_EQ(mssql_changes(statement), 5);
+  EXPECT_EQ(mssql_column_count(statement), 0);
+  mssql_finalize(statement);
+}
+
+TEST_F(FfiApiTest, ReadsBinaryAndGuidCells) {
+  mssql_statement* statement =
+      Prepare("SELECT rows=1 cols=2 types=bin,guid strlen=4");
+  ASSERT_NE(statement, nullptr);
+  ASSERT_EQ(mssql_step(statement), MSSQL_ROW);
+  int32_t length = 0;
+  EXPECT_NE(mssql_column_blob(statement, 0, &length), nullptr);
+  EXPECT_EQ(length, 4);
+  EXPECT_NE(mssql_column_blob(statement, 1, &length), nullptr);
+  EXPECT_EQ(length, 16);
+  EXPECT_EQ(mssql_column_text(statement, 1, nullptr), nullptr);
+  mssql_finalize(statement);
+}
+
+TEST_F(FfiApiTest, ReportsTimeouts) {
+  mssql_statement* statement = Prepare("SELECT rows=1 latency=5000000", 1000);
+  ASSERT_NE(statement, nullptr);
+  EXPECT_EQ(mssql_step(statement), MSSQL_ERROR);
+  EXPECT_STREQ(mssql_errcode(connection_), "Timeout");
+  EXPECT_NE(std::string(mssql_errmsg(connection_)), "");
+  // Failed until reset.
+  EXPECT_EQ(mssql_step(statement), MSSQL_DONE);
+  mssql_finalize(statement);
+}
+
+TEST_F(FfiApiTest, RejectsMisuse) {
+  mssql_statement* statement = nullptr;
+  EXPECT_EQ(mssql_prepare(connection_, "", 0, &statement), MSSQL_MISUSE);
+  EXPECT_EQ(mssql_step(nullptr), MSSQL_MISUSE);
+  EXPECT_EQ(mssql_column_count(nullptr), 0);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,132 @@
+#include <flutter_linux/flutter_linux.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fl_value_adapter.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// Two rows of an int and a text column; the text is NULL in the second.
+ColumnarResult SampleResult() {
+  ColumnarResult result;
+  result.row_count = 2;
+  ResultColumn id;
+  id.name = "id";
+  id.type = CellType::kInt64;
+  id.ints = {1, 2};
+  ResultColumn name;
+  name.name = "name";
+  name.type = CellType::kText;
+  name.strings = {"alice", ""};
+  name.null_bitmap = {0x02};
+  result.columns.push_back(id);
+  result.columns.push_back(name);
+  return result;
+}
+
+}  // namespace
+
+TEST(FlValueAdapter, ReadsMapArguments) {
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "server", fl_value_new_string("db"));
+  fl_value_set_string_take(args, "loginTimeoutMs", fl_value_new_int(1500));
+  fl_value_set_string_take(args, "utf8Text", fl_value_new_bool(true));
+  fl_value_set_string_take(args, "statementCacheSize", fl_value_new_int(-1));
+
+  EXPECT_EQ(GetStringFromMap(args, "server"), "db");
+  EXPECT_EQ(GetStringFromMap(args, "loginTimeoutMs"), "");
+  EXPECT_EQ(GetIntFromMap(args, "missing", 7), 7);
+  EXPECT_EQ(GetIntFromMap(nullptr, "server", 3), 3);
+
+  ConnectOptions options = ReadConnectOptions(args);
+  EXPECT_EQ(options.server, "db");
+  EXPECT_EQ(options.login_timeout, 2u);
+  EXPECT_TRUE(options.utf8_text);
+  EXPECT_EQ(options.statement_cache_size, 0u);
+}
+
+TEST(FlValueAdapter, ReadsParameters) {
+  const uint8_t bytes[] = {1, 2, 3};
+  g_autoptr(FlValue) args = fl_value_new_map();
+  FlValue* list = fl_value_new_list();
+  fl_value_append_take(list, fl_value_new_null());
+  fl_value_append_take(list, fl_value_new_bool(true));
+  fl_value_append_take(list, fl_value_new_int(42));
+  fl_value_append_take(list, fl_value_new_float(1.5));
+  fl_value_append_take(list, fl_value_new_string("text"));
+  fl_value_append_take(list, fl_value_new_uint8_list(bytes, 3));
+  fl_value_set_string_take(args, "parameters", list);
+
+  std::vector<SqlParameter> params;
+  std::string error;
+  ASSERT_TRUE(ReadParameters(args, &params, &error)) << error;
+  ASSERT_EQ(params.size(), 6u);
+  EXPECT_EQ(params[0].type, SqlParameter::Type::kNull);
+  EXPECT_TRUE(params[1].bool_value);
+  EXPECT_EQ(params[2].int_value, 42);
+  EXPECT_EQ(params[3].double_value, 1.5);
+  EXPECT_EQ(params[4].text, "text");
+  EXPECT_EQ(params[5].bytes, std::vector<uint8_t>({1, 2, 3}));
+}
+
+TEST(FlValueAdapter, RejectsUnsupportedParameters) {
+  g_autoptr(FlValue) args = fl_value_new_map();
+  FlValue* list = fl_value_new_list();
+  fl_value_append_take(list, fl_value_new_int(1));
+  fl_value_append_take(list, fl_value_new_map());
+  fl_value_set_string_take(args, "parameters", list);
+
+  std::vector<SqlParameter> params;
+  std::string error;
+  EXPECT_FALSE(ReadParameters(args, &params, &error));
+  EXPECT_EQ(error, "Unsupported type for parameter 2");
+}
+
+TEST(FlValueAdapter, EncodesRows) {
+  g_autoptr(FlValue) reply = EncodeRows(SampleResult());
+
+  EXPECT_EQ(fl_value_get_int(fl_value_lookup_string(reply, "rowCount")), 2);
+  FlValue* types = fl_value_lookup_string(reply, "columnTypes");
+  EXPECT_STREQ(fl_value_get_string(fl_value_get_list_value(types, 0)), "int");
+  EXPECT_STREQ(fl_value_get_string(fl_value_get_list_value(types, 1)), "string");
+
+  FlValue* rows = fl_value_lookup_string(reply, "rows");
+  ASSERT_EQ(fl_value_get_length(rows), 2u);
+  FlValue* first = fl_value_get_list_value(rows, 0);
+  EXPECT_EQ(fl_value_get_int(fl_value_lookup_string(first, "id")), 1);
+  EXPECT_STREQ(fl_value_get_string(fl_value_lookup_string(first, "name")),
+               "alice");
+  FlValue* second = fl_value_get_list_value(rows, 1);
+  EXPECT_EQ(fl_value_get_type(fl_value_lookup_string(second, "name")),
+            FL_VALUE_TYPE_NULL);
+}
+
+TEST(FlValueAdapter, EncodesColumns) {
+  g_autoptr(FlValue) reply = EncodeColumnar(SampleResult());
+
+  EXPECT_STREQ(fl_value_get_string(fl_value_lookup_string(reply, "format")),
+               "columnar");
+  FlValue* data = fl_value_lookup_string(reply, "columnData");
+  FlValue* ids = fl_value_get_list_value(data, 0);
+  ASSERT_EQ(fl_value_get_type(ids), FL_VALUE_TYPE_INT64_LIST);
+  EXPECT_EQ(fl_value_get_int64_list(ids)[1], 2);
+  FlValue* names = fl_value_get_list_value(data, 1);
+  ASSERT_EQ(fl_value_get_type(names), FL_VALUE_TYPE_LIST);
+  EXPECT_STREQ(fl_value_get_string(fl_value_get_list_value(names, 0)), "alice");
+
+  FlValue* nulls = fl_value_lookup_string(reply, "nulls");
+  EXPECT_EQ(fl_value_get_type(fl_value_get_list_value(nulls, 0)),
+            FL_VALUE_TYPE_NULL);
+  FlValue* name_nulls = fl_value_get_list_value(nulls, 1);
+  ASSERT_EQ(fl_value_get_type(name_nulls), FL_VALUE_TYPE_UINT8_LIST);
+  EXPECT_EQ(fl_value_get_uint8_list(name_nulls)[0], 0x02);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "lru_cache.h"
+
+namespace mssql_connect {
+namespace test {
+
+TEST(LruCache, EvictsLeastRecentlyUsed) {
+  LruCache<std::string, int> cache(2);
+  EXPECT_EQ(cache.Put("a", 1), 0u);
+  EXPECT_EQ(cache.Put("b", 2), 0u);
+  ASSERT_NE(cache.Get("a"), nullptr);  // "b" is now the oldest.
+  EXPECT_EQ(cache.Put("c", 3), 1u);
+
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.Get("b"), nullptr);
+  EXPECT_EQ(*cache.Get("a"), 1);
+  EXPECT_EQ(*cache.Get("c"), 3);
+}
+
+TEST(LruCache, PutReplacesExisting) {
+  LruCache<std::string, int> cache(2);
+  cache.Put("a", 1);
+  cache.Put("b", 2);
+  EXPECT_EQ(cache.Put("a", 10), 0u);
+  cache.Put("c", 3);
+
+  EXPECT_EQ(*cache.Get("a"), 10);
+  EXPECT_EQ(cache.Get("b"), nullptr);
+}
+
+TEST(LruCache, TakeRemovesEntry) {
+  LruCache<std::string, std::unique_ptr<int>> cache(4);
+  cache.Put("a", std::unique_ptr<int>(new int(7)));
+
+  std::unique_ptr<int> value;
+  ASSERT_TRUE(cache.Take("a", &value));
+  EXPECT_EQ(*value, 7);
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_FALSE(cache.Take("a", &value));
+}
+
+TEST(LruCache, ZeroCapacityKeepsNothing) {
+  LruCache<int, int> cache(0);
+  EXPECT_EQ(cache.Put(1, 1), 1u);
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.Get(1), nullptr);
+}
+
+TEST(LruCache, EraseAndClear) {
+  LruCache<int, int> cache(3);
+  cache.Put(1, 1);
+  cache.Put(2, 2);
+  EXPECT_TRUE(cache.Erase(1));
+  EXPECT_FALSE(cache.Erase(1));
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0u);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
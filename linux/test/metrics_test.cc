@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "metrics.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// Turns collection on for one test and off again after it.
+class MetricsTest : public ::testing::Test {
+ protected:
+  void SetUp() override { Metrics::set_enabled(true); }
+  void TearDown() override { Metrics::set_enabled(false); }
+};
+
+}  // namespace
+
+TEST(LatencyHistogram, BucketsCoverEveryValue) {
+  EXPECT_EQ(LatencyHistogram::BucketIndex(0), 0u);
+  EXPECT_EQ(LatencyHistogram::BucketIndex(7), 7u);
+  EXPECT_EQ(LatencyHistogram::BucketIndex(8), 8u);
+  EXPECT_EQ(LatencyHistogram::BucketIndex(UINT64_MAX), kLatencyBucketCount - 1);
+  EXPECT_EQ(LatencyHistogram::BucketUpperBound(kLatencyBucketCount - 1),
+            UINT64_MAX);
+
+  // Every bucket starts right after the previous one ends.
+  for (size_t i = 1; i < kLatencyBucketCount; ++i) {
+    uint64_t first = LatencyHistogram::BucketUpperBound(i - 1) + 1;
+    EXPECT_EQ(LatencyHistogram::BucketIndex(first), i);
+    EXPECT_EQ(LatencyHistogram::BucketIndex(LatencyHistogram::BucketUpperBound(i)), i);
+  }
+}
+
+TEST(LatencyHistogram, ReportsPercentiles) {
+  LatencyHistogram histogram;
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    histogram.Record(i * 1000);
+  }
+  HistogramSnapshot snapshot = histogram.Snapshot();
+  EXPECT_EQ(snapshot.count, 1000u);
+  EXPECT_EQ(snapshot.max_ns, 1000000u);
+  EXPECT_EQ(snapshot.total_ns, 500500000u);
+
+  // Within the 1/8 bucket width above the exact value.
+  uint64_t p50 = snapshot.ValueAtPercentile(50);
+  EXPECT_GE(p50, 500000u);
+  EXPECT_LE(p50, 500000u + 500000u / 8);
+  uint64_t p99 = snapshot.ValueAtPercentile(99);
+  EXPECT_GE(p99, 990000u);
+  EXPECT_LE(p99, 1000000u);
+  EXPECT_EQ(snapshot.ValueAtPercentile(100), 1000000u);
+
+  histogram.Reset();
+  EXPECT_EQ(histogram.Snapshot().count, 0u);
+  EXPECT_EQ(histogram.Snapshot().ValueAtPercentile(50), 0u);
+}
+
+TEST_F(MetricsTest, ForwardsToParent) {
+  Metrics parent;
+  Metrics child(&parent);
+  child.CountCall(CallKind::kQuery);
+  child.CountError(CallKind::kQuery);
+  child.AddRows(3);
+  child.AddBytes(100);
+  child.Record(Phase::kFetch, std::chrono::microseconds(5));
+
+  MetricsSnapshot snapshot = parent.Snapshot();
+  EXPECT_EQ(snapshot.calls[static_cast<size_t>(CallKind::kQuery)], 1u);
+  EXPECT_EQ(snapshot.errors[static_cast<size_t>(CallKind::kQuery)], 1u);
+  EXPECT_EQ(snapshot.rows, 3u);
+  EXPECT_EQ(snapshot.bytes, 100u);
+  EXPECT_EQ(snapshot.phases[static_cast<size_t>(Phase::kFetch)].total_ns, 5000u);
+
+  child.Reset();
+  EXPECT_EQ(child.Snapshot().rows, 0u);
+  EXPECT_EQ(parent.Snapshot().rows, 3u);
+}
+
+TEST_F(MetricsTest, RecordsNothingWhileDisabled) {
+  Metrics metrics;
+  Metrics::set_enabled(false);
+  metrics.CountCall(CallKind::kExecute);
+  metrics.AddRows(1);
+  {
+    PhaseTimer timer(&metrics, Phase::kExecute);
+    EXPECT_EQ(timer.Stop().count(), 0);
+  }
+  Metrics::set_enabled(true);
+  {
+    PhaseTimer timer(&metrics, Phase::kExecute);
+  }
+
+  MetricsSnapshot snapshot = metrics.Snapshot();
+  EXPECT_EQ(snapshot.calls[static_cast<size_t>(CallKind::kExecute)], 0u);
+  EXPECT_EQ(snapshot.rows, 0u);
+  EXPECT_EQ(snapshot.phases[static_cast<size_t>(Phase::kExecute)].count, 1u);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
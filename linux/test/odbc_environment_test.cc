@@ -0,0 +1,125 @@
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "odbc_environment.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+size_t OpenFileDescriptorCount() {
+  size_t count = 0;
+  DIR* dir = opendir("/proc/self/fd");
+  if (!dir) {
+    return 0;
+  }
+  while (readdir(dir)) {
+    ++count;
+  }
+  closedir(dir);
+  return count;
+}
+
+size_t ResidentSetBytes() {
+  long pages = 0;
+  long resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (!statm) {
+    return 0;
+  }
+  if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(statm);
+  return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Opens and closes one connection the way the plugin does. Connects for real
+// when MSSQL_CONNECT_TEST_CONNECTION_STRING names a reachable server;
+// otherwise only exercises the environment and connection handles.
+void OpenAndClose(const char* connection_string) {
+  std::string error;
+  std::shared_ptr<OdbcEnvironment> environment = OdbcEnvironment::Get(&error);
+  ASSERT_TRUE(environment) << error;
+  SQLHDBC dbc = environment->AllocConnection(&error);
+  ASSERT_TRUE(dbc != SQL_NULL_HDBC) << error;
+  if (connection_string) {
+    SQLRETURN ret = SQLDriverConnect(dbc, nullptr, (SQLCHAR*)connection_string,
+                                     SQL_NTS, nullptr, 0, nullptr,
+                                     SQL_DRIVER_NOPROMPT);
+    ASSERT_TRUE(SQL_SUCCEEDED(ret));
+    SQLDisconnect(dbc);
+  }
+  environment->FreeConnection(dbc);
+}
+
+}  // namespace
+
+TEST(OdbcEnvironment, IsSharedAndFreedWithLastReference) {
+  // Other tests in the runner may leave an environment alive, so counts are
+  // checked relative to the start. Get() adds at most the one it creates.
+  const size_t before = OdbcEnvironment::live_environments();
+  std::shared_ptr<OdbcEnvironment> first = OdbcEnvironment::Get(nullptr);
+  std::shared_ptr<OdbcEnvironment> second = OdbcEnvironment::Get(nullptr);
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first, second);
+  EXPECT_GE(OdbcEnvironment::live_environments(), 1u);
+  EXPECT_LE(OdbcEnvironment::live_environments(), before + 1);
+  first.reset();
+  second.reset();
+  EXPECT_EQ(OdbcEnvironment::live_environments(), before);
+}
+
+TEST(OdbcEnvironment, PoolingKeepsEnvironmentAlive) {
+  const size_t before = OdbcEnvironment::live_environments();
+  OdbcEnvironmentOptions options;
+  options.connection_pooling = true;
+  OdbcEnvironment::Configure(options);
+  {
+    std::shared_ptr<OdbcEnvironment> environment = OdbcEnvironment::Get(nullptr);
+    ASSERT_TRUE(environment);
+    EXPECT_TRUE(environment->connection_pooling());
+  }
+  EXPECT_EQ(OdbcEnvironment::live_environments(), before + 1);
+
+  OdbcEnvironment::Configure(OdbcEnvironmentOptions());
+  EXPECT_EQ(OdbcEnvironment::live_environments(), before);
+  std::shared_ptr<OdbcEnvironment> environment = OdbcEnvironment::Get(nullptr);
+  ASSERT_TRUE(environment);
+  EXPECT_FALSE(environment->connection_pooling());
+}
+
+// Opens and closes 10k connections and checks that ODBC handles, file
+// descriptors and resident memory do not grow with the iteration count.
+TEST(OdbcEnvironment, SoakOpenCloseStaysFlat) {
+  const char* connection_string =
+      std::getenv("MSSQL_CONNECT_TEST_CONNECTION_STRING");
+  const int kWarmup = 500;
+  const int kIterations = 10000;
+
+  for (int i = 0; i < kWarmup; ++i) {
+    OpenAndClose(connection_string);
+  }
+  size_t fds_before = OpenFileDescriptorCount();
+  size_t rss_before = ResidentSetBytes();
+
+  for (int i = 0; i < kIterations; ++i) {
+    OpenAndClose(connection_string);
+  }
+
+  EXPECT_EQ(OdbcEnvironment::live_environments(), 0u);
+  EXPECT_EQ(OdbcEnvironment::live_connections(), 0u);
+  EXPECT_EQ(OpenFileDescriptorCount(), fds_before);
+  // Allow for allocator noise, but not per-iteration growth.
+  EXPECT_LT(ResidentSetBytes(), rss_before + 2 * 1024 * 1024);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
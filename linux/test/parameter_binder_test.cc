@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "parameter_binder.h"
+#include "text_encoding.h"
+
+// Exported by the synthetic driver.
+extern "C" SQLSMALLINT SyntheticOdbcParamType(SQLHSTMT stmt,
+                                              SQLUSMALLINT number);
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// One statement on a synthetic connection; see
+// linux/benchmark/synthetic_odbc_driver.cc for the statement syntax.
+class ParameterBinderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
+    SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
+    SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt_);
+  }
+
+  void TearDown() override {
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc_);
+    SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  }
+
+  void Prepare(const std::string& sql) {
+    std::vector<SQLWCHAR> text = Utf8ToUtf16(sql);
+    ASSERT_TRUE(SQL_SUCCEEDED(
+        SQLPrepareW(stmt_, text.data(), (SQLINTEGER)text.size())));
+  }
+
+  SQLHENV env_ = SQL_NULL_HENV;
+  SQLHDBC dbc_ = SQL_NULL_HDBC;
+  SQLHSTMT stmt_ = SQL_NULL_HSTMT;
+};
+
+}  // namespace
+
+TEST_F(ParameterBinderTest, DeclaresNullsWithTheDescribedType) {
+  Prepare("SELECT rows=1 cols=0 params=blob,int");
+  ParameterBinder binder;
+  std::string error;
+  ASSERT_TRUE(binder.Bind(stmt_, {SqlParameter::Null(), SqlParameter::Null()},
+                          &error))
+      << error;
+  // nvarchar would not convert to varbinary(max).
+  EXPECT_EQ(SyntheticOdbcParamType(stmt_, 1), SQL_LONGVARBINARY);
+  EXPECT_EQ(SyntheticOdbcParamType(stmt_, 2), SQL_INTEGER);
+}
+
+TEST_F(ParameterBinderTest, DeclaresNullsAsNvarcharWhenUndescribed) {
+  Prepare("SELECT rows=1 cols=0");
+  ParameterBinder binder;
+  std::string error;
+  ASSERT_TRUE(binder.Bind(stmt_, {SqlParameter::Null(), SqlParameter::Int64(1)},
+                          &error))
+      << error;
+  EXPECT_EQ(SyntheticOdbcParamType(stmt_, 1), SQL_WVARCHAR);
+  EXPECT_EQ(SyntheticOdbcParamType(stmt_, 2), SQL_BIGINT);
+}
+
+TEST_F(ParameterBinderTest, DeclaresNullArrayColumnsWithTheDescribedType) {
+  Prepare("SELECT rows=1 cols=0 params=bin");
+  std::vector<std::vector<SqlParameter>> rows = {
+      {SqlParameter::Null(), SqlParameter::Int64(1)},
+      {SqlParameter::Null(), SqlParameter::Null()},
+  };
+  ParameterArrayBinder binder;
+  std::string error;
+  ASSERT_TRUE(binder.Bind(stmt_, rows, 0, rows.size(), &error)) << error;
+  EXPECT_EQ(SyntheticOdbcParamType(stmt_, 1), SQL_VARBINARY);
+  EXPECT_EQ(SyntheticOdbcParamType(stmt_, 2), SQL_BIGINT);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
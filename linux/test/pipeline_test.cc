@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+PipelineOperation Query(const std::string& sql,
+                        std::vector<SqlParameter> params = {}) {
+  PipelineOperation operation;
+  operation.sql = sql;
+  operation.params = std::move(params);
+  return operation;
+}
+
+PipelineOperation Execute(const std::string& sql) {
+  PipelineOperation operation;
+  operation.kind = PipelineOperation::Kind::kExecute;
+  operation.sql = sql;
+  return operation;
+}
+
+StatementResult ResultSet() {
+  StatementResult result;
+  result.has_result_set = true;
+  return result;
+}
+
+StatementResult RowCount(int64_t count) {
+  StatementResult result;
+  result.row_count = count;
+  return result;
+}
+
+}  // namespace
+
+TEST(Pipeline, CombinesConsecutiveReadOnlyQueries) {
+  std::vector<PipelineOperation> operations = {
+      Query("SELECT * FROM Users WHERE id = ?;", {SqlParameter::Int64(1)}),
+      Query("SELECT * FROM Roles WHERE name = ?", {SqlParameter::Text("a")}),
+      Execute("UPDATE Users SET seen = 1"),
+      Query("SELECT COUNT(*) FROM Users"),
+      Query("SELECT * INTO #copy FROM Users"),
+      Query("SELECT 1"),
+  };
+
+  std::vector<PipelineStep> steps = PlanPipeline(operations);
+  ASSERT_EQ(steps.size(), 5u);
+  EXPECT_EQ(steps[0].first, 0u);
+  EXPECT_EQ(steps[0].count, 2u);
+  EXPECT_EQ(steps[0].sql,
+            "SELECT * FROM Users WHERE id = ?\n;\n"
+            "SELECT * FROM Roles WHERE name = ?");
+  ASSERT_EQ(steps[0].params.size(), 2u);
+  EXPECT_EQ(steps[0].params[1].text, "a");
+  // Commands and queries that write run alone.
+  EXPECT_EQ(steps[1].sql, "UPDATE Users SET seen = 1");
+  EXPECT_EQ(steps[2].count, 1u);
+  EXPECT_EQ(steps[2].sql, "SELECT COUNT(*) FROM Users");
+  EXPECT_EQ(steps[3].first, 4u);
+  EXPECT_EQ(steps[4].first, 5u);
+  EXPECT_EQ(PlanPipeline({operations[5], operations[3]}).size(), 1u);
+}
+
+TEST(Pipeline, RunsQueriesThatChangeBatchStateAlone) {
+  std::vector<PipelineStep> steps = PlanPipeline({
+      Query("SELECT 1"),
+      Query("DECLARE @n int = 1; SELECT @n"),
+      Query("DECLARE @n int = 2; SELECT @n"),
+      Query("SET NOCOUNT ON; SELECT * FROM Users"),
+      // Quoted, these are just column names.
+      Query("SELECT [set], [declare] FROM Options"),
+      Query("SELECT 2"),
+  });
+  ASSERT_EQ(steps.size(), 5u);
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(steps[i].first, i);
+    EXPECT_EQ(steps[i].count, 1u);
+  }
+  EXPECT_EQ(steps[4].first, 4u);
+  EXPECT_EQ(steps[4].count, 2u);
+}
+
+TEST(Pipeline, RunsBareProcedureCallsAlone) {
+  std::vector<PipelineStep> steps = PlanPipeline({
+      Query("SELECT 1"),
+      Query("dbo.ListUsers @active = ?", {SqlParameter::Int64(1)}),
+      Query("SELECT 2"),
+  });
+  ASSERT_EQ(steps.size(), 3u);
+  // EXEC may only be left out at the start of a batch.
+  EXPECT_EQ(steps[1].first, 1u);
+  EXPECT_EQ(steps[1].sql, "dbo.ListUsers @active = ?");
+  EXPECT_EQ(steps[2].count, 1u);
+}
+
+TEST(Pipeline, TerminatesQueriesEndingInALineComment) {
+  std::vector<PipelineStep> steps = PlanPipeline({
+      Query("SELECT * FROM Users -- active only"),
+      Query("WITH t AS (SELECT 1 AS n) SELECT n FROM t"),
+  });
+  ASSERT_EQ(steps.size(), 1u);
+  // A CTE needs its predecessor terminated, which a ; inside the comment
+  // would not do.
+  EXPECT_EQ(steps[0].sql,
+            "SELECT * FROM Users -- active only\n;\n"
+            "WITH t AS (SELECT 1 AS n) SELECT n FROM t");
+}
+
+TEST(Pipeline, KeepsCombinedStepsUnderTheParameterLimit) {
+  std::vector<SqlParameter> params(kMaxPipelineStepParameters / 2 + 1);
+  std::vector<PipelineStep> steps =
+      PlanPipeline({Query("SELECT ?", params), Query("SELECT ?", params)});
+  EXPECT_EQ(steps.size(), 2u);
+}
+
+TEST(Pipeline, SplitsResultsPerOperation) {
+  std::vector<PipelineOperation> operations = {
+      Query("SELECT 1"), Query("SELECT 2"), Execute("UPDATE t SET x = 1")};
+  std::vector<PipelineStep> steps = PlanPipeline(operations);
+  ASSERT_EQ(steps.size(), 2u);
+
+  std::vector<StatementResult> out;
+  std::string error;
+  // A row count between the result sets, e.g. from a variable assignment,
+  // does not shift them.
+  ASSERT_TRUE(SplitStepResults(steps[0], operations,
+                               {ResultSet(), RowCount(1), ResultSet()}, &out,
+                               &error));
+  ASSERT_TRUE(SplitStepResults(steps[1], operations,
+                               {RowCount(2), RowCount(3)}, &out, &error));
+  ASSERT_EQ(out.size(), 3u);
+  EXPECT_TRUE(out[0].has_result_set);
+  EXPECT_TRUE(out[1].has_result_set);
+  EXPECT_FALSE(out[2].has_result_set);
+  EXPECT_EQ(out[2].row_count, 5);
+
+  // Under SET NOCOUNT ON a command reports nothing.
+  out.clear();
+  ASSERT_TRUE(SplitStepResults(steps[1], operations, {}, &out, &error));
+  EXPECT_EQ(out[0].row_count, 0);
+}
+
+TEST(Pipeline, RejectsCombinedQueriesThatDoNotLineUp) {
+  std::vector<PipelineOperation> operations = {
+      Query("SELECT 1 SELECT 2"), Query("SELECT 3")};
+  std::vector<PipelineStep> steps = PlanPipeline(operations);
+  ASSERT_EQ(steps.size(), 1u);
+
+  std::vector<StatementResult> out;
+  std::string error;
+  EXPECT_FALSE(SplitStepResults(
+      steps[0], operations, {ResultSet(), ResultSet(), ResultSet()}, &out,
+      &error));
+  EXPECT_NE(error.find("exactly one"), std::string::npos);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
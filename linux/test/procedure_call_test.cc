@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "procedure_call.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+using Direction = ProcedureParameter::Direction;
+using Type = SqlParameter::Type;
+
+// One statement on a synthetic connection; see
+// linux/benchmark/synthetic_odbc_driver.cc for what a call returns.
+class ProcedureCallTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
+    SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
+    SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt_);
+  }
+
+  void TearDown() override {
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc_);
+    SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  }
+
+  SQLHENV env_ = SQL_NULL_HENV;
+  SQLHDBC dbc_ = SQL_NULL_HDBC;
+  SQLHSTMT stmt_ = SQL_NULL_HSTMT;
+};
+
+ProcedureParameter Param(const std::string& name, Direction direction,
+                         Type type, SqlParameter value = SqlParameter(),
+                         size_t output_size = 0) {
+  ProcedureParameter param;
+  param.name = name;
+  param.direction = direction;
+  param.type = type;
+  param.value = value;
+  param.output_size = output_size;
+  return param;
+}
+
+}  // namespace
+
+TEST(ProcedureCallNameTest, AcceptsPlainAndBracketedNames) {
+  EXPECT_TRUE(ProcedureCall::IsValidName("GetOrders"));
+  EXPECT_TRUE(ProcedureCall::IsValidName("dbo.GetOrders"));
+  EXPECT_TRUE(ProcedureCall::IsValidName("sales.dbo.get_orders$2"));
+  EXPECT_TRUE(ProcedureCall::IsValidName("srv.sales.dbo.[Get Orders]"));
+  EXPECT_TRUE(ProcedureCall::IsValidName("#temp_proc"));
+  EXPECT_TRUE(ProcedureCall::IsValidName("[dbo].[a.b]"));
+}
+
+TEST(ProcedureCallNameTest, RejectsAnythingElse) {
+  EXPECT_FALSE(ProcedureCall::IsValidName(""));
+  EXPECT_FALSE(ProcedureCall::IsValidName("dbo."));
+  EXPECT_FALSE(ProcedureCall::IsValidName(".p"));
+  EXPECT_FALSE(ProcedureCall::IsValidName("dbo..p"));
+  EXPECT_FALSE(ProcedureCall::IsValidName("a.b.c.d.e"));
+  EXPECT_FALSE(ProcedureCall::IsValidName("[unclosed"));
+  EXPECT_FALSE(ProcedureCall::IsValidName("[]"));
+  EXPECT_FALSE(ProcedureCall::IsValidName("[a]b"));
+  EXPECT_FALSE(ProcedureCall::IsValidName("p(1)"));
+  EXPECT_FALSE(ProcedureCall::IsValidName("two words"));
+  EXPECT_FALSE(ProcedureCall::IsValidName("p; DROP TABLE t"));
+}
+
+TEST_F(ProcedureCallTest, RejectsInvalidNamesWithoutExecuting) {
+  ProcedureCall call(stmt_);
+  ProcedureResult result;
+  std::string error;
+  EXPECT_FALSE(call.Execute("p;p", {}, &result, &error));
+  EXPECT_EQ(error, "Invalid procedure name: p;p");
+}
+
+TEST_F(ProcedureCallTest, ReturnsOutputsAndTheReturnValue) {
+  // The driver derives each output from the argument's name, so these
+  // values also show every argument was bound by name.
+  std::vector<ProcedureParameter> params = {
+      Param("@id", Direction::kInput, Type::kInt64, SqlParameter::Int64(7)),
+      Param("@count", Direction::kInputOutput, Type::kInt64,
+            SqlParameter::Int64(5)),
+      Param("total", Direction::kOutput, Type::kInt64),
+      Param("@label", Direction::kOutput, Type::kText, SqlParameter(), 20),
+      Param("@text", Direction::kInputOutput, Type::kText,
+            SqlParameter::Text("ab"), 20),
+  };
+  ProcedureCall call(stmt_);
+  ProcedureResult result;
+  std::string error;
+  ASSERT_TRUE(call.Execute("dbo.Report", params, &result, &error)) << error;
+
+  EXPECT_EQ(result.return_value, 5);
+  EXPECT_TRUE(result.result_sets.empty());
+  EXPECT_TRUE(result.row_counts.empty());
+  ASSERT_EQ(result.outputs.size(), 4u);
+  EXPECT_EQ(result.outputs[0].first, "count");
+  EXPECT_EQ(result.outputs[0].second.type, Type::kInt64);
+  EXPECT_EQ(result.outputs[0].second.int_value, 5 + 5);
+  EXPECT_EQ(result.outputs[1].first, "total");
+  EXPECT_EQ(result.outputs[1].second.int_value, 5);
+  EXPECT_EQ(result.outputs[2].first, "label");
+  EXPECT_EQ(result.outputs[2].second.type, Type::kText);
+  EXPECT_EQ(result.outputs[2].second.text, "label");
+  EXPECT_EQ(result.outputs[3].first, "text");
+  EXPECT_EQ(result.outputs[3].second.text, "abtext");
+}
+
+TEST_F(ProcedureCallTest, KeepsNullInputOutputValues) {
+  std::vector<ProcedureParameter> params = {
+      Param("@maybe", Direction::kInputOutput, Type::kInt64),
+  };
+  ProcedureCall call(stmt_);
+  ProcedureResult result;
+  std::string error;
+  ASSERT_TRUE(call.Execute("p", params, &result, &error)) << error;
+  EXPECT_EQ(result.return_value, 1);
+  ASSERT_EQ(result.outputs.size(), 1u);
+  EXPECT_EQ(result.outputs[0].second.type, Type::kNull);
+}
+
+TEST_F(ProcedureCallTest, TruncatesTextToTheOutputSize) {
+  std::vector<ProcedureParameter> params = {
+      Param("@label", Direction::kOutput, Type::kText, SqlParameter(), 3),
+  };
+  ProcedureCall call(stmt_);
+  ProcedureResult result;
+  std::string error;
+  ASSERT_TRUE(call.Execute("p", params, &result, &error)) << error;
+  ASSERT_EQ(result.outputs.size(), 1u);
+  EXPECT_EQ(result.outputs[0].second.text, "lab");
+}
+
+TEST_F(ProcedureCallTest, RequiresParameterNames) {
+  std::vector<ProcedureParameter> params = {
+      Param("@a", Direction::kInput, Type::kInt64, SqlParameter::Int64(1)),
+      Param("@", Direction::kInput, Type::kInt64, SqlParameter::Int64(2)),
+  };
+  ProcedureCall call(stmt_);
+  ProcedureResult result;
+  std::string error;
+  EXPECT_FALSE(call.Execute("p", params, &result, &error));
+  EXPECT_EQ(error, "Parameter 2 has no name");
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include "request_registry.h"
+
+namespace mssql_connect {
+namespace test {
+
+TEST(RequestRegistry, CancelsQueuedRequestBeforeItStarts) {
+  RequestRegistry registry;
+  registry.Add(7);
+
+  EXPECT_TRUE(registry.Cancel(7));
+  EXPECT_FALSE(registry.Attach(7, SQL_NULL_HSTMT));
+  EXPECT_TRUE(registry.Detach(7));
+}
+
+TEST(RequestRegistry, LetsUncancelledRequestRun) {
+  RequestRegistry registry;
+  registry.Add(7);
+
+  EXPECT_TRUE(registry.Attach(7, SQL_NULL_HSTMT));
+  EXPECT_FALSE(registry.Detach(7));
+}
+
+TEST(RequestRegistry, IgnoresFinishedAndUnknownRequests) {
+  RequestRegistry registry;
+  registry.Add(7);
+  registry.Remove(7);
+
+  EXPECT_FALSE(registry.Cancel(7));
+  EXPECT_FALSE(registry.Cancel(8));
+  EXPECT_EQ(registry.size(), 0u);
+}
+
+TEST(RequestRegistry, IgnoresRequestIdZero) {
+  RequestRegistry registry;
+  registry.Add(0);
+
+  EXPECT_EQ(registry.size(), 0u);
+  EXPECT_FALSE(registry.Cancel(0));
+  EXPECT_TRUE(registry.Attach(0, SQL_NULL_HSTMT));
+  EXPECT_FALSE(registry.Detach(0));
+}
+
+}  // namespace test
+}  // namespace mssql_connect
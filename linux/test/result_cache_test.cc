@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "result_cache.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+using Cache = ResultCache<std::string>;
+using std::chrono::milliseconds;
+
+const milliseconds kMinute(60000);
+
+}  // namespace
+
+TEST(ResultCache, FindsTablesInQueries) {
+  EXPECT_EQ(FindTables("SELECT * FROM [dbo].[Users] u "
+                       "JOIN dbo.Roles AS r ON r.id = u.role_id"),
+            (std::vector<std::string>{"users", "roles"}));
+  EXPECT_EQ(FindTables("select a from Codes c, Countries where 1 = 1"),
+            (std::vector<std::string>{"codes", "countries"}));
+  // Literals and comments are not read as SQL.
+  EXPECT_EQ(FindTables("SELECT 'from x' -- FROM y\n FROM /* from z */ T"),
+            (std::vector<std::string>{"t"}));
+  EXPECT_EQ(FindTables("SELECT * FROM (SELECT id FROM Items) i"),
+            (std::vector<std::string>{"items"}));
+}
+
+TEST(ResultCache, FindsWrittenTables) {
+  std::vector<std::string> tables;
+  ASSERT_TRUE(FindWrittenTables("UPDATE u SET name = ? FROM Users u", &tables));
+  EXPECT_EQ(tables, (std::vector<std::string>{"u", "users"}));
+  ASSERT_TRUE(FindWrittenTables("INSERT INTO [Audit] VALUES (1)", &tables));
+  EXPECT_EQ(tables, (std::vector<std::string>{"audit"}));
+  ASSERT_TRUE(FindWrittenTables("DELETE Orders WHERE id = 1", &tables));
+  EXPECT_EQ(tables, (std::vector<std::string>{"orders"}));
+  ASSERT_TRUE(FindWrittenTables("SELECT * FROM Users", &tables));
+  EXPECT_TRUE(tables.empty());
+  EXPECT_FALSE(FindWrittenTables("EXEC dbo.RebuildCodes", &tables));
+  // EXEC can be left out of the first statement of a batch.
+  EXPECT_FALSE(FindWrittenTables("dbo.RebuildCodes @force = 1", &tables));
+  EXPECT_FALSE(FindWrittenTables("[RebuildCodes]", &tables));
+  ASSERT_TRUE(FindWrittenTables(";WITH c AS (SELECT 1 AS x) SELECT x FROM c",
+                                &tables));
+  EXPECT_TRUE(tables.empty());
+  // Writes that name no table may change anything.
+  EXPECT_FALSE(FindWrittenTables("DROP PROCEDURE dbo.Reload", &tables));
+  EXPECT_FALSE(FindWrittenTables("ALTER VIEW Active AS SELECT 1 AS x", &tables));
+}
+
+TEST(ResultCache, MatchesWildcardPatterns) {
+  EXPECT_TRUE(MatchesPattern("*users*", "SELECT * FROM Users"));
+  EXPECT_TRUE(MatchesPattern("select ? from t", "SELECT a FROM T"));
+  EXPECT_FALSE(MatchesPattern("*roles*", "SELECT * FROM Users"));
+  EXPECT_TRUE(MatchesPattern("*", ""));
+}
+
+TEST(ResultCache, CountsHitsAndMisses) {
+  Cache cache(1000);
+  std::string value;
+  EXPECT_FALSE(cache.Get("k", &value));
+  cache.Put("k", "db", "SELECT * FROM Codes", "rows", 10, kMinute);
+  ASSERT_TRUE(cache.Get("k", &value));
+  EXPECT_EQ(value, "rows");
+
+  ResultCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.bytes, 10u);
+}
+
+TEST(ResultCache, EvictsLeastRecentlyUsedOverBudget) {
+  Cache cache(100);
+  std::string value;
+  cache.Put("a", "db", "SELECT 1", "a", 40, kMinute);
+  cache.Put("b", "db", "SELECT 2", "b", 40, kMinute);
+  ASSERT_TRUE(cache.Get("a", &value));  // "b" is now the oldest.
+  cache.Put("c", "db", "SELECT 3", "c", 40, kMinute);
+
+  EXPECT_TRUE(cache.Get("a", &value));
+  EXPECT_FALSE(cache.Get("b", &value));
+  EXPECT_TRUE(cache.Get("c", &value));
+  EXPECT_EQ(cache.stats().evictions, 1u);
+  EXPECT_EQ(cache.stats().bytes, 80u);
+
+  // Larger than the whole budget: not stored, nothing evicted.
+  cache.Put("d", "db", "SELECT 4", "d", 101, kMinute);
+  EXPECT_FALSE(cache.Get("d", &value));
+  EXPECT_EQ(cache.stats().entries, 2u);
+}
+
+TEST(ResultCache, ExpiresEntries) {
+  Cache cache(1000);
+  std::string value;
+  Cache::Clock::time_point now = Cache::Clock::now();
+  cache.Put("k", "db", "SELECT 1", "v", 1, milliseconds(100), now);
+  EXPECT_TRUE(cache.Get("k", &value, now + milliseconds(99)));
+  EXPECT_FALSE(cache.Get("k", &value, now + milliseconds(100)));
+  EXPECT_EQ(cache.stats().expirations, 1u);
+  EXPECT_EQ(cache.stats().entries, 0u);
+}
+
+TEST(ResultCache, InvalidatesByTableAndTarget) {
+  Cache cache(1000);
+  std::string value;
+  cache.Put("users@a", "a", "SELECT * FROM dbo.Users", "1", 1, kMinute);
+  cache.Put("users@b", "b", "SELECT * FROM Users", "2", 1, kMinute);
+  cache.Put("codes@a", "a", "SELECT * FROM Codes", "3", 1, kMinute);
+
+  // A write on target "a" leaves target "b" alone.
+  EXPECT_EQ(cache.InvalidateAfterWrite("a", "UPDATE [Users] SET x = 1"), 1u);
+  EXPECT_FALSE(cache.Get("users@a", &value));
+  EXPECT_TRUE(cache.Get("users@b", &value));
+  EXPECT_TRUE(cache.Get("codes@a", &value));
+
+  // A procedure may write anything on its target.
+  EXPECT_EQ(cache.InvalidateAfterWrite("a", "EXEC dbo.Reload"), 1u);
+  EXPECT_FALSE(cache.Get("codes@a", &value));
+
+  EXPECT_EQ(cache.InvalidateTables("", {"dbo.users"}), 1u);
+  EXPECT_EQ(cache.stats().entries, 0u);
+  EXPECT_EQ(cache.stats().invalidations, 3u);
+}
+
+TEST(ResultCache, InvalidatesByPattern) {
+  Cache cache(1000);
+  std::string value;
+  cache.Put("1", "db", "SELECT * FROM Users", "1", 1, kMinute);
+  cache.Put("2", "db", "SELECT * FROM Roles", "2", 1, kMinute);
+  EXPECT_EQ(cache.InvalidatePattern("*from users*"), 1u);
+  EXPECT_FALSE(cache.Get("1", &value));
+  EXPECT_TRUE(cache.Get("2", &value));
+}
+
+TEST(ResultCache, ZeroBudgetStoresNothing) {
+  Cache cache;
+  std::string value;
+  EXPECT_FALSE(cache.enabled());
+  cache.Put("k", "db", "SELECT 1", "v", 1, kMinute);
+  EXPECT_FALSE(cache.Get("k", &value));
+}
+
+}  // namespace test
+}  // namespace mssql_connect
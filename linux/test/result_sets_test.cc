@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "result_sets.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// One statement on a synthetic connection; see
+// linux/benchmark/synthetic_odbc_driver.cc for the batch syntax.
+class ResultSetsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env_);
+    SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc_);
+    SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt_);
+  }
+
+  void TearDown() override {
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc_);
+    SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  }
+
+  void Run(const std::string& sql) {
+    std::vector<SQLWCHAR> text = Utf8ToUtf16(sql);
+    ASSERT_TRUE(SQL_SUCCEEDED(
+        SQLExecDirectW(stmt_, text.data(), (SQLINTEGER)text.size())));
+  }
+
+  SQLHENV env_ = SQL_NULL_HENV;
+  SQLHDBC dbc_ = SQL_NULL_HDBC;
+  SQLHSTMT stmt_ = SQL_NULL_HSTMT;
+};
+
+}  // namespace
+
+TEST_F(ResultSetsTest, ReadsResultSetsAndRowCountsInOrder) {
+  Run("SELECT rows=2 cols=1 types=int; INSERT rows=3 cols=0; "
+      "SELECT rows=1 cols=2 types=text,int strlen=4; UPDATE rows=0 cols=0");
+  std::vector<StatementResult> results;
+  std::string error;
+  ASSERT_TRUE(ReadStatementResults(stmt_, true, &results, &error)) << error;
+  ASSERT_EQ(results.size(), 4u);
+
+  ASSERT_TRUE(results[0].has_result_set);
+  EXPECT_EQ(results[0].row_count, 2);
+  const ColumnarResult& first = results[0].result_set;
+  ASSERT_EQ(first.columns.size(), 1u);
+  ASSERT_EQ(first.columns[0].ints.size(), 2u);
+  EXPECT_EQ(first.columns[0].ints[1], 1);  // row * (column + 1)
+
+  EXPECT_FALSE(results[1].has_result_set);
+  EXPECT_EQ(results[1].row_count, 3);
+
+  ASSERT_TRUE(results[2].has_result_set);
+  const ColumnarResult& second = results[2].result_set;
+  EXPECT_EQ(second.row_count, 1u);
+  ASSERT_EQ(second.columns.size(), 2u);
+  ASSERT_EQ(second.columns[0].strings.size(), 1u);
+  EXPECT_EQ(second.columns[0].strings[0], "abcd");
+
+  // A statement that affected no rows still reports its count.
+  EXPECT_FALSE(results[3].has_result_set);
+  EXPECT_EQ(results[3].row_count, 0);
+}
+
+TEST_F(ResultSetsTest, ReadsBatchesOfOnlyRowCounts) {
+  Run("INSERT rows=1 cols=0; INSERT rows=2 cols=0; DELETE rows=5 cols=0");
+  std::vector<StatementResult> results;
+  std::string error;
+  ASSERT_TRUE(ReadStatementResults(stmt_, false, &results, &error)) << error;
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(results[0].row_count, 1);
+  EXPECT_EQ(results[1].row_count, 2);
+  EXPECT_EQ(results[2].row_count, 5);
+  for (const StatementResult& result : results) {
+    EXPECT_FALSE(result.has_result_set);
+  }
+}
+
+TEST_F(ResultSetsTest, FailsOnAnErrorInALaterStatement) {
+  Run("SELECT rows=1 cols=1 types=int; INSERT rows=1 cols=0; "
+      "SELECT types=unknown");
+  std::vector<StatementResult> results;
+  std::string error;
+  EXPECT_FALSE(ReadStatementResults(stmt_, false, &results, &error));
+  EXPECT_NE(error.find("42000"), std::string::npos) << error;
+  // The results before the failing statement were read.
+  EXPECT_EQ(results.size(), 2u);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "scratch_pool.h"
+
+namespace mssql_connect {
+namespace test {
+
+TEST(ScratchPool, ReusesGivenBuffers) {
+  ScratchPool pool;
+  std::vector<uint8_t> buffer = pool.Take(1000);
+  ASSERT_GE(buffer.size(), 1000u);
+  const uint8_t* data = buffer.data();
+  pool.Give(std::move(buffer));
+  EXPECT_GE(pool.retained_bytes(), 1000u);
+
+  std::vector<uint8_t> again = pool.Take(500);
+  EXPECT_EQ(again.data(), data);
+  EXPECT_EQ(pool.retained_bytes(), 0u);
+}
+
+TEST(ScratchPool, TakesTheSmallestBufferThatFits) {
+  ScratchPool pool;
+  std::vector<uint8_t> small = pool.Take(100);
+  std::vector<uint8_t> large = pool.Take(10000);
+  const uint8_t* large_data = large.data();
+  pool.Give(std::move(small));
+  pool.Give(std::move(large));
+
+  EXPECT_EQ(pool.Take(5000).data(), large_data);
+}
+
+TEST(ScratchPool, GrowsABufferThatIsTooSmall) {
+  ScratchPool pool;
+  pool.Give(pool.Take(10));
+  EXPECT_GE(pool.Take(100).size(), 100u);
+  EXPECT_EQ(pool.retained_bytes(), 0u);
+}
+
+TEST(ScratchPool, DropsBuffersPastItsLimit) {
+  ScratchPool pool;
+  pool.Give(pool.Take(ScratchPool::kMaxRetainedBytes));
+  pool.Give(pool.Take(1));  // Reuses the first buffer.
+  pool.Give(std::vector<uint8_t>(1));
+  EXPECT_EQ(pool.retained_bytes(), ScratchPool::kMaxRetainedBytes);
+}
+
+TEST(ScratchPool, CountsAndTrimsTheTextString) {
+  ScratchPool pool;
+  std::string* text = pool.text();
+  text->assign(ScratchPool::kMaxRetainedBytes / 2, 'x');
+  EXPECT_GE(pool.retained_bytes(), ScratchPool::kMaxRetainedBytes / 2);
+  // The string's share of the limit is not left for buffers.
+  pool.Give(std::vector<uint8_t>(ScratchPool::kMaxRetainedBytes / 2 + 1));
+  EXPECT_LE(pool.retained_bytes(), ScratchPool::kMaxRetainedBytes);
+
+  // A string grown past the limit is freed once it is done with.
+  text->assign(ScratchPool::kMaxRetainedBytes + 1, 'x');
+  pool.Trim();
+  EXPECT_LT(pool.text()->capacity(), 1024u);
+  EXPECT_EQ(pool.retained_bytes(), 0u);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
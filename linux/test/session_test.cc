@@ -0,0 +1,389 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "binary_result.h"
+#include "session.h"
+#include "transaction.h"
+
+// Exported by the synthetic driver.
+extern "C" uint64_t SyntheticOdbcEndTranCount(SQLHDBC dbc,
+                                              SQLSMALLINT completion);
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// The tests link the synthetic driver in place of the driver manager, so
+// every statement describes its own result; see
+// linux/benchmark/synthetic_odbc_driver.cc.
+std::unique_ptr<Session> OpenSession(size_t statement_cache_size =
+                                         StatementCache::kDefaultCapacity) {
+  ConnectOptions options;
+  options.server = "localhost";
+  options.database = "test";
+  options.statement_cache_size = statement_cache_size;
+  SessionError error;
+  std::unique_ptr<Session> session = Session::Open(options, nullptr, &error);
+  EXPECT_TRUE(session) << error.code << ": " << error.details;
+  return session;
+}
+
+SQLUINTEGER ConnectAttr(Session* session, SQLINTEGER attribute) {
+  SQLUINTEGER value = 0;
+  EXPECT_TRUE(SQL_SUCCEEDED(SQLGetConnectAttr(
+      session->handle(), attribute, &value, SQL_IS_UINTEGER, nullptr)));
+  return value;
+}
+
+int64_t TranCount(Session* session) {
+  ColumnarResult result;
+  SessionError error;
+  EXPECT_TRUE(session->Query("SELECT @@TRANCOUNT", {}, StatementOptions(),
+                             &result, &error))
+      << error.details;
+  return result.row_count == 1 ? result.columns[0].ints[0] : -1;
+}
+
+// Runs a statement that starts the driver's implicit transaction.
+void Write(Session* session) {
+  int64_t rows_affected = 0;
+  SessionError error;
+  EXPECT_TRUE(session->Execute("INSERT rows=1 cols=0", {}, StatementOptions(),
+                               &rows_affected, &error))
+      << error.details;
+}
+
+// Records what Session::Query() hands it, and how many rows had been
+// fetched when each row arrived.
+class RecordingSink : public ResultSink {
+ public:
+  void Start(const BlockFetcher& fetcher) override {
+    ++starts;
+    columns = fetcher.columns().size();
+  }
+  void AddRow(const BlockFetcher& fetcher, size_t row) override {
+    values.push_back(fetcher.GetInt32(0, row));
+    rows_read.push_back(fetcher.rows_read());
+  }
+  void Finish() override { ++finishes; }
+
+  int starts = 0;
+  int finishes = 0;
+  size_t columns = 0;
+  std::vector<int32_t> values;
+  std::vector<uint64_t> rows_read;
+};
+
+}  // namespace
+
+TEST(Session, BuildsConnectionString) {
+  ConnectOptions options;
+  options.server = "db,1433";
+  options.database = "sales";
+  options.username = "app";
+  options.password = "secret";
+  EXPECT_EQ(BuildConnectionString(options),
+            "DRIVER={ODBC Driver 18 for SQL Server};SERVER=db,1433;"
+            "DATABASE=sales;UID=app;PWD=secret;TrustServerCertificate=Yes;");
+}
+
+TEST(Session, RoundsTimeoutsUpToSeconds) {
+  EXPECT_EQ(TimeoutSeconds(0), 0u);
+  EXPECT_EQ(TimeoutSeconds(-5), 0u);
+  EXPECT_EQ(TimeoutSeconds(1), 1u);
+  EXPECT_EQ(TimeoutSeconds(1000), 1u);
+  EXPECT_EQ(TimeoutSeconds(1001), 2u);
+}
+
+TEST(Session, MapsSqlStatesToErrorCodes) {
+  EXPECT_STREQ(ErrorCodeForState("HYT00", false, "QueryError"), "Timeout");
+  EXPECT_STREQ(ErrorCodeForState("HY008", false, "QueryError"), "Cancelled");
+  EXPECT_STREQ(ErrorCodeForState("42000", true, "QueryError"), "Cancelled");
+  EXPECT_STREQ(ErrorCodeForState("42000", false, "QueryError"), "QueryError");
+}
+
+TEST(Session, QueriesTypedColumns) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+  EXPECT_FALSE(session->target().empty());
+
+  ColumnarResult result;
+  SessionError error;
+  ASSERT_TRUE(session->Query("SELECT rows=10 cols=2 types=int,text strlen=4", {},
+                             StatementOptions(), &result, &error))
+      << error.details;
+  EXPECT_EQ(result.row_count, 10u);
+  ASSERT_EQ(result.columns.size(), 2u);
+  EXPECT_EQ(result.columns[0].name, "c1");
+  EXPECT_STREQ(CellTypeName(result.columns[0].type), "int");
+  EXPECT_STREQ(CellTypeName(result.columns[1].type), "string");
+  EXPECT_EQ(result.columns[0].ints[7], 7);
+  EXPECT_EQ(result.columns[1].strings[0], "bcde");
+}
+
+TEST(Session, StreamsRowsIntoASinkAsTheyAreFetched) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  RecordingSink sink;
+  SessionError error;
+  ASSERT_TRUE(session->Query("SELECT rows=600 cols=2 types=int,text", {},
+                             StatementOptions(), &sink, &error))
+      << error.details;
+  EXPECT_EQ(sink.starts, 1);
+  EXPECT_EQ(sink.finishes, 1);
+  EXPECT_EQ(sink.columns, 2u);
+  ASSERT_EQ(sink.values.size(), 600u);
+  EXPECT_EQ(sink.values[599], 599);
+  // Each row arrived with its own rowset, not after the whole result.
+  EXPECT_EQ(sink.rows_read.front(), BlockFetcher::kDefaultRowArraySize);
+  EXPECT_EQ(sink.rows_read.back(), 600u);
+}
+
+TEST(Session, DoesNotFinishTheSinkWhenAFetchFails) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  RecordingSink sink;
+  SessionError error;
+  EXPECT_FALSE(session->Query("SELECT rows=600 cols=1 types=int bad=300", {},
+                              StatementOptions(), &sink, &error));
+  EXPECT_EQ(error.code, "QueryError");
+  EXPECT_EQ(error.message, "Failed to fetch rows");
+  EXPECT_EQ(sink.finishes, 0);
+  // The rowsets before the failing one were delivered.
+  EXPECT_EQ(sink.values.size(), BlockFetcher::kDefaultRowArraySize);
+}
+
+TEST(Session, EncodesBinaryResultsAsTheyAreFetched) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  // More rows than one rowset, with NULLs and every bound column type.
+  const std::string sql =
+      "SELECT rows=300 cols=10 types=int,double,bit,text,bin,bigint,decimal,"
+      "numeric,datetime,guid strlen=5 nulls=7";
+  ColumnarResult result;
+  SessionError error;
+  ASSERT_TRUE(session->Query(sql, {}, StatementOptions(), &result, &error))
+      << error.details;
+  std::vector<uint8_t> expected;
+  EncodeBinaryResult(result, &expected);
+
+  std::vector<uint8_t> streamed;
+  BinaryResultSink sink(&streamed);
+  ASSERT_TRUE(session->Query(sql, {}, StatementOptions(), &sink, &error))
+      << error.details;
+  EXPECT_EQ(streamed, expected);
+}
+
+TEST(Session, BindsParameters) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  ColumnarResult result;
+  SessionError error;
+  std::vector<SqlParameter> params = {SqlParameter::Int64(1),
+                                      SqlParameter::Text("name")};
+  EXPECT_TRUE(session->Query("SELECT rows=3 cols=1 types=int", params,
+                             StatementOptions(), &result, &error))
+      << error.details;
+  EXPECT_EQ(result.row_count, 3u);
+}
+
+TEST(Session, ExecuteReportsAffectedRows) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  int64_t rows_affected = 0;
+  SessionError error;
+  ASSERT_TRUE(session->Execute("INSERT rows=4 cols=0", {}, StatementOptions(),
+                               &rows_affected, &error))
+      << error.details;
+  EXPECT_EQ(rows_affected, 4);
+}
+
+TEST(Session, ReusesPreparedStatements) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  const std::string sql = "SELECT rows=2 cols=1 types=int";
+  ColumnarResult result;
+  SessionError error;
+  ASSERT_TRUE(session->Query(sql, {}, StatementOptions(), &result, &error));
+  StatementCacheStats before = StatementCache::stats();
+  result = ColumnarResult();
+  ASSERT_TRUE(session->Query(sql, {}, StatementOptions(), &result, &error));
+  EXPECT_EQ(StatementCache::stats().hits, before.hits + 1);
+  EXPECT_EQ(session->statements()->size(), 1u);
+  EXPECT_EQ(result.row_count, 2u);
+}
+
+TEST(Session, DescribesCachedStatementsAgainWhenTheResultChanges) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  const std::string sql = "SELECT rows=2 cols=2 types=int,text strlen=16";
+  ColumnarResult result;
+  SessionError error;
+  ASSERT_TRUE(session->Query(sql, {}, StatementOptions(), &result, &error));
+
+  // As if the text column had been narrower when the statement was first
+  // described, e.g. before an ALTER TABLE.
+  std::string message;
+  std::unique_ptr<PreparedStatement> statement =
+      session->statements()->Take(session->handle(), sql, &message);
+  ASSERT_TRUE(statement && statement->described);
+  statement->columns[1].column_size = 4;
+  session->statements()->Return(sql, std::move(statement));
+
+  result = ColumnarResult();
+  ASSERT_TRUE(session->Query(sql, {}, StatementOptions(), &result, &error))
+      << error.details;
+  ASSERT_EQ(result.row_count, 2u);
+  EXPECT_EQ(result.columns[1].strings[0].size(), 16u);
+  statement = session->statements()->Take(session->handle(), sql, &message);
+  ASSERT_TRUE(statement);
+  EXPECT_EQ(statement->columns[1].column_size, 16u);
+}
+
+TEST(Session, ReportsTimeouts) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  StatementOptions options;
+  options.timeout = 1;
+  ColumnarResult result;
+  SessionError error;
+  EXPECT_FALSE(session->Query("SELECT rows=1 cols=1 latency=5000000", {},
+                              options, &result, &error));
+  EXPECT_EQ(error.code, "Timeout");
+  EXPECT_EQ(error.message, "Query execution failed");
+}
+
+TEST(Session, CancelsRegisteredRequests) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+
+  RequestRegistry requests;
+  requests.Add(7);
+  StatementOptions options;
+  options.requests = &requests;
+  options.request_id = 7;
+  std::thread canceller([&requests]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    requests.Cancel(7);
+  });
+  int64_t rows_affected = 0;
+  SessionError error;
+  EXPECT_FALSE(session->Execute("UPDATE rows=1 cols=0 latency=5000000", {},
+                                options, &rows_affected, &error));
+  canceller.join();
+  requests.Remove(7);
+  EXPECT_EQ(error.code, "Cancelled");
+}
+
+TEST(Session, TransactionTogglesAutocommitAndRestoresIsolation) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+  Transaction transaction(session->handle());
+  std::string error;
+
+  ASSERT_TRUE(transaction.Begin(IsolationLevel::kSerializable, &error))
+      << error;
+  EXPECT_TRUE(transaction.active());
+  EXPECT_EQ(ConnectAttr(session.get(), SQL_ATTR_AUTOCOMMIT),
+            static_cast<SQLUINTEGER>(SQL_AUTOCOMMIT_OFF));
+  EXPECT_EQ(ConnectAttr(session.get(), SQL_ATTR_TXN_ISOLATION),
+            static_cast<SQLUINTEGER>(SQL_TXN_SERIALIZABLE));
+  EXPECT_FALSE(transaction.Begin(IsolationLevel::kDefault, &error));
+  Write(session.get());
+  EXPECT_EQ(TranCount(session.get()), 1);
+
+  ASSERT_TRUE(transaction.Commit(&error)) << error;
+  EXPECT_FALSE(transaction.active());
+  EXPECT_EQ(SyntheticOdbcEndTranCount(session->handle(), SQL_COMMIT), 1u);
+  EXPECT_EQ(TranCount(session.get()), 0);
+  EXPECT_EQ(ConnectAttr(session.get(), SQL_ATTR_AUTOCOMMIT),
+            static_cast<SQLUINTEGER>(SQL_AUTOCOMMIT_ON));
+  EXPECT_EQ(ConnectAttr(session.get(), SQL_ATTR_TXN_ISOLATION),
+            static_cast<SQLUINTEGER>(SQL_TXN_READ_COMMITTED));
+
+  // The default level leaves the connection's own alone.
+  ASSERT_TRUE(transaction.Begin(IsolationLevel::kDefault, &error)) << error;
+  EXPECT_EQ(ConnectAttr(session.get(), SQL_ATTR_TXN_ISOLATION),
+            static_cast<SQLUINTEGER>(SQL_TXN_READ_COMMITTED));
+  ASSERT_TRUE(transaction.Rollback(&error)) << error;
+}
+
+TEST(Session, TransactionRollsBackToSavepoints) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+  Transaction transaction(session->handle());
+  std::string error;
+  ASSERT_TRUE(transaction.Begin(IsolationLevel::kDefault, &error)) << error;
+
+  // Nothing has started the server's transaction yet, so this savepoint
+  // marks its start rather than being saved.
+  ASSERT_TRUE(transaction.Savepoint("at_start", &error)) << error;
+  EXPECT_EQ(TranCount(session.get()), 0);
+  Write(session.get());
+  ASSERT_TRUE(transaction.Savepoint("after_write", &error)) << error;
+  Write(session.get());
+  EXPECT_EQ(transaction.savepoints(),
+            (std::vector<std::string>{"at_start", "after_write"}));
+
+  ASSERT_TRUE(transaction.RollbackTo("after_write", &error)) << error;
+  EXPECT_EQ(SyntheticOdbcEndTranCount(session->handle(), SQL_ROLLBACK), 0u);
+  EXPECT_EQ(TranCount(session.get()), 1);
+
+  // Rolls back with SQLEndTran, yet the transaction stays open.
+  ASSERT_TRUE(transaction.RollbackTo("at_start", &error)) << error;
+  EXPECT_EQ(SyntheticOdbcEndTranCount(session->handle(), SQL_ROLLBACK), 1u);
+  EXPECT_EQ(TranCount(session.get()), 0);
+  EXPECT_TRUE(transaction.active());
+  EXPECT_EQ(transaction.savepoints(), std::vector<std::string>{"at_start"});
+  EXPECT_EQ(ConnectAttr(session.get(), SQL_ATTR_AUTOCOMMIT),
+            static_cast<SQLUINTEGER>(SQL_AUTOCOMMIT_OFF));
+  EXPECT_FALSE(transaction.RollbackTo("after_write", &error));
+
+  // Later statements still run in a transaction.
+  Write(session.get());
+  EXPECT_EQ(TranCount(session.get()), 1);
+  ASSERT_TRUE(transaction.Commit(&error)) << error;
+  EXPECT_EQ(SyntheticOdbcEndTranCount(session->handle(), SQL_COMMIT), 1u);
+}
+
+TEST(Session, AbandonedTransactionLeavesTheConnectionClean) {
+  std::unique_ptr<Session> session = OpenSession();
+  ASSERT_TRUE(session);
+  Transaction transaction(session->handle());
+  std::string error;
+  ASSERT_TRUE(transaction.Begin(IsolationLevel::kSnapshot, &error)) << error;
+  Write(session.get());
+  ASSERT_TRUE(transaction.Savepoint("s1", &error)) << error;
+
+  // As before a pooled connection is released for the next caller.
+  EXPECT_TRUE(transaction.Abandon());
+  EXPECT_FALSE(transaction.active());
+  EXPECT_TRUE(transaction.savepoints().empty());
+  EXPECT_EQ(SyntheticOdbcEndTranCount(session->handle(), SQL_ROLLBACK), 1u);
+  EXPECT_EQ(TranCount(session.get()), 0);
+  EXPECT_EQ(ConnectAttr(session.get(), SQL_ATTR_AUTOCOMMIT),
+            static_cast<SQLUINTEGER>(SQL_AUTOCOMMIT_ON));
+  EXPECT_EQ(ConnectAttr(session.get(), SQL_ATTR_TXN_ISOLATION),
+            static_cast<SQLUINTEGER>(SQL_TXN_READ_COMMITTED));
+
+  // Nothing left to roll back.
+  EXPECT_TRUE(transaction.Abandon());
+  EXPECT_EQ(SyntheticOdbcEndTranCount(session->handle(), SQL_ROLLBACK), 1u);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
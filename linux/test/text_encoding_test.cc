@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "text_encoding.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+std::string Convert(const std::vector<SQLWCHAR>& units) {
+  return Utf16ToUtf8(units.data(), units.size());
+}
+
+}  // namespace
+
+TEST(TextEncoding, Ascii) {
+  EXPECT_EQ(Convert({'a', 'B', '1', ' '}), "aB1 ");
+  EXPECT_EQ(Convert({}), "");
+}
+
+TEST(TextEncoding, MultiByte) {
+  // U+00E9, U+20AC
+  EXPECT_EQ(Convert({0x00E9, 0x20AC}), "\xC3\xA9\xE2\x82\xAC");
+}
+
+TEST(TextEncoding, SurrogatePair) {
+  // U+1F600
+  EXPECT_EQ(Convert({0xD83D, 0xDE00}), "\xF0\x9F\x98\x80");
+}
+
+TEST(TextEncoding, UnpairedSurrogatesAreReplaced) {
+  EXPECT_EQ(Convert({0xD83D, 'a'}), "\xEF\xBF\xBD" "a");
+  EXPECT_EQ(Convert({0xDE00}), "\xEF\xBF\xBD");
+  EXPECT_EQ(Convert({'a', 0xD83D}), "a\xEF\xBF\xBD");
+}
+
+// Longer than the vectorized blocks, with non-ASCII units at block edges.
+TEST(TextEncoding, LongMixedText) {
+  std::vector<SQLWCHAR> units(100, 'x');
+  std::string expected(100, 'x');
+  EXPECT_EQ(Convert(units), expected);
+
+  units[15] = 0x00E9;
+  units[31] = 0xD83D;
+  units[32] = 0xDE00;
+  units[99] = 0x20AC;
+  expected = std::string(15, 'x') + "\xC3\xA9" + std::string(15, 'x') +
+             "\xF0\x9F\x98\x80" + std::string(66, 'x') + "\xE2\x82\xAC";
+  EXPECT_EQ(Convert(units), expected);
+}
+
+TEST(TextEncoding, Appends) {
+  std::string out = "x=";
+  std::vector<SQLWCHAR> units = {'4', '2'};
+  AppendUtf16AsUtf8(units.data(), units.size(), &out);
+  EXPECT_EQ(out, "x=42");
+}
+
+TEST(TextEncoding, Utf8ToUtf16) {
+  EXPECT_EQ(Utf8ToUtf16("aB1"), (std::vector<SQLWCHAR>{'a', 'B', '1'}));
+  EXPECT_EQ(Utf8ToUtf16("\xC3\xA9\xE2\x82\xAC"),
+            (std::vector<SQLWCHAR>{0x00E9, 0x20AC}));
+  EXPECT_EQ(Utf8ToUtf16("\xF0\x9F\x98\x80"),
+            (std::vector<SQLWCHAR>{0xD83D, 0xDE00}));
+}
+
+TEST(TextEncoding, InvalidUtf8IsReplaced) {
+  // Truncated sequence, stray continuation byte, overlong encoding.
+  EXPECT_EQ(Utf8ToUtf16("\xE2\x82"), (std::vector<SQLWCHAR>{0xFFFD}));
+  EXPECT_EQ(Utf8ToUtf16("\x80" "a"), (std::vector<SQLWCHAR>{0xFFFD, 'a'}));
+  EXPECT_EQ(Utf8ToUtf16("\xC0\xAF"), (std::vector<SQLWCHAR>{0xFFFD}));
+}
+
+TEST(TextEncoding, RoundTrip) {
+  std::string text = "caf\xC3\xA9 \xF0\x9F\x98\x80 ok";
+  std::vector<SQLWCHAR> wide = Utf8ToUtf16(text);
+  EXPECT_EQ(Utf16ToUtf8(wide.data(), wide.size()), text);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
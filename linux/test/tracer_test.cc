@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tracer.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// Turns tracing on for one test, with an empty buffer, and off after it.
+class TracerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Tracer::set_enabled(true);
+    Tracer::Global().Clear();
+  }
+  void TearDown() override { Tracer::set_enabled(false); }
+};
+
+}  // namespace
+
+TEST_F(TracerTest, RecordsSpansOfTracedCalls) {
+  TraceCall call = Tracer::BeginCall(3, 42);
+  ASSERT_TRUE(call.traced());
+  auto start = Tracer::Clock::now();
+  Tracer::Global().Record(call, "fetch", start,
+                          start + std::chrono::microseconds(5), 256);
+  {
+    ScopedTraceCall scope(call);
+    ScopedSpan span(Tracer::Current(), "execute");
+  }
+  EXPECT_FALSE(Tracer::Current().traced());
+
+  std::vector<TraceSpan> spans = Tracer::Global().Snapshot();
+  ASSERT_EQ(spans.size(), 2u);
+  EXPECT_STREQ(spans[0].name, "fetch");
+  EXPECT_EQ(spans[0].connection_id, 3);
+  EXPECT_EQ(spans[0].request_id, 42);
+  EXPECT_EQ(spans[0].duration_ns, 5000);
+  EXPECT_EQ(spans[0].rows, 256);
+  EXPECT_STREQ(spans[1].name, "execute");
+  EXPECT_EQ(spans[1].rows, -1);
+}
+
+TEST_F(TracerTest, IgnoresUntracedCalls) {
+  Tracer::set_enabled(false);
+  TraceCall call = Tracer::BeginCall(1, 0);
+  EXPECT_FALSE(call.traced());
+  { ScopedSpan span(call, "execute"); }
+  Tracer::set_enabled(true);
+  EXPECT_TRUE(Tracer::Global().Snapshot().empty());
+}
+
+TEST_F(TracerTest, KeepsTheNewestSpansWhenFull) {
+  TraceCall call = Tracer::BeginCall(1, 0);
+  auto now = Tracer::Clock::now();
+  for (size_t i = 0; i < Tracer::kCapacity + 10; ++i) {
+    Tracer::Global().Record(call, "fetch", now, now, static_cast<int64_t>(i));
+  }
+  std::vector<TraceSpan> spans = Tracer::Global().Snapshot();
+  ASSERT_EQ(spans.size(), Tracer::kCapacity);
+  EXPECT_EQ(spans.front().rows, 10);
+  EXPECT_EQ(spans.back().rows, static_cast<int64_t>(Tracer::kCapacity + 9));
+
+  Tracer::Global().Clear();
+  EXPECT_TRUE(Tracer::Global().Snapshot().empty());
+}
+
+TEST_F(TracerTest, WritesChromeTraceEvents) {
+  TraceSpan span;
+  std::snprintf(span.name, sizeof(span.name), "query \"x\"");
+  span.connection_id = 2;
+  span.request_id = 9;
+  span.call_id = 17;
+  span.start_ns = 1500;
+  span.duration_ns = 250;
+
+  std::ostringstream out;
+  Tracer::WriteChromeTrace({span}, &out);
+  std::string json = out.str();
+  EXPECT_NE(json.find("\"traceEvents\":["), std::string::npos);
+  EXPECT_NE(json.find("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,"
+                      "\"args\":{\"name\":\"connection 2\"}}"),
+            std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"call 17 (request 9)\""), std::string::npos);
+  EXPECT_NE(json.find("{\"name\":\"query \\\"x\\\"\",\"cat\":\"mssql_connect\","
+                      "\"ph\":\"X\",\"ts\":1.500,\"dur\":0.250,\"pid\":2,"
+                      "\"tid\":17,\"args\":{\"requestId\":9}}"),
+            std::string::npos);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "transaction.h"
+
+namespace mssql_connect {
+namespace test {
+
+TEST(Transaction, ParsesIsolationLevels) {
+  IsolationLevel level = IsolationLevel::kSnapshot;
+  ASSERT_TRUE(ParseIsolationLevel("", &level));
+  EXPECT_EQ(level, IsolationLevel::kDefault);
+  ASSERT_TRUE(ParseIsolationLevel("repeatableRead", &level));
+  EXPECT_EQ(level, IsolationLevel::kRepeatableRead);
+  ASSERT_TRUE(ParseIsolationLevel("snapshot", &level));
+  EXPECT_EQ(level, IsolationLevel::kSnapshot);
+  EXPECT_FALSE(ParseIsolationLevel("chaos", &level));
+}
+
+TEST(Transaction, AcceptsOnlyPlainSavepointNames) {
+  EXPECT_TRUE(IsValidSavepointName("before_import"));
+  EXPECT_TRUE(IsValidSavepointName("_s1"));
+  EXPECT_TRUE(IsValidSavepointName(std::string(32, 'a')));
+  EXPECT_FALSE(IsValidSavepointName(""));
+  EXPECT_FALSE(IsValidSavepointName("1st"));
+  EXPECT_FALSE(IsValidSavepointName("a b"));
+  EXPECT_FALSE(IsValidSavepointName("s; DROP TABLE t"));
+  EXPECT_FALSE(IsValidSavepointName(std::string(33, 'a')));
+}
+
+TEST(Transaction, RejectsCallsOutsideATransaction) {
+  Transaction transaction(SQL_NULL_HDBC);
+  std::string error;
+
+  EXPECT_FALSE(transaction.active());
+  EXPECT_FALSE(transaction.Commit(&error));
+  EXPECT_FALSE(transaction.Rollback(&error));
+  EXPECT_FALSE(transaction.Savepoint("s1", &error));
+  EXPECT_FALSE(transaction.RollbackTo("s1", &error));
+  EXPECT_FALSE(error.empty());
+  // Nothing to roll back, so the connection is fine to reuse.
+  EXPECT_TRUE(transaction.Abandon());
+}
+
+}  // namespace test
+}  // namespace mssql_connect
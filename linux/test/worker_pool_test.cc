@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connection_pool.h"
+#include "worker_pool.h"
+
+namespace mssql_connect {
+namespace test {
+
+namespace {
+
+// Blocks callers until Open() is called.
+class Gate {
+ public:
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return open_; });
+  }
+
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      open_ = true;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool open_ = false;
+};
+
+// Opens numbered fake connections.
+class CountingFactory : public ConnectionPool::Factory {
+ public:
+  ConnectionPool::Handle Open(std::string*) override {
+    return reinterpret_cast<ConnectionPool::Handle>(
+        static_cast<intptr_t>(++opened_));
+  }
+  bool IsAlive(ConnectionPool::Handle) override { return true; }
+  void Close(ConnectionPool::Handle) override {}
+
+ private:
+  std::atomic<int> opened_{0};
+};
+
+}  // namespace
+
+TEST(WorkerPool, RunsTasksForOneKeyInOrder) {
+  std::vector<int> order;
+  std::mutex order_mutex;
+  Gate done;
+  {
+    WorkerPool pool(4);
+    for (int i = 0; i < 100; ++i) {
+      pool.Post(7, [i, &order, &order_mutex, &done]() {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        order.push_back(i);
+        if (i == 99) {
+          done.Open();
+        }
+      });
+    }
+    done.Wait();
+  }
+  ASSERT_EQ(order.size(), 100u);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(WorkerPool, NeverOverlapsTasksForOneKey) {
+  std::atomic<int> running(0);
+  std::atomic<int> max_running(0);
+  std::atomic<int> finished(0);
+  Gate done;
+  {
+    WorkerPool pool(4);
+    for (int i = 0; i < 50; ++i) {
+      pool.Post(1, [&]() {
+        int now = ++running;
+        int seen = max_running.load();
+        while (now > seen && !max_running.compare_exchange_weak(seen, now)) {
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        --running;
+        if (++finished == 50) {
+          done.Open();
+        }
+      });
+    }
+    done.Wait();
+  }
+  EXPECT_EQ(max_running.load(), 1);
+}
+
+TEST(WorkerPool, RunsDifferentKeysInParallel) {
+  // The first task only finishes once the second one has started, which
+  // deadlocks unless the two keys run on separate workers.
+  Gate first_may_finish;
+  Gate both_done;
+  std::atomic<int> finished(0);
+  {
+    WorkerPool pool(2);
+    pool.Post(1, [&]() {
+      first_may_finish.Wait();
+      if (++finished == 2) {
+        both_done.Open();
+      }
+    });
+    pool.Post(2, [&]() {
+      first_may_finish.Open();
+      if (++finished == 2) {
+        both_done.Open();
+      }
+    });
+    both_done.Wait();
+  }
+  EXPECT_EQ(finished.load(), 2);
+}
+
+TEST(WorkerPool, HoldsKeyUntilAsyncTaskReleases) {
+  WorkerPool::Task release;
+  std::mutex release_mutex;
+  Gate started;
+  Gate next_ran;
+  std::atomic<bool> released(false);
+  std::atomic<bool> ran_early(false);
+  {
+    WorkerPool pool(2);
+    pool.PostAsync(3, [&](WorkerPool::Task done) {
+      std::lock_guard<std::mutex> lock(release_mutex);
+      release = std::move(done);
+      started.Open();
+    });
+    pool.Post(3, [&]() {
+      ran_early = !released;
+      next_ran.Open();
+    });
+    started.Wait();
+    // The first task has returned, but the key stays busy until released.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    released = true;
+    {
+      std::lock_guard<std::mutex> lock(release_mutex);
+      release();
+    }
+    next_ran.Wait();
+  }
+  EXPECT_FALSE(ran_early.load());
+}
+
+TEST(WorkerPool, ServesMoreAcquiresThanThreadsWithoutBlocking) {
+  ConnectionPoolOptions options;
+  options.max_size = 1;
+  options.acquire_timeout = std::chrono::seconds(30);
+  ConnectionPool connections(std::make_unique<CountingFactory>(), options);
+
+  const int kCalls = 8;
+  std::mutex mutex;
+  std::condition_variable finished_cv;
+  int finished = 0;
+  {
+    WorkerPool pool(2);
+    for (int i = 0; i < kCalls; ++i) {
+      // Like the plugin's acquire calls: no worker waits for the pool. The
+      // release call, queued on the same workers, completes the next one.
+      pool.Post([&]() {
+        connections.AcquireAsync(&pool, [&](ConnectionPool::Handle handle,
+                                            const std::string& error) {
+          EXPECT_NE(handle, nullptr) << error;
+          pool.Post([&, handle]() {
+            connections.Release(handle);
+            std::lock_guard<std::mutex> lock(mutex);
+            ++finished;
+            finished_cv.notify_all();
+          });
+        });
+      });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    EXPECT_TRUE(finished_cv.wait_for(lock, std::chrono::seconds(5),
+                                     [&]() { return finished == kCalls; }));
+  }
+  EXPECT_EQ(connections.stats().creations, 1u);
+  EXPECT_EQ(connections.stats().timeouts, 0u);
+}
+
+TEST(WorkerPool, DestructorDropsQueuedTasks) {
+  Gate release;
+  Gate started;
+  std::atomic<int> ran(0);
+  {
+    WorkerPool pool(1);
+    pool.Post(1, [&]() {
+      started.Open();
+      release.Wait();
+      ++ran;
+    });
+    for (int i = 0; i < 10; ++i) {
+      pool.Post(1, [&]() { ++ran; });
+    }
+    started.Wait();
+    release.Open();
+  }
+  // Only the task that was already running is guaranteed to have run; the
+  // ones queued behind it may be discarded during shutdown.
+  EXPECT_GE(ran.load(), 1);
+  EXPECT_LE(ran.load(), 11);
+}
+
+}  // namespace test
+}  // namespace mssql_connect
@@ -0,0 +1,225 @@
+#include "async_reactor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace mssql_connect {
+
+namespace {
+
+// Asks the driver whether |stmt|'s asynchronous call has finished, the way
+// |operation| was started. Returns false while it is still executing.
+template <typename Operation>
+bool Poll(Operation* operation, SQLRETURN* ret) {
+#ifdef _WIN32
+  if (operation->event) {
+    if (WaitForSingleObject(operation->event, 0) != WAIT_OBJECT_0) {
+      return false;
+    }
+    if (!SQL_SUCCEEDED(SQLCompleteAsync(SQL_HANDLE_STMT, operation->stmt, ret))) {
+      *ret = SQL_ERROR;
+    }
+    return true;
+  }
+#endif
+  *ret = operation->call();
+  return *ret != SQL_STILL_EXECUTING;
+}
+
+}  // namespace
+
+AsyncReactor::AsyncReactor(const Options& options) : options_(options) {
+  size_t thread_count = std::max<size_t>(1, options_.thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    loops_.push_back(std::unique_ptr<Loop>(new Loop()));
+  }
+  for (auto& loop : loops_) {
+#ifdef _WIN32
+    loop->wake_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+#endif
+    Loop* raw = loop.get();
+    loop->thread = std::thread([this, raw]() { Run(raw); });
+  }
+}
+
+AsyncReactor::~AsyncReactor() {
+  for (auto& loop : loops_) {
+    {
+      std::lock_guard<std::mutex> lock(loop->mutex);
+      loop->stopping = true;
+    }
+    loop->wake.notify_all();
+#ifdef _WIN32
+    SetEvent(loop->wake_event);
+#endif
+  }
+  for (auto& loop : loops_) {
+    loop->thread.join();
+#ifdef _WIN32
+    CloseHandle(loop->wake_event);
+#endif
+  }
+}
+
+void AsyncReactor::Submit(SQLHSTMT stmt, Call call, Done done) {
+  ++submitted_;
+  Operation operation{stmt, std::move(call), std::move(done)};
+  if (!SQL_SUCCEEDED(SQLSetStmtAttr(stmt, SQL_ATTR_ASYNC_ENABLE,
+                                    (SQLPOINTER)SQL_ASYNC_ENABLE_ON,
+                                    SQL_IS_UINTEGER))) {
+    // The driver only runs this statement synchronously.
+    ++synchronous_;
+    Finish(&operation, operation.call());
+    return;
+  }
+#ifdef _WIN32
+  if (options_.use_events) {
+    // Manual reset: the WaitForMultipleObjects that wakes the loop must not
+    // consume the signal that Poll() then checks for. Each event serves one
+    // execution and is closed by Finish(), so it is never reset.
+    operation.event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (operation.event &&
+        !SQL_SUCCEEDED(SQLSetStmtAttr(stmt, SQL_ATTR_ASYNC_STMT_EVENT,
+                                      operation.event, SQL_IS_POINTER))) {
+      CloseHandle(operation.event);
+      operation.event = nullptr;
+    }
+  }
+#endif
+
+  SQLRETURN ret = operation.call();
+  if (ret != SQL_STILL_EXECUTING) {
+    Finish(&operation, ret);
+    return;
+  }
+
+  Loop* loop = loops_.front().get();
+  for (auto& candidate : loops_) {
+    if (candidate->load < loop->load) {
+      loop = candidate.get();
+    }
+  }
+  ++loop->load;
+  ++in_flight_;
+  {
+    std::lock_guard<std::mutex> lock(loop->mutex);
+    loop->incoming.push_back(std::move(operation));
+  }
+  loop->wake.notify_one();
+#ifdef _WIN32
+  SetEvent(loop->wake_event);
+#endif
+}
+
+AsyncReactorStats AsyncReactor::stats() const {
+  AsyncReactorStats stats;
+  stats.submitted = submitted_;
+  stats.synchronous = synchronous_;
+  stats.in_flight = in_flight_;
+  stats.polls = polls_;
+  return stats;
+}
+
+void AsyncReactor::Run(Loop* loop) {
+  std::vector<Operation> active;
+  std::chrono::microseconds interval = options_.min_poll_interval;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(loop->mutex);
+      if (active.empty()) {
+        loop->wake.wait(lock, [loop]() {
+          return loop->stopping || !loop->incoming.empty();
+        });
+      }
+      for (Operation& operation : loop->incoming) {
+        active.push_back(std::move(operation));
+      }
+      loop->incoming.clear();
+      if (loop->stopping) {
+        break;
+      }
+    }
+
+    bool progressed = false;
+    for (size_t i = 0; i < active.size();) {
+      SQLRETURN ret;
+      if (!Poll(&active[i], &ret)) {
+        ++polls_;
+        ++i;
+        continue;
+      }
+      Finish(&active[i], ret);
+      --loop->load;
+      --in_flight_;
+      active[i] = std::move(active.back());
+      active.pop_back();
+      progressed = true;
+    }
+    if (active.empty()) {
+      continue;
+    }
+    interval = progressed ? options_.min_poll_interval
+                          : std::min(interval * 2, options_.max_poll_interval);
+
+#ifdef _WIN32
+    // With an event for every statement there is nothing to poll: sleep
+    // until one of them, or new work, is signalled.
+    bool all_events = active.size() < MAXIMUM_WAIT_OBJECTS;
+    for (const Operation& operation : active) {
+      all_events = all_events && operation.event;
+    }
+    if (all_events) {
+      std::vector<HANDLE> handles;
+      handles.reserve(active.size() + 1);
+      handles.push_back(loop->wake_event);
+      for (const Operation& operation : active) {
+        handles.push_back(operation.event);
+      }
+      WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE,
+                             INFINITE);
+      continue;
+    }
+#endif
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->wake.wait_for(lock, interval, [loop]() {
+      return loop->stopping || !loop->incoming.empty();
+    });
+  }
+
+  // Shutting down: cancel what is still executing and wait for the driver
+  // to acknowledge it.
+  for (Operation& operation : active) {
+    SQLCancel(operation.stmt);
+  }
+  for (Operation& operation : active) {
+    SQLRETURN ret;
+    while (!Poll(&operation, &ret)) {
+      std::this_thread::sleep_for(options_.max_poll_interval);
+    }
+    Finish(&operation, ret);
+    --loop->load;
+    --in_flight_;
+  }
+}
+
+void AsyncReactor::Finish(Operation* operation, SQLRETURN ret) {
+  Done done = std::move(operation->done);
+  operation->call = nullptr;
+  done(ret);
+#ifdef _WIN32
+  if (operation->event) {
+    CloseHandle(operation->event);
+    operation->event = nullptr;
+  }
+#endif
+}
+
+void AsyncReactor::EndAsync(SQLHSTMT stmt) {
+#ifdef _WIN32
+  SQLSetStmtAttr(stmt, SQL_ATTR_ASYNC_STMT_EVENT, nullptr, SQL_IS_POINTER);
+#endif
+  SQLSetStmtAttr(stmt, SQL_ATTR_ASYNC_ENABLE, (SQLPOINTER)SQL_ASYNC_ENABLE_OFF,
+                 SQL_IS_UINTEGER);
+}
+
+}  // namespace mssql_connect
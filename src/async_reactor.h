@@ -0,0 +1,134 @@
+#ifndef MSSQL_CONNECT_ASYNC_REACTOR_H_
+#define MSSQL_CONNECT_ASYNC_REACTOR_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mssql_connect {
+
+struct AsyncReactorStats {
+  // Statements submitted, and those that the driver ran synchronously
+  // because it does not support statement-level asynchronous execution.
+  uint64_t submitted = 0;
+  uint64_t synchronous = 0;
+  // Statements currently executing.
+  uint64_t in_flight = 0;
+  // Calls that found a statement still executing.
+  uint64_t polls = 0;
+};
+
+// Runs statements in ODBC asynchronous mode so that a few threads can wait
+// on many executions at once.
+//
+// Submit() switches a statement to SQL_ATTR_ASYNC_ENABLE and starts the
+// call. If the driver answers SQL_STILL_EXECUTING, the statement is handed
+// to one of the reactor's threads, which resumes it until it completes and
+// then reports the final return code. On Windows the reactor first asks the
+// driver for completion events (SQL_ATTR_ASYNC_STMT_EVENT) and, while every
+// statement on a thread has one, sleeps in WaitForMultipleObjects and
+// finishes them with SQLCompleteAsync. Otherwise it polls: the call is
+// repeated with the same arguments, as ODBC requires, backing off from
+// |min_poll_interval| to |max_poll_interval| while nothing completes.
+//
+// SQLCancel works as usual on a statement the reactor is driving: the next
+// poll or completion reports SQLSTATE HY008.
+class AsyncReactor {
+ public:
+  // The asynchronous call, e.g. SQLExecute on the statement. Called again
+  // with the same arguments until it stops returning SQL_STILL_EXECUTING.
+  using Call = std::function<SQLRETURN()>;
+
+  // Receives the call's final return code. The statement is left in
+  // asynchronous mode so that its diagnostics survive: read them, then call
+  // EndAsync() before using the statement synchronously. Runs on a reactor
+  // thread, or inline in Submit() if the call finishes right away; it should
+  // hand any blocking work, such as fetching, to another thread.
+  using Done = std::function<void(SQLRETURN)>;
+
+  struct Options {
+    size_t thread_count = 2;
+    std::chrono::microseconds min_poll_interval{50};
+    std::chrono::microseconds max_poll_interval{2000};
+    // Ask for completion events where the platform has them.
+    bool use_events = true;
+  };
+
+  explicit AsyncReactor(const Options& options);
+
+  // Stops the threads. Statements still executing are cancelled and their
+  // Done callbacks run with the result of the cancellation.
+  ~AsyncReactor();
+
+  AsyncReactor(const AsyncReactor&) = delete;
+  AsyncReactor& operator=(const AsyncReactor&) = delete;
+
+  // Starts |call| on |stmt| in asynchronous mode and calls |done| once it
+  // has finished. |stmt| must stay allocated, and anything the call reads
+  // (such as bound parameters) valid, until then.
+  void Submit(SQLHSTMT stmt, Call call, Done done);
+
+  // Switches |stmt| back to synchronous execution after its Done callback.
+  // Resets the statement's diagnostics.
+  static void EndAsync(SQLHSTMT stmt);
+
+  AsyncReactorStats stats() const;
+
+  size_t thread_count() const { return loops_.size(); }
+
+ private:
+  struct Operation {
+    SQLHSTMT stmt;
+    Call call;
+    Done done;
+#ifdef _WIN32
+    // Completion event, or nullptr when the statement is polled.
+    HANDLE event = nullptr;
+#endif
+  };
+
+  // One reactor thread and the statements it drives.
+  struct Loop {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Operation> incoming;
+    bool stopping = false;
+    std::atomic<size_t> load{0};
+#ifdef _WIN32
+    // Signalled with |wake| so a thread waiting on completion events sees
+    // new work.
+    HANDLE wake_event = nullptr;
+#endif
+    std::thread thread;
+  };
+
+  void Run(Loop* loop);
+
+  // Reports |ret| to |operation|'s Done callback and releases its event.
+  void Finish(Operation* operation, SQLRETURN ret);
+
+  const Options options_;
+  std::vector<std::unique_ptr<Loop>> loops_;
+
+  std::atomic<uint64_t> submitted_{0};
+  std::atomic<uint64_t> synchronous_{0};
+  std::atomic<uint64_t> in_flight_{0};
+  std::atomic<uint64_t> polls_{0};
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_ASYNC_REACTOR_H_
@@ -0,0 +1,145 @@
+#include "batch_executor.h"
+
+#include <algorithm>
+
+#include "odbc_error.h"
+
+namespace mssql_connect {
+
+namespace {
+
+BatchRowStatus ToRowStatus(SQLUSMALLINT status) {
+  switch (status) {
+    case SQL_PARAM_SUCCESS:
+      return BatchRowStatus::kSuccess;
+    case SQL_PARAM_SUCCESS_WITH_INFO:
+      return BatchRowStatus::kSuccessWithInfo;
+    case SQL_PARAM_ERROR:
+      return BatchRowStatus::kError;
+    case SQL_PARAM_DIAG_UNAVAILABLE:
+      // The driver ran the array as one unit and cannot tell which row
+      // failed; the row did not complete.
+      return BatchRowStatus::kError;
+    default:
+      return BatchRowStatus::kUnused;
+  }
+}
+
+}  // namespace
+
+const size_t BatchExecutor::kDefaultBatchSize;
+const size_t BatchExecutor::kMaxBatchBytes;
+
+BatchExecutor::BatchExecutor(SQLHSTMT stmt, size_t batch_size)
+    : stmt_(stmt), batch_size_(std::max<size_t>(1, batch_size)) {}
+
+bool BatchExecutor::Execute(const std::vector<std::vector<SqlParameter>>& rows,
+                            BatchResult* result, std::string* error) {
+  result->rows_affected = 0;
+  result->statuses.assign(rows.size(), BatchRowStatus::kUnused);
+  result->error.clear();
+  if (rows.empty()) {
+    return true;
+  }
+  for (size_t row = 1; row < rows.size(); ++row) {
+    if (rows[row].size() != rows[0].size()) {
+      *error = "Row " + std::to_string(row + 1) + " has " +
+               std::to_string(rows[row].size()) + " values, expected " +
+               std::to_string(rows[0].size());
+      return false;
+    }
+  }
+
+  std::vector<SQLUSMALLINT> statuses(std::min(batch_size_, rows.size()));
+  SQLULEN processed = 0;
+  SQLSetStmtAttr(stmt_, SQL_ATTR_PARAM_BIND_TYPE,
+                 (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0);
+  SQLSetStmtAttr(stmt_, SQL_ATTR_PARAM_STATUS_PTR, statuses.data(), 0);
+  SQLSetStmtAttr(stmt_, SQL_ATTR_PARAMS_PROCESSED_PTR, &processed, 0);
+
+  ParameterArrayBinder binder;
+  size_t first = 0;
+  bool ok = true;
+  while (first < rows.size()) {
+    size_t count = NextBatchSize(rows, first);
+    if (!binder.Bind(stmt_, rows, first, count, error)) {
+      ok = false;
+      break;
+    }
+    SQLSetStmtAttr(stmt_, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)count,
+                   0);
+    std::fill(statuses.begin(), statuses.begin() + count, SQL_PARAM_UNUSED);
+    processed = 0;
+
+    SQLRETURN ret = SQLExecute(stmt_);
+    if (ret == SQL_ERROR && processed == 0) {
+      result->error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+      if (result->error.empty()) {
+        result->error = "Batch execution failed";
+      }
+      std::fill(result->statuses.begin() + first,
+                result->statuses.begin() + first + count,
+                BatchRowStatus::kError);
+      break;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      result->statuses[first + i] = ToRowStatus(statuses[i]);
+    }
+    if (ret != SQL_NO_DATA) {
+      result->rows_affected += CollectRowCounts();
+    }
+    SQLFreeStmt(stmt_, SQL_CLOSE);
+    first += count;
+  }
+
+  Reset();
+  return ok;
+}
+
+size_t BatchExecutor::NextBatchSize(
+    const std::vector<std::vector<SqlParameter>>& rows, size_t first) const {
+  // Every element of a column is as wide as the column's widest value.
+  std::vector<size_t> widths(rows[first].size(), 0);
+  size_t count = 0;
+  while (first + count < rows.size() && count < batch_size_) {
+    const std::vector<SqlParameter>& row = rows[first + count];
+    size_t row_bytes = 0;
+    for (size_t i = 0; i < row.size(); ++i) {
+      row_bytes +=
+          std::max(widths[i], ParameterArrayBinder::ElementBytes(row[i]));
+    }
+    if (count > 0 && row_bytes * (count + 1) > kMaxBatchBytes) {
+      break;
+    }
+    for (size_t i = 0; i < row.size(); ++i) {
+      widths[i] =
+          std::max(widths[i], ParameterArrayBinder::ElementBytes(row[i]));
+    }
+    ++count;
+  }
+  return count;
+}
+
+int64_t BatchExecutor::CollectRowCounts() {
+  // Drivers report either one count for the whole array or one result per
+  // parameter set.
+  int64_t total = 0;
+  SQLRETURN ret;
+  do {
+    SQLLEN count = 0;
+    if (SQL_SUCCEEDED(SQLRowCount(stmt_, &count)) && count > 0) {
+      total += count;
+    }
+    ret = SQLMoreResults(stmt_);
+  } while (SQL_SUCCEEDED(ret));
+  return total;
+}
+
+void BatchExecutor::Reset() {
+  SQLFreeStmt(stmt_, SQL_RESET_PARAMS);
+  SQLSetStmtAttr(stmt_, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+  SQLSetStmtAttr(stmt_, SQL_ATTR_PARAM_STATUS_PTR, nullptr, 0);
+  SQLSetStmtAttr(stmt_, SQL_ATTR_PARAMS_PROCESSED_PTR, nullptr, 0);
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,79 @@
+#ifndef MSSQL_CONNECT_BATCH_EXECUTOR_H_
+#define MSSQL_CONNECT_BATCH_EXECUTOR_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "parameter_binder.h"
+
+namespace mssql_connect {
+
+// Outcome of one row of a batch.
+enum class BatchRowStatus {
+  kSuccess,
+  kSuccessWithInfo,
+  kError,
+  // Not executed because an earlier batch failed or the driver skipped it.
+  kUnused,
+};
+
+struct BatchResult {
+  // Sum of the row counts the driver reported.
+  int64_t rows_affected = 0;
+  // One entry per input row.
+  std::vector<BatchRowStatus> statuses;
+  // Diagnostics of the batch that failed, if any.
+  std::string error;
+};
+
+// Executes a prepared statement once per row of parameters, sending the rows
+// in batches of parameter arrays (SQL_ATTR_PARAMSET_SIZE) so each batch is a
+// single round trip.
+//
+// A batch holds at most |batch_size| rows and is cut short when its arrays
+// would exceed kMaxBatchBytes. Rows the driver rejects are reported in
+// BatchResult::statuses without stopping the batch. If a batch fails as a
+// whole, its diagnostics go to BatchResult::error and later rows are left
+// unused.
+class BatchExecutor {
+ public:
+  static const size_t kDefaultBatchSize = 1000;
+  static const size_t kMaxBatchBytes = 16 * 1024 * 1024;
+
+  BatchExecutor(SQLHSTMT stmt, size_t batch_size);
+
+  BatchExecutor(const BatchExecutor&) = delete;
+  BatchExecutor& operator=(const BatchExecutor&) = delete;
+
+  // Runs every row of |rows|. Returns false and fills |error| if the rows
+  // could not be sent at all (mismatched widths, binding failures); a
+  // failure during execution is reported through |result| instead.
+  bool Execute(const std::vector<std::vector<SqlParameter>>& rows,
+               BatchResult* result, std::string* error);
+
+ private:
+  // Number of rows starting at |first| that fit in one batch.
+  size_t NextBatchSize(const std::vector<std::vector<SqlParameter>>& rows,
+                       size_t first) const;
+
+  // Adds the row counts of every result the last execution produced.
+  int64_t CollectRowCounts();
+
+  // Restores single-row execution so the statement can be reused.
+  void Reset();
+
+  SQLHSTMT stmt_;
+  size_t batch_size_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_BATCH_EXECUTOR_H_
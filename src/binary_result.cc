@@ -0,0 +1,348 @@
+#include "binary_result.h"
+
+#include <cstring>
+
+namespace mssql_connect {
+
+namespace {
+
+size_t Pad(size_t bytes) { return (bytes + 7) & ~static_cast<size_t>(7); }
+
+BinaryColumnType TypeOf(CellType type) {
+  switch (type) {
+    case CellType::kBool:
+      return BinaryColumnType::kBool;
+    case CellType::kInt32:
+    case CellType::kInt64:
+      return BinaryColumnType::kInt64;
+    case CellType::kDouble:
+      return BinaryColumnType::kDouble;
+    case CellType::kDecimal:
+      return BinaryColumnType::kDecimal;
+    case CellType::kDateTime:
+      return BinaryColumnType::kDateTime;
+    case CellType::kTime:
+      return BinaryColumnType::kTime;
+    case CellType::kGuid:
+      return BinaryColumnType::kGuid;
+    case CellType::kBinary:
+      return BinaryColumnType::kBinary;
+    case CellType::kText:
+      break;
+  }
+  return BinaryColumnType::kText;
+}
+
+bool IsVariable(const ResultColumn& column) {
+  return column.type == CellType::kText || column.type == CellType::kBinary ||
+         (column.type == CellType::kDecimal && column.decimal_text);
+}
+
+// Bytes of |column|'s string heap.
+size_t HeapBytes(const ResultColumn& column) {
+  size_t bytes = 0;
+  if (column.type == CellType::kBinary) {
+    for (const std::vector<uint8_t>& value : column.binaries) {
+      bytes += value.size();
+    }
+  } else {
+    for (const std::string& value : column.strings) {
+      bytes += value.size();
+    }
+  }
+  return bytes;
+}
+
+// Appends to a buffer sized up front, so nothing is reallocated.
+class Writer {
+ public:
+  explicit Writer(std::vector<uint8_t>* out) : out_(out) {}
+
+  void Bytes(const void* data, size_t size) {
+    if (size > 0) {
+      std::memcpy(out_->data() + position_, data, size);
+      position_ += size;
+    }
+  }
+  template <typename T>
+  void Value(T value) {
+    Bytes(&value, sizeof(value));
+  }
+  // Zero-fills up to the next multiple of 8.
+  void Align() {
+    size_t aligned = Pad(position_);
+    std::memset(out_->data() + position_, 0, aligned - position_);
+    position_ = aligned;
+  }
+
+ private:
+  std::vector<uint8_t>* out_;
+  size_t position_ = 0;
+};
+
+// Bytes of a column descriptor naming |name|.
+size_t DescriptorBytes(const std::string& name) { return 8 + Pad(name.size()); }
+
+void WriteDescriptor(Writer* writer, BinaryColumnType type, uint8_t flags,
+                     int scale, const std::string& name) {
+  writer->Value(static_cast<uint8_t>(type));
+  writer->Value(flags);
+  writer->Value(static_cast<int16_t>(scale));
+  writer->Value(static_cast<uint32_t>(name.size()));
+  writer->Bytes(name.data(), name.size());
+  writer->Align();
+}
+
+void WriteHeader(Writer* writer, size_t rows, size_t columns) {
+  writer->Bytes("MSR1", 4);
+  writer->Value(static_cast<uint32_t>(rows));
+  writer->Value(static_cast<uint32_t>(columns));
+  writer->Value(static_cast<uint32_t>(0));
+}
+
+}  // namespace
+
+size_t BinaryCellWidth(BinaryColumnType type) {
+  switch (type) {
+    case BinaryColumnType::kBool:
+      return 1;
+    case BinaryColumnType::kGuid:
+      return 16;
+    case BinaryColumnType::kText:
+    case BinaryColumnType::kBinary:
+      return 0;
+    default:
+      return 8;
+  }
+}
+
+void EncodeBinaryResult(const ColumnarResult& result, std::vector<uint8_t>* out) {
+  size_t rows = result.row_count;
+  size_t size = 16;
+  for (const ResultColumn& column : result.columns) {
+    size += DescriptorBytes(column.name);
+    if (!column.null_bitmap.empty()) {
+      size += Pad((rows + 7) / 8);
+    }
+    if (IsVariable(column)) {
+      size += Pad((rows + 1) * sizeof(uint32_t)) + Pad(HeapBytes(column));
+    } else {
+      size += Pad(rows * BinaryCellWidth(TypeOf(column.type)));
+    }
+  }
+  out->resize(size);
+
+  Writer writer(out);
+  WriteHeader(&writer, rows, result.columns.size());
+  for (const ResultColumn& column : result.columns) {
+    uint8_t flags = 0;
+    if (!column.null_bitmap.empty()) {
+      flags |= kBinaryHasNulls;
+    }
+    if (IsVariable(column)) {
+      flags |= kBinaryVariable;
+    }
+    WriteDescriptor(&writer, TypeOf(column.type), flags, column.scale,
+                    column.name);
+  }
+
+  for (const ResultColumn& column : result.columns) {
+    if (!column.null_bitmap.empty()) {
+      // FinishColumnar() padded the bitmap to cover every row.
+      writer.Bytes(column.null_bitmap.data(), (rows + 7) / 8);
+      writer.Align();
+    }
+    switch (column.type) {
+      case CellType::kBool:
+        writer.Bytes(column.bools.data(), rows);
+        break;
+      case CellType::kDouble:
+        writer.Bytes(column.doubles.data(), rows * sizeof(double));
+        break;
+      case CellType::kGuid:
+        for (const std::vector<uint8_t>& guid : column.binaries) {
+          uint8_t bytes[16] = {};
+          std::memcpy(bytes, guid.data(), guid.size() < 16 ? guid.size() : 16);
+          writer.Bytes(bytes, sizeof(bytes));
+        }
+        break;
+      case CellType::kText:
+      case CellType::kBinary:
+      case CellType::kDecimal: {
+        if (!IsVariable(column)) {
+          writer.Bytes(column.ints.data(), rows * sizeof(int64_t));
+          break;
+        }
+        bool binary = column.type == CellType::kBinary;
+        uint32_t offset = 0;
+        writer.Value(offset);
+        for (size_t r = 0; r < rows; ++r) {
+          offset += static_cast<uint32_t>(binary ? column.binaries[r].size()
+                                                 : column.strings[r].size());
+          writer.Value(offset);
+        }
+        writer.Align();
+        for (size_t r = 0; r < rows; ++r) {
+          if (binary) {
+            writer.Bytes(column.binaries[r].data(), column.binaries[r].size());
+          } else {
+            writer.Bytes(column.strings[r].data(), column.strings[r].size());
+          }
+        }
+        break;
+      }
+      default:
+        writer.Bytes(column.ints.data(), rows * sizeof(int64_t));
+        break;
+    }
+    writer.Align();
+  }
+}
+
+void BinaryResultSink::Start(const BlockFetcher& fetcher) {
+  const std::vector<ColumnDescription>& descriptions = fetcher.columns();
+  columns_.assign(descriptions.size(), Column());
+  row_count_ = 0;
+  for (size_t i = 0; i < descriptions.size(); ++i) {
+    Column& column = columns_[i];
+    column.name = descriptions[i].name;
+    column.cell_type = fetcher.cell_type(i);
+    column.type = TypeOf(column.cell_type);
+    if (column.cell_type == CellType::kDecimal) {
+      column.scale = fetcher.decimal_scale(i);
+    }
+    column.variable = column.cell_type == CellType::kText ||
+                      column.cell_type == CellType::kBinary ||
+                      (column.cell_type == CellType::kDecimal &&
+                       IsDecimalText(descriptions[i]));
+  }
+}
+
+void BinaryResultSink::AddRow(const BlockFetcher& fetcher, size_t row) {
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    Column& column = columns_[i];
+    bool is_null = fetcher.IsNull(i, row);
+    if (is_null) {
+      if (column.null_bitmap.size() <= row_count_ / 8) {
+        column.null_bitmap.resize(row_count_ / 8 + 1, 0);
+      }
+      column.null_bitmap[row_count_ / 8] |=
+          static_cast<uint8_t>(1u << (row_count_ % 8));
+    }
+    if (column.variable) {
+      // Text and decimals are appended to the heap in place.
+      if (!is_null && !fetcher.IsLob(i)) {
+        if (column.cell_type == CellType::kText) {
+          fetcher.AppendText(i, row, &column.heap);
+        } else if (column.cell_type == CellType::kDecimal) {
+          fetcher.AppendDecimal(i, row, &column.heap);
+        } else {
+          size_t size = 0;
+          const uint8_t* data = fetcher.GetBinary(i, row, &size);
+          column.heap.append(reinterpret_cast<const char*>(data), size);
+        }
+      }
+      column.ends.push_back(static_cast<uint32_t>(column.heap.size()));
+      continue;
+    }
+    size_t offset = column.cells.size();
+    column.cells.resize(offset + BinaryCellWidth(column.type), 0);
+    if (is_null) {
+      continue;
+    }
+    uint8_t* cell = column.cells.data() + offset;
+    int64_t value = 0;
+    switch (column.cell_type) {
+      case CellType::kBool:
+        *cell = fetcher.GetBool(i, row) ? 1 : 0;
+        continue;
+      case CellType::kDouble: {
+        double number = fetcher.GetDouble(i, row);
+        std::memcpy(cell, &number, sizeof(number));
+        continue;
+      }
+      case CellType::kGuid:
+        fetcher.GetGuid(i, row, cell);
+        continue;
+      case CellType::kInt32:
+        value = fetcher.GetInt32(i, row);
+        break;
+      case CellType::kInt64:
+        value = fetcher.GetInt64(i, row);
+        break;
+      case CellType::kDecimal:
+        fetcher.GetDecimal(i, row, &value);
+        break;
+      case CellType::kDateTime:
+      case CellType::kTime:
+        value = fetcher.GetMicros(i, row);
+        break;
+      case CellType::kText:
+      case CellType::kBinary:
+        break;
+    }
+    std::memcpy(cell, &value, sizeof(value));
+  }
+  ++row_count_;
+}
+
+void BinaryResultSink::Finish() {
+  size_t rows = row_count_;
+  size_t size = 16;
+  for (Column& column : columns_) {
+    size += DescriptorBytes(column.name);
+    if (!column.null_bitmap.empty()) {
+      column.null_bitmap.resize((rows + 7) / 8, 0);
+      size += Pad(column.null_bitmap.size());
+    }
+    if (column.variable) {
+      size += Pad((rows + 1) * sizeof(uint32_t)) + Pad(column.heap.size());
+    } else {
+      size += Pad(column.cells.size());
+    }
+  }
+  out_->resize(size);
+
+  Writer writer(out_);
+  WriteHeader(&writer, rows, columns_.size());
+  for (const Column& column : columns_) {
+    uint8_t flags = 0;
+    if (!column.null_bitmap.empty()) {
+      flags |= kBinaryHasNulls;
+    }
+    if (column.variable) {
+      flags |= kBinaryVariable;
+    }
+    WriteDescriptor(&writer, column.type, flags, column.scale, column.name);
+  }
+  for (Column& column : columns_) {
+    if (!column.null_bitmap.empty()) {
+      writer.Bytes(column.null_bitmap.data(), column.null_bitmap.size());
+      writer.Align();
+    }
+    if (column.variable) {
+      writer.Value(static_cast<uint32_t>(0));
+      writer.Bytes(column.ends.data(), column.ends.size() * sizeof(uint32_t));
+      writer.Align();
+      writer.Bytes(column.heap.data(), column.heap.size());
+    } else {
+      writer.Bytes(column.cells.data(), column.cells.size());
+    }
+    writer.Align();
+    // The blocks are copied out; drop them as the buffer fills up.
+    column = Column();
+  }
+}
+
+void EncodeBinaryError(const std::string& code, const std::string& message,
+                       std::vector<uint8_t>* out) {
+  out->resize(12 + code.size() + message.size());
+  Writer writer(out);
+  writer.Bytes("MSE1", 4);
+  writer.Value(static_cast<uint32_t>(code.size()));
+  writer.Bytes(code.data(), code.size());
+  writer.Value(static_cast<uint32_t>(message.size()));
+  writer.Bytes(message.data(), message.size());
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,107 @@
+#ifndef MSSQL_CONNECT_BINARY_RESULT_H_
+#define MSSQL_CONNECT_BINARY_RESULT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "columnar_result.h"
+
+namespace mssql_connect {
+
+// A compact result encoding sent as one byte buffer on the
+// "mssql_connect/binary" channel, so a reply needs neither a tagged
+// per-value encoding nor per-row maps. The Dart side reads it lazily through
+// ByteData views (QueryResult.fromBinary).
+//
+// Numbers are in host byte order, which is little-endian on every platform
+// Flutter runs on. Every block starts at a multiple of 8 bytes from the start
+// of the buffer.
+//
+//   Header
+//     char[4]  "MSR1"
+//     u32      row count
+//     u32      column count
+//     u32      reserved, 0
+//   Column descriptors, one per column
+//     u8       type (BinaryColumnType)
+//     u8       flags (kBinaryHasNulls, kBinaryVariable)
+//     i16      scale of decimal columns
+//     u32      name length in bytes, followed by the UTF-8 name, padded
+//   Column blocks, in column order
+//     null bitmap, (rows + 7) / 8 bytes, if kBinaryHasNulls; bit (row % 8)
+//       of byte (row / 8) is set for NULL cells
+//     fixed-width columns: row count cells of BinaryCellWidth() bytes
+//     variable-width columns: row count + 1 u32 offsets, then the string
+//       heap the offsets point into; cell r is heap[offsets[r],
+//       offsets[r + 1])
+//
+// A failed call is answered with an error frame instead:
+//     char[4]  "MSE1"
+//     u32      code length, followed by the code
+//     u32      message length, followed by the UTF-8 message
+enum class BinaryColumnType : uint8_t {
+  kBool = 0,
+  kInt64 = 1,
+  kDouble = 2,
+  kDecimal = 3,
+  kDateTime = 4,
+  kTime = 5,
+  kGuid = 6,
+  kText = 7,
+  kBinary = 8,
+};
+
+const uint8_t kBinaryHasNulls = 1;
+const uint8_t kBinaryVariable = 2;
+
+// Bytes per cell of a fixed-width column of |type|.
+size_t BinaryCellWidth(BinaryColumnType type);
+
+// Encodes |result| into |out|. Cells of LOB rows (see BlockFetcher::IsLob)
+// are sent empty.
+void EncodeBinaryResult(const ColumnarResult& result, std::vector<uint8_t>* out);
+
+// Encodes a result into |out| as it is fetched, without reading it into a
+// ColumnarResult first: cells go straight from the fetcher into per-column
+// blocks, which Finish() lays out in the order above. Cells of LOB rows are
+// sent empty.
+class BinaryResultSink : public ResultSink {
+ public:
+  explicit BinaryResultSink(std::vector<uint8_t>* out) : out_(out) {}
+
+  void Start(const BlockFetcher& fetcher) override;
+  void AddRow(const BlockFetcher& fetcher, size_t row) override;
+  void Finish() override;
+
+ private:
+  struct Column {
+    std::string name;
+    CellType cell_type = CellType::kText;
+    BinaryColumnType type = BinaryColumnType::kText;
+    int scale = 0;
+    bool variable = false;
+    // Empty until the column's first NULL.
+    std::vector<uint8_t> null_bitmap;
+    // Fixed-width columns: the cells, back to back.
+    std::vector<uint8_t> cells;
+    // Variable-width columns: the offset at which each cell ends, and the
+    // string heap.
+    std::vector<uint32_t> ends;
+    std::string heap;
+  };
+
+  std::vector<uint8_t>* out_;
+  std::vector<Column> columns_;
+  size_t row_count_ = 0;
+};
+
+// Encodes an error frame.
+void EncodeBinaryError(const std::string& code, const std::string& message,
+                       std::vector<uint8_t>* out);
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_BINARY_RESULT_H_
@@ -0,0 +1,789 @@
+#include "block_fetcher.h"
+
+#include <sqlucode.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "odbc_error.h"
+#include "scratch_pool.h"
+#include "text_encoding.h"
+
+// SQL Server's time(n) type and its C struct, from msodbcsql.h.
+#ifndef SQL_SS_TIME2
+#define SQL_SS_TIME2 (-154)
+#endif
+#ifndef SQL_C_SS_TIME2
+#define SQL_C_SS_TIME2 0x4000
+#endif
+
+namespace mssql_connect {
+
+namespace {
+
+struct SsTime2Struct {
+  SQLUSMALLINT hour;
+  SQLUSMALLINT minute;
+  SQLUSMALLINT second;
+  SQLUINTEGER fraction;
+};
+
+const int64_t kMicrosPerSecond = 1000000;
+const int64_t kMicrosPerDay = 86400 * kMicrosPerSecond;
+
+// Days from 1970-01-01 to the given proleptic Gregorian date.
+int64_t DaysFromCivil(int64_t year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+  unsigned day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  unsigned day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+int64_t TimeOfDayMicros(unsigned hour, unsigned minute, unsigned second,
+                        SQLUINTEGER fraction_ns) {
+  return ((hour * 60 + minute) * 60 + second) * kMicrosPerSecond +
+         fraction_ns / 1000;
+}
+
+// Divides the little-endian magnitude |value| by 10 in place and returns
+// the remainder.
+unsigned DivideBy10(uint8_t* value, size_t length) {
+  unsigned remainder = 0;
+  for (size_t i = length; i-- > 0;) {
+    unsigned current = (remainder << 8) | value[i];
+    value[i] = static_cast<uint8_t>(current / 10);
+    remainder = current % 10;
+  }
+  return remainder;
+}
+
+// Characters needed to render a non-character column as text, e.g. a
+// timestamp with fractional seconds or a GUID.
+const SQLULEN kMinFormattedChars = 64;
+
+// Bytes per SQLGetData call for unbounded columns.
+const size_t kGetDataChunkBytes = 8000;
+
+// Alignment of the bound arrays, enough for every C type bound.
+const size_t kArrayAlignment = 16;
+
+size_t AlignUp(size_t bytes) {
+  return (bytes + kArrayAlignment - 1) / kArrayAlignment * kArrayAlignment;
+}
+
+// UTF-8 bytes a character of a column can take: three per UTF-16 unit, and
+// a surrogate pair (two units) takes four.
+const SQLULEN kMaxUtf8BytesPerChar = 3;
+
+bool IsHighSurrogate(SQLWCHAR unit) {
+  return unit >= 0xD800 && unit <= 0xDBFF;
+}
+
+bool IsUnboundedType(SQLSMALLINT sql_type) {
+  switch (sql_type) {
+    case SQL_LONGVARCHAR:
+    case SQL_WLONGVARCHAR:
+    case SQL_LONGVARBINARY:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Characters needed for a column's text, or zero if its size is unknown or
+// unbounded.
+SQLULEN TextChars(const ColumnDescription& column) {
+  if (column.column_size == 0 || IsUnboundedType(column.sql_type)) {
+    return 0;
+  }
+  switch (column.sql_type) {
+    case SQL_CHAR:
+    case SQL_VARCHAR:
+    case SQL_WCHAR:
+    case SQL_WVARCHAR:
+      return column.column_size;
+    default:
+      return std::max(column.column_size + 2, kMinFormattedChars);
+  }
+}
+
+}  // namespace
+
+const SQLULEN BlockFetcher::kDefaultRowArraySize;
+const size_t BlockFetcher::kMaxBufferBytes;
+const SQLULEN BlockFetcher::kMaxBoundChars;
+const SQLULEN BlockFetcher::kMaxBoundBytes;
+
+BlockFetcher::BlockFetcher(SQLHSTMT stmt) : stmt_(stmt) {}
+
+BlockFetcher::~BlockFetcher() {
+  if (!bindings_.empty()) {
+    SQLFreeStmt(stmt_, SQL_UNBIND);
+    SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+    SQLSetStmtAttr(stmt_, SQL_ATTR_ROWS_FETCHED_PTR, nullptr, 0);
+    SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_STATUS_PTR, nullptr, 0);
+  }
+  ScratchPool& pool = ScratchPool::ForThisThread();
+  pool.Give(std::move(buffer_));
+  pool.Give(std::move(chunk_));
+  pool.Give(std::move(wide_));
+  pool.Give(std::move(lob_data_));
+  for (Binding& binding : bindings_) {
+    pool.Give(std::move(binding.unbound_bytes));
+  }
+  // The reply has been built, so text() is no longer in use.
+  pool.Trim();
+}
+
+bool BlockFetcher::Bind(std::string* error) {
+  SQLSMALLINT num_cols = 0;
+  if (!SQL_SUCCEEDED(SQLNumResultCols(stmt_, &num_cols))) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+    return false;
+  }
+
+  columns_.assign(num_cols, ColumnDescription());
+  SQLWCHAR name[256];
+  for (SQLSMALLINT i = 0; i < num_cols; ++i) {
+    ColumnDescription& column = columns_[i];
+    SQLSMALLINT name_length = 0;
+    SQLRETURN ret = SQLDescribeColW(stmt_, i + 1, name, 256, &name_length,
+                                    &column.sql_type, &column.column_size,
+                                    &column.decimal_digits, &column.nullable);
+    if (!SQL_SUCCEEDED(ret)) {
+      *error = "SQLDescribeCol failed.";
+      return false;
+    }
+    column.name = Utf16ToUtf8(name, std::min<SQLSMALLINT>(name_length, 255));
+  }
+  return BindColumns(error);
+}
+
+bool BlockFetcher::Bind(const std::vector<ColumnDescription>& columns,
+                        std::string* error) {
+  columns_ = columns;
+  return BindColumns(error);
+}
+
+bool BlockFetcher::BindColumns(std::string* error) {
+  size_t num_cols = columns_.size();
+  bindings_.assign(num_cols, Binding());
+  has_unbound_ = false;
+
+  size_t row_bytes = 0;
+  for (size_t i = 0; i < num_cols; ++i) {
+    const ColumnDescription& column = columns_[i];
+    Binding& binding = bindings_[i];
+    switch (column.sql_type) {
+      case SQL_BIT:
+        binding.type = CellType::kBool;
+        binding.c_type = SQL_C_BIT;
+        binding.element_size = sizeof(SQLCHAR);
+        break;
+      case SQL_INTEGER:
+      case SQL_SMALLINT:
+      case SQL_TINYINT:
+        binding.type = CellType::kInt32;
+        binding.c_type = SQL_C_SLONG;
+        binding.element_size = sizeof(SQLINTEGER);
+        break;
+      case SQL_BIGINT:
+        binding.type = CellType::kInt64;
+        binding.c_type = SQL_C_SBIGINT;
+        binding.element_size = sizeof(SQLBIGINT);
+        break;
+      case SQL_DECIMAL:
+      case SQL_NUMERIC:
+        binding.type = CellType::kDecimal;
+        binding.c_type = SQL_C_NUMERIC;
+        binding.element_size = sizeof(SQL_NUMERIC_STRUCT);
+        break;
+      case SQL_TYPE_DATE:
+      case SQL_TYPE_TIMESTAMP:
+        binding.type = CellType::kDateTime;
+        binding.c_type = SQL_C_TYPE_TIMESTAMP;
+        binding.element_size = sizeof(SQL_TIMESTAMP_STRUCT);
+        break;
+      case SQL_TYPE_TIME:
+        binding.type = CellType::kTime;
+        binding.c_type = SQL_C_TYPE_TIME;
+        binding.element_size = sizeof(SQL_TIME_STRUCT);
+        break;
+      case SQL_SS_TIME2:
+        binding.type = CellType::kTime;
+        binding.c_type = SQL_C_SS_TIME2;
+        binding.element_size = sizeof(SsTime2Struct);
+        break;
+      case SQL_GUID:
+        binding.type = CellType::kGuid;
+        binding.c_type = SQL_C_GUID;
+        binding.element_size = sizeof(SQLGUID);
+        break;
+      case SQL_FLOAT:
+      case SQL_REAL:
+      case SQL_DOUBLE:
+        binding.type = CellType::kDouble;
+        binding.c_type = SQL_C_DOUBLE;
+        binding.element_size = sizeof(SQLDOUBLE);
+        break;
+      case SQL_BINARY:
+      case SQL_VARBINARY:
+      case SQL_LONGVARBINARY:
+        binding.type = CellType::kBinary;
+        binding.c_type = SQL_C_BINARY;
+        if (column.column_size == 0 || column.column_size > kMaxBoundBytes ||
+            IsUnboundedType(column.sql_type)) {
+          has_unbound_ = true;
+        }
+        binding.element_size = (SQLLEN)std::max<SQLULEN>(column.column_size, 1);
+        break;
+      default: {
+        binding.type = CellType::kText;
+        SQLULEN chars = TextChars(column);
+        if (chars == 0 || chars > kMaxBoundChars) {
+          // Unbounded: this and every later column use SQLGetData.
+          has_unbound_ = true;
+        }
+        // A value that may be streamed lazily stays UTF-16, since LOB
+        // offsets are in UTF-16 units.
+        bool lazy = has_unbound_ && lob_threshold_ > 0 && i + 1 == num_cols;
+        if (utf8_text_ && !lazy) {
+          binding.c_type = SQL_C_CHAR;
+          binding.element_size = (SQLLEN)(chars * kMaxUtf8BytesPerChar + 1);
+        } else {
+          binding.c_type = SQL_C_WCHAR;
+          binding.element_size = (SQLLEN)((chars + 1) * sizeof(SQLWCHAR));
+        }
+        break;
+      }
+    }
+    binding.bound = !has_unbound_;
+    if (binding.bound) {
+      row_bytes += binding.element_size + sizeof(SQLLEN);
+    }
+  }
+
+  if (has_unbound_) {
+    row_array_size_ = 1;
+  } else {
+    row_array_size_ = std::max<SQLULEN>(
+        1, std::min<SQLULEN>(kDefaultRowArraySize,
+                             kMaxBufferBytes / std::max<size_t>(row_bytes, 1)));
+  }
+
+  // One buffer holds every array, each aligned for any C type.
+  std::vector<size_t> offsets;
+  size_t total = 0;
+  for (size_t i = 0; i < bindings_.size(); ++i) {
+    const Binding& binding = bindings_[i];
+    SQLULEN elements = binding.bound ? row_array_size_ : 1;
+    offsets.push_back(total);
+    total += AlignUp(sizeof(SQLLEN) * elements);
+    if (binding.bound || (binding.type != CellType::kText &&
+                          binding.type != CellType::kBinary)) {
+      offsets.push_back(total);
+      total += AlignUp(binding.element_size * elements);
+    } else {
+      offsets.push_back(SIZE_MAX);
+    }
+  }
+  ScratchPool& pool = ScratchPool::ForThisThread();
+  pool.Give(std::move(buffer_));
+  buffer_ = pool.Take(total);
+  for (size_t i = 0; i < bindings_.size(); ++i) {
+    Binding& binding = bindings_[i];
+    binding.indicators = reinterpret_cast<SQLLEN*>(buffer_.data() + offsets[2 * i]);
+    binding.indicators[0] = 0;
+    if (offsets[2 * i + 1] != SIZE_MAX) {
+      binding.data = buffer_.data() + offsets[2 * i + 1];
+    }
+  }
+  if (has_unbound_) {
+    if (chunk_.empty()) {
+      chunk_ = pool.Take(kGetDataChunkBytes);
+    }
+    if (wide_.capacity() == 0) {
+      wide_ = pool.Take(kGetDataChunkBytes);
+      wide_.clear();
+    }
+  }
+
+  if (num_cols == 0) {
+    return true;
+  }
+
+  SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)SQL_BIND_BY_COLUMN, 0);
+  if (!SQL_SUCCEEDED(SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_ARRAY_SIZE,
+                                    (SQLPOINTER)row_array_size_, 0))) {
+    // The driver does not do block cursors; fall back to one row at a time.
+    row_array_size_ = 1;
+  }
+  SQLSetStmtAttr(stmt_, SQL_ATTR_ROWS_FETCHED_PTR, &rows_fetched_, 0);
+  row_status_.assign(row_array_size_, SQL_ROW_SUCCESS);
+  SQLSetStmtAttr(stmt_, SQL_ATTR_ROW_STATUS_PTR, row_status_.data(), 0);
+
+  for (size_t i = 0; i < bindings_.size(); ++i) {
+    Binding& binding = bindings_[i];
+    if (!binding.bound) {
+      continue;
+    }
+    SQLRETURN ret = SQLBindCol(stmt_, (SQLUSMALLINT)(i + 1), binding.c_type,
+                               binding.data, binding.element_size,
+                               binding.indicators);
+    if (!SQL_SUCCEEDED(ret)) {
+      *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+      return false;
+    }
+  }
+  for (size_t i = 0; i < bindings_.size(); ++i) {
+    Binding& binding = bindings_[i];
+    if (binding.type == CellType::kDecimal &&
+        !DescribeNumeric(i, binding.bound ? binding.data : nullptr,
+                         error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BlockFetcher::DescribeNumeric(size_t column, SQLPOINTER data,
+                                   std::string* error) {
+  SQLHDESC ard = SQL_NULL_HDESC;
+  SQLSMALLINT record = (SQLSMALLINT)(column + 1);
+  const ColumnDescription& description = columns_[column];
+  // Setting any field but the data pointer unbinds the record, so the data
+  // pointer goes last.
+  bool ok =
+      SQL_SUCCEEDED(SQLGetStmtAttr(stmt_, SQL_ATTR_APP_ROW_DESC, &ard, 0,
+                                   nullptr)) &&
+      SQL_SUCCEEDED(SQLSetDescFieldW(ard, record, SQL_DESC_TYPE,
+                                     (SQLPOINTER)SQL_C_NUMERIC, 0)) &&
+      SQL_SUCCEEDED(SQLSetDescFieldW(
+          ard, record, SQL_DESC_PRECISION,
+          (SQLPOINTER)(SQLLEN)std::max<SQLULEN>(description.column_size, 1), 0)) &&
+      SQL_SUCCEEDED(SQLSetDescFieldW(
+          ard, record, SQL_DESC_SCALE,
+          (SQLPOINTER)(SQLLEN)description.decimal_digits, 0)) &&
+      (!data || SQL_SUCCEEDED(SQLSetDescFieldW(ard, record, SQL_DESC_DATA_PTR,
+                                                data, 0)));
+  if (!ok) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+  }
+  return ok;
+}
+
+bool BlockFetcher::Next(SQLULEN* rows, std::string* error) {
+  if (!timed_ && !observer_) {
+    bool ok = FetchNext(rows, error);
+    rows_read_ += *rows;
+    return ok;
+  }
+  auto start = std::chrono::steady_clock::now();
+  bool ok = FetchNext(rows, error);
+  auto end = std::chrono::steady_clock::now();
+  if (timed_) {
+    fetch_time_ +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+  }
+  rows_read_ += *rows;
+  if (observer_) {
+    observer_(start, end, *rows);
+  }
+  return ok;
+}
+
+bool BlockFetcher::FetchNext(SQLULEN* rows, std::string* error) {
+  *rows = 0;
+  if (columns_.empty()) {
+    return true;
+  }
+
+  rows_fetched_ = 0;
+  // A driver that ignores SQL_ATTR_ROW_STATUS_PTR leaves every row
+  // successful.
+  std::fill(row_status_.begin(), row_status_.end(), SQL_ROW_SUCCESS);
+  SQLRETURN ret = SQLFetch(stmt_);
+  if (ret == SQL_NO_DATA) {
+    return true;
+  }
+  if (!SQL_SUCCEEDED(ret)) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+    if (error->empty()) {
+      *error = "Failed to fetch rows, but no diagnostic message was returned.";
+    }
+    return false;
+  }
+  *rows = rows_fetched_;
+  if (ret == SQL_SUCCESS_WITH_INFO && !CheckRowStatus(*rows, error)) {
+    *rows = 0;
+    return false;
+  }
+  if (has_unbound_ && *rows > 0) {
+    return ReadUnbound(error);
+  }
+  return true;
+}
+
+bool BlockFetcher::CheckRowStatus(SQLULEN rows, std::string* error) {
+  for (SQLULEN r = 0; r < rows && r < row_status_.size(); ++r) {
+    if (row_status_[r] == SQL_ROW_ERROR) {
+      *error = "Row " + std::to_string(rows_read_ + r + 1) +
+               " could not be fetched. " +
+               GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+      return false;
+    }
+    if (row_status_[r] == SQL_ROW_SUCCESS_WITH_INFO) {
+      ++rows_with_info_;
+    }
+  }
+  // Bound buffers are sized from the column descriptions, so a truncated
+  // value means they no longer match the result.
+  if (GetOdbcSqlState(SQL_HANDLE_STMT, stmt_) == "01004") {
+    *error = "Fetched data was truncated; the result's columns do not match "
+             "their description. " +
+             GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+    return false;
+  }
+  return true;
+}
+
+bool BlockFetcher::ReadUnbound(std::string* error) {
+  lob_pending_ = false;
+  lob_complete_ = false;
+  lob_start_ = 0;
+  lob_data_.clear();
+
+  for (size_t i = 0; i < bindings_.size(); ++i) {
+    Binding& binding = bindings_[i];
+    if (binding.bound) {
+      continue;
+    }
+
+    if (binding.type != CellType::kText && binding.type != CellType::kBinary) {
+      // SQL_ARD_TYPE picks up the precision and scale DescribeNumeric() set.
+      SQLSMALLINT c_type = binding.type == CellType::kDecimal
+                               ? (SQLSMALLINT)SQL_ARD_TYPE
+                               : binding.c_type;
+      SQLRETURN ret = SQLGetData(stmt_, (SQLUSMALLINT)(i + 1), c_type,
+                                 binding.data, binding.element_size,
+                                 &binding.indicators[0]);
+      if (!SQL_SUCCEEDED(ret)) {
+        *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+        return false;
+      }
+      continue;
+    }
+
+    // Long UTF-16 text is collected whole first so a surrogate pair split
+    // across chunks is converted correctly.
+    bool text = binding.type == CellType::kText;
+    std::vector<uint8_t>* out = text ? &wide_ : &binding.unbound_bytes;
+    out->clear();
+    binding.unbound_text.clear();
+    binding.indicators[0] = 0;
+    bool lazy = lob_threshold_ > 0 && i + 1 == bindings_.size();
+    bool complete = false;
+    bool is_null = false;
+    if (!ReadChunks(i, lazy ? lob_threshold_ : SIZE_MAX, out, &complete,
+                    &is_null, error)) {
+      return false;
+    }
+    if (is_null) {
+      binding.indicators[0] = SQL_NULL_DATA;
+    } else if (!complete) {
+      lob_pending_ = true;
+      lob_data_.swap(*out);
+    } else if (text && binding.c_type == SQL_C_CHAR) {
+      binding.unbound_text.assign(wide_.begin(), wide_.end());
+    } else if (text) {
+      AppendUtf16AsUtf8(reinterpret_cast<const SQLWCHAR*>(wide_.data()),
+                        wide_.size() / sizeof(SQLWCHAR),
+                        &binding.unbound_text);
+    }
+  }
+  return true;
+}
+
+bool BlockFetcher::ReadChunks(size_t column, size_t limit,
+                              std::vector<uint8_t>* out, bool* complete,
+                              bool* is_null, std::string* error) {
+  SQLSMALLINT c_type = bindings_[column].c_type;
+  // Text chunks are NUL-terminated; binary chunks fill the whole buffer.
+  size_t room = kGetDataChunkBytes;
+  if (c_type == SQL_C_WCHAR) {
+    room -= sizeof(SQLWCHAR);
+  } else if (c_type == SQL_C_CHAR) {
+    room -= 1;
+  }
+  chunk_.resize(kGetDataChunkBytes);
+  *complete = false;
+  *is_null = false;
+  while (out->size() <= limit) {
+    SQLLEN indicator = 0;
+    SQLRETURN ret = SQLGetData(stmt_, (SQLUSMALLINT)(column + 1), c_type,
+                               chunk_.data(), (SQLLEN)chunk_.size(),
+                               &indicator);
+    if (ret == SQL_NO_DATA) {
+      *complete = true;
+      return true;
+    }
+    if (!SQL_SUCCEEDED(ret)) {
+      *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+      return false;
+    }
+    if (indicator == SQL_NULL_DATA) {
+      *is_null = true;
+      *complete = true;
+      return true;
+    }
+    size_t bytes = indicator == SQL_NO_TOTAL || (size_t)indicator > room
+                       ? room
+                       : (size_t)indicator;
+    out->insert(out->end(), chunk_.data(), chunk_.data() + bytes);
+    if (ret == SQL_SUCCESS) {
+      *complete = true;
+      return true;
+    }
+  }
+  return true;
+}
+
+bool BlockFetcher::IsLob(size_t column) const {
+  return lob_pending_ && column + 1 == bindings_.size();
+}
+
+bool BlockFetcher::FillLob(size_t offset, size_t length, size_t* first,
+                           size_t* count, bool* end, std::string* error) {
+  if (!lob_pending_) {
+    *error = "The current row has no pending LOB";
+    return false;
+  }
+  if (offset < lob_start_) {
+    *error = "LOB data before offset " + std::to_string(lob_start_) +
+             " has already been read";
+    return false;
+  }
+  size_t column = bindings_.size() - 1;
+  size_t unit = bindings_[column].type == CellType::kText ? sizeof(SQLWCHAR) : 1;
+  size_t want = offset + length;
+  while (!lob_complete_ && lob_start_ + lob_data_.size() / unit < want) {
+    bool is_null = false;
+    if (!ReadChunks(column, lob_data_.size(), &lob_data_, &lob_complete_,
+                    &is_null, error)) {
+      return false;
+    }
+    // Skipped-over data is not kept.
+    DiscardLob(offset);
+  }
+  size_t available = lob_start_ + lob_data_.size() / unit;
+  size_t begin = std::min(offset, available);
+  size_t stop = std::min(want, available);
+  *first = (begin - lob_start_) * unit;
+  *count = (stop - begin) * unit;
+  *end = lob_complete_ && stop == available;
+  return true;
+}
+
+void BlockFetcher::DiscardLob(size_t offset) {
+  size_t unit =
+      bindings_.back().type == CellType::kText ? sizeof(SQLWCHAR) : 1;
+  size_t units = std::min(offset > lob_start_ ? offset - lob_start_ : 0,
+                          lob_data_.size() / unit);
+  lob_data_.erase(lob_data_.begin(), lob_data_.begin() + units * unit);
+  lob_start_ += units;
+}
+
+bool BlockFetcher::ReadLobBytes(size_t offset, size_t length,
+                                std::vector<uint8_t>* out, bool* end,
+                                std::string* error) {
+  size_t first = 0;
+  size_t count = 0;
+  if (!FillLob(offset, length, &first, &count, end, error)) {
+    return false;
+  }
+  out->assign(lob_data_.begin() + first, lob_data_.begin() + first + count);
+  DiscardLob(offset + count);
+  return true;
+}
+
+bool BlockFetcher::ReadLobText(size_t offset, size_t length, std::string* out,
+                               size_t* units, bool* end, std::string* error) {
+  size_t first = 0;
+  size_t count = 0;
+  if (!FillLob(offset, length, &first, &count, end, error)) {
+    return false;
+  }
+  const SQLWCHAR* text =
+      reinterpret_cast<const SQLWCHAR*>(lob_data_.data() + first);
+  *units = count / sizeof(SQLWCHAR);
+  if (*units > 1 && !*end && IsHighSurrogate(text[*units - 1])) {
+    // Leave the first half of a pair for the next read.
+    --*units;
+  }
+  out->clear();
+  AppendUtf16AsUtf8(text, *units, out);
+  DiscardLob(offset + *units);
+  return true;
+}
+
+bool BlockFetcher::IsNull(size_t column, size_t row) const {
+  const Binding& binding = bindings_[column];
+  return binding.indicators[binding.bound ? row : 0] == SQL_NULL_DATA;
+}
+
+bool BlockFetcher::GetBool(size_t column, size_t row) const {
+  const Binding& binding = bindings_[column];
+  return binding.data[(binding.bound ? row : 0) * binding.element_size] != 0;
+}
+
+int32_t BlockFetcher::GetInt32(size_t column, size_t row) const {
+  const Binding& binding = bindings_[column];
+  SQLINTEGER value;
+  std::memcpy(&value,
+              binding.data + (binding.bound ? row : 0) * binding.element_size,
+              sizeof(value));
+  return static_cast<int32_t>(value);
+}
+
+double BlockFetcher::GetDouble(size_t column, size_t row) const {
+  const Binding& binding = bindings_[column];
+  SQLDOUBLE value;
+  std::memcpy(&value,
+              binding.data + (binding.bound ? row : 0) * binding.element_size,
+              sizeof(value));
+  return static_cast<double>(value);
+}
+
+int64_t BlockFetcher::GetInt64(size_t column, size_t row) const {
+  SQLBIGINT value;
+  std::memcpy(&value, Cell(column, row), sizeof(value));
+  return static_cast<int64_t>(value);
+}
+
+int64_t BlockFetcher::GetMicros(size_t column, size_t row) const {
+  const Binding& binding = bindings_[column];
+  if (binding.c_type == SQL_C_TYPE_TIMESTAMP) {
+    SQL_TIMESTAMP_STRUCT value;
+    std::memcpy(&value, Cell(column, row), sizeof(value));
+    return DaysFromCivil(value.year, value.month, value.day) * kMicrosPerDay +
+           TimeOfDayMicros(value.hour, value.minute, value.second,
+                           value.fraction);
+  }
+  if (binding.c_type == SQL_C_SS_TIME2) {
+    SsTime2Struct value;
+    std::memcpy(&value, Cell(column, row), sizeof(value));
+    return TimeOfDayMicros(value.hour, value.minute, value.second,
+                           value.fraction);
+  }
+  SQL_TIME_STRUCT value;
+  std::memcpy(&value, Cell(column, row), sizeof(value));
+  return TimeOfDayMicros(value.hour, value.minute, value.second, 0);
+}
+
+void BlockFetcher::GetGuid(size_t column, size_t row, uint8_t* out) const {
+  SQLGUID value;
+  std::memcpy(&value, Cell(column, row), sizeof(value));
+  // The first three fields are integers in host order; the text form shows
+  // them most significant byte first.
+  for (int i = 0; i < 4; ++i) {
+    out[i] = static_cast<uint8_t>(value.Data1 >> (24 - 8 * i));
+  }
+  out[4] = static_cast<uint8_t>(value.Data2 >> 8);
+  out[5] = static_cast<uint8_t>(value.Data2);
+  out[6] = static_cast<uint8_t>(value.Data3 >> 8);
+  out[7] = static_cast<uint8_t>(value.Data3);
+  std::memcpy(out + 8, value.Data4, sizeof(value.Data4));
+}
+
+bool BlockFetcher::GetDecimal(size_t column, size_t row,
+                              int64_t* unscaled) const {
+  SQL_NUMERIC_STRUCT value;
+  std::memcpy(&value, Cell(column, row), sizeof(value));
+  uint64_t magnitude = 0;
+  for (int i = SQL_MAX_NUMERIC_LEN - 1; i >= 0; --i) {
+    if (i >= 8 && value.val[i] != 0) {
+      return false;
+    }
+    if (i < 8) {
+      magnitude = (magnitude << 8) | value.val[i];
+    }
+  }
+  if (magnitude > static_cast<uint64_t>(INT64_MAX)) {
+    return false;
+  }
+  // sign is 1 for positive values and 0 for negative ones.
+  *unscaled = value.sign == 0 ? -static_cast<int64_t>(magnitude)
+                              : static_cast<int64_t>(magnitude);
+  return true;
+}
+
+void BlockFetcher::AppendDecimal(size_t column, size_t row,
+                                 std::string* out) const {
+  SQL_NUMERIC_STRUCT value;
+  std::memcpy(&value, Cell(column, row), sizeof(value));
+  char digits[48];
+  size_t count = 0;
+  bool zero;
+  do {
+    digits[count++] = static_cast<char>('0' + DivideBy10(value.val, SQL_MAX_NUMERIC_LEN));
+    zero = true;
+    for (SQLCHAR byte : value.val) {
+      zero = zero && byte == 0;
+    }
+  } while (!zero);
+
+  size_t scale = value.scale > 0 ? static_cast<size_t>(value.scale) : 0;
+  // Leading zeros so there is at least one digit before the point.
+  while (count <= scale) {
+    digits[count++] = '0';
+  }
+  if (value.sign == 0) {
+    out->push_back('-');
+  }
+  for (size_t i = count; i-- > 0;) {
+    out->push_back(digits[i]);
+    if (i == scale && scale > 0) {
+      out->push_back('.');
+    }
+  }
+}
+
+const uint8_t* BlockFetcher::GetBinary(size_t column, size_t row,
+                                       size_t* size) const {
+  const Binding& binding = bindings_[column];
+  if (!binding.bound) {
+    *size = binding.unbound_bytes.size();
+    return binding.unbound_bytes.data();
+  }
+  SQLLEN bytes = binding.indicators[row];
+  *size = bytes < 0 ? 0 : std::min<size_t>(bytes, binding.element_size);
+  return binding.data + row * binding.element_size;
+}
+
+void BlockFetcher::AppendText(size_t column, size_t row, std::string* out) const {
+  const Binding& binding = bindings_[column];
+  if (!binding.bound) {
+    out->append(binding.unbound_text);
+    return;
+  }
+  SQLLEN bytes = binding.indicators[row];
+  if (binding.c_type == SQL_C_CHAR) {
+    const char* text = reinterpret_cast<const char*>(
+        binding.data + row * binding.element_size);
+    out->append(text, bytes < 0 ? 0
+                                : std::min<size_t>(bytes, binding.element_size - 1));
+    return;
+  }
+  size_t max_chars = binding.element_size / sizeof(SQLWCHAR) - 1;
+  size_t chars = bytes < 0 ? 0 : std::min<size_t>(bytes / sizeof(SQLWCHAR), max_chars);
+  const SQLWCHAR* text = reinterpret_cast<const SQLWCHAR*>(
+      binding.data + row * binding.element_size);
+  AppendUtf16AsUtf8(text, chars, out);
+}
+
+}  // namespace mssql_connect
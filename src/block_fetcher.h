@@ -0,0 +1,275 @@
+#ifndef MSSQL_CONNECT_BLOCK_FETCHER_H_
+#define MSSQL_CONNECT_BLOCK_FETCHER_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mssql_connect {
+
+struct ColumnDescription {
+  std::string name;
+  SQLSMALLINT sql_type = SQL_UNKNOWN_TYPE;
+  SQLULEN column_size = 0;
+  SQLSMALLINT decimal_digits = 0;
+  SQLSMALLINT nullable = SQL_NULLABLE_UNKNOWN;
+};
+
+// How a column's cells are fetched and exposed.
+enum class CellType {
+  kBool,
+  kInt32,
+  kInt64,
+  kDouble,
+  // decimal and numeric, exact: an unscaled integer and the column's scale.
+  kDecimal,
+  // date, datetime, datetime2 and smalldatetime, as microseconds since the
+  // Unix epoch. SQL Server values carry no time zone; they are read as UTC.
+  kDateTime,
+  // time, as microseconds since midnight.
+  kTime,
+  // uniqueidentifier, as 16 bytes in RFC 4122 (display) order.
+  kGuid,
+  kText,
+  kBinary,
+};
+
+// Fetches a result set in blocks of rows.
+//
+// Fixed-size columns are bound once with SQLBindCol into column-wise arrays
+// and whole rowsets are pulled with a single SQLFetch using
+// SQL_ATTR_ROW_ARRAY_SIZE, instead of one SQLFetch per row and one
+// SQLGetData per cell.
+//
+// Unbounded columns (e.g. nvarchar(max)) cannot be bound. Drivers only allow
+// SQLGetData after the last bound column and with a rowset size of one, so
+// when a result has such a column, it and every column after it are read
+// with SQLGetData and the rowset size drops to one.
+//
+// With a LOB threshold set, a text or binary value in the last column that
+// is longer than the threshold is not read with the row. It stays in the
+// driver, and ReadLobBytes()/ReadLobText() stream it in chunks until the
+// next call to Next(). Earlier columns are always read in full, since
+// SQLGetData cannot go back to a column once a later one has been read.
+//
+// Text is fetched as UTF-16 and transcoded, unless set_utf8_text() asks
+// the driver for SQL_C_CHAR, which it returns as UTF-8 when the client code
+// page is UTF-8.
+class BlockFetcher {
+ public:
+  // Rows per rowset when every column can be bound.
+  static const SQLULEN kDefaultRowArraySize = 256;
+
+  // Upper bound on bound buffer memory; wide rows get smaller rowsets.
+  static const size_t kMaxBufferBytes = 4 * 1024 * 1024;
+
+  // Character columns wider than this are read with SQLGetData.
+  static const SQLULEN kMaxBoundChars = 8000;
+
+  // Binary columns wider than this are read with SQLGetData.
+  static const SQLULEN kMaxBoundBytes = 8000;
+
+  explicit BlockFetcher(SQLHSTMT stmt);
+
+  // Unbinds the columns and restores a rowset size of one, so the statement
+  // can be reused.
+  ~BlockFetcher();
+
+  BlockFetcher(const BlockFetcher&) = delete;
+  BlockFetcher& operator=(const BlockFetcher&) = delete;
+
+  // Describes the current result set and binds its columns. Returns false
+  // and fills |error| on failure.
+  bool Bind(std::string* error);
+
+  // Like Bind(), but takes the column descriptions from an earlier execution
+  // of the same prepared statement instead of describing them again.
+  bool Bind(const std::vector<ColumnDescription>& columns, std::string* error);
+
+  const std::vector<ColumnDescription>& columns() const { return columns_; }
+
+  // Rows per rowset chosen by Bind().
+  SQLULEN row_array_size() const { return row_array_size_; }
+
+  // Leaves last-column values longer than |bytes| in the driver to be read
+  // with ReadLobBytes()/ReadLobText(). Zero (the default) reads every value
+  // with its row. Must be called before Bind().
+  void set_lob_threshold(size_t bytes) { lob_threshold_ = bytes; }
+
+  // Fetches text as SQL_C_CHAR and copies it without transcoding. Only
+  // correct when the driver returns UTF-8 for SQL_C_CHAR. A value streamed
+  // with ReadLobText() is still fetched as UTF-16. Must be called before
+  // Bind().
+  void set_utf8_text(bool utf8_text) { utf8_text_ = utf8_text; }
+
+  // Fetches the next rowset and sets |rows| to the number of rows in it,
+  // which is zero once the result set is exhausted. Returns false and fills
+  // |error| on failure, including when the driver marks a row of the
+  // rowset SQL_ROW_ERROR or truncates a bound value (01004).
+  bool Next(SQLULEN* rows, std::string* error);
+
+  // Measures the time spent in Next() from now on, for fetch_time(). Off
+  // by default, since it reads the clock twice per rowset.
+  void set_timed(bool timed) { timed_ = timed; }
+  std::chrono::nanoseconds fetch_time() const { return fetch_time_; }
+
+  // Called at the end of each Next() with the time it started and ended
+  // and the rows it returned, e.g. to trace every block.
+  using FetchObserver =
+      std::function<void(std::chrono::steady_clock::time_point start,
+                         std::chrono::steady_clock::time_point end,
+                         SQLULEN rows)>;
+  void set_fetch_observer(FetchObserver observer) {
+    observer_ = std::move(observer);
+  }
+
+  // Rows returned by Next() so far.
+  uint64_t rows_read() const { return rows_read_; }
+
+  // Rows the driver returned with a warning (SQL_ROW_SUCCESS_WITH_INFO),
+  // e.g. a fractional-seconds truncation. Their values are still used.
+  uint64_t rows_with_info() const { return rows_with_info_; }
+
+  // Accessors for cell |row| (an index into the current rowset) of
+  // |column| (zero-based). Only the accessor matching cell_type() is valid.
+  CellType cell_type(size_t column) const { return bindings_[column].type; }
+  bool IsNull(size_t column, size_t row) const;
+  bool GetBool(size_t column, size_t row) const;
+  int32_t GetInt32(size_t column, size_t row) const;
+  int64_t GetInt64(size_t column, size_t row) const;
+  // kDateTime and kTime cells, in microseconds.
+  int64_t GetMicros(size_t column, size_t row) const;
+  // Writes the 16 bytes of a kGuid cell to |out|.
+  void GetGuid(size_t column, size_t row, uint8_t* out) const;
+  // Sets |unscaled| to a kDecimal cell times 10^decimal_scale(). Returns
+  // false if it does not fit in 64 bits, which only happens for
+  // precisions above 18.
+  bool GetDecimal(size_t column, size_t row, int64_t* unscaled) const;
+  // Appends a kDecimal cell as exact decimal text, e.g. "-12.3400".
+  void AppendDecimal(size_t column, size_t row, std::string* out) const;
+  int decimal_scale(size_t column) const {
+    return columns_[column].decimal_digits;
+  }
+  double GetDouble(size_t column, size_t row) const;
+  // Appends the cell's text as UTF-8.
+  void AppendText(size_t column, size_t row, std::string* out) const;
+  // Returns the cell's bytes and sets |size| to their count.
+  const uint8_t* GetBinary(size_t column, size_t row, size_t* size) const;
+
+  // Whether |column| of the current row was left in the driver to be
+  // streamed. Only the last column can be, and only while the rowset size
+  // is one, so there is no row to pick.
+  bool IsLob(size_t column) const;
+
+  // Streams the pending LOB of the current row. |offset| and |length| are
+  // in bytes for binary columns and in UTF-16 code units for text columns.
+  // Reads must move forward: data before the end of the previous read is
+  // discarded. |end| is set once the value has been returned up to its
+  // end. A text read may return one unit less than asked for rather than
+  // split a surrogate pair, and sets |units| to the units returned.
+  bool ReadLobBytes(size_t offset, size_t length, std::vector<uint8_t>* out,
+                    bool* end, std::string* error);
+  bool ReadLobText(size_t offset, size_t length, std::string* out,
+                   size_t* units, bool* end, std::string* error);
+
+ private:
+  struct Binding {
+    CellType type = CellType::kText;
+    // False for columns read with SQLGetData.
+    bool bound = false;
+    SQLSMALLINT c_type = SQL_C_WCHAR;
+    // Bytes per element in |data|.
+    SQLLEN element_size = 0;
+    // Arrays in |buffer_|; |data| is null for unbound text and binary
+    // columns.
+    unsigned char* data = nullptr;
+    SQLLEN* indicators = nullptr;
+    // Text of an unbound column for the current row.
+    std::string unbound_text;
+    // Bytes of an unbound binary column for the current row.
+    std::vector<uint8_t> unbound_bytes;
+  };
+
+  // Chooses buffers for |columns_| and binds them.
+  bool BindColumns(std::string* error);
+
+  // Sets the precision and scale SQL_C_NUMERIC values of |column| are
+  // returned with; drivers otherwise use a scale of zero. Bound columns
+  // are bound again to |data|.
+  bool DescribeNumeric(size_t column, SQLPOINTER data, std::string* error);
+
+  const unsigned char* Cell(size_t column, size_t row) const {
+    const Binding& binding = bindings_[column];
+    return binding.data + (binding.bound ? row : 0) * binding.element_size;
+  }
+
+  // Next() without the timing.
+  bool FetchNext(SQLULEN* rows, std::string* error);
+
+  // Checks the status of each row of a rowset SQLFetch returned with
+  // SQL_SUCCESS_WITH_INFO.
+  bool CheckRowStatus(SQLULEN rows, std::string* error);
+
+  // Reads the unbound columns of the current (single-row) rowset.
+  bool ReadUnbound(std::string* error);
+
+  // Appends the value of unbound |column| to |out| with SQLGetData, in the
+  // column's C type, until the value ends or |out|
+  // grows past |limit| bytes (SIZE_MAX for no limit). Sets |complete| when
+  // the value ended and |is_null| for NULL.
+  bool ReadChunks(size_t column, size_t limit, std::vector<uint8_t>* out,
+                  bool* complete, bool* is_null, std::string* error);
+
+  // Reads the pending LOB until units [offset, offset + length) are in
+  // |lob_data_| or the value ends. Sets |first| and |count| to the bytes of
+  // |lob_data_| holding the part of that range the value has.
+  bool FillLob(size_t offset, size_t length, size_t* first, size_t* count,
+               bool* end, std::string* error);
+
+  // Drops the pending LOB's data before unit |offset|.
+  void DiscardLob(size_t offset);
+
+  SQLHSTMT stmt_;
+  std::vector<ColumnDescription> columns_;
+  std::vector<Binding> bindings_;
+  SQLULEN row_array_size_ = 1;
+  SQLULEN rows_fetched_ = 0;
+  // SQL_ATTR_ROW_STATUS_PTR, one entry per row of the rowset.
+  std::vector<SQLUSMALLINT> row_status_;
+  bool has_unbound_ = false;
+  uint64_t rows_read_ = 0;
+  uint64_t rows_with_info_ = 0;
+  bool timed_ = false;
+  std::chrono::nanoseconds fetch_time_{0};
+  FetchObserver observer_;
+  // Every binding's data and indicator arrays, taken from the thread's
+  // ScratchPool and given back by the destructor.
+  std::vector<uint8_t> buffer_;
+  // Reused across cells of unbound columns.
+  std::vector<uint8_t> chunk_;
+  std::vector<uint8_t> wide_;
+
+  bool utf8_text_ = false;
+  size_t lob_threshold_ = 0;
+  // The last column's value of the current row is still in the driver.
+  bool lob_pending_ = false;
+  // Part of the pending value read from the driver and not yet discarded,
+  // starting at unit |lob_start_|.
+  std::vector<uint8_t> lob_data_;
+  size_t lob_start_ = 0;
+  bool lob_complete_ = false;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_BLOCK_FETCHER_H_
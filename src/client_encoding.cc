@@ -0,0 +1,78 @@
+#include "client_encoding.h"
+
+#include <sqlext.h>
+#include <sqlucode.h>
+
+#ifndef _WIN32
+#include <langinfo.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+#include "odbc_error.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+
+namespace {
+
+std::string ToUpper(std::string text) {
+  for (char& c : text) {
+    c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  }
+  return text;
+}
+
+}  // namespace
+
+bool IsUtf8Collation(const std::string& collation) {
+  const std::string kSuffix = "_UTF8";
+  std::string upper = ToUpper(collation);
+  return upper.size() > kSuffix.size() &&
+         upper.compare(upper.size() - kSuffix.size(), kSuffix.size(),
+                       kSuffix) == 0;
+}
+
+bool ClientCharsetIsUtf8() {
+#ifdef _WIN32
+  return GetACP() == CP_UTF8;
+#else
+  std::string codeset = ToUpper(nl_langinfo(CODESET));
+  return codeset == "UTF-8" || codeset == "UTF8";
+#endif
+}
+
+bool CanFetchUtf8Text(SQLHDBC dbc, bool* utf8_text, std::string* error) {
+  *utf8_text = false;
+  if (!ClientCharsetIsUtf8()) {
+    return true;
+  }
+
+  SQLHSTMT stmt = SQL_NULL_HSTMT;
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt))) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_DBC, dbc);
+    return false;
+  }
+  std::vector<SQLWCHAR> sql = Utf8ToUtf16(
+      "SELECT CONVERT(nvarchar(128), "
+      "DATABASEPROPERTYEX(DB_NAME(), 'Collation'))");
+  SQLWCHAR collation[129] = {0};
+  SQLLEN indicator = 0;
+  bool ok = SQL_SUCCEEDED(
+                SQLExecDirectW(stmt, sql.data(), (SQLINTEGER)sql.size())) &&
+            SQL_SUCCEEDED(SQLFetch(stmt)) &&
+            SQL_SUCCEEDED(SQLGetData(stmt, 1, SQL_C_WCHAR, collation,
+                                     sizeof(collation), &indicator));
+  if (!ok) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+  } else if (indicator > 0) {
+    size_t units = std::min<size_t>((size_t)indicator / sizeof(SQLWCHAR), 128);
+    *utf8_text = IsUtf8Collation(Utf16ToUtf8(collation, units));
+  }
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+  return ok;
+}
+
+}  // namespace mssql_connect
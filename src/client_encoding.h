@@ -0,0 +1,29 @@
+#ifndef MSSQL_CONNECT_CLIENT_ENCODING_H_
+#define MSSQL_CONNECT_CLIENT_ENCODING_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+
+#include <string>
+
+namespace mssql_connect {
+
+// Whether |collation| is one of the _UTF8 collations of SQL Server 2019
+// and later, which store char and varchar as UTF-8.
+bool IsUtf8Collation(const std::string& collation);
+
+// Whether the driver hands out SQL_C_CHAR text as UTF-8 in this process:
+// the ANSI code page on Windows, the locale's codeset elsewhere.
+bool ClientCharsetIsUtf8();
+
+// Whether text on |dbc| can be fetched as SQL_C_CHAR without transcoding:
+// the client charset is UTF-8 and the current database has a UTF-8
+// collation. Returns false and fills |error| if the collation cannot be
+// read.
+bool CanFetchUtf8Text(SQLHDBC dbc, bool* utf8_text, std::string* error);
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_CLIENT_ENCODING_H_
@@ -0,0 +1,178 @@
+#include "columnar_result.h"
+
+#include "scratch_pool.h"
+
+namespace mssql_connect {
+
+namespace {
+
+// Every decimal(18, s) value fits in an int64_t once unscaled.
+const SQLULEN kMaxInt64DecimalPrecision = 18;
+
+void MarkNull(ResultColumn* column, size_t row) {
+  if (column->null_bitmap.size() <= row / 8) {
+    column->null_bitmap.resize(row / 8 + 1, 0);
+  }
+  column->null_bitmap[row / 8] |= static_cast<uint8_t>(1u << (row % 8));
+}
+
+}  // namespace
+
+bool ReadResult(BlockFetcher* fetcher, ResultSink* sink, std::string* error) {
+  sink->Start(*fetcher);
+  SQLULEN rows = 0;
+  while (true) {
+    if (!fetcher->Next(&rows, error)) {
+      return false;
+    }
+    if (rows == 0) {
+      break;
+    }
+    for (SQLULEN r = 0; r < rows; ++r) {
+      sink->AddRow(*fetcher, r);
+    }
+  }
+  sink->Finish();
+  return true;
+}
+
+bool ReadColumnar(BlockFetcher* fetcher, ColumnarResult* result,
+                  std::string* error) {
+  ColumnarSink sink(result);
+  return ReadResult(fetcher, &sink, error);
+}
+
+bool IsDecimalText(const ColumnDescription& column) {
+  return column.column_size > kMaxInt64DecimalPrecision;
+}
+
+void StartColumnar(const BlockFetcher& fetcher, ColumnarResult* result) {
+  const std::vector<ColumnDescription>& descriptions = fetcher.columns();
+  result->columns.assign(descriptions.size(), ResultColumn());
+  result->row_count = 0;
+  for (size_t i = 0; i < descriptions.size(); ++i) {
+    result->columns[i].name = descriptions[i].name;
+    result->columns[i].type = fetcher.cell_type(i);
+    if (result->columns[i].type == CellType::kDecimal) {
+      result->columns[i].scale = fetcher.decimal_scale(i);
+      result->columns[i].decimal_text = IsDecimalText(descriptions[i]);
+    }
+  }
+}
+
+size_t AppendColumnarRow(const BlockFetcher& fetcher, size_t row,
+                         ColumnarResult* result) {
+  size_t bytes = 0;
+  // Cells are formatted into this and copied out at their final size.
+  std::string* scratch = ScratchPool::ForThisThread().text();
+  for (size_t i = 0; i < result->columns.size(); ++i) {
+    ResultColumn& column = result->columns[i];
+    bool is_null = fetcher.IsNull(i, row);
+    if (is_null) {
+      MarkNull(&column, result->row_count);
+    }
+    switch (column.type) {
+      case CellType::kBool:
+        column.bools.push_back(!is_null && fetcher.GetBool(i, row) ? 1 : 0);
+        bytes += sizeof(uint8_t);
+        break;
+      case CellType::kInt32:
+        column.ints.push_back(is_null ? 0 : fetcher.GetInt32(i, row));
+        bytes += sizeof(int64_t);
+        break;
+      case CellType::kInt64:
+        column.ints.push_back(is_null ? 0 : fetcher.GetInt64(i, row));
+        bytes += sizeof(int64_t);
+        break;
+      case CellType::kDateTime:
+      case CellType::kTime:
+        column.ints.push_back(is_null ? 0 : fetcher.GetMicros(i, row));
+        bytes += sizeof(int64_t);
+        break;
+      case CellType::kDecimal:
+        if (column.decimal_text) {
+          column.strings.emplace_back();
+          if (!is_null) {
+            scratch->clear();
+            fetcher.AppendDecimal(i, row, scratch);
+            column.strings.back().assign(*scratch);
+          }
+          bytes += sizeof(std::string) + column.strings.back().size();
+        } else {
+          int64_t unscaled = 0;
+          if (!is_null) {
+            fetcher.GetDecimal(i, row, &unscaled);
+          }
+          column.ints.push_back(unscaled);
+          bytes += sizeof(int64_t);
+        }
+        break;
+      case CellType::kGuid:
+        column.binaries.emplace_back(is_null ? 0 : 16);
+        if (!is_null) {
+          fetcher.GetGuid(i, row, column.binaries.back().data());
+        }
+        bytes += sizeof(std::vector<uint8_t>) + column.binaries.back().size();
+        break;
+      case CellType::kDouble:
+        column.doubles.push_back(is_null ? 0.0 : fetcher.GetDouble(i, row));
+        bytes += sizeof(double);
+        break;
+      case CellType::kText:
+        column.strings.emplace_back();
+        if (fetcher.IsLob(i)) {
+          column.lob_rows.push_back(result->row_count);
+        } else if (!is_null) {
+          scratch->clear();
+          fetcher.AppendText(i, row, scratch);
+          column.strings.back().assign(*scratch);
+        }
+        bytes += sizeof(std::string) + column.strings.back().size();
+        break;
+      case CellType::kBinary:
+        column.binaries.emplace_back();
+        if (fetcher.IsLob(i)) {
+          column.lob_rows.push_back(result->row_count);
+        } else if (!is_null) {
+          size_t size = 0;
+          const uint8_t* data = fetcher.GetBinary(i, row, &size);
+          column.binaries.back().assign(data, data + size);
+        }
+        bytes += sizeof(std::vector<uint8_t>) + column.binaries.back().size();
+        break;
+    }
+  }
+  ++result->row_count;
+  return bytes;
+}
+
+void FinishColumnar(ColumnarResult* result) {
+  // Pad bitmaps so every column with NULLs covers every row.
+  size_t bitmap_bytes = (result->row_count + 7) / 8;
+  for (ResultColumn& column : result->columns) {
+    if (!column.null_bitmap.empty()) {
+      column.null_bitmap.resize(bitmap_bytes, 0);
+    }
+  }
+}
+
+void AppendScaledDecimal(int64_t unscaled, int scale, std::string* out) {
+  // Negated as unsigned so INT64_MIN works too.
+  uint64_t magnitude = unscaled < 0 ? 0 - static_cast<uint64_t>(unscaled)
+                                    : static_cast<uint64_t>(unscaled);
+  std::string digits = std::to_string(magnitude);
+  size_t places = scale > 0 ? static_cast<size_t>(scale) : 0;
+  if (digits.size() <= places) {
+    digits.insert(0, places + 1 - digits.size(), '0');
+  }
+  if (unscaled < 0) {
+    out->push_back('-');
+  }
+  out->append(digits, 0, digits.size() - places);
+  if (places > 0) {
+    out->push_back('.');
+    out->append(digits, digits.size() - places, places);
+  }
+}
+
+}  // namespace mssql_connect
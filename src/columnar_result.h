@@ -0,0 +1,113 @@
+#ifndef MSSQL_CONNECT_COLUMNAR_RESULT_H_
+#define MSSQL_CONNECT_COLUMNAR_RESULT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+
+namespace mssql_connect {
+
+// One result column stored as a typed array. Only the vector matching |type|
+// is populated; NULL cells hold a zero value (or an empty string) and are
+// flagged in |null_bitmap|.
+//
+// kInt32, kInt64, kDateTime and kTime cells go in |ints|, and kGuid cells in
+// |binaries|. kDecimal cells go in |ints| unscaled when every value fits in
+// 64 bits (precision 18 or less), otherwise in |strings| as decimal text.
+struct ResultColumn {
+  std::string name;
+  CellType type = CellType::kText;
+  // Digits after the decimal point of kDecimal cells.
+  int scale = 0;
+  // Whether kDecimal cells are in |strings| rather than |ints|.
+  bool decimal_text = false;
+  std::vector<uint8_t> bools;
+  std::vector<int64_t> ints;
+  std::vector<double> doubles;
+  std::vector<std::string> strings;
+  std::vector<std::vector<uint8_t>> binaries;
+  // Rows whose cell was left in the driver to be streamed (see
+  // BlockFetcher::IsLob); their value in |strings| or |binaries| is empty.
+  std::vector<size_t> lob_rows;
+  // Bit (row % 8) of byte (row / 8) is set when the cell is NULL. Empty if
+  // the column has no NULLs.
+  std::vector<uint8_t> null_bitmap;
+
+  bool IsNull(size_t row) const {
+    return row / 8 < null_bitmap.size() &&
+           (null_bitmap[row / 8] >> (row % 8)) & 1;
+  }
+};
+
+// A result set stored column by column, so column names are sent once and
+// cells need no per-row map or per-value boxing.
+struct ColumnarResult {
+  std::vector<ResultColumn> columns;
+  size_t row_count = 0;
+};
+
+// Receives a result set row by row while it is fetched, so a reply can be
+// encoded straight from the fetcher's rowsets rather than from a copy of
+// the whole result; see ReadResult() and Session::Query().
+class ResultSink {
+ public:
+  virtual ~ResultSink() = default;
+
+  // Called once the fetcher is bound, before any row.
+  virtual void Start(const BlockFetcher& fetcher) = 0;
+  // Called for each row of the current rowset, in order. |fetcher|'s cells
+  // are only valid until it fetches the next rowset.
+  virtual void AddRow(const BlockFetcher& fetcher, size_t row) = 0;
+  // Called once the result set is exhausted; not after a failed fetch.
+  virtual void Finish() = 0;
+};
+
+// Drains |fetcher|, which must already be bound, into |sink|. Returns false
+// and fills |error| on failure.
+bool ReadResult(BlockFetcher* fetcher, ResultSink* sink, std::string* error);
+
+// Drains |fetcher|, which must already be bound, into |result|. Returns false
+// and fills |error| on failure.
+bool ReadColumnar(BlockFetcher* fetcher, ColumnarResult* result,
+                  std::string* error);
+
+// Building blocks for reading a result in pieces: start an empty result with
+// the fetcher's columns, append rows of the current rowset one at a time,
+// then finish it once no more rows will be added.
+void StartColumnar(const BlockFetcher& fetcher, ColumnarResult* result);
+// Returns the approximate number of bytes the row added.
+size_t AppendColumnarRow(const BlockFetcher& fetcher, size_t row,
+                         ColumnarResult* result);
+void FinishColumnar(ColumnarResult* result);
+
+// Reads a result into a ColumnarResult with the functions above.
+class ColumnarSink : public ResultSink {
+ public:
+  explicit ColumnarSink(ColumnarResult* result) : result_(result) {}
+
+  void Start(const BlockFetcher& fetcher) override {
+    StartColumnar(fetcher, result_);
+  }
+  void AddRow(const BlockFetcher& fetcher, size_t row) override {
+    AppendColumnarRow(fetcher, row, result_);
+  }
+  void Finish() override { FinishColumnar(result_); }
+
+ private:
+  ColumnarResult* result_;
+};
+
+// Whether the kDecimal cells of |column| are too wide for 64 bits and are
+// kept as decimal text; see ResultColumn.
+bool IsDecimalText(const ColumnDescription& column);
+
+// Appends |unscaled| / 10^|scale| as exact decimal text, like
+// BlockFetcher::AppendDecimal does for the cell it came from.
+void AppendScaledDecimal(int64_t unscaled, int scale, std::string* out);
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_COLUMNAR_RESULT_H_
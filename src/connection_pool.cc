@@ -0,0 +1,456 @@
+#include "connection_pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+namespace mssql_connect {
+
+namespace {
+
+const char kTimeoutError[] = "Timed out waiting for a pooled connection";
+
+std::string Trim(const std::string& value) {
+  size_t begin = 0;
+  size_t end = value.size();
+  while (begin < end && std::isspace(static_cast<unsigned char>(value[begin]))) {
+    ++begin;
+  }
+  while (end > begin && std::isspace(static_cast<unsigned char>(value[end - 1]))) {
+    --end;
+  }
+  return value.substr(begin, end - begin);
+}
+
+}  // namespace
+
+std::string NormalizeConnectionString(const std::string& connection_string) {
+  std::vector<std::pair<std::string, std::string>> pairs;
+  size_t pos = 0;
+  while (pos < connection_string.size()) {
+    size_t equals = connection_string.find('=', pos);
+    if (equals == std::string::npos) {
+      break;
+    }
+    std::string key = Trim(connection_string.substr(pos, equals - pos));
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+      return static_cast<char>(std::tolower(c));
+    });
+
+    // A braced value runs to the matching '}' and may contain ';'.
+    size_t value_begin = equals + 1;
+    while (value_begin < connection_string.size() &&
+           std::isspace(static_cast<unsigned char>(connection_string[value_begin]))) {
+      ++value_begin;
+    }
+    size_t value_end;
+    if (value_begin < connection_string.size() &&
+        connection_string[value_begin] == '{') {
+      size_t close = connection_string.find('}', value_begin);
+      value_end = close == std::string::npos ? connection_string.size()
+                                             : close + 1;
+      pos = connection_string.find(';', value_end);
+    } else {
+      pos = connection_string.find(';', value_begin);
+      value_end = pos;
+    }
+    if (pos == std::string::npos) {
+      pos = connection_string.size();
+    } else {
+      ++pos;
+    }
+    if (value_end == std::string::npos) {
+      value_end = connection_string.size();
+    }
+
+    if (!key.empty()) {
+      pairs.emplace_back(
+          key, Trim(connection_string.substr(value_begin, value_end - value_begin)));
+    }
+  }
+
+  std::stable_sort(pairs.begin(), pairs.end(),
+                   [](const std::pair<std::string, std::string>& a,
+                      const std::pair<std::string, std::string>& b) {
+                     return a.first < b.first;
+                   });
+
+  std::string normalized;
+  for (const auto& pair : pairs) {
+    normalized += pair.first;
+    normalized += '=';
+    normalized += pair.second;
+    normalized += ';';
+  }
+  return normalized;
+}
+
+ConnectionPool::ConnectionPool(std::unique_ptr<Factory> factory,
+                               ConnectionPoolOptions options)
+    : factory_(std::move(factory)), options_(options) {}
+
+ConnectionPool::~ConnectionPool() {
+  FailAll(std::vector<Waiter>(std::make_move_iterator(waiters_.begin()),
+                              std::make_move_iterator(waiters_.end())),
+          "The connection pool was closed");
+  for (const auto& idle : idle_) {
+    factory_->Close(idle.handle);
+  }
+}
+
+void ConnectionPool::Prewarm() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (open_.size() + opening_ < options_.min_size) {
+    ++opening_;
+    lock.unlock();
+    std::string error;
+    Handle handle = factory_->Open(&error);
+    lock.lock();
+    --opening_;
+    if (!handle) {
+      ++stats_.creation_failures;
+      break;
+    }
+    ++stats_.creations;
+    Clock::time_point now = Clock::now();
+    open_[handle] = now;
+    idle_.push_back(IdleConnection{handle, now});
+  }
+  lock.unlock();
+  released_cv_.notify_all();
+}
+
+ConnectionPool::Handle ConnectionPool::Acquire(std::string* error) {
+  const Clock::time_point deadline = Clock::now() + options_.acquire_timeout;
+  bool waited = false;
+
+  std::vector<Handle> expired;
+  Handle candidate = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      std::vector<Handle> now_expired = TakeExpiredLocked(Clock::now());
+      expired.insert(expired.end(), now_expired.begin(), now_expired.end());
+
+      if (!idle_.empty()) {
+        candidate = idle_.back().handle;
+        idle_.pop_back();
+        break;
+      }
+      if (open_.size() + opening_ < options_.max_size) {
+        ++opening_;
+        break;
+      }
+      if (!waited) {
+        waited = true;
+        ++stats_.waits;
+      }
+      if (released_cv_.wait_until(lock, deadline) == std::cv_status::timeout &&
+          idle_.empty() && open_.size() + opening_ >= options_.max_size) {
+        ++stats_.timeouts;
+        lock.unlock();
+        CloseAll(expired);
+        if (error) {
+          *error = kTimeoutError;
+        }
+        return nullptr;
+      }
+    }
+  }
+  CloseAll(expired);
+
+  std::string open_error;
+  Handle handle = Finish(candidate, &open_error);
+  if (!handle) {
+    if (error) {
+      *error = open_error;
+    }
+    // The reserved slot is free again.
+    released_cv_.notify_one();
+    ServeWaiters();
+  }
+  return handle;
+}
+
+void ConnectionPool::AcquireAsync(const void* owner, AcquireCallback done) {
+  std::vector<Handle> expired;
+  Handle candidate = nullptr;
+  bool queued = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Clock::time_point now = Clock::now();
+    expired = TakeExpiredLocked(now);
+    if (!idle_.empty()) {
+      candidate = idle_.back().handle;
+      idle_.pop_back();
+    } else if (open_.size() + opening_ < options_.max_size) {
+      ++opening_;
+    } else {
+      ++stats_.waits;
+      waiters_.push_back(
+          Waiter{owner, now + options_.acquire_timeout, std::move(done)});
+      queued = true;
+    }
+  }
+  CloseAll(expired);
+  if (queued) {
+    return;
+  }
+
+  std::string error;
+  Handle handle = Finish(candidate, &error);
+  done(handle, error);
+  if (!handle) {
+    released_cv_.notify_one();
+    ServeWaiters();
+  }
+}
+
+void ConnectionPool::CancelWaiters(const void* owner) {
+  std::vector<Waiter> cancelled;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = waiters_.begin(); it != waiters_.end();) {
+      if (it->owner == owner) {
+        cancelled.push_back(std::move(*it));
+        it = waiters_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  FailAll(std::move(cancelled), "Acquire was cancelled");
+}
+
+void ConnectionPool::Release(Handle handle) {
+  std::vector<Handle> expired;
+  AcquireCallback handoff;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_.find(handle) == open_.end()) {
+      return;
+    }
+    Clock::time_point now = Clock::now();
+    if (IsExpiredLocked(handle, now)) {
+      open_.erase(handle);
+      ++stats_.lifetime_evictions;
+      expired.push_back(handle);
+    } else if (!waiters_.empty()) {
+      handoff = std::move(waiters_.front().done);
+      waiters_.pop_front();
+      ++stats_.hits;
+    } else {
+      idle_.push_back(IdleConnection{handle, now});
+    }
+    std::vector<Handle> idle_expired = TakeExpiredLocked(now);
+    expired.insert(expired.end(), idle_expired.begin(), idle_expired.end());
+  }
+  CloseAll(expired);
+  if (handoff) {
+    handoff(handle, std::string());
+  } else {
+    released_cv_.notify_one();
+  }
+  ServeWaiters();
+}
+
+void ConnectionPool::Discard(Handle handle) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_.erase(handle) == 0) {
+      return;
+    }
+  }
+  factory_->Close(handle);
+  released_cv_.notify_one();
+  ServeWaiters();
+}
+
+void ConnectionPool::EvictExpired() {
+  std::vector<Handle> expired;
+  std::vector<Waiter> timed_out;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Clock::time_point now = Clock::now();
+    expired = TakeExpiredLocked(now);
+    // Every waiter waits as long, so the oldest time out first.
+    while (!waiters_.empty() && waiters_.front().deadline <= now) {
+      timed_out.push_back(std::move(waiters_.front()));
+      waiters_.pop_front();
+      ++stats_.timeouts;
+    }
+  }
+  CloseAll(expired);
+  FailAll(std::move(timed_out), kTimeoutError);
+}
+
+ConnectionPoolStats ConnectionPool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ConnectionPoolStats stats = stats_;
+  stats.waiting = waiters_.size();
+  stats.idle = idle_.size();
+  stats.in_use = open_.size() - idle_.size();
+  return stats;
+}
+
+bool ConnectionPool::IsExpiredLocked(Handle handle, Clock::time_point now) const {
+  if (options_.max_lifetime.count() <= 0) {
+    return false;
+  }
+  auto it = open_.find(handle);
+  return it != open_.end() && now - it->second >= options_.max_lifetime;
+}
+
+std::vector<ConnectionPool::Handle> ConnectionPool::TakeExpiredLocked(
+    Clock::time_point now) {
+  std::vector<Handle> expired;
+  auto it = idle_.begin();
+  while (it != idle_.end()) {
+    if (IsExpiredLocked(it->handle, now)) {
+      ++stats_.lifetime_evictions;
+    } else if (open_.size() > options_.min_size &&
+               now - it->last_used >= options_.idle_timeout) {
+      ++stats_.idle_evictions;
+    } else {
+      ++it;
+      continue;
+    }
+    expired.push_back(it->handle);
+    open_.erase(it->handle);
+    it = idle_.erase(it);
+  }
+  return expired;
+}
+
+void ConnectionPool::CloseAll(const std::vector<Handle>& handles) {
+  for (Handle handle : handles) {
+    factory_->Close(handle);
+  }
+}
+
+ConnectionPool::Handle ConnectionPool::Finish(Handle candidate,
+                                              std::string* error) {
+  if (candidate) {
+    if (factory_->IsAlive(candidate)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.hits;
+      return candidate;
+    }
+    // The server or network dropped it while idle; its slot goes to a
+    // replacement.
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      open_.erase(candidate);
+      ++stats_.dead_evictions;
+      ++opening_;
+    }
+    factory_->Close(candidate);
+  }
+  Handle handle = factory_->Open(error);
+  std::lock_guard<std::mutex> lock(mutex_);
+  --opening_;
+  if (handle) {
+    ++stats_.creations;
+    open_[handle] = Clock::now();
+  } else {
+    ++stats_.creation_failures;
+  }
+  return handle;
+}
+
+void ConnectionPool::ServeWaiters() {
+  while (true) {
+    AcquireCallback done;
+    Handle candidate = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (waiters_.empty()) {
+        return;
+      }
+      if (!idle_.empty()) {
+        candidate = idle_.back().handle;
+        idle_.pop_back();
+      } else if (open_.size() + opening_ < options_.max_size) {
+        ++opening_;
+      } else {
+        return;
+      }
+      done = std::move(waiters_.front().done);
+      waiters_.pop_front();
+    }
+    std::string error;
+    Handle handle = Finish(candidate, &error);
+    done(handle, error);
+    if (!handle) {
+      // The slot is free again, for the next waiter or an Acquire().
+      released_cv_.notify_one();
+    }
+  }
+}
+
+void ConnectionPool::FailAll(std::vector<Waiter> waiters,
+                             const std::string& error) {
+  for (Waiter& waiter : waiters) {
+    waiter.done(nullptr, error);
+  }
+}
+
+ConnectionPoolRegistry::ConnectionPoolRegistry(
+    std::chrono::milliseconds sweep_interval)
+    : sweep_interval_(sweep_interval) {}
+
+ConnectionPoolRegistry::~ConnectionPoolRegistry() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  stop_cv_.notify_all();
+  if (sweeper_.joinable()) {
+    sweeper_.join();
+  }
+}
+
+std::shared_ptr<ConnectionPool> ConnectionPoolRegistry::GetOrCreate(
+    const std::string& key, const std::string& label, const Creator& create) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = pools_.find(key);
+  if (it != pools_.end()) {
+    return it->second.pool;
+  }
+  std::shared_ptr<ConnectionPool> pool = create();
+  pools_[key] = Entry{label, pool};
+  if (!sweeper_.joinable()) {
+    sweeper_ = std::thread([this]() { SweepLoop(); });
+  }
+  return pool;
+}
+
+std::vector<std::pair<std::string, std::shared_ptr<ConnectionPool>>>
+ConnectionPoolRegistry::Snapshot() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::pair<std::string, std::shared_ptr<ConnectionPool>>> pools;
+  pools.reserve(pools_.size());
+  for (const auto& entry : pools_) {
+    pools.emplace_back(entry.second.label, entry.second.pool);
+  }
+  return pools;
+}
+
+void ConnectionPoolRegistry::SweepLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_cv_.wait_for(lock, sweep_interval_, [this]() { return stopping_; })) {
+    std::vector<std::shared_ptr<ConnectionPool>> pools;
+    pools.reserve(pools_.size());
+    for (const auto& entry : pools_) {
+      pools.push_back(entry.second.pool);
+    }
+    // Closing connections can take a server round trip each.
+    lock.unlock();
+    for (const auto& pool : pools) {
+      pool->EvictExpired();
+    }
+    lock.lock();
+  }
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,233 @@
+#ifndef MSSQL_CONNECT_CONNECTION_POOL_H_
+#define MSSQL_CONNECT_CONNECTION_POOL_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mssql_connect {
+
+// Returns |connection_string| with keys trimmed and lower-cased and the
+// key/value pairs sorted, so that strings differing only in key order, case
+// or whitespace map to the same pool. Values are kept verbatim, including
+// {braced} values that contain ';'.
+std::string NormalizeConnectionString(const std::string& connection_string);
+
+struct ConnectionPoolOptions {
+  // Connections kept open even when idle for longer than |idle_timeout|.
+  size_t min_size = 0;
+  // Upper bound on open connections, idle plus in use.
+  size_t max_size = 10;
+  // Idle connections beyond |min_size| are closed after this long.
+  std::chrono::milliseconds idle_timeout = std::chrono::minutes(5);
+  // Connections are closed instead of reused once this old. Zero disables.
+  std::chrono::milliseconds max_lifetime = std::chrono::minutes(30);
+  // How long Acquire() and AcquireAsync() wait for a connection when the
+  // pool is exhausted.
+  std::chrono::milliseconds acquire_timeout = std::chrono::seconds(30);
+};
+
+struct ConnectionPoolStats {
+  // Acquires served from an idle connection.
+  uint64_t hits = 0;
+  // Acquires that had to wait for another caller to release.
+  uint64_t waits = 0;
+  // AcquireAsync() calls currently queued.
+  size_t waiting = 0;
+  // Acquires that gave up after |acquire_timeout|.
+  uint64_t timeouts = 0;
+  // Connections opened, and attempts that failed.
+  uint64_t creations = 0;
+  uint64_t creation_failures = 0;
+  // Connections closed for idling, age, or failing the liveness check.
+  uint64_t idle_evictions = 0;
+  uint64_t lifetime_evictions = 0;
+  uint64_t dead_evictions = 0;
+  size_t idle = 0;
+  size_t in_use = 0;
+};
+
+// A bounded pool of open connections to one target.
+//
+// The pool is agnostic of the handle type; a Factory opens, checks and closes
+// handles. Idle and lifetime eviction happen on Acquire()/Release() and on
+// EvictExpired(), which ConnectionPoolRegistry calls periodically.
+class ConnectionPool {
+ public:
+  using Handle = void*;
+  using Clock = std::chrono::steady_clock;
+
+  // Receives an open connection, or nullptr and the reason there is none.
+  using AcquireCallback =
+      std::function<void(Handle handle, const std::string& error)>;
+
+  class Factory {
+   public:
+    virtual ~Factory() = default;
+
+    // Opens a new connection, or returns nullptr and fills |error|.
+    virtual Handle Open(std::string* error) = 0;
+
+    // A cheap, local check that |handle| is still usable. Must not do a
+    // server round trip.
+    virtual bool IsAlive(Handle handle) = 0;
+
+    virtual void Close(Handle handle) = 0;
+  };
+
+  ConnectionPool(std::unique_ptr<Factory> factory, ConnectionPoolOptions options);
+
+  // Closes idle connections and fails queued AcquireAsync() calls. Every
+  // acquired connection must have been released or discarded first.
+  ~ConnectionPool();
+
+  ConnectionPool(const ConnectionPool&) = delete;
+  ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+  // Opens connections until |min_size| are available.
+  void Prewarm();
+
+  // Returns an open connection, waiting up to |acquire_timeout| if the pool
+  // is at |max_size|. Returns nullptr and fills |error| on failure.
+  Handle Acquire(std::string* error);
+
+  // Like Acquire() but never waits: if the pool is at |max_size|, |done| is
+  // queued and called, in order, by the Release() or Discard() that frees a
+  // connection, or with an error by the first EvictExpired() after
+  // |acquire_timeout|. Otherwise it is called before this returns. |done|
+  // runs without the pool's lock, on whichever thread completes it, and
+  // may have to open a connection first; it should not block.
+  //
+  // |owner| tags the call for CancelWaiters().
+  void AcquireAsync(const void* owner, AcquireCallback done);
+
+  // Fails every queued AcquireAsync() call of |owner|, e.g. before the
+  // owner goes away.
+  void CancelWaiters(const void* owner);
+
+  // Returns |handle| to the pool for reuse, or hands it to the oldest
+  // queued AcquireAsync() call.
+  void Release(Handle handle);
+
+  // Closes |handle| instead of reusing it, e.g. after a fatal error.
+  void Discard(Handle handle);
+
+  // Closes idle connections past their idle timeout or lifetime, and fails
+  // AcquireAsync() calls queued for longer than |acquire_timeout|.
+  void EvictExpired();
+
+  const ConnectionPoolOptions& options() const { return options_; }
+
+  ConnectionPoolStats stats() const;
+
+ private:
+  struct IdleConnection {
+    Handle handle;
+    Clock::time_point last_used;
+  };
+
+  struct Waiter {
+    const void* owner;
+    Clock::time_point deadline;
+    AcquireCallback done;
+  };
+
+  bool IsExpiredLocked(Handle handle, Clock::time_point now) const;
+
+  // Removes expired idle connections and returns them for closing outside
+  // the lock.
+  std::vector<Handle> TakeExpiredLocked(Clock::time_point now);
+
+  void CloseAll(const std::vector<Handle>& handles);
+
+  // Ends an acquire that took |candidate| from the idle list, or that
+  // reserved an opening slot if |candidate| is null. A dead candidate's
+  // slot is used to open a replacement.
+  Handle Finish(Handle candidate, std::string* error);
+
+  // Gives free slots to queued AcquireAsync() calls, opening a connection
+  // for each.
+  void ServeWaiters();
+
+  // Calls the |done| of each of |waiters| with |error|.
+  static void FailAll(std::vector<Waiter> waiters, const std::string& error);
+
+  std::unique_ptr<Factory> factory_;
+  const ConnectionPoolOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable released_cv_;
+  // Most recently released at the back, so reuse favours warm connections
+  // and the oldest idle ones age out.
+  std::vector<IdleConnection> idle_;
+  // Creation time of every open connection, idle or in use.
+  std::unordered_map<Handle, Clock::time_point> open_;
+  // Connections currently being opened; they count towards |max_size|.
+  size_t opening_ = 0;
+  // AcquireAsync() calls waiting for a connection, oldest first. Only
+  // non-empty while the pool is at |max_size| with nothing idle.
+  std::deque<Waiter> waiters_;
+  ConnectionPoolStats stats_;
+};
+
+// Pools keyed by normalized connection string.
+//
+// Once the first pool exists, a background thread calls EvictExpired() on
+// every pool each |sweep_interval|, so a pool that nobody acquires from any
+// more still closes its connections as they idle out.
+class ConnectionPoolRegistry {
+ public:
+  using Creator = std::function<std::shared_ptr<ConnectionPool>()>;
+
+  explicit ConnectionPoolRegistry(
+      std::chrono::milliseconds sweep_interval = std::chrono::seconds(1));
+
+  // Stops the sweeps. Pools still referenced elsewhere live on.
+  ~ConnectionPoolRegistry();
+
+  ConnectionPoolRegistry(const ConnectionPoolRegistry&) = delete;
+  ConnectionPoolRegistry& operator=(const ConnectionPoolRegistry&) = delete;
+
+  // Returns the pool for |key|, calling |create| if there is none yet.
+  // |label| is what Snapshot() reports for the pool; unlike |key| it should
+  // not contain credentials.
+  std::shared_ptr<ConnectionPool> GetOrCreate(const std::string& key,
+                                              const std::string& label,
+                                              const Creator& create);
+
+  // Returns every pool together with its label.
+  std::vector<std::pair<std::string, std::shared_ptr<ConnectionPool>>>
+  Snapshot() const;
+
+ private:
+  struct Entry {
+    std::string label;
+    std::shared_ptr<ConnectionPool> pool;
+  };
+
+  void SweepLoop();
+
+  const std::chrono::milliseconds sweep_interval_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> pools_;
+  // Wakes the sweeper early when the registry is destroyed.
+  std::condition_variable stop_cv_;
+  bool stopping_ = false;
+  // Started with the first pool.
+  std::thread sweeper_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_CONNECTION_POOL_H_
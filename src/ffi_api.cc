@@ -0,0 +1,500 @@
+#include "ffi_api.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "odbc_error.h"
+#include "session.h"
+
+using mssql_connect::BlockFetcher;
+using mssql_connect::CellType;
+using mssql_connect::ConnectOptions;
+using mssql_connect::ErrorCodeForState;
+using mssql_connect::GetOdbcDiagnostics;
+using mssql_connect::GetOdbcSqlState;
+using mssql_connect::PreparedStatement;
+using mssql_connect::Session;
+using mssql_connect::SessionError;
+using mssql_connect::SqlParameter;
+using mssql_connect::TimeoutSeconds;
+
+struct mssql_connection {
+  std::unique_ptr<Session> session;
+  // The error of the last failed call; see mssql_errcode().
+  std::string error_code;
+  std::string error_message;
+};
+
+struct mssql_statement {
+  enum class State {
+    // Not executed since it was prepared or reset.
+    kReady,
+    // Positioned on row |row| of the current rowset.
+    kRows,
+    // Executed and exhausted, or failed.
+    kDone,
+  };
+
+  mssql_connection* connection = nullptr;
+  std::string sql;
+  std::unique_ptr<PreparedStatement> prepared;
+  std::vector<SqlParameter> params;
+  mssql_connect::ParameterBinder binder;
+  // Set while a result set is open.
+  std::unique_ptr<BlockFetcher> fetcher;
+  State state = State::kReady;
+  SQLULEN rows = 0;
+  SQLULEN row = 0;
+  int64_t changes = -1;
+  // Conversions of the current row's cells, one per column; see
+  // mssql_column_text() and mssql_column_blob().
+  std::vector<std::string> text;
+  std::vector<std::vector<uint8_t>> guids;
+};
+
+namespace {
+
+const char kQueryError[] = "QueryError";
+const char kQueryFailed[] = "Query execution failed";
+
+int32_t Fail(mssql_connection* connection, const std::string& code,
+             const std::string& message, const std::string& details) {
+  connection->error_code = code;
+  connection->error_message =
+      details.empty() ? message : message + ": " + details;
+  return MSSQL_ERROR;
+}
+
+void ClearError(mssql_connection* connection) {
+  connection->error_code.clear();
+  connection->error_message.clear();
+}
+
+// Closes the open result set, if any, so the statement can run again.
+void CloseResult(mssql_statement* statement) {
+  statement->fetcher.reset();
+  SQLFreeStmt(statement->prepared->handle(), SQL_CLOSE);
+  statement->rows = 0;
+  statement->row = 0;
+}
+
+// Reads the next rowset and moves to its first row.
+int32_t FetchRowset(mssql_statement* statement) {
+  std::string error;
+  if (!statement->fetcher->Next(&statement->rows, &error)) {
+    statement->state = mssql_statement::State::kDone;
+    statement->prepared->described = false;
+    std::string sqlstate =
+        GetOdbcSqlState(SQL_HANDLE_STMT, statement->prepared->handle());
+    return Fail(statement->connection,
+                ErrorCodeForState(sqlstate, false, kQueryError),
+                "Failed to fetch rows", error);
+  }
+  statement->row = 0;
+  if (statement->rows == 0) {
+    statement->state = mssql_statement::State::kDone;
+    return MSSQL_DONE;
+  }
+  return MSSQL_ROW;
+}
+
+int32_t NextRow(mssql_statement* statement) {
+  if (statement->row + 1 < statement->rows) {
+    ++statement->row;
+    return MSSQL_ROW;
+  }
+  return FetchRowset(statement);
+}
+
+int32_t Execute(mssql_statement* statement) {
+  mssql_connection* connection = statement->connection;
+  SQLHSTMT stmt = statement->prepared->handle();
+  // Anything after this fails until mssql_reset().
+  statement->state = mssql_statement::State::kDone;
+
+  std::string error;
+  if (!statement->binder.Bind(stmt, statement->params, &error)) {
+    return Fail(connection, kQueryError, kQueryFailed, error);
+  }
+  SQLRETURN ret = SQLExecute(stmt);
+  if (!SQL_SUCCEEDED(ret) && ret != SQL_NO_DATA) {
+    std::string sqlstate = GetOdbcSqlState(SQL_HANDLE_STMT, stmt);
+    error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+    SQLFreeStmt(stmt, SQL_CLOSE);
+    return Fail(connection, ErrorCodeForState(sqlstate, false, kQueryError),
+                kQueryFailed, error);
+  }
+
+  SQLSMALLINT column_count = 0;
+  if (ret != SQL_NO_DATA) {
+    SQLNumResultCols(stmt, &column_count);
+  }
+  if (column_count == 0) {
+    statement->changes = mssql_connect::AffectedRows(stmt, ret, statement->sql);
+    return MSSQL_DONE;
+  }
+
+  statement->fetcher.reset(new BlockFetcher(stmt));
+  statement->fetcher->set_utf8_text(connection->session->utf8_text());
+  if (!mssql_connect::DescribeResult(statement->prepared.get(),
+                                     statement->fetcher.get(),
+                                     mssql_connect::TraceCall(), &error)) {
+    CloseResult(statement);
+    return Fail(connection, kQueryError, "Failed to describe result", error);
+  }
+  statement->text.assign(column_count, std::string());
+  statement->guids.assign(column_count, std::vector<uint8_t>());
+  statement->state = mssql_statement::State::kRows;
+  return FetchRowset(statement);
+}
+
+int32_t Bind(mssql_statement* statement, int32_t index, SqlParameter value) {
+  if (statement == nullptr || index < 1 ||
+      statement->state != mssql_statement::State::kReady) {
+    return MSSQL_MISUSE;
+  }
+  if (statement->params.size() < static_cast<size_t>(index)) {
+    statement->params.resize(index);
+  }
+  statement->params[index - 1] = std::move(value);
+  return MSSQL_OK;
+}
+
+// Whether |column| of the current row can be read.
+bool HasCell(mssql_statement* statement, int32_t column) {
+  return statement != nullptr &&
+         statement->state == mssql_statement::State::kRows && column >= 0 &&
+         static_cast<size_t>(column) < statement->fetcher->columns().size() &&
+         !statement->fetcher->IsNull(column, statement->row);
+}
+
+}  // namespace
+
+int32_t mssql_open(const char* server, const char* database,
+                   const char* username, const char* password,
+                   int64_t login_timeout_ms, mssql_connection** connection) {
+  if (connection == nullptr) {
+    return MSSQL_MISUSE;
+  }
+  *connection = new mssql_connection();
+  ConnectOptions options;
+  options.server = server ? server : "";
+  options.database = database ? database : "";
+  options.username = username ? username : "";
+  options.password = password ? password : "";
+  options.login_timeout = TimeoutSeconds(login_timeout_ms);
+  SessionError error;
+  (*connection)->session = Session::Open(options, nullptr, &error);
+  if (!(*connection)->session) {
+    return Fail(*connection, error.code, error.message, error.details);
+  }
+  return MSSQL_OK;
+}
+
+void mssql_close(mssql_connection* connection) {
+  delete connection;
+}
+
+const char* mssql_errcode(mssql_connection* connection) {
+  return connection ? connection->error_code.c_str() : "";
+}
+
+const char* mssql_errmsg(mssql_connection* connection) {
+  return connection ? connection->error_message.c_str() : "";
+}
+
+int32_t mssql_prepare(mssql_connection* connection, const char* sql,
+                      int64_t timeout_ms, mssql_statement** statement) {
+  if (connection == nullptr || !connection->session || sql == nullptr ||
+      *sql == '\0' || statement == nullptr) {
+    return MSSQL_MISUSE;
+  }
+  ClearError(connection);
+  Session* session = connection->session.get();
+  std::string error;
+  std::unique_ptr<PreparedStatement> prepared =
+      session->statements()->Take(session->handle(), sql, &error);
+  if (!prepared) {
+    return Fail(connection, kQueryError, "Failed to prepare statement", error);
+  }
+  if (!prepared->SetQueryTimeout(TimeoutSeconds(timeout_ms), &error)) {
+    session->statements()->Return(sql, std::move(prepared));
+    return Fail(connection, kQueryError, "Failed to prepare statement", error);
+  }
+  *statement = new mssql_statement();
+  (*statement)->connection = connection;
+  (*statement)->sql = sql;
+  (*statement)->prepared = std::move(prepared);
+  return MSSQL_OK;
+}
+
+void mssql_finalize(mssql_statement* statement) {
+  if (statement == nullptr) {
+    return;
+  }
+  statement->fetcher.reset();
+  statement->connection->session->statements()->Return(
+      statement->sql, std::move(statement->prepared));
+  delete statement;
+}
+
+int32_t mssql_reset(mssql_statement* statement) {
+  if (statement == nullptr) {
+    return MSSQL_MISUSE;
+  }
+  if (statement->state != mssql_statement::State::kReady) {
+    CloseResult(statement);
+  }
+  statement->state = mssql_statement::State::kReady;
+  statement->changes = -1;
+  return MSSQL_OK;
+}
+
+int32_t mssql_clear_bindings(mssql_statement* statement) {
+  if (statement == nullptr ||
+      statement->state != mssql_statement::State::kReady) {
+    return MSSQL_MISUSE;
+  }
+  statement->params.clear();
+  return MSSQL_OK;
+}
+
+int32_t mssql_bind_null(mssql_statement* statement, int32_t index) {
+  return Bind(statement, index, SqlParameter::Null());
+}
+
+int32_t mssql_bind_bool(mssql_statement* statement, int32_t index,
+                        int32_t value) {
+  return Bind(statement, index, SqlParameter::Bool(value != 0));
+}
+
+int32_t mssql_bind_int64(mssql_statement* statement, int32_t index,
+                         int64_t value) {
+  return Bind(statement, index, SqlParameter::Int64(value));
+}
+
+int32_t mssql_bind_double(mssql_statement* statement, int32_t index,
+                          double value) {
+  return Bind(statement, index, SqlParameter::Double(value));
+}
+
+int32_t mssql_bind_text(mssql_statement* statement, int32_t index,
+                        const char* value, int32_t length) {
+  if (value == nullptr) {
+    return mssql_bind_null(statement, index);
+  }
+  size_t size = length < 0 ? std::strlen(value) : static_cast<size_t>(length);
+  return Bind(statement, index, SqlParameter::Text(std::string(value, size)));
+}
+
+int32_t mssql_bind_blob(mssql_statement* statement, int32_t index,
+                        const void* value, int32_t length) {
+  if (value == nullptr || length < 0) {
+    return mssql_bind_null(statement, index);
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(value);
+  return Bind(statement, index,
+              SqlParameter::Binary(std::vector<uint8_t>(bytes, bytes + length)));
+}
+
+int32_t mssql_step(mssql_statement* statement) {
+  if (statement == nullptr) {
+    return MSSQL_MISUSE;
+  }
+  ClearError(statement->connection);
+  switch (statement->state) {
+    case mssql_statement::State::kReady:
+      return Execute(statement);
+    case mssql_statement::State::kRows:
+      return NextRow(statement);
+    case mssql_statement::State::kDone:
+      break;
+  }
+  return MSSQL_DONE;
+}
+
+int64_t mssql_changes(mssql_statement* statement) {
+  return statement ? statement->changes : -1;
+}
+
+void mssql_interrupt(mssql_statement* statement) {
+  if (statement != nullptr) {
+    SQLCancel(statement->prepared->handle());
+  }
+}
+
+int32_t mssql_column_count(mssql_statement* statement) {
+  if (statement == nullptr || !statement->fetcher) {
+    return 0;
+  }
+  return static_cast<int32_t>(statement->fetcher->columns().size());
+}
+
+const char* mssql_column_name(mssql_statement* statement, int32_t column) {
+  if (column < 0 || column >= mssql_column_count(statement)) {
+    return nullptr;
+  }
+  return statement->fetcher->columns()[column].name.c_str();
+}
+
+int32_t mssql_column_type(mssql_statement* statement, int32_t column) {
+  if (column < 0 || column >= mssql_column_count(statement)) {
+    return 0;
+  }
+  switch (statement->fetcher->cell_type(column)) {
+    case CellType::kBool:
+      return MSSQL_TYPE_BOOL;
+    case CellType::kInt32:
+    case CellType::kInt64:
+      return MSSQL_TYPE_INT;
+    case CellType::kDouble:
+      return MSSQL_TYPE_DOUBLE;
+    case CellType::kDecimal:
+      return MSSQL_TYPE_DECIMAL;
+    case CellType::kDateTime:
+      return MSSQL_TYPE_DATETIME;
+    case CellType::kTime:
+      return MSSQL_TYPE_TIME;
+    case CellType::kGuid:
+      return MSSQL_TYPE_GUID;
+    case CellType::kBinary:
+      return MSSQL_TYPE_BINARY;
+    case CellType::kText:
+      break;
+  }
+  return MSSQL_TYPE_TEXT;
+}
+
+int32_t mssql_column_scale(mssql_statement* statement, int32_t column) {
+  if (column < 0 || column >= mssql_column_count(statement)) {
+    return 0;
+  }
+  return statement->fetcher->decimal_scale(column);
+}
+
+int32_t mssql_column_is_null(mssql_statement* statement, int32_t column) {
+  if (statement == nullptr ||
+      statement->state != mssql_statement::State::kRows || column < 0 ||
+      column >= mssql_column_count(statement)) {
+    return 1;
+  }
+  return statement->fetcher->IsNull(column, statement->row) ? 1 : 0;
+}
+
+int64_t mssql_column_int64(mssql_statement* statement, int32_t column) {
+  if (!HasCell(statement, column)) {
+    return 0;
+  }
+  const BlockFetcher& fetcher = *statement->fetcher;
+  SQLULEN row = statement->row;
+  switch (fetcher.cell_type(column)) {
+    case CellType::kBool:
+      return fetcher.GetBool(column, row) ? 1 : 0;
+    case CellType::kInt32:
+      return fetcher.GetInt32(column, row);
+    case CellType::kInt64:
+      return fetcher.GetInt64(column, row);
+    case CellType::kDateTime:
+    case CellType::kTime:
+      return fetcher.GetMicros(column, row);
+    case CellType::kDecimal: {
+      int64_t unscaled = 0;
+      return fetcher.GetDecimal(column, row, &unscaled) ? unscaled : 0;
+    }
+    case CellType::kDouble:
+      return static_cast<int64_t>(fetcher.GetDouble(column, row));
+    case CellType::kGuid:
+    case CellType::kText:
+    case CellType::kBinary:
+      break;
+  }
+  return 0;
+}
+
+double mssql_column_double(mssql_statement* statement, int32_t column) {
+  if (!HasCell(statement, column)) {
+    return 0;
+  }
+  const BlockFetcher& fetcher = *statement->fetcher;
+  switch (fetcher.cell_type(column)) {
+    case CellType::kDouble:
+      return fetcher.GetDouble(column, statement->row);
+    case CellType::kDecimal: {
+      std::string text;
+      fetcher.AppendDecimal(column, statement->row, &text);
+      return std::strtod(text.c_str(), nullptr);
+    }
+    default:
+      return static_cast<double>(mssql_column_int64(statement, column));
+  }
+}
+
+const char* mssql_column_text(mssql_statement* statement, int32_t column,
+                              int32_t* length) {
+  if (length != nullptr) {
+    *length = 0;
+  }
+  if (!HasCell(statement, column)) {
+    return nullptr;
+  }
+  const BlockFetcher& fetcher = *statement->fetcher;
+  std::string& text = statement->text[column];
+  text.clear();
+  switch (fetcher.cell_type(column)) {
+    case CellType::kText:
+      fetcher.AppendText(column, statement->row, &text);
+      break;
+    case CellType::kDecimal:
+      fetcher.AppendDecimal(column, statement->row, &text);
+      break;
+    default:
+      return nullptr;
+  }
+  if (length != nullptr) {
+    *length = static_cast<int32_t>(text.size());
+  }
+  return text.c_str();
+}
+
+const uint8_t* mssql_column_blob(mssql_statement* statement, int32_t column,
+                                 int32_t* length) {
+  if (length != nullptr) {
+    *length = 0;
+  }
+  if (!HasCell(statement, column)) {
+    return nullptr;
+  }
+  const BlockFetcher& fetcher = *statement->fetcher;
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  switch (fetcher.cell_type(column)) {
+    case CellType::kBinary:
+      data = fetcher.GetBinary(column, statement->row, &size);
+      break;
+    case CellType::kGuid: {
+      std::vector<uint8_t>& guid = statement->guids[column];
+      guid.resize(16);
+      fetcher.GetGuid(column, statement->row, guid.data());
+      data = guid.data();
+      size = guid.size();
+      break;
+    }
+    case CellType::kText: {
+      int32_t text_length = 0;
+      data = reinterpret_cast<const uint8_t*>(
+          mssql_column_text(statement, column, &text_length));
+      size = static_cast<size_t>(text_length);
+      break;
+    }
+    default:
+      return nullptr;
+  }
+  if (length != nullptr) {
+    *length = static_cast<int32_t>(size);
+  }
+  return data;
+}
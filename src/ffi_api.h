@@ -0,0 +1,158 @@
+#ifndef MSSQL_CONNECT_FFI_API_H_
+#define MSSQL_CONNECT_FFI_API_H_
+
+// A synchronous C API over the shared session engine (see session.h), for
+// dart:ffi callers that cannot afford a platform channel round trip, e.g.
+// one-row lookups by key run from a background isolate.
+//
+// The calls follow the prepare/bind/step pattern of SQLite:
+//
+//   mssql_connection* db;
+//   if (mssql_open("server", "db", "user", "pass", 15000, &db) != MSSQL_OK) {
+//     puts(mssql_errmsg(db));
+//   }
+//   mssql_statement* stmt;
+//   mssql_prepare(db, "SELECT name FROM users WHERE id = ?", 0, &stmt);
+//   mssql_bind_int64(stmt, 1, 42);
+//   while (mssql_step(stmt) == MSSQL_ROW) {
+//     puts(mssql_column_text(stmt, 0, NULL));
+//   }
+//   mssql_finalize(stmt);
+//   mssql_close(db);
+//
+// Rows are read straight from the driver's bound rowset buffers, so a step
+// costs no allocation unless a text or GUID cell is converted.
+//
+// A connection and its statements must be used from one thread at a time.
+// Only mssql_interrupt() may be called from another thread. Connections
+// opened here are separate from the ones the platform channel opens.
+//
+// Pointers returned by mssql_errmsg() and mssql_column_*() stay valid until
+// the next call on the same connection or statement.
+
+#include <stdint.h>
+
+#ifdef FLUTTER_PLUGIN_IMPL
+#ifdef _WIN32
+#define MSSQL_CONNECT_API __declspec(dllexport)
+#else
+#define MSSQL_CONNECT_API __attribute__((visibility("default")))
+#endif
+#else
+#define MSSQL_CONNECT_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mssql_connection mssql_connection;
+typedef struct mssql_statement mssql_statement;
+
+// Result codes.
+#define MSSQL_OK 0
+// The call failed; mssql_errcode() and mssql_errmsg() say why.
+#define MSSQL_ERROR 1
+// The call was made with invalid arguments or in the wrong state.
+#define MSSQL_MISUSE 2
+// mssql_step() has a row ready.
+#define MSSQL_ROW 100
+// mssql_step() has finished executing the statement.
+#define MSSQL_DONE 101
+
+// Column types, as CellType in block_fetcher.h.
+#define MSSQL_TYPE_BOOL 1
+#define MSSQL_TYPE_INT 2
+#define MSSQL_TYPE_DOUBLE 3
+#define MSSQL_TYPE_DECIMAL 4
+#define MSSQL_TYPE_DATETIME 5
+#define MSSQL_TYPE_TIME 6
+#define MSSQL_TYPE_GUID 7
+#define MSSQL_TYPE_TEXT 8
+#define MSSQL_TYPE_BINARY 9
+
+// Connects to |server|. |login_timeout_ms| of zero keeps the driver's
+// default. |*connection| is set even when the connection fails, so the
+// error can be read; it must always be passed to mssql_close().
+MSSQL_CONNECT_API int32_t mssql_open(const char* server, const char* database,
+                                     const char* username, const char* password,
+                                     int64_t login_timeout_ms,
+                                     mssql_connection** connection);
+// Disconnects. Every statement of |connection| must be finalized first.
+MSSQL_CONNECT_API void mssql_close(mssql_connection* connection);
+
+// The error of the last failed call on |connection| or one of its
+// statements: a code such as "QueryError", "Timeout" or "Cancelled", and
+// the driver's diagnostics. Empty strings when the last call succeeded.
+MSSQL_CONNECT_API const char* mssql_errcode(mssql_connection* connection);
+MSSQL_CONNECT_API const char* mssql_errmsg(mssql_connection* connection);
+
+// Prepares |sql|, with ? placeholders, reusing the connection's cached
+// statement for the same text. |timeout_ms| of zero means no query timeout.
+MSSQL_CONNECT_API int32_t mssql_prepare(mssql_connection* connection,
+                                        const char* sql, int64_t timeout_ms,
+                                        mssql_statement** statement);
+// Returns |statement| to the connection's statement cache.
+MSSQL_CONNECT_API void mssql_finalize(mssql_statement* statement);
+// Ends the current execution so the statement can be stepped again. Bound
+// values are kept.
+MSSQL_CONNECT_API int32_t mssql_reset(mssql_statement* statement);
+MSSQL_CONNECT_API int32_t mssql_clear_bindings(mssql_statement* statement);
+
+// Sets parameter |index| (one-based). Values are copied. Only allowed
+// before the first mssql_step() or after mssql_reset(). A |length| of -1
+// reads |value| up to its terminating NUL.
+MSSQL_CONNECT_API int32_t mssql_bind_null(mssql_statement* statement, int32_t index);
+MSSQL_CONNECT_API int32_t mssql_bind_bool(mssql_statement* statement, int32_t index,
+                                          int32_t value);
+MSSQL_CONNECT_API int32_t mssql_bind_int64(mssql_statement* statement, int32_t index,
+                                           int64_t value);
+MSSQL_CONNECT_API int32_t mssql_bind_double(mssql_statement* statement, int32_t index,
+                                            double value);
+MSSQL_CONNECT_API int32_t mssql_bind_text(mssql_statement* statement, int32_t index,
+                                          const char* value, int32_t length);
+MSSQL_CONNECT_API int32_t mssql_bind_blob(mssql_statement* statement, int32_t index,
+                                          const void* value, int32_t length);
+
+// Executes the statement on the first call, then moves to the next row.
+// Returns MSSQL_ROW while there are rows, then MSSQL_DONE.
+MSSQL_CONNECT_API int32_t mssql_step(mssql_statement* statement);
+// Rows affected by a statement without a result set, once it is done; -1
+// when the driver does not report it.
+MSSQL_CONNECT_API int64_t mssql_changes(mssql_statement* statement);
+// Cancels a running mssql_step() from another thread; it then fails with
+// "Cancelled".
+MSSQL_CONNECT_API void mssql_interrupt(mssql_statement* statement);
+
+// The result columns, valid once mssql_step() has returned MSSQL_ROW or
+// MSSQL_DONE. |column| is zero-based.
+MSSQL_CONNECT_API int32_t mssql_column_count(mssql_statement* statement);
+MSSQL_CONNECT_API const char* mssql_column_name(mssql_statement* statement,
+                                                int32_t column);
+MSSQL_CONNECT_API int32_t mssql_column_type(mssql_statement* statement, int32_t column);
+// Digits after the decimal point of a MSSQL_TYPE_DECIMAL column.
+MSSQL_CONNECT_API int32_t mssql_column_scale(mssql_statement* statement, int32_t column);
+
+// Cells of the current row. A NULL cell reads as 0, 0.0 or NULL.
+MSSQL_CONNECT_API int32_t mssql_column_is_null(mssql_statement* statement,
+                                               int32_t column);
+// Bool, int, datetime and time cells (the latter two in microseconds since
+// the Unix epoch and since midnight), and decimal cells unscaled.
+MSSQL_CONNECT_API int64_t mssql_column_int64(mssql_statement* statement, int32_t column);
+// Double cells, and the other numeric cells converted.
+MSSQL_CONNECT_API double mssql_column_double(mssql_statement* statement, int32_t column);
+// Text cells as UTF-8 and decimal cells as exact decimal text, NUL
+// terminated; |length|, if not NULL, is set to their length in bytes.
+// NULL for other types.
+MSSQL_CONNECT_API const char* mssql_column_text(mssql_statement* statement,
+                                                int32_t column, int32_t* length);
+// Binary cells, the 16 bytes of GUID cells, and the UTF-8 bytes of text
+// cells. NULL for other types.
+MSSQL_CONNECT_API const uint8_t* mssql_column_blob(mssql_statement* statement,
+                                                   int32_t column, int32_t* length);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // MSSQL_CONNECT_FFI_API_H_
@@ -0,0 +1,94 @@
+#ifndef MSSQL_CONNECT_LRU_CACHE_H_
+#define MSSQL_CONNECT_LRU_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace mssql_connect {
+
+// A map that holds at most |capacity| entries and evicts the least recently
+// used one when full. Not thread safe.
+template <typename Key, typename Value>
+class LruCache {
+ public:
+  explicit LruCache(size_t capacity) : capacity_(capacity) {}
+
+  LruCache(const LruCache&) = delete;
+  LruCache& operator=(const LruCache&) = delete;
+
+  size_t capacity() const { return capacity_; }
+  size_t size() const { return index_.size(); }
+
+  // Returns the value for |key| and marks it most recently used, or nullptr.
+  Value* Get(const Key& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->second;
+  }
+
+  // Moves the value for |key| out of the cache into |value|. Returns false if
+  // there is none.
+  bool Take(const Key& key, Value* value) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return false;
+    }
+    *value = std::move(it->second->second);
+    entries_.erase(it->second);
+    index_.erase(it);
+    return true;
+  }
+
+  // Inserts or replaces the value for |key| as the most recently used entry,
+  // then evicts from the least recently used end until the cache fits.
+  // Returns the number of entries evicted.
+  size_t Put(const Key& key, Value value) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      it->second->second = std::move(value);
+      entries_.splice(entries_.begin(), entries_, it->second);
+    } else {
+      entries_.emplace_front(key, std::move(value));
+      index_[key] = entries_.begin();
+    }
+    size_t evicted = 0;
+    while (index_.size() > capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+      ++evicted;
+    }
+    return evicted;
+  }
+
+  bool Erase(const Key& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return false;
+    }
+    entries_.erase(it->second);
+    index_.erase(it);
+    return true;
+  }
+
+  void Clear() {
+    index_.clear();
+    entries_.clear();
+  }
+
+ private:
+  using Entry = std::pair<Key, Value>;
+
+  const size_t capacity_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<Key, typename std::list<Entry>::iterator> index_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_LRU_CACHE_H_
@@ -0,0 +1,196 @@
+#include "metrics.h"
+
+namespace mssql_connect {
+
+namespace {
+
+// Index of the highest set bit of |value|, which must not be zero.
+int HighestBit(uint64_t value) {
+  int bit = 0;
+  for (int shift = 32; shift > 0; shift /= 2) {
+    if (value >> shift) {
+      value >>= shift;
+      bit += shift;
+    }
+  }
+  return bit;
+}
+
+void StoreMax(std::atomic<uint64_t>* max, uint64_t value) {
+  uint64_t current = max->load(std::memory_order_relaxed);
+  while (value > current &&
+         !max->compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+std::atomic<bool> Metrics::enabled_{false};
+
+const char* PhaseName(Phase phase) {
+  switch (phase) {
+    case Phase::kConnect:
+      return "connect";
+    case Phase::kExecute:
+      return "execute";
+    case Phase::kFetch:
+      return "fetch";
+    case Phase::kEncode:
+      return "encode";
+    case Phase::kReply:
+      return "reply";
+  }
+  return "";
+}
+
+const char* CallKindName(CallKind kind) {
+  switch (kind) {
+    case CallKind::kConnect:
+      return "connect";
+    case CallKind::kQuery:
+      return "query";
+    case CallKind::kExecute:
+      return "execute";
+  }
+  return "";
+}
+
+uint64_t HistogramSnapshot::ValueAtPercentile(double percentile) const {
+  if (count == 0) {
+    return 0;
+  }
+  // The rank of the sample at |percentile|, counting from one.
+  uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > count) rank = count;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      uint64_t bound = LatencyHistogram::BucketUpperBound(i);
+      return bound < max_ns ? bound : max_ns;
+    }
+  }
+  return max_ns;
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t ns) {
+  if (ns < 8) {
+    return static_cast<size_t>(ns);
+  }
+  int bit = HighestBit(ns);
+  size_t sub = static_cast<size_t>((ns >> (bit - 3)) & 7);
+  return static_cast<size_t>(bit - 2) * 8 + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+  if (index < 8) {
+    return index;
+  }
+  int shift = static_cast<int>(index / 8) - 1;
+  uint64_t lower = static_cast<uint64_t>(8 + index % 8) << shift;
+  return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::Record(uint64_t ns) {
+  buckets_[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_ns_.fetch_add(ns, std::memory_order_relaxed);
+  StoreMax(&max_ns_, ns);
+}
+
+HistogramSnapshot LatencyHistogram::Snapshot() const {
+  HistogramSnapshot snapshot;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.total_ns = total_ns_.load(std::memory_order_relaxed);
+  snapshot.max_ns = max_ns_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void LatencyHistogram::Reset() {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  total_ns_.store(0, std::memory_order_relaxed);
+  max_ns_.store(0, std::memory_order_relaxed);
+}
+
+Metrics& Metrics::Global() {
+  static Metrics* global = new Metrics();
+  return *global;
+}
+
+void Metrics::CountCall(CallKind kind) {
+  if (!enabled()) return;
+  calls_[static_cast<size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+  if (parent_) parent_->CountCall(kind);
+}
+
+void Metrics::CountError(CallKind kind) {
+  if (!enabled()) return;
+  errors_[static_cast<size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+  if (parent_) parent_->CountError(kind);
+}
+
+void Metrics::AddRows(uint64_t rows) {
+  if (!enabled()) return;
+  rows_.fetch_add(rows, std::memory_order_relaxed);
+  if (parent_) parent_->AddRows(rows);
+}
+
+void Metrics::AddBytes(uint64_t bytes) {
+  if (!enabled()) return;
+  bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  if (parent_) parent_->AddBytes(bytes);
+}
+
+void Metrics::Record(Phase phase, std::chrono::nanoseconds elapsed) {
+  if (!enabled()) return;
+  uint64_t ns = elapsed.count() < 0 ? 0 : static_cast<uint64_t>(elapsed.count());
+  phases_[static_cast<size_t>(phase)].Record(ns);
+  if (parent_) parent_->Record(phase, elapsed);
+}
+
+MetricsSnapshot Metrics::Snapshot() const {
+  MetricsSnapshot snapshot;
+  for (size_t i = 0; i < kCallKindCount; ++i) {
+    snapshot.calls[i] = calls_[i].load(std::memory_order_relaxed);
+    snapshot.errors[i] = errors_[i].load(std::memory_order_relaxed);
+  }
+  snapshot.rows = rows_.load(std::memory_order_relaxed);
+  snapshot.bytes = bytes_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < kPhaseCount; ++i) {
+    snapshot.phases[i] = phases_[i].Snapshot();
+  }
+  return snapshot;
+}
+
+void Metrics::Reset() {
+  for (size_t i = 0; i < kCallKindCount; ++i) {
+    calls_[i].store(0, std::memory_order_relaxed);
+    errors_[i].store(0, std::memory_order_relaxed);
+  }
+  rows_.store(0, std::memory_order_relaxed);
+  bytes_.store(0, std::memory_order_relaxed);
+  for (auto& phase : phases_) {
+    phase.Reset();
+  }
+}
+
+std::chrono::nanoseconds PhaseTimer::Stop() {
+  if (!metrics_) {
+    return std::chrono::nanoseconds(0);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Metrics::Clock::now() - start_);
+  metrics_->Record(phase_, elapsed);
+  metrics_ = nullptr;
+  return elapsed;
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,171 @@
+#ifndef MSSQL_CONNECT_METRICS_H_
+#define MSSQL_CONNECT_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace mssql_connect {
+
+// The parts of a call that are timed separately.
+enum class Phase {
+  // SQLDriverConnect, or taking a connection from a pool.
+  kConnect,
+  // SQLExecute, until it returns or its asynchronous execution completes.
+  kExecute,
+  // SQLFetch and SQLGetData calls reading a result.
+  kFetch,
+  // Building the reply from the fetched rows.
+  kEncode,
+  // Handing the reply over: copying it to the platform thread, waiting for
+  // that thread, and the codec encoding it for Dart.
+  kReply,
+};
+constexpr size_t kPhaseCount = 5;
+
+// The calls that are counted separately.
+enum class CallKind {
+  kConnect,
+  kQuery,
+  kExecute,
+};
+constexpr size_t kCallKindCount = 3;
+
+// Names used in the getStats reply, e.g. "fetch" and "query".
+const char* PhaseName(Phase phase);
+const char* CallKindName(CallKind kind);
+
+// Buckets of a LatencyHistogram; see there.
+constexpr size_t kLatencyBucketCount = 496;
+
+// A copy of a LatencyHistogram's counts.
+struct HistogramSnapshot {
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+  std::array<uint64_t, kLatencyBucketCount> buckets{};
+
+  // The smallest recorded value that |percentile| (0 to 100) percent of
+  // the samples do not exceed, rounded up to the end of its bucket, i.e.
+  // overstated by at most 1/8. Zero without samples.
+  uint64_t ValueAtPercentile(double percentile) const;
+};
+
+// A latency histogram in the style of HdrHistogram: buckets are exact below
+// 8 ns, then split every power of two into 8 linear sub-buckets, so any
+// value from 1 ns to centuries is kept with a relative error under 12.5%
+// in a fixed 496 buckets. Recording is a few relaxed atomic increments and
+// never allocates or locks. Thread safe.
+class LatencyHistogram {
+ public:
+  LatencyHistogram() = default;
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void Record(uint64_t ns);
+
+  // Concurrent records may or may not be included.
+  HistogramSnapshot Snapshot() const;
+  void Reset();
+
+  // The bucket |ns| falls in, and the largest value of bucket |index|.
+  static size_t BucketIndex(uint64_t ns);
+  static uint64_t BucketUpperBound(size_t index);
+
+ private:
+  std::array<std::atomic<uint64_t>, kLatencyBucketCount> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_ns_{0};
+  std::atomic<uint64_t> max_ns_{0};
+};
+
+struct MetricsSnapshot {
+  std::array<uint64_t, kCallKindCount> calls{};
+  std::array<uint64_t, kCallKindCount> errors{};
+  // Rows fetched by queries or affected by commands.
+  uint64_t rows = 0;
+  // Approximate size of the query replies.
+  uint64_t bytes = 0;
+  std::array<HistogramSnapshot, kPhaseCount> phases;
+};
+
+// Call counters and per-phase latency histograms, kept for each connection
+// and for the whole process.
+//
+// Collection is off until set_enabled(true). While it is off every
+// recording method returns after one relaxed atomic load and PhaseTimer
+// does not read the clock, so instrumented calls pay a few nanoseconds.
+// A connection's Metrics forwards everything it records to its parent, the
+// process-wide Global() instance. Thread safe; counters are relaxed atomics,
+// so a Reset() during calls may keep or lose some of their samples.
+class Metrics {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit Metrics(Metrics* parent = nullptr) : parent_(parent) {}
+
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+  static void set_enabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  static Metrics& Global();
+
+  void CountCall(CallKind kind);
+  void CountError(CallKind kind);
+  void AddRows(uint64_t rows);
+  void AddBytes(uint64_t bytes);
+  void Record(Phase phase, std::chrono::nanoseconds elapsed);
+
+  MetricsSnapshot Snapshot() const;
+
+  // Clears this instance only, not its parent.
+  void Reset();
+
+ private:
+  static std::atomic<bool> enabled_;
+
+  Metrics* const parent_;
+  std::array<std::atomic<uint64_t>, kCallKindCount> calls_{};
+  std::array<std::atomic<uint64_t>, kCallKindCount> errors_{};
+  std::atomic<uint64_t> rows_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::array<LatencyHistogram, kPhaseCount> phases_;
+};
+
+// Times one phase from construction until Stop() or destruction, whichever
+// comes first, and records it in |metrics| (which may be null). Does
+// nothing while metrics are disabled.
+class PhaseTimer {
+ public:
+  PhaseTimer(Metrics* metrics, Phase phase)
+      : metrics_(metrics && Metrics::enabled() ? metrics : nullptr),
+        phase_(phase) {
+    if (metrics_) {
+      start_ = Metrics::Clock::now();
+    }
+  }
+
+  ~PhaseTimer() { Stop(); }
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+  // Records the time so far, once, and returns it; zero when disabled.
+  std::chrono::nanoseconds Stop();
+
+ private:
+  Metrics* metrics_;
+  Phase phase_;
+  Metrics::Clock::time_point start_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_METRICS_H_
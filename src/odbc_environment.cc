@@ -0,0 +1,112 @@
+#include "odbc_environment.h"
+
+namespace mssql_connect {
+
+std::mutex OdbcEnvironment::mutex_;
+std::weak_ptr<OdbcEnvironment> OdbcEnvironment::shared_;
+std::shared_ptr<OdbcEnvironment> OdbcEnvironment::pinned_;
+OdbcEnvironmentOptions OdbcEnvironment::next_options_;
+std::atomic<size_t> OdbcEnvironment::live_environments_(0);
+std::atomic<size_t> OdbcEnvironment::live_connections_(0);
+
+std::shared_ptr<OdbcEnvironment> OdbcEnvironment::Get(std::string* error) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::shared_ptr<OdbcEnvironment> environment = shared_.lock();
+  if (environment) {
+    return environment;
+  }
+
+  const OdbcEnvironmentOptions options = next_options_;
+
+  // The pooling mode is read by the driver manager when the environment is
+  // allocated, so it has to be set on the null handle first.
+  SQLSetEnvAttr(SQL_NULL_HENV, SQL_ATTR_CONNECTION_POOLING,
+                (SQLPOINTER)(options.connection_pooling ? SQL_CP_ONE_PER_HENV
+                                                        : SQL_CP_OFF),
+                SQL_IS_UINTEGER);
+
+  SQLHENV env = SQL_NULL_HENV;
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env))) {
+    if (error) {
+      *error = "Failed to allocate environment handle";
+    }
+    return nullptr;
+  }
+  if (!SQL_SUCCEEDED(SQLSetEnvAttr(env, SQL_ATTR_ODBC_VERSION,
+                                   (SQLPOINTER)SQL_OV_ODBC3, 0))) {
+    SQLFreeHandle(SQL_HANDLE_ENV, env);
+    if (error) {
+      *error = "Failed to set ODBC version";
+    }
+    return nullptr;
+  }
+  if (options.connection_pooling) {
+    SQLSetEnvAttr(env, SQL_ATTR_CP_MATCH,
+                  (SQLPOINTER)(options.relaxed_match ? SQL_CP_RELAXED_MATCH
+                                                     : SQL_CP_STRICT_MATCH),
+                  SQL_IS_UINTEGER);
+  }
+
+  environment.reset(new OdbcEnvironment(env, options));
+  shared_ = environment;
+  if (options.connection_pooling) {
+    pinned_ = environment;
+  }
+  return environment;
+}
+
+void OdbcEnvironment::Configure(const OdbcEnvironmentOptions& options) {
+  std::shared_ptr<OdbcEnvironment> unpinned;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    next_options_ = options;
+    std::shared_ptr<OdbcEnvironment> current = shared_.lock();
+    if (!options.connection_pooling ||
+        (current && current->options_.relaxed_match != options.relaxed_match)) {
+      // Let the current environment go once its connections are closed so
+      // the next one picks up the new options.
+      unpinned.swap(pinned_);
+    } else if (current && current->options_.connection_pooling) {
+      pinned_ = current;
+    }
+  }
+  // |unpinned| may hold the last reference; free it outside the lock.
+}
+
+OdbcEnvironmentOptions OdbcEnvironment::options() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return next_options_;
+}
+
+OdbcEnvironment::OdbcEnvironment(SQLHENV env,
+                                 const OdbcEnvironmentOptions& options)
+    : env_(env), options_(options) {
+  ++live_environments_;
+}
+
+OdbcEnvironment::~OdbcEnvironment() {
+  SQLFreeHandle(SQL_HANDLE_ENV, env_);
+  --live_environments_;
+}
+
+SQLHDBC OdbcEnvironment::AllocConnection(std::string* error) {
+  SQLHDBC dbc = SQL_NULL_HDBC;
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_DBC, env_, &dbc))) {
+    if (error) {
+      *error = "Failed to allocate connection handle";
+    }
+    return SQL_NULL_HDBC;
+  }
+  ++live_connections_;
+  return dbc;
+}
+
+void OdbcEnvironment::FreeConnection(SQLHDBC dbc) {
+  if (dbc == SQL_NULL_HDBC) {
+    return;
+  }
+  SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+  --live_connections_;
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,81 @@
+#ifndef MSSQL_CONNECT_ODBC_ENVIRONMENT_H_
+#define MSSQL_CONNECT_ODBC_ENVIRONMENT_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace mssql_connect {
+
+struct OdbcEnvironmentOptions {
+  // Lets the driver manager pool connections per environment
+  // (SQL_CP_ONE_PER_HENV). While enabled, the shared environment is kept
+  // alive even when no connection references it, so the pool survives.
+  bool connection_pooling = false;
+  // SQL_ATTR_CP_MATCH: relaxed matching lets the driver manager reuse a
+  // pooled connection whose non-essential attributes differ.
+  bool relaxed_match = false;
+};
+
+// The process-wide ODBC environment handle.
+//
+// Environments are lazily created and reference counted: every connection
+// holds a reference, and the handle is freed once the last reference goes
+// away. This replaces allocating (and leaking) one environment per connect.
+class OdbcEnvironment {
+ public:
+  // Returns the shared environment, creating it if needed. Returns nullptr
+  // and fills |error| if the handle cannot be allocated.
+  static std::shared_ptr<OdbcEnvironment> Get(std::string* error);
+
+  // Changes the options used for the environment. Driver-manager pooling is
+  // a process attribute that must be set before the environment handle is
+  // allocated, so a change applies once the current environment (if any) is
+  // released by every connection using it.
+  static void Configure(const OdbcEnvironmentOptions& options);
+
+  static OdbcEnvironmentOptions options();
+
+  ~OdbcEnvironment();
+
+  OdbcEnvironment(const OdbcEnvironment&) = delete;
+  OdbcEnvironment& operator=(const OdbcEnvironment&) = delete;
+
+  SQLHENV handle() const { return env_; }
+  bool connection_pooling() const { return options_.connection_pooling; }
+
+  // Allocates a connection handle on this environment. The caller must free
+  // it with FreeConnection(), and keep the environment alive until then.
+  SQLHDBC AllocConnection(std::string* error);
+  void FreeConnection(SQLHDBC dbc);
+
+  // Live handle counts, for leak checks.
+  static size_t live_environments() { return live_environments_; }
+  static size_t live_connections() { return live_connections_; }
+
+ private:
+  OdbcEnvironment(SQLHENV env, const OdbcEnvironmentOptions& options);
+
+  SQLHENV env_;
+  const OdbcEnvironmentOptions options_;
+
+  static std::mutex mutex_;
+  static std::weak_ptr<OdbcEnvironment> shared_;
+  // Holds an extra reference while driver-manager pooling is enabled.
+  static std::shared_ptr<OdbcEnvironment> pinned_;
+  static OdbcEnvironmentOptions next_options_;
+  static std::atomic<size_t> live_environments_;
+  static std::atomic<size_t> live_connections_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_ODBC_ENVIRONMENT_H_
@@ -0,0 +1,47 @@
+#include "odbc_error.h"
+
+#include <sqlext.h>
+
+#include <string>
+
+#include "text_encoding.h"
+
+namespace mssql_connect {
+
+std::string GetOdbcDiagnostics(SQLSMALLINT handle_type, SQLHANDLE handle) {
+  std::string diagnostics;
+  SQLSMALLINT i = 1;
+  SQLWCHAR sqlstate[6];
+  SQLINTEGER native_error;
+  SQLWCHAR message_text[SQL_MAX_MESSAGE_LENGTH];
+  SQLSMALLINT text_length;
+
+  while (SQLGetDiagRecW(handle_type, handle, i, sqlstate, &native_error,
+                        message_text, SQL_MAX_MESSAGE_LENGTH,
+                        &text_length) == SQL_SUCCESS) {
+    if (text_length >= SQL_MAX_MESSAGE_LENGTH) {
+      text_length = SQL_MAX_MESSAGE_LENGTH - 1;
+    }
+    diagnostics += "Message " + std::to_string(i) + ": ";
+    AppendUtf16AsUtf8(message_text, text_length, &diagnostics);
+    diagnostics += " (SQLSTATE: ";
+    AppendUtf16AsUtf8(sqlstate, 5, &diagnostics);
+    diagnostics += ", Native error: " + std::to_string(native_error) + ")\n";
+    i++;
+  }
+  return diagnostics;
+}
+
+std::string GetOdbcSqlState(SQLSMALLINT handle_type, SQLHANDLE handle) {
+  SQLWCHAR sqlstate[6];
+  SQLINTEGER native_error;
+  SQLSMALLINT text_length;
+  std::string state;
+  if (SQL_SUCCEEDED(SQLGetDiagRecW(handle_type, handle, 1, sqlstate,
+                                   &native_error, nullptr, 0, &text_length))) {
+    AppendUtf16AsUtf8(sqlstate, 5, &state);
+  }
+  return state;
+}
+
+}  // namespace mssql_connect
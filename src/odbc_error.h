@@ -0,0 +1,24 @@
+#ifndef MSSQL_CONNECT_ODBC_ERROR_H_
+#define MSSQL_CONNECT_ODBC_ERROR_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+
+#include <string>
+
+namespace mssql_connect {
+
+// Returns the diagnostic records of |handle| as UTF-8, one
+// "Message N: text (SQLSTATE: xxxxx, Native error: n)" line per record.
+// Returns an empty string if there are none.
+std::string GetOdbcDiagnostics(SQLSMALLINT handle_type, SQLHANDLE handle);
+
+// Returns the SQLSTATE of the first diagnostic record of |handle|, e.g.
+// "HYT00" for a timeout, or an empty string if there is none.
+std::string GetOdbcSqlState(SQLSMALLINT handle_type, SQLHANDLE handle);
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_ODBC_ERROR_H_
@@ -0,0 +1,448 @@
+#include "parameter_binder.h"
+
+#include <sqlucode.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "odbc_error.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+
+namespace {
+
+// Largest nvarchar(n) / varbinary(n); longer values are sent as (max).
+const SQLULEN kMaxBoundedChars = 4000;
+const SQLULEN kMaxBoundedBytes = 8000;
+
+template <typename T>
+void Store(const T& value, std::vector<unsigned char>* data) {
+  data->resize(sizeof(T));
+  std::memcpy(data->data(), &value, sizeof(T));
+}
+
+template <typename T>
+void StoreAt(const T& value, size_t index, std::vector<unsigned char>* data) {
+  std::memcpy(data->data() + index * sizeof(T), &value, sizeof(T));
+}
+
+// Picks the types a parameter that is only ever NULL is declared with.
+// nvarchar converts implicitly to most column types, but not to varbinary
+// or image, so the type the server infers for the parameter is used when
+// the driver can describe it. That may cost the driver a round trip, so it
+// is only asked for NULLs.
+void DescribeNullParameter(SQLHSTMT stmt, size_t index, SQLSMALLINT* c_type,
+                           SQLSMALLINT* sql_type, SQLULEN* column_size,
+                           SQLSMALLINT* decimal_digits) {
+  SQLSMALLINT nullable = SQL_NULLABLE_UNKNOWN;
+  if (!SQL_SUCCEEDED(SQLDescribeParam(stmt, (SQLUSMALLINT)(index + 1),
+                                      sql_type, column_size, decimal_digits,
+                                      &nullable)) ||
+      *sql_type == SQL_UNKNOWN_TYPE) {
+    *sql_type = SQL_WVARCHAR;
+    *column_size = 1;
+    *decimal_digits = 0;
+  }
+  switch (*sql_type) {
+    case SQL_BINARY:
+    case SQL_VARBINARY:
+    case SQL_LONGVARBINARY:
+      *c_type = SQL_C_BINARY;
+      break;
+    default:
+      *c_type = SQL_C_WCHAR;
+      break;
+  }
+}
+
+// The type every value of a parameter array is sent as.
+bool ArrayType(const std::vector<std::vector<SqlParameter>>& rows,
+               size_t first, size_t count, size_t column,
+               SqlParameter::Type* type) {
+  using Type = SqlParameter::Type;
+  *type = Type::kNull;
+  for (size_t row = first; row < first + count; ++row) {
+    Type value_type = rows[row][column].type;
+    if (value_type == Type::kNull || value_type == *type) {
+      continue;
+    }
+    if (*type == Type::kNull) {
+      *type = value_type;
+    } else if ((*type == Type::kInt64 && value_type == Type::kDouble) ||
+               (*type == Type::kDouble && value_type == Type::kInt64)) {
+      *type = Type::kDouble;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+SqlParameter SqlParameter::Bool(bool value) {
+  SqlParameter param;
+  param.type = Type::kBool;
+  param.bool_value = value;
+  return param;
+}
+
+SqlParameter SqlParameter::Int64(int64_t value) {
+  SqlParameter param;
+  param.type = Type::kInt64;
+  param.int_value = value;
+  return param;
+}
+
+SqlParameter SqlParameter::Double(double value) {
+  SqlParameter param;
+  param.type = Type::kDouble;
+  param.double_value = value;
+  return param;
+}
+
+SqlParameter SqlParameter::Text(std::string value) {
+  SqlParameter param;
+  param.type = Type::kText;
+  param.text = std::move(value);
+  return param;
+}
+
+SqlParameter SqlParameter::Binary(std::vector<uint8_t> value) {
+  SqlParameter param;
+  param.type = Type::kBinary;
+  param.bytes = std::move(value);
+  return param;
+}
+
+bool ParameterBinder::Bind(SQLHSTMT stmt,
+                           const std::vector<SqlParameter>& params,
+                           std::string* error) {
+  Reset(stmt, params.size());
+  for (size_t i = 0; i < params.size(); ++i) {
+    if (!BindAt(stmt, i, SQL_PARAM_INPUT, params[i].type, params[i], 0,
+                error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ParameterBinder::Reset(SQLHSTMT stmt, size_t count) {
+  SQLFreeStmt(stmt, SQL_RESET_PARAMS);
+  // Buffers are bound by address, so size the vector once up front.
+  buffers_.clear();
+  buffers_.resize(count);
+}
+
+bool ParameterBinder::BindAt(SQLHSTMT stmt, size_t index, SQLSMALLINT io_type,
+                             SqlParameter::Type type,
+                             const SqlParameter& value, size_t output_size,
+                             std::string* error) {
+  Buffer& buffer = buffers_[index];
+  buffer.type = type;
+  bool is_null = value.type == SqlParameter::Type::kNull;
+  bool sends_value = io_type != SQL_PARAM_OUTPUT && !is_null;
+  SQLSMALLINT c_type;
+  SQLSMALLINT sql_type;
+  SQLULEN column_size = 0;
+  SQLSMALLINT decimal_digits = 0;
+
+  switch (type) {
+    case SqlParameter::Type::kNull:
+      DescribeNullParameter(stmt, index, &c_type, &sql_type, &column_size,
+                            &decimal_digits);
+      break;
+    case SqlParameter::Type::kBool:
+      c_type = SQL_C_BIT;
+      sql_type = SQL_BIT;
+      column_size = 1;
+      Store<unsigned char>(sends_value && value.bool_value ? 1 : 0,
+                           &buffer.data);
+      break;
+    case SqlParameter::Type::kInt64:
+      c_type = SQL_C_SBIGINT;
+      sql_type = SQL_BIGINT;
+      column_size = 19;
+      Store<SQLBIGINT>(sends_value ? value.int_value : 0, &buffer.data);
+      break;
+    case SqlParameter::Type::kDouble:
+      c_type = SQL_C_DOUBLE;
+      sql_type = SQL_DOUBLE;
+      column_size = 15;
+      Store<SQLDOUBLE>(sends_value ? value.double_value : 0, &buffer.data);
+      break;
+    case SqlParameter::Type::kText: {
+      std::vector<SQLWCHAR> wide;
+      if (sends_value) {
+        wide = Utf8ToUtf16(value.text);
+      }
+      c_type = SQL_C_WCHAR;
+      size_t chars = std::max(wide.size(), output_size);
+      if (chars <= kMaxBoundedChars) {
+        sql_type = SQL_WVARCHAR;
+        column_size = kMaxBoundedChars;
+      } else {
+        sql_type = SQL_WLONGVARCHAR;
+        column_size = 0;
+      }
+      // Keep room for a terminator so an empty string has a valid buffer.
+      buffer.data.assign((chars + 1) * sizeof(SQLWCHAR), 0);
+      if (!wide.empty()) {
+        std::memcpy(buffer.data.data(), wide.data(),
+                    wide.size() * sizeof(SQLWCHAR));
+      }
+      buffer.indicator = (SQLLEN)(wide.size() * sizeof(SQLWCHAR));
+      break;
+    }
+    case SqlParameter::Type::kBinary: {
+      size_t bytes = std::max(sends_value ? value.bytes.size() : 0,
+                              output_size);
+      c_type = SQL_C_BINARY;
+      if (bytes <= kMaxBoundedBytes) {
+        sql_type = SQL_VARBINARY;
+        column_size = kMaxBoundedBytes;
+      } else {
+        sql_type = SQL_LONGVARBINARY;
+        column_size = 0;
+      }
+      buffer.data.assign(bytes + 1, 0);
+      if (sends_value && !value.bytes.empty()) {
+        std::memcpy(buffer.data.data(), value.bytes.data(),
+                    value.bytes.size());
+      }
+      buffer.indicator = sends_value ? (SQLLEN)value.bytes.size() : 0;
+      break;
+    }
+    default:
+      *error = "Unsupported parameter type";
+      return false;
+  }
+  if (!sends_value) {
+    buffer.indicator = SQL_NULL_DATA;
+  } else if (type != SqlParameter::Type::kText &&
+             type != SqlParameter::Type::kBinary) {
+    buffer.indicator = 0;
+  }
+
+  SQLPOINTER data = buffer.data.empty() ? nullptr : buffer.data.data();
+  SQLRETURN ret = SQLBindParameter(
+      stmt, (SQLUSMALLINT)(index + 1), io_type, c_type, sql_type, column_size,
+      decimal_digits, data, (SQLLEN)buffer.data.size(), &buffer.indicator);
+  if (!SQL_SUCCEEDED(ret)) {
+    *error = "Failed to bind parameter " + std::to_string(index + 1) + ": " +
+             GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+    return false;
+  }
+  return true;
+}
+
+SqlParameter ParameterBinder::Output(size_t index) const {
+  const Buffer& buffer = buffers_[index];
+  if (buffer.indicator == SQL_NULL_DATA || buffer.data.empty()) {
+    return SqlParameter::Null();
+  }
+  switch (buffer.type) {
+    case SqlParameter::Type::kBool:
+      return SqlParameter::Bool(buffer.data[0] != 0);
+    case SqlParameter::Type::kInt64: {
+      SQLBIGINT value;
+      std::memcpy(&value, buffer.data.data(), sizeof(value));
+      return SqlParameter::Int64(value);
+    }
+    case SqlParameter::Type::kDouble: {
+      SQLDOUBLE value;
+      std::memcpy(&value, buffer.data.data(), sizeof(value));
+      return SqlParameter::Double(value);
+    }
+    case SqlParameter::Type::kText: {
+      // The buffer keeps one unit for the terminator; a longer value was
+      // truncated to fit.
+      size_t capacity = buffer.data.size() / sizeof(SQLWCHAR) - 1;
+      size_t chars = std::min<size_t>(buffer.indicator / sizeof(SQLWCHAR),
+                                      capacity);
+      return SqlParameter::Text(Utf16ToUtf8(
+          reinterpret_cast<const SQLWCHAR*>(buffer.data.data()), chars));
+    }
+    case SqlParameter::Type::kBinary: {
+      size_t bytes = std::min<size_t>(buffer.indicator, buffer.data.size() - 1);
+      return SqlParameter::Binary(std::vector<uint8_t>(
+          buffer.data.begin(), buffer.data.begin() + bytes));
+    }
+    default:
+      return SqlParameter::Null();
+  }
+}
+
+bool ParameterArrayBinder::Bind(
+    SQLHSTMT stmt, const std::vector<std::vector<SqlParameter>>& rows,
+    size_t first, size_t count, std::string* error) {
+  using Type = SqlParameter::Type;
+  SQLFreeStmt(stmt, SQL_RESET_PARAMS);
+  size_t width = rows[first].size();
+  for (size_t row = first; row < first + count; ++row) {
+    if (rows[row].size() != width) {
+      *error = "Row " + std::to_string(row + 1) + " has " +
+               std::to_string(rows[row].size()) + " values, expected " +
+               std::to_string(width);
+      return false;
+    }
+  }
+
+  columns_.clear();
+  columns_.resize(width);
+  for (size_t i = 0; i < width; ++i) {
+    Column& column = columns_[i];
+    column.indicators.assign(count, SQL_NULL_DATA);
+    Type type;
+    if (!ArrayType(rows, first, count, i, &type)) {
+      *error = "Parameter " + std::to_string(i + 1) +
+               " has values of different types";
+      return false;
+    }
+
+    SQLSMALLINT c_type;
+    SQLSMALLINT sql_type;
+    SQLULEN column_size = 0;
+    SQLSMALLINT decimal_digits = 0;
+    SQLLEN element_size = 0;
+    switch (type) {
+      case Type::kNull:
+        DescribeNullParameter(stmt, i, &c_type, &sql_type, &column_size,
+                              &decimal_digits);
+        element_size = sizeof(SQLWCHAR);
+        column.data.assign(count * element_size, 0);
+        break;
+      case Type::kBool:
+        c_type = SQL_C_BIT;
+        sql_type = SQL_BIT;
+        column_size = 1;
+        element_size = sizeof(unsigned char);
+        column.data.assign(count * element_size, 0);
+        for (size_t r = 0; r < count; ++r) {
+          const SqlParameter& value = rows[first + r][i];
+          if (value.type == Type::kNull) continue;
+          StoreAt<unsigned char>(value.bool_value ? 1 : 0, r, &column.data);
+          column.indicators[r] = 0;
+        }
+        break;
+      case Type::kInt64:
+        c_type = SQL_C_SBIGINT;
+        sql_type = SQL_BIGINT;
+        column_size = 19;
+        element_size = sizeof(SQLBIGINT);
+        column.data.assign(count * element_size, 0);
+        for (size_t r = 0; r < count; ++r) {
+          const SqlParameter& value = rows[first + r][i];
+          if (value.type == Type::kNull) continue;
+          StoreAt<SQLBIGINT>(value.int_value, r, &column.data);
+          column.indicators[r] = 0;
+        }
+        break;
+      case Type::kDouble:
+        c_type = SQL_C_DOUBLE;
+        sql_type = SQL_DOUBLE;
+        column_size = 15;
+        element_size = sizeof(SQLDOUBLE);
+        column.data.assign(count * element_size, 0);
+        for (size_t r = 0; r < count; ++r) {
+          const SqlParameter& value = rows[first + r][i];
+          if (value.type == Type::kNull) continue;
+          SQLDOUBLE number = value.type == Type::kInt64
+                                 ? static_cast<SQLDOUBLE>(value.int_value)
+                                 : value.double_value;
+          StoreAt<SQLDOUBLE>(number, r, &column.data);
+          column.indicators[r] = 0;
+        }
+        break;
+      case Type::kText: {
+        std::vector<std::vector<SQLWCHAR>> wide(count);
+        size_t max_chars = 0;
+        for (size_t r = 0; r < count; ++r) {
+          const SqlParameter& value = rows[first + r][i];
+          if (value.type == Type::kNull) continue;
+          wide[r] = Utf8ToUtf16(value.text);
+          max_chars = std::max(max_chars, wide[r].size());
+        }
+        c_type = SQL_C_WCHAR;
+        if (max_chars <= kMaxBoundedChars) {
+          sql_type = SQL_WVARCHAR;
+          column_size = kMaxBoundedChars;
+        } else {
+          sql_type = SQL_WLONGVARCHAR;
+          column_size = 0;
+        }
+        element_size = (SQLLEN)((max_chars + 1) * sizeof(SQLWCHAR));
+        column.data.assign(count * element_size, 0);
+        for (size_t r = 0; r < count; ++r) {
+          if (rows[first + r][i].type == Type::kNull) continue;
+          size_t bytes = wide[r].size() * sizeof(SQLWCHAR);
+          if (bytes > 0) {
+            std::memcpy(column.data.data() + r * element_size, wide[r].data(),
+                        bytes);
+          }
+          column.indicators[r] = (SQLLEN)bytes;
+        }
+        break;
+      }
+      case Type::kBinary: {
+        size_t max_bytes = 0;
+        for (size_t r = 0; r < count; ++r) {
+          const SqlParameter& value = rows[first + r][i];
+          if (value.type == Type::kNull) continue;
+          max_bytes = std::max(max_bytes, value.bytes.size());
+        }
+        c_type = SQL_C_BINARY;
+        if (max_bytes <= kMaxBoundedBytes) {
+          sql_type = SQL_VARBINARY;
+          column_size = kMaxBoundedBytes;
+        } else {
+          sql_type = SQL_LONGVARBINARY;
+          column_size = 0;
+        }
+        element_size = (SQLLEN)std::max<size_t>(max_bytes, 1);
+        column.data.assign(count * element_size, 0);
+        for (size_t r = 0; r < count; ++r) {
+          const SqlParameter& value = rows[first + r][i];
+          if (value.type == Type::kNull) continue;
+          if (!value.bytes.empty()) {
+            std::memcpy(column.data.data() + r * element_size,
+                        value.bytes.data(), value.bytes.size());
+          }
+          column.indicators[r] = (SQLLEN)value.bytes.size();
+        }
+        break;
+      }
+      default:
+        *error = "Unsupported parameter type";
+        return false;
+    }
+
+    SQLRETURN ret = SQLBindParameter(
+        stmt, (SQLUSMALLINT)(i + 1), SQL_PARAM_INPUT, c_type, sql_type,
+        column_size, decimal_digits, column.data.data(), element_size,
+        column.indicators.data());
+    if (!SQL_SUCCEEDED(ret)) {
+      *error = "Failed to bind parameter " + std::to_string(i + 1) + ": " +
+               GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t ParameterArrayBinder::ElementBytes(const SqlParameter& value) {
+  switch (value.type) {
+    case SqlParameter::Type::kText:
+      // At most one UTF-16 unit per UTF-8 byte, plus the terminator.
+      return sizeof(SQLLEN) + (value.text.size() + 1) * sizeof(SQLWCHAR);
+    case SqlParameter::Type::kBinary:
+      return sizeof(SQLLEN) + value.bytes.size();
+    default:
+      return sizeof(SQLLEN) + sizeof(SQLBIGINT);
+  }
+}
+
+}  // namespace mssql_connect
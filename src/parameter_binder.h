@@ -0,0 +1,129 @@
+#ifndef MSSQL_CONNECT_PARAMETER_BINDER_H_
+#define MSSQL_CONNECT_PARAMETER_BINDER_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mssql_connect {
+
+// A statement parameter value, converted from the platform channel value.
+struct SqlParameter {
+  enum class Type {
+    kNull,
+    kBool,
+    kInt64,
+    kDouble,
+    kText,
+    kBinary,
+  };
+
+  Type type = Type::kNull;
+  bool bool_value = false;
+  int64_t int_value = 0;
+  double double_value = 0;
+  // UTF-8.
+  std::string text;
+  std::vector<uint8_t> bytes;
+
+  static SqlParameter Null() { return SqlParameter(); }
+  static SqlParameter Bool(bool value);
+  static SqlParameter Int64(int64_t value);
+  static SqlParameter Double(double value);
+  static SqlParameter Text(std::string value);
+  static SqlParameter Binary(std::vector<uint8_t> value);
+};
+
+// Binds parameters to a statement with SQLBindParameter.
+//
+// SQL types are picked so that repeated executions declare the same
+// parameter types whatever the values are: integers are always bigint, and
+// strings and byte arrays are nvarchar(4000)/varbinary(8000), or the (max)
+// types when longer. Otherwise the server would compile and cache one plan
+// per distinct declared length. A NULL, which has no type of its own, is
+// declared with the type SQLDescribeParam reports, or as nvarchar(1) when
+// the driver cannot describe the parameter.
+class ParameterBinder {
+ public:
+  ParameterBinder() = default;
+
+  ParameterBinder(const ParameterBinder&) = delete;
+  ParameterBinder& operator=(const ParameterBinder&) = delete;
+
+  // Binds |params| as input parameters 1..n of |stmt|. The bound buffers
+  // belong to the binder, which must outlive the statement's execution.
+  // Returns false and fills |error| on failure.
+  bool Bind(SQLHSTMT stmt, const std::vector<SqlParameter>& params,
+            std::string* error);
+
+  // Unbinds the parameters of |stmt| and makes room for |count| parameters
+  // bound one at a time with BindAt().
+  void Reset(SQLHSTMT stmt, size_t count);
+
+  // Binds parameter |index| + 1 with |io_type| (SQL_PARAM_INPUT, _OUTPUT or
+  // _INPUT_OUTPUT) as a value of |type|. |value| is sent unless the
+  // parameter is output only; a kNull value is sent as NULL. Output text and
+  // binary buffers hold at least |output_size| characters or bytes.
+  bool BindAt(SQLHSTMT stmt, size_t index, SQLSMALLINT io_type,
+              SqlParameter::Type type, const SqlParameter& value,
+              size_t output_size, std::string* error);
+
+  // Value of output parameter |index| once the statement has run and all of
+  // its results have been consumed.
+  SqlParameter Output(size_t index) const;
+
+ private:
+  struct Buffer {
+    SqlParameter::Type type = SqlParameter::Type::kNull;
+    std::vector<unsigned char> data;
+    SQLLEN indicator = 0;
+  };
+
+  std::vector<Buffer> buffers_;
+};
+
+// Binds rows of input parameters as column-wise arrays, for executing a
+// statement once per row with SQL_ATTR_PARAMSET_SIZE.
+//
+// Every value of a column is sent with one SQL type, chosen from the
+// non-null values of the bound rows: integers and doubles together are
+// sent as float, other mixed types are an error. A column of only NULLs is
+// declared like a NULL ParameterBinder parameter. Text and binary elements
+// are as wide as the longest value of their column.
+class ParameterArrayBinder {
+ public:
+  ParameterArrayBinder() = default;
+
+  ParameterArrayBinder(const ParameterArrayBinder&) = delete;
+  ParameterArrayBinder& operator=(const ParameterArrayBinder&) = delete;
+
+  // Binds rows [first, first + count) of |rows|, which must all have the
+  // same number of values, as parameters 1..n of |stmt|. The arrays belong
+  // to the binder, which must outlive the statement's execution. Returns
+  // false and fills |error| on failure.
+  bool Bind(SQLHSTMT stmt,
+            const std::vector<std::vector<SqlParameter>>& rows, size_t first,
+            size_t count, std::string* error);
+
+  // Upper bound on the array element size |value| needs, including its
+  // length indicator. Used to bound the memory of one batch.
+  static size_t ElementBytes(const SqlParameter& value);
+
+ private:
+  struct Column {
+    std::vector<unsigned char> data;
+    std::vector<SQLLEN> indicators;
+  };
+
+  std::vector<Column> columns_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_PARAMETER_BINDER_H_
@@ -0,0 +1,119 @@
+#include "pipeline.h"
+
+#include <utility>
+
+#include "result_cache.h"
+
+namespace mssql_connect {
+
+namespace {
+
+bool CanCombine(const PipelineOperation& operation) {
+  if (operation.kind != PipelineOperation::Kind::kQuery) {
+    return false;
+  }
+  // A variable declared by one query would clash with the same name in
+  // another, and a SET would change how its neighbours run.
+  if (ChangesBatchState(operation.sql)) {
+    return false;
+  }
+  // Also false for a bare procedure call, which is only one when it
+  // starts the batch.
+  std::vector<std::string> written;
+  return FindWrittenTables(operation.sql, &written) && written.empty();
+}
+
+// |sql| without trailing whitespace and statement terminators.
+std::string TrimStatement(const std::string& sql) {
+  size_t end = sql.size();
+  while (end > 0 && (sql[end - 1] == ';' || sql[end - 1] == ' ' ||
+                     sql[end - 1] == '\t' || sql[end - 1] == '\r' ||
+                     sql[end - 1] == '\n')) {
+    --end;
+  }
+  return sql.substr(0, end);
+}
+
+}  // namespace
+
+std::vector<PipelineStep> PlanPipeline(
+    const std::vector<PipelineOperation>& operations) {
+  std::vector<PipelineStep> steps;
+  bool open = false;
+  for (size_t i = 0; i < operations.size(); ++i) {
+    const PipelineOperation& operation = operations[i];
+    bool combine = CanCombine(operation);
+    if (open && combine &&
+        steps.back().params.size() + operation.params.size() <=
+            kMaxPipelineStepParameters) {
+      PipelineStep& step = steps.back();
+      // The terminator gets its own line so that a trailing -- comment in
+      // the previous query cannot swallow it.
+      step.sql = TrimStatement(step.sql) + "\n;\n" + TrimStatement(operation.sql);
+      step.params.insert(step.params.end(), operation.params.begin(),
+                         operation.params.end());
+      ++step.count;
+      continue;
+    }
+    PipelineStep step;
+    step.first = i;
+    step.count = 1;
+    step.sql = operation.sql;
+    step.params = operation.params;
+    steps.push_back(std::move(step));
+    open = combine;
+  }
+  return steps;
+}
+
+bool SplitStepResults(const PipelineStep& step,
+                      const std::vector<PipelineOperation>& operations,
+                      std::vector<StatementResult> results,
+                      std::vector<StatementResult>* out, std::string* error) {
+  if (step.count == 1 &&
+      operations[step.first].kind == PipelineOperation::Kind::kExecute) {
+    StatementResult total;
+    for (const StatementResult& result : results) {
+      if (!result.has_result_set && result.row_count >= 0) {
+        total.row_count = (total.row_count < 0 ? 0 : total.row_count) +
+                          result.row_count;
+      }
+    }
+    if (total.row_count < 0) {
+      total.row_count = 0;
+    }
+    out->push_back(std::move(total));
+    return true;
+  }
+
+  std::vector<StatementResult> sets;
+  for (StatementResult& result : results) {
+    if (result.has_result_set) {
+      sets.push_back(std::move(result));
+    }
+  }
+  if (step.count == 1) {
+    if (!sets.empty()) {
+      out->push_back(std::move(sets.front()));
+    } else {
+      out->push_back(results.empty() ? StatementResult()
+                                     : std::move(results.front()));
+    }
+    return true;
+  }
+  if (sets.size() != step.count) {
+    *error = "Queries " + std::to_string(step.first) + " to " +
+             std::to_string(step.first + step.count - 1) +
+             " were combined into one batch and returned " +
+             std::to_string(sets.size()) +
+             " result sets; each query in a pipeline must return exactly "
+             "one";
+    return false;
+  }
+  for (StatementResult& set : sets) {
+    out->push_back(std::move(set));
+  }
+  return true;
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,66 @@
+#ifndef MSSQL_CONNECT_PIPELINE_H_
+#define MSSQL_CONNECT_PIPELINE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "parameter_binder.h"
+#include "result_sets.h"
+
+namespace mssql_connect {
+
+// One call of a pipeline: a query, answered with its result set, or a
+// command, answered with its affected row count.
+struct PipelineOperation {
+  enum class Kind {
+    kQuery,
+    kExecute,
+  };
+
+  Kind kind = Kind::kQuery;
+  std::string sql;
+  std::vector<SqlParameter> params;
+};
+
+// Operations [first, first + count) of a pipeline, sent to the server as
+// one statement with their parameters in order.
+struct PipelineStep {
+  size_t first = 0;
+  size_t count = 0;
+  std::string sql;
+  std::vector<SqlParameter> params;
+};
+
+// SQL Server accepts 2100 parameters per request; a combined step stays
+// below this many.
+constexpr size_t kMaxPipelineStepParameters = 2000;
+
+// Splits |operations| into the steps that run them in order.
+//
+// Consecutive queries that only read (see FindWrittenTables()) are
+// combined into one batch, separated by ";" on a line of its own (so a
+// trailing -- comment cannot hide it), so that they take a single round
+// trip; each must then produce exactly one result set. Commands, and
+// queries that may write, run on their own so that their results cannot be
+// confused with their neighbours': a command's row count disappears under
+// SET NOCOUNT ON. So do queries with DECLARE or SET, whose variables and
+// settings would leak into the rest of the batch, and calls of a procedure
+// by its bare name, which only works at the start of a batch.
+std::vector<PipelineStep> PlanPipeline(
+    const std::vector<PipelineOperation>& operations);
+
+// Hands out the results |step| produced, one per operation, appending them
+// to |out|: the single result set of each combined query; the first result
+// set of a query run alone, or its row count if it had none; and for a
+// command the total of its row counts, 0 if it reported none. Returns
+// false and fills |error| if the result sets of a combined step do not
+// line up with its queries.
+bool SplitStepResults(const PipelineStep& step,
+                      const std::vector<PipelineOperation>& operations,
+                      std::vector<StatementResult> results,
+                      std::vector<StatementResult>* out, std::string* error);
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_PIPELINE_H_
@@ -0,0 +1,182 @@
+#include "procedure_call.h"
+
+#include <sqlucode.h>
+
+#include <cctype>
+#include <utility>
+
+#include "odbc_error.h"
+#include "result_sets.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+
+namespace {
+
+SQLSMALLINT IoType(ProcedureParameter::Direction direction) {
+  switch (direction) {
+    case ProcedureParameter::Direction::kOutput:
+      return SQL_PARAM_OUTPUT;
+    case ProcedureParameter::Direction::kInputOutput:
+      return SQL_PARAM_INPUT_OUTPUT;
+    default:
+      return SQL_PARAM_INPUT;
+  }
+}
+
+std::string WithoutAt(const std::string& name) {
+  return !name.empty() && name[0] == '@' ? name.substr(1) : name;
+}
+
+}  // namespace
+
+ProcedureCall::ProcedureCall(SQLHSTMT stmt) : stmt_(stmt) {}
+
+bool ProcedureCall::IsValidName(const std::string& name) {
+  // Up to four dot-separated parts, each a regular identifier or a
+  // [bracketed] one without a closing bracket inside.
+  size_t parts = 0;
+  size_t i = 0;
+  while (i < name.size()) {
+    if (name[i] == '[') {
+      size_t close = name.find(']', i + 1);
+      if (close == std::string::npos || close == i + 1) {
+        return false;
+      }
+      i = close + 1;
+    } else {
+      size_t start = i;
+      while (i < name.size() &&
+             (std::isalnum(static_cast<unsigned char>(name[i])) ||
+              name[i] == '_' || name[i] == '@' || name[i] == '#' ||
+              name[i] == '$')) {
+        ++i;
+      }
+      if (i == start) {
+        return false;
+      }
+    }
+    ++parts;
+    if (i < name.size()) {
+      if (name[i] != '.' || i + 1 == name.size()) {
+        return false;
+      }
+      ++i;
+    }
+  }
+  return parts > 0 && parts <= 4;
+}
+
+bool ProcedureCall::Execute(const std::string& name,
+                            const std::vector<ProcedureParameter>& params,
+                            ProcedureResult* result, std::string* error) {
+  if (!IsValidName(name)) {
+    *error = "Invalid procedure name: " + name;
+    return false;
+  }
+  std::string sql = "{? = call " + name + "(";
+  for (size_t i = 0; i < params.size(); ++i) {
+    sql += i == 0 ? "?" : ", ?";
+  }
+  sql += ")}";
+
+  if (!BindParameters(params, error)) {
+    return false;
+  }
+
+  std::vector<SQLWCHAR> wide = Utf8ToUtf16(sql);
+  SQLRETURN ret =
+      SQLExecDirectW(stmt_, wide.data(), (SQLINTEGER)wide.size());
+  if (ret != SQL_NO_DATA && !SQL_SUCCEEDED(ret)) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+    if (error->empty()) {
+      *error = "Stored procedure execution failed";
+    }
+    return false;
+  }
+  if (ret != SQL_NO_DATA && !ReadResults(result, error)) {
+    return false;
+  }
+
+  // Output parameters are filled in once the last result is consumed.
+  result->return_value =
+      return_indicator_ == SQL_NULL_DATA ? 0 : return_value_;
+  result->outputs.clear();
+  for (size_t i = 0; i < params.size(); ++i) {
+    if (params[i].direction != ProcedureParameter::Direction::kInput) {
+      result->outputs.emplace_back(WithoutAt(params[i].name),
+                                   binder_.Output(i + 1));
+    }
+  }
+  return true;
+}
+
+bool ProcedureCall::BindParameters(
+    const std::vector<ProcedureParameter>& params, std::string* error) {
+  // Parameter 1 is the return value; the arguments follow it.
+  binder_.Reset(stmt_, params.size() + 1);
+  return_value_ = 0;
+  return_indicator_ = 0;
+  SQLRETURN ret = SQLBindParameter(stmt_, 1, SQL_PARAM_OUTPUT, SQL_C_SLONG,
+                                   SQL_INTEGER, 10, 0, &return_value_,
+                                   sizeof(return_value_), &return_indicator_);
+  if (!SQL_SUCCEEDED(ret)) {
+    *error = "Failed to bind the return value: " +
+             GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+    return false;
+  }
+
+  SQLHDESC ipd = SQL_NULL_HDESC;
+  if (!params.empty() &&
+      !SQL_SUCCEEDED(SQLGetStmtAttr(stmt_, SQL_ATTR_IMP_PARAM_DESC, &ipd, 0,
+                                    nullptr))) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+    return false;
+  }
+
+  for (size_t i = 0; i < params.size(); ++i) {
+    const ProcedureParameter& param = params[i];
+    if (WithoutAt(param.name).empty()) {
+      *error = "Parameter " + std::to_string(i + 1) + " has no name";
+      return false;
+    }
+    if (!binder_.BindAt(stmt_, i + 1, IoType(param.direction), param.type,
+                        param.value, param.output_size, error)) {
+      return false;
+    }
+    // Name the parameter so the server matches it to the procedure's
+    // declaration instead of by position.
+    std::vector<SQLWCHAR> parameter_name =
+        Utf8ToUtf16("@" + WithoutAt(param.name));
+    parameter_name.push_back(0);
+    SQLSMALLINT record = (SQLSMALLINT)(i + 2);
+    if (!SQL_SUCCEEDED(SQLSetDescFieldW(ipd, record, SQL_DESC_NAME,
+                                        parameter_name.data(), SQL_NTS)) ||
+        !SQL_SUCCEEDED(SQLSetDescFieldW(ipd, record, SQL_DESC_UNNAMED,
+                                        (SQLPOINTER)SQL_NAMED, 0))) {
+      *error = "Failed to name parameter " + param.name + ": " +
+               GetOdbcDiagnostics(SQL_HANDLE_DESC, ipd);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ProcedureCall::ReadResults(ProcedureResult* result, std::string* error) {
+  std::vector<StatementResult> results;
+  if (!ReadStatementResults(stmt_, utf8_text_, &results, error)) {
+    return false;
+  }
+  result->result_sets.clear();
+  result->row_counts.clear();
+  for (StatementResult& item : results) {
+    if (item.has_result_set) {
+      result->result_sets.push_back(std::move(item.result_set));
+    } else {
+      result->row_counts.push_back(item.row_count);
+    }
+  }
+  return true;
+}
+
+}  // namespace mssql_connect
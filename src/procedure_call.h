@@ -0,0 +1,96 @@
+#ifndef MSSQL_CONNECT_PROCEDURE_CALL_H_
+#define MSSQL_CONNECT_PROCEDURE_CALL_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "columnar_result.h"
+#include "parameter_binder.h"
+
+namespace mssql_connect {
+
+// A named argument of a stored procedure call.
+struct ProcedureParameter {
+  enum class Direction {
+    kInput,
+    kOutput,
+    kInputOutput,
+  };
+
+  // Parameter name as declared by the procedure; a leading '@' is optional.
+  std::string name;
+  Direction direction = Direction::kInput;
+  // SQL type the parameter is sent and read back as. For input parameters
+  // this is the type of |value|.
+  SqlParameter::Type type = SqlParameter::Type::kNull;
+  // Ignored for output-only parameters.
+  SqlParameter value;
+  // Characters or bytes reserved for a text or binary output value.
+  size_t output_size = 0;
+};
+
+// Everything a procedure call produced.
+struct ProcedureResult {
+  int32_t return_value = 0;
+  // Result sets in the order the procedure produced them.
+  std::vector<ColumnarResult> result_sets;
+  // Row counts of the statements that produced no result set, e.g. the
+  // INSERTs of a procedure without SET NOCOUNT ON.
+  std::vector<int64_t> row_counts;
+  // Output and input/output parameters, by name without the '@'.
+  std::vector<std::pair<std::string, SqlParameter>> outputs;
+};
+
+// Runs a stored procedure with the ODBC call escape,
+// "{? = call name(?, ...)}", in a single round trip.
+//
+// Arguments are bound by name, so they may be given in any order and
+// parameters with defaults may be left out. Output parameters and the return
+// value are only sent after every result set, so all result sets are read
+// into memory before they are collected.
+class ProcedureCall {
+ public:
+  explicit ProcedureCall(SQLHSTMT stmt);
+
+  ProcedureCall(const ProcedureCall&) = delete;
+  ProcedureCall& operator=(const ProcedureCall&) = delete;
+
+  // Calls procedure |name| (optionally schema qualified) with |params|.
+  // Returns false and fills |error| on failure.
+  bool Execute(const std::string& name,
+               const std::vector<ProcedureParameter>& params,
+               ProcedureResult* result, std::string* error);
+
+  // Fetches result set text as UTF-8; see BlockFetcher::set_utf8_text().
+  void set_utf8_text(bool utf8_text) { utf8_text_ = utf8_text; }
+
+  // Whether |name| is a plain, optionally qualified and bracketed, object
+  // name that can be pasted into the call escape.
+  static bool IsValidName(const std::string& name);
+
+ private:
+  bool BindParameters(const std::vector<ProcedureParameter>& params,
+                      std::string* error);
+
+  // Reads the current and every following result of the executed call.
+  bool ReadResults(ProcedureResult* result, std::string* error);
+
+  SQLHSTMT stmt_;
+  bool utf8_text_ = false;
+  ParameterBinder binder_;
+  SQLINTEGER return_value_ = 0;
+  SQLLEN return_indicator_ = 0;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_PROCEDURE_CALL_H_
@@ -0,0 +1,70 @@
+#include "request_registry.h"
+
+#include <sqlext.h>
+
+namespace mssql_connect {
+
+void RequestRegistry::Add(int request_id) {
+  if (request_id == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  requests_[request_id] = Request();
+}
+
+void RequestRegistry::Remove(int request_id) {
+  if (request_id == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  requests_.erase(request_id);
+}
+
+bool RequestRegistry::Attach(int request_id, SQLHSTMT stmt) {
+  if (request_id == 0) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = requests_.find(request_id);
+  if (it == requests_.end()) {
+    return true;
+  }
+  if (it->second.cancelled) {
+    return false;
+  }
+  it->second.stmt = stmt;
+  return true;
+}
+
+bool RequestRegistry::Detach(int request_id) {
+  if (request_id == 0) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = requests_.find(request_id);
+  if (it == requests_.end()) {
+    return false;
+  }
+  it->second.stmt = SQL_NULL_HSTMT;
+  return it->second.cancelled;
+}
+
+bool RequestRegistry::Cancel(int request_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = requests_.find(request_id);
+  if (it == requests_.end()) {
+    return false;
+  }
+  it->second.cancelled = true;
+  if (it->second.stmt != SQL_NULL_HSTMT) {
+    SQLCancel(it->second.stmt);
+  }
+  return true;
+}
+
+size_t RequestRegistry::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return requests_.size();
+}
+
+}  // namespace mssql_connect
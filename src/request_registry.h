@@ -0,0 +1,71 @@
+#ifndef MSSQL_CONNECT_REQUEST_REGISTRY_H_
+#define MSSQL_CONNECT_REQUEST_REGISTRY_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+namespace mssql_connect {
+
+// Calls in flight by the request id Dart gave them, so that another thread
+// can cancel them.
+//
+// A request is added when its call is queued and removed once the call has
+// replied. While the call runs a statement, the statement is attached to the
+// request and Cancel() interrupts it with SQLCancel; the statement then fails
+// with SQLSTATE HY008 and its connection is free for the next call. A
+// request cancelled before it attaches a statement is refused by Attach(),
+// so a call still queued behind others on its connection never starts. A
+// cancel that lands between Attach() and the driver starting to execute
+// finds nothing running and is lost; Detach() still reports it.
+//
+// Request id 0 stands for a call that cannot be cancelled; every method
+// ignores it. Thread safe.
+class RequestRegistry {
+ public:
+  RequestRegistry() = default;
+
+  RequestRegistry(const RequestRegistry&) = delete;
+  RequestRegistry& operator=(const RequestRegistry&) = delete;
+
+  void Add(int request_id);
+  void Remove(int request_id);
+
+  // Attaches |stmt|, which is about to run for |request_id|. Returns false
+  // if the request has been cancelled, in which case the caller must not
+  // run the statement.
+  bool Attach(int request_id, SQLHSTMT stmt);
+
+  // Detaches the statement of |request_id|; it must be detached before it
+  // is freed or used for another request. Returns whether the request was
+  // cancelled.
+  bool Detach(int request_id);
+
+  // Cancels |request_id|: interrupts its statement if one is attached, or
+  // marks it so that it will not start. Returns false if no such request is
+  // in flight, e.g. because it has already replied.
+  bool Cancel(int request_id);
+
+  // Requests in flight.
+  size_t size() const;
+
+ private:
+  struct Request {
+    SQLHSTMT stmt = SQL_NULL_HSTMT;
+    bool cancelled = false;
+  };
+
+  // Held across SQLCancel so that a statement cannot be detached, and then
+  // freed, while it is being cancelled.
+  mutable std::mutex mutex_;
+  std::unordered_map<int, Request> requests_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_REQUEST_REGISTRY_H_
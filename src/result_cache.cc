@@ -0,0 +1,276 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace mssql_connect {
+
+namespace {
+
+// A word, a quoted identifier or a single punctuation character of a SQL
+// statement. Words and identifiers are lower-cased; |quoted| tells an
+// identifier such as [from] apart from the keyword.
+struct Token {
+  std::string text;
+  bool quoted = false;
+};
+
+char Lower(char c) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+bool IsWordChar(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '@' ||
+         c == '#' || c == '$' || (c & 0x80) != 0;
+}
+
+std::vector<Token> Tokenize(const std::string& sql) {
+  std::vector<Token> tokens;
+  size_t i = 0;
+  const size_t n = sql.size();
+  while (i < n) {
+    char c = sql[i];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++i;
+    } else if (c == '-' && i + 1 < n && sql[i + 1] == '-') {
+      while (i < n && sql[i] != '\n') ++i;
+    } else if (c == '/' && i + 1 < n && sql[i + 1] == '*') {
+      size_t end = sql.find("*/", i + 2);
+      i = end == std::string::npos ? n : end + 2;
+    } else if (c == '\'') {
+      // String literal; '' is an escaped quote.
+      for (++i; i < n; ++i) {
+        if (sql[i] == '\'') {
+          if (i + 1 < n && sql[i + 1] == '\'') {
+            ++i;
+          } else {
+            break;
+          }
+        }
+      }
+      ++i;
+    } else if (c == '[' || c == '"') {
+      char close = c == '[' ? ']' : '"';
+      Token token;
+      token.quoted = true;
+      for (++i; i < n; ++i) {
+        if (sql[i] == close) {
+          if (i + 1 < n && sql[i + 1] == close) {
+            ++i;
+          } else {
+            break;
+          }
+        }
+        token.text.push_back(Lower(sql[i]));
+      }
+      ++i;
+      tokens.push_back(std::move(token));
+    } else if (IsWordChar(c)) {
+      Token token;
+      while (i < n && IsWordChar(sql[i])) {
+        token.text.push_back(Lower(sql[i++]));
+      }
+      tokens.push_back(std::move(token));
+    } else {
+      Token token;
+      token.text.push_back(c);
+      tokens.push_back(std::move(token));
+      ++i;
+    }
+  }
+  return tokens;
+}
+
+bool IsKeyword(const Token& token, const char* keyword) {
+  return !token.quoted && token.text == keyword;
+}
+
+bool IsName(const Token& token) {
+  return token.quoted || (!token.text.empty() && IsWordChar(token.text[0]));
+}
+
+// Reads a (possibly multi-part) name starting at |*i| and returns its last
+// part, or an empty string if there is no name there (e.g. a subquery).
+std::string ReadName(const std::vector<Token>& tokens, size_t* i) {
+  std::string name;
+  while (*i < tokens.size() && IsName(tokens[*i])) {
+    name = tokens[(*i)++].text;
+    if (*i < tokens.size() && tokens[*i].text == "." && !tokens[*i].quoted) {
+      ++*i;
+    } else {
+      break;
+    }
+  }
+  return name;
+}
+
+void AddName(std::string name, std::vector<std::string>* names) {
+  if (!name.empty() &&
+      std::find(names->begin(), names->end(), name) == names->end()) {
+    names->push_back(std::move(name));
+  }
+}
+
+// Words that can follow a table name in a FROM list and so are not its
+// alias.
+bool EndsTableReference(const Token& token) {
+  static const char* const kWords[] = {
+      "apply", "cross", "delete", "except", "exec", "execute", "for",
+      "full", "go", "group", "having", "inner", "insert", "intersect",
+      "into", "join", "left", "merge", "on", "option", "order", "outer",
+      "output", "pivot", "right", "select", "set", "union", "unpivot",
+      "update", "using", "values", "when", "where", "with"};
+  if (token.quoted) {
+    return false;
+  }
+  for (const char* word : kWords) {
+    if (token.text == word) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Words a T-SQL statement can start with. A batch that starts with any
+// other name calls that procedure: EXEC may be left out of the first
+// statement of a batch.
+bool StartsStatement(const Token& token) {
+  static const char* const kWords[] = {
+      "alter", "backup", "begin", "break", "bulk", "checkpoint", "close",
+      "commit", "continue", "create", "dbcc", "deallocate", "declare",
+      "delete", "deny", "disable", "drop", "enable", "end", "exec",
+      "execute", "fetch", "go", "goto", "grant", "if", "insert", "kill",
+      "merge", "open", "print", "raiserror", "readtext", "receive",
+      "reconfigure", "restore", "return", "revert", "revoke", "rollback",
+      "save", "select", "send", "set", "setuser", "shutdown", "throw",
+      "truncate", "update", "updatetext", "use", "waitfor", "while", "with",
+      "writetext"};
+  if (token.quoted) {
+    return false;
+  }
+  for (const char* word : kWords) {
+    if (token.text == word) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+std::vector<std::string> FindTables(const std::string& sql) {
+  std::vector<Token> tokens = Tokenize(sql);
+  std::vector<std::string> names;
+  for (size_t i = 0; i < tokens.size();) {
+    const Token& token = tokens[i++];
+    if (token.quoted) {
+      continue;
+    }
+    if (token.text == "from") {
+      // FROM a [AS] x, b y, ...
+      while (true) {
+        AddName(ReadName(tokens, &i), &names);
+        if (i < tokens.size() && IsKeyword(tokens[i], "as")) ++i;
+        if (i < tokens.size() && IsName(tokens[i]) &&
+            !EndsTableReference(tokens[i])) {
+          ++i;
+        }
+        if (i < tokens.size() && tokens[i].text == "," && !tokens[i].quoted) {
+          ++i;
+          continue;
+        }
+        break;
+      }
+    } else if (token.text == "join" || token.text == "into" ||
+               token.text == "update" || token.text == "merge" ||
+               token.text == "using" || token.text == "table") {
+      if (i < tokens.size() && IsKeyword(tokens[i], "into")) ++i;
+      AddName(ReadName(tokens, &i), &names);
+    } else if ((token.text == "delete" || token.text == "insert") &&
+               i < tokens.size() && !IsKeyword(tokens[i], "from") &&
+               !IsKeyword(tokens[i], "into")) {
+      AddName(ReadName(tokens, &i), &names);
+    }
+  }
+  return names;
+}
+
+bool FindWrittenTables(const std::string& sql,
+                       std::vector<std::string>* tables) {
+  tables->clear();
+  bool writes = false;
+  std::vector<Token> tokens = Tokenize(sql);
+  size_t first = 0;
+  while (first < tokens.size() && tokens[first].text == ";" &&
+         !tokens[first].quoted) {
+    ++first;
+  }
+  if (first < tokens.size() && IsName(tokens[first]) &&
+      !StartsStatement(tokens[first])) {
+    // A bare procedure call, e.g. "dbo.Refresh @id = 1".
+    return false;
+  }
+  for (size_t i = first; i < tokens.size(); ++i) {
+    const Token& token = tokens[i];
+    if (token.quoted) {
+      continue;
+    }
+    const std::string& word = token.text;
+    if (word == "exec" || word == "execute" || word == "call" ||
+        word == "sp_executesql") {
+      return false;
+    }
+    if (word == "insert" || word == "update" || word == "delete" ||
+        word == "merge" || word == "truncate" || word == "drop" ||
+        word == "alter" || word == "into") {
+      writes = true;
+    }
+  }
+  if (writes) {
+    *tables = FindTables(sql);
+    // A write whose target cannot be named, e.g. DROP PROCEDURE or ALTER
+    // VIEW, may change anything.
+    if (tables->empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ChangesBatchState(const std::string& sql) {
+  for (const Token& token : Tokenize(sql)) {
+    // Both are reserved, so a column named either has to be quoted. SET
+    // also follows UPDATE, which is a write and never combined anyway.
+    if (IsKeyword(token, "declare") || IsKeyword(token, "set")) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MatchesPattern(const std::string& pattern, const std::string& text) {
+  // Iterative wildcard match that backtracks to the last '*'.
+  size_t p = 0;
+  size_t t = 0;
+  size_t star = std::string::npos;
+  size_t resume = 0;
+  while (t < text.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      resume = t;
+    } else if (p < pattern.size() &&
+               (pattern[p] == '?' || Lower(pattern[p]) == Lower(text[t]))) {
+      ++p;
+      ++t;
+    } else if (star != std::string::npos) {
+      p = star + 1;
+      t = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') ++p;
+  return p == pattern.size();
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,277 @@
+#ifndef MSSQL_CONNECT_RESULT_CACHE_H_
+#define MSSQL_CONNECT_RESULT_CACHE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mssql_connect {
+
+// Lower-cased names of the tables |sql| names: every name after FROM,
+// JOIN, INTO, UPDATE, MERGE, USING and TABLE, and after DELETE or INSERT used
+// without FROM or INTO, including comma-separated FROM lists. Only the
+// last part of a multi-part name is kept and brackets or quotes are
+// stripped, so "[dbo].[Users]" and "users" are the same table. Comments
+// and string literals are skipped.
+std::vector<std::string> FindTables(const std::string& sql);
+
+// The tables a statement may write. For a statement that writes at all
+// these are all the tables it names, which covers writes through an alias
+// at the cost of also counting the tables it only reads. Returns false if
+// it can write tables that cannot be seen in its text: it executes a
+// procedure or dynamic SQL, starts with a bare procedure name (EXEC can be
+// left out of the first statement of a batch), or writes without naming a
+// table. Returns true with no tables for a statement that only reads.
+bool FindWrittenTables(const std::string& sql, std::vector<std::string>* tables);
+
+// Whether |sql| declares a variable or changes a session setting with
+// DECLARE or SET, which would carry over to the statements after it in the
+// same batch.
+bool ChangesBatchState(const std::string& sql);
+
+// Whether |text| matches |pattern|, where '*' matches any run of
+// characters and '?' any one character. Case-insensitive.
+bool MatchesPattern(const std::string& pattern, const std::string& text);
+
+struct ResultCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  // Entries dropped to stay within the byte budget, and entries found
+  // expired.
+  uint64_t evictions = 0;
+  uint64_t expirations = 0;
+  // Entries dropped by Invalidate*() calls, explicit or after a write.
+  uint64_t invalidations = 0;
+  size_t entries = 0;
+  size_t bytes = 0;
+  size_t max_bytes = 0;
+};
+
+// Query results shared by every connection, keyed by the caller (the
+// plugin uses the connection target, SQL text, parameters and result
+// format) and bounded by the total byte size the caller reports for them.
+//
+// Each entry records the connection target and SQL it came from, the
+// tables that SQL reads, and when it expires. Entries are evicted least
+// recently used first once the budget is exceeded, dropped when found
+// expired, and invalidated by table or by a pattern over their SQL.
+// Invalidation scans every entry; the cache is meant for a modest number
+// of small lookup results. Thread safe.
+template <typename Value>
+class ResultCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // A budget of zero disables the cache: nothing is stored.
+  explicit ResultCache(size_t max_bytes = 0) : max_bytes_(max_bytes) {}
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  // Changes the budget, evicting entries that no longer fit.
+  void SetMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    EvictLocked();
+  }
+
+  bool enabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_bytes_ > 0;
+  }
+
+  // Copies the live value for |key| into |value| and marks it most
+  // recently used. Returns false on a miss, dropping an expired entry.
+  bool Get(const std::string& key, Value* value) {
+    return Get(key, value, Clock::now());
+  }
+
+  bool Get(const std::string& key, Value* value, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      ++misses_;
+      return false;
+    }
+    if (it->second->expires <= now) {
+      EraseLocked(it->second);
+      ++expirations_;
+      ++misses_;
+      return false;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    *value = it->second->value;
+    ++hits_;
+    return true;
+  }
+
+  // Stores |value| for |key| until |ttl| has passed, replacing any previous
+  // entry. |bytes| is what the value counts against the budget; a value
+  // larger than the whole budget is not stored.
+  void Put(const std::string& key, const std::string& target,
+           const std::string& sql, Value value, size_t bytes,
+           std::chrono::milliseconds ttl) {
+    Put(key, target, sql, std::move(value), bytes, ttl, Clock::now());
+  }
+
+  void Put(const std::string& key, const std::string& target,
+           const std::string& sql, Value value, size_t bytes,
+           std::chrono::milliseconds ttl, Clock::time_point now) {
+    std::vector<std::string> tables = FindTables(sql);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      EraseLocked(it->second);
+    }
+    if (bytes > max_bytes_ || ttl.count() <= 0) {
+      return;
+    }
+    entries_.push_front(Entry{key, target, sql, std::move(tables),
+                              std::move(value), bytes, now + ttl});
+    index_[key] = entries_.begin();
+    bytes_ += bytes;
+    EvictLocked();
+  }
+
+  // Drops the entries of |target| that read any of |tables|, which may be
+  // written as in SQL ("dbo.Users", "[Users]"). An empty |target| matches
+  // every target. Returns the number dropped.
+  size_t InvalidateTables(const std::string& target,
+                          const std::vector<std::string>& tables) {
+    std::vector<std::string> names;
+    for (const std::string& table : tables) {
+      std::vector<std::string> found = FindTables("FROM " + table);
+      names.insert(names.end(), found.begin(), found.end());
+    }
+    return InvalidateNames(target, names);
+  }
+
+  // Drops every entry of |target|, or every entry if it is empty.
+  size_t InvalidateTarget(const std::string& target) {
+    return InvalidateIf([&](const Entry& entry) {
+      return target.empty() || entry.target == target;
+    });
+  }
+
+  // Drops the entries whose SQL matches |pattern|; see MatchesPattern().
+  size_t InvalidatePattern(const std::string& pattern) {
+    return InvalidateIf([&](const Entry& entry) {
+      return MatchesPattern(pattern, entry.sql);
+    });
+  }
+
+  // Drops what a statement run on |target| may have changed: the entries
+  // reading the tables it writes, or all of |target|'s entries when those
+  // cannot be told from its text.
+  size_t InvalidateAfterWrite(const std::string& target,
+                              const std::string& sql) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (index_.empty()) {
+        return 0;
+      }
+    }
+    std::vector<std::string> tables;
+    if (!FindWrittenTables(sql, &tables)) {
+      return InvalidateTarget(target);
+    }
+    return tables.empty() ? 0 : InvalidateNames(target, tables);
+  }
+
+  ResultCacheStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ResultCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.expirations = expirations_;
+    stats.invalidations = invalidations_;
+    stats.entries = index_.size();
+    stats.bytes = bytes_;
+    stats.max_bytes = max_bytes_;
+    return stats;
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string target;
+    std::string sql;
+    std::vector<std::string> tables;
+    Value value;
+    size_t bytes;
+    Clock::time_point expires;
+  };
+  using Iterator = typename std::list<Entry>::iterator;
+
+  // InvalidateTables() with names as FindTables() returns them.
+  size_t InvalidateNames(const std::string& target,
+                         const std::vector<std::string>& names) {
+    return InvalidateIf([&](const Entry& entry) {
+      if (!target.empty() && entry.target != target) {
+        return false;
+      }
+      for (const std::string& name : names) {
+        for (const std::string& read : entry.tables) {
+          if (read == name) {
+            return true;
+          }
+        }
+      }
+      return false;
+    });
+  }
+
+  template <typename Predicate>
+  size_t InvalidateIf(Predicate predicate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t dropped = 0;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      auto next = std::next(it);
+      if (predicate(*it)) {
+        EraseLocked(it);
+        ++dropped;
+      }
+      it = next;
+    }
+    invalidations_ += dropped;
+    return dropped;
+  }
+
+  void EraseLocked(Iterator it) {
+    bytes_ -= it->bytes;
+    index_.erase(it->key);
+    entries_.erase(it);
+  }
+
+  void EvictLocked() {
+    while (bytes_ > max_bytes_ && !entries_.empty()) {
+      EraseLocked(std::prev(entries_.end()));
+      ++evictions_;
+    }
+  }
+
+  mutable std::mutex mutex_;
+  size_t max_bytes_;
+  size_t bytes_ = 0;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, Iterator> index_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t evictions_ = 0;
+  uint64_t expirations_ = 0;
+  uint64_t invalidations_ = 0;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_RESULT_CACHE_H_
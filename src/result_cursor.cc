@@ -0,0 +1,51 @@
+#include "result_cursor.h"
+
+namespace mssql_connect {
+
+ResultCursor::ResultCursor(SQLHSTMT stmt)
+    : stmt_(stmt), fetcher_(new BlockFetcher(stmt)) {}
+
+ResultCursor::~ResultCursor() {
+  // The fetcher unbinds from the statement, so it must go first.
+  fetcher_.reset();
+  SQLFreeStmt(stmt_, SQL_CLOSE);
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+}
+
+bool ResultCursor::Bind(std::string* error) {
+  return fetcher_->Bind(error);
+}
+
+bool ResultCursor::Fetch(size_t max_rows, size_t max_bytes,
+                         ColumnarResult* chunk, std::string* error) {
+  StartColumnar(*fetcher_, chunk);
+  size_t bytes = 0;
+  while (!done_ && (max_rows == 0 || chunk->row_count < max_rows) &&
+         (max_bytes == 0 || bytes < max_bytes)) {
+    if (next_row_ == rowset_size_) {
+      next_row_ = 0;
+      if (!fetcher_->Next(&rowset_size_, error)) {
+        return false;
+      }
+      if (rowset_size_ == 0) {
+        done_ = true;
+        break;
+      }
+    }
+    bytes += AppendColumnarRow(*fetcher_, next_row_++, chunk);
+    if (next_row_ == rowset_size_ &&
+        rowset_size_ < fetcher_->row_array_size()) {
+      // A short rowset is the last one.
+      done_ = true;
+    }
+    if (!chunk->columns.empty() &&
+        fetcher_->IsLob(chunk->columns.size() - 1)) {
+      // Fetching on would discard the value; stay on this row.
+      break;
+    }
+  }
+  FinishColumnar(chunk);
+  return true;
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,76 @@
+#ifndef MSSQL_CONNECT_RESULT_CURSOR_H_
+#define MSSQL_CONNECT_RESULT_CURSOR_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "columnar_result.h"
+
+namespace mssql_connect {
+
+// An open result set read in bounded chunks.
+//
+// The statement stays open between chunks, so native memory is limited to
+// the fetcher's rowset buffers plus one chunk regardless of result size. A
+// chunk may end part way through a rowset; the remaining rows are returned
+// by the next call.
+class ResultCursor {
+ public:
+  // Takes ownership of |stmt|, which must have an open result set.
+  explicit ResultCursor(SQLHSTMT stmt);
+
+  // Closes the result set and frees the statement.
+  ~ResultCursor();
+
+  ResultCursor(const ResultCursor&) = delete;
+  ResultCursor& operator=(const ResultCursor&) = delete;
+
+  // Describes and binds the result columns. Returns false and fills |error|
+  // on failure.
+  bool Bind(std::string* error);
+
+  // Leaves last-column values longer than |bytes| in the driver; see
+  // BlockFetcher::set_lob_threshold(). A chunk ends at a row with such a
+  // value, which can be streamed with lob() until the next Fetch().
+  void set_lob_threshold(size_t bytes) { fetcher_->set_lob_threshold(bytes); }
+
+  // See BlockFetcher::set_utf8_text(). Must be called before Bind().
+  void set_utf8_text(bool utf8_text) { fetcher_->set_utf8_text(utf8_text); }
+
+  const std::vector<ColumnDescription>& columns() const {
+    return fetcher_->columns();
+  }
+
+  // Replaces |chunk| with up to |max_rows| rows, stopping early once the
+  // chunk holds about |max_bytes| of data (always at least one row). Zero
+  // disables either limit. Returns false and fills |error| on failure.
+  bool Fetch(size_t max_rows, size_t max_bytes, ColumnarResult* chunk,
+             std::string* error);
+
+  // True once the last row has been returned.
+  bool done() const { return done_; }
+
+  // Streams the pending LOB of the last row returned.
+  BlockFetcher* lob() { return fetcher_.get(); }
+
+ private:
+  SQLHSTMT stmt_;
+  std::unique_ptr<BlockFetcher> fetcher_;
+  // Rows in the fetcher's current rowset, and the next one to return.
+  SQLULEN rowset_size_ = 0;
+  SQLULEN next_row_ = 0;
+  bool done_ = false;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_RESULT_CURSOR_H_
@@ -0,0 +1,48 @@
+#include "result_sets.h"
+
+#include "block_fetcher.h"
+#include "odbc_error.h"
+
+namespace mssql_connect {
+
+bool ReadStatementResults(SQLHSTMT stmt, bool utf8_text,
+                          std::vector<StatementResult>* results,
+                          std::string* error) {
+  results->clear();
+  while (true) {
+    SQLSMALLINT num_cols = 0;
+    if (!SQL_SUCCEEDED(SQLNumResultCols(stmt, &num_cols))) {
+      *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+      return false;
+    }
+    if (num_cols > 0) {
+      results->emplace_back();
+      StatementResult& result = results->back();
+      result.has_result_set = true;
+      BlockFetcher fetcher(stmt);
+      fetcher.set_utf8_text(utf8_text);
+      if (!fetcher.Bind(error) ||
+          !ReadColumnar(&fetcher, &result.result_set, error)) {
+        return false;
+      }
+      result.row_count = (int64_t)result.result_set.row_count;
+    } else {
+      SQLLEN count = -1;
+      if (SQL_SUCCEEDED(SQLRowCount(stmt, &count)) && count >= 0) {
+        results->emplace_back();
+        results->back().row_count = count;
+      }
+    }
+
+    SQLRETURN ret = SQLMoreResults(stmt);
+    if (ret == SQL_NO_DATA) {
+      return true;
+    }
+    if (!SQL_SUCCEEDED(ret)) {
+      *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+      return false;
+    }
+  }
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,38 @@
+#ifndef MSSQL_CONNECT_RESULT_SETS_H_
+#define MSSQL_CONNECT_RESULT_SETS_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "columnar_result.h"
+
+namespace mssql_connect {
+
+// One result of an executed batch: either a result set, or the row count
+// of a statement that returned no rows (INSERT, UPDATE, DELETE, ...).
+struct StatementResult {
+  bool has_result_set = false;
+  ColumnarResult result_set;
+  // -1 when the driver reported no count, e.g. for DDL.
+  int64_t row_count = -1;
+};
+
+// Reads the current result of |stmt| and every following one, advancing
+// with SQLMoreResults, into |results| in the order the server sent them.
+// Statements with neither a result set nor a row count are skipped.
+// |utf8_text| fetches text as UTF-8; see BlockFetcher::set_utf8_text().
+// Returns false and fills |error| on failure.
+bool ReadStatementResults(SQLHSTMT stmt, bool utf8_text,
+                          std::vector<StatementResult>* results,
+                          std::string* error);
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_RESULT_SETS_H_
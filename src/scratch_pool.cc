@@ -0,0 +1,66 @@
+#include "scratch_pool.h"
+
+#include <utility>
+
+namespace mssql_connect {
+
+const size_t ScratchPool::kMaxRetainedBytes;
+
+ScratchPool& ScratchPool::ForThisThread() {
+  static thread_local ScratchPool pool;
+  return pool;
+}
+
+size_t ScratchPool::retained_bytes() const {
+  // A short string's characters live in the string object itself.
+  static const size_t kInlineCapacity = std::string().capacity();
+  size_t text_bytes = text_.capacity() > kInlineCapacity ? text_.capacity() : 0;
+  return retained_bytes_ + text_bytes;
+}
+
+std::vector<uint8_t> ScratchPool::Take(size_t bytes) {
+  // The smallest buffer that is big enough, else the biggest one, grown.
+  size_t best = free_.size();
+  for (size_t i = 0; i < free_.size(); ++i) {
+    size_t capacity = free_[i].capacity();
+    if (best == free_.size()) {
+      best = i;
+      continue;
+    }
+    size_t best_capacity = free_[best].capacity();
+    bool fits = capacity >= bytes;
+    bool best_fits = best_capacity >= bytes;
+    if (fits ? !best_fits || capacity < best_capacity
+             : !best_fits && capacity > best_capacity) {
+      best = i;
+    }
+  }
+  std::vector<uint8_t> buffer;
+  if (best < free_.size()) {
+    buffer.swap(free_[best]);
+    free_[best].swap(free_.back());
+    free_.pop_back();
+    retained_bytes_ -= buffer.capacity();
+  }
+  if (buffer.size() < bytes) {
+    buffer.resize(bytes);
+  }
+  return buffer;
+}
+
+void ScratchPool::Give(std::vector<uint8_t> buffer) {
+  if (buffer.capacity() == 0 ||
+      retained_bytes() + buffer.capacity() > kMaxRetainedBytes) {
+    return;
+  }
+  retained_bytes_ += buffer.capacity();
+  free_.push_back(std::move(buffer));
+}
+
+void ScratchPool::Trim() {
+  if (retained_bytes() > kMaxRetainedBytes) {
+    std::string().swap(text_);
+  }
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,61 @@
+#ifndef MSSQL_CONNECT_SCRATCH_POOL_H_
+#define MSSQL_CONNECT_SCRATCH_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mssql_connect {
+
+// Byte buffers reused across the queries a worker thread runs: bound column
+// arrays, SQLGetData chunks and transcoding output.
+//
+// A BlockFetcher takes its buffers when it binds and gives them all back
+// when it is destroyed, which is once its reply has been built. Queries on
+// a warm worker then allocate no fetch buffers at all, and their memory is
+// already paged in.
+class ScratchPool {
+ public:
+  // Buffers and text() beyond this many bytes are freed instead of kept.
+  static const size_t kMaxRetainedBytes = 16 * 1024 * 1024;
+
+  ScratchPool() = default;
+
+  ScratchPool(const ScratchPool&) = delete;
+  ScratchPool& operator=(const ScratchPool&) = delete;
+
+  // The calling thread's pool.
+  static ScratchPool& ForThisThread();
+
+  // A buffer of at least |bytes| bytes. Its contents are unspecified.
+  std::vector<uint8_t> Take(size_t bytes);
+
+  // Returns |buffer| for a later Take(). Its size is kept.
+  void Give(std::vector<uint8_t> buffer);
+
+  // A string to transcode a cell into before copying it out at its final
+  // size; AppendUtf16AsUtf8() reserves three bytes per unit, which would
+  // otherwise stay allocated with every stored cell. It keeps the capacity
+  // of the longest cell until Trim().
+  std::string* text() {
+    Trim();
+    return &text_;
+  }
+
+  // Frees text() if it has grown past what the pool may retain, e.g. after
+  // a large LOB was transcoded into it.
+  void Trim();
+
+  // Bytes held by given buffers and allocated by text().
+  size_t retained_bytes() const;
+
+ private:
+  std::vector<std::vector<uint8_t>> free_;
+  size_t retained_bytes_ = 0;
+  std::string text_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_SCRATCH_POOL_H_
@@ -0,0 +1,372 @@
+#include "session.h"
+
+#include <sqlucode.h>
+
+#include <chrono>
+#include <sstream>
+#include <utility>
+
+#include "client_encoding.h"
+#include "connection_pool.h"
+#include "odbc_error.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+
+std::string BuildConnectionString(const ConnectOptions& options) {
+  std::stringstream conn_str_ss;
+  conn_str_ss << "DRIVER={ODBC Driver 18 for SQL Server};SERVER=" << options.server
+              << ";DATABASE=" << options.database
+              << ";UID=" << options.username
+              << ";PWD=" << options.password
+              << ";TrustServerCertificate=Yes;";
+  return conn_str_ss.str();
+}
+
+SQLULEN TimeoutSeconds(int64_t milliseconds) {
+  return milliseconds > 0 ? (SQLULEN)((milliseconds + 999) / 1000) : 0;
+}
+
+void SetLoginTimeout(SQLHDBC dbc, SQLULEN seconds) {
+  if (seconds > 0) {
+    SQLSetConnectAttr(dbc, SQL_ATTR_LOGIN_TIMEOUT, (SQLPOINTER)seconds,
+                      SQL_IS_UINTEGER);
+  }
+}
+
+bool DriverConnect(SQLHDBC dbc, const std::string& connection_string,
+                   SQLULEN login_timeout, std::string* error) {
+  std::vector<SQLWCHAR> text = Utf8ToUtf16(connection_string);
+  SetLoginTimeout(dbc, login_timeout);
+  SQLRETURN ret = SQLDriverConnectW(dbc, NULL, text.data(), (SQLSMALLINT)text.size(),
+                                    NULL, 0, NULL, SQL_DRIVER_NOPROMPT);
+  if (SQL_SUCCEEDED(ret)) {
+    return true;
+  }
+  *error = GetOdbcDiagnostics(SQL_HANDLE_DBC, dbc);
+  if (error->empty()) {
+    *error = "Failed to connect to database, but no diagnostic message was returned.";
+  }
+  return false;
+}
+
+const char* ErrorCodeForState(const std::string& sqlstate, bool cancelled,
+                              const char* fallback) {
+  if (sqlstate == "HYT00") {
+    return "Timeout";
+  }
+  if (cancelled || sqlstate == "HY008") {
+    return "Cancelled";
+  }
+  return fallback;
+}
+
+const char* CellTypeName(CellType type) {
+  switch (type) {
+    case CellType::kBool:
+      return "bool";
+    case CellType::kInt32:
+    case CellType::kInt64:
+      return "int";
+    case CellType::kDouble:
+      return "double";
+    case CellType::kDecimal:
+      return "decimal";
+    case CellType::kDateTime:
+      return "datetime";
+    case CellType::kTime:
+      return "time";
+    case CellType::kGuid:
+      return "guid";
+    case CellType::kBinary:
+      return "binary";
+    case CellType::kText:
+      break;
+  }
+  return "string";
+}
+
+std::unique_ptr<PreparedStatement> PrepareStatement(
+    SQLHDBC dbc, StatementCache* statements, const std::string& sql,
+    const std::vector<SqlParameter>& params, SQLULEN timeout,
+    ParameterBinder* binder, const TraceCall& trace, std::string* error) {
+  ScopedSpan span(trace, "prepare");
+  std::unique_ptr<PreparedStatement> statement = statements->Take(dbc, sql, error);
+  if (!statement) {
+    return nullptr;
+  }
+  if (!statement->SetQueryTimeout(timeout, error) ||
+      !binder->Bind(statement->handle(), params, error)) {
+    statements->Return(sql, std::move(statement));
+    return nullptr;
+  }
+  return statement;
+}
+
+// Whether the result |stmt| has just produced has the shape of |columns|.
+// A cached statement can return other columns after the schema of a table
+// it reads changes, or when it is a batch or procedure that picks its
+// result at run time. The driver answers from the metadata the execution
+// returned, without a round trip; only the names are not compared.
+bool MatchesResult(SQLHSTMT stmt, const std::vector<ColumnDescription>& columns) {
+  SQLSMALLINT count = 0;
+  if (!SQL_SUCCEEDED(SQLNumResultCols(stmt, &count)) ||
+      static_cast<size_t>(count) != columns.size()) {
+    return false;
+  }
+  for (SQLSMALLINT i = 0; i < count; ++i) {
+    const ColumnDescription& column = columns[i];
+    SQLSMALLINT sql_type = SQL_UNKNOWN_TYPE;
+    SQLULEN column_size = 0;
+    SQLSMALLINT decimal_digits = 0;
+    SQLSMALLINT nullable = SQL_NULLABLE_UNKNOWN;
+    if (!SQL_SUCCEEDED(SQLDescribeColW(stmt, i + 1, nullptr, 0, nullptr,
+                                       &sql_type, &column_size,
+                                       &decimal_digits, &nullable)) ||
+        sql_type != column.sql_type || column_size != column.column_size ||
+        decimal_digits != column.decimal_digits) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DescribeResult(PreparedStatement* statement, BlockFetcher* fetcher,
+                    const TraceCall& trace, std::string* error) {
+  ScopedSpan span(trace, "describe");
+  if (statement->described &&
+      MatchesResult(statement->handle(), statement->columns)) {
+    return fetcher->Bind(statement->columns, error);
+  }
+  if (!fetcher->Bind(error)) {
+    return false;
+  }
+  statement->columns = fetcher->columns();
+  statement->described = true;
+  return true;
+}
+
+SQLLEN AffectedRows(SQLHSTMT stmt, SQLRETURN ret, const std::string& sql) {
+  if (ret == SQL_NO_DATA) {
+    return 0;
+  }
+  SQLLEN affected_rows = -1;
+  if (!SQL_SUCCEEDED(SQLRowCount(stmt, &affected_rows)) &&
+      (sql.rfind("INSERT", 0) == 0 || sql.rfind("insert", 0) == 0)) {
+    affected_rows = 1;
+  }
+  return affected_rows;
+}
+
+const CallErrors kQueryErrors = {"QueryError", "Query execution failed",
+                                 "Query was cancelled"};
+const CallErrors kExecuteErrors = {"ExecuteError", "Command execution failed",
+                                   "Command was cancelled"};
+
+SessionError ExecutionError(const CallErrors& errors,
+                            const std::string& sqlstate, std::string details,
+                            bool cancelled) {
+  if (details.empty()) {
+    details = std::string(errors.message) +
+              ", but no diagnostic message was returned.";
+  }
+  return SessionError{ErrorCodeForState(sqlstate, cancelled, errors.code),
+                      errors.message, std::move(details)};
+}
+
+bool FetchResult(PreparedStatement* statement, bool utf8_text,
+                 const StatementOptions& options, Metrics* metrics,
+                 ResultSink* sink, SessionError* error) {
+  SQLHSTMT stmt = statement->handle();
+  std::string error_message;
+  bool ok;
+  {
+    BlockFetcher fetcher(stmt);
+    fetcher.set_utf8_text(utf8_text);
+    ok = DescribeResult(statement, &fetcher, options.trace, &error_message);
+    if (ok) {
+      // Each block is a fetch span inside the encode span.
+      const TraceCall& trace = options.trace;
+      if (trace.traced()) {
+        fetcher.set_fetch_observer([trace](Tracer::Clock::time_point start,
+                                           Tracer::Clock::time_point end, SQLULEN rows) {
+          Tracer::Global().Record(trace, "fetch", start, end, (int64_t)rows);
+        });
+      }
+      ScopedSpan encode_span(trace, "encode");
+      // Fetching and encoding interleave; the fetcher times its own part
+      // and the rest is the sink's.
+      Metrics::Clock::time_point started;
+      if (metrics) {
+        fetcher.set_timed(true);
+        started = Metrics::Clock::now();
+      }
+      ok = ReadResult(&fetcher, sink, &error_message);
+      if (metrics) {
+        std::chrono::nanoseconds fetch = fetcher.fetch_time();
+        metrics->Record(Phase::kFetch, fetch);
+        metrics->Record(Phase::kEncode, Metrics::Clock::now() - started - fetch);
+        metrics->AddRows(fetcher.rows_read());
+      }
+    }
+    // Before the fetcher unbinds the statement, while its diagnostics are
+    // still those of the failure.
+    bool cancelled = options.requests && options.requests->Detach(options.request_id);
+    if (!ok) {
+      *error = SessionError{
+          ErrorCodeForState(GetOdbcSqlState(SQL_HANDLE_STMT, stmt), cancelled,
+                            kQueryErrors.code),
+          "Failed to fetch rows", error_message};
+    }
+  }
+  if (!ok) {
+    // E.g. a 01004 truncation: describe afresh next time.
+    statement->described = false;
+  }
+  return ok;
+}
+
+std::unique_ptr<Session> Session::Open(const ConnectOptions& options,
+                                       std::shared_ptr<Metrics> metrics,
+                                       SessionError* error) {
+  if (metrics) {
+    metrics->CountCall(CallKind::kConnect);
+  }
+  auto fail = [&](std::string message, std::string details) {
+    if (metrics) {
+      metrics->CountError(CallKind::kConnect);
+    }
+    *error = SessionError{"ConnectionError", std::move(message), std::move(details)};
+    return nullptr;
+  };
+
+  std::string error_message;
+  std::shared_ptr<OdbcEnvironment> environment = OdbcEnvironment::Get(&error_message);
+  if (!environment) {
+    return fail(error_message, "");
+  }
+  SQLHDBC dbc = environment->AllocConnection(&error_message);
+  if (dbc == SQL_NULL_HDBC) {
+    return fail(error_message, "");
+  }
+
+  std::string connection_string = BuildConnectionString(options);
+  bool connected;
+  {
+    PhaseTimer timer(metrics.get(), Phase::kConnect);
+    connected = DriverConnect(dbc, connection_string, options.login_timeout,
+                              &error_message);
+  }
+  if (!connected) {
+    environment->FreeConnection(dbc);
+    return fail("Failed to connect to database", error_message);
+  }
+
+  // Falls back to UTF-16 if the collation cannot be read.
+  bool utf8_text = false;
+  if (options.utf8_text && !CanFetchUtf8Text(dbc, &utf8_text, &error_message)) {
+    utf8_text = false;
+  }
+  return std::unique_ptr<Session>(new Session(
+      std::move(environment), dbc, options,
+      NormalizeConnectionString(connection_string), utf8_text, std::move(metrics)));
+}
+
+Session::Session(std::shared_ptr<OdbcEnvironment> environment, SQLHDBC dbc,
+                 const ConnectOptions& options, std::string target, bool utf8_text,
+                 std::shared_ptr<Metrics> metrics)
+    : environment_(std::move(environment)),
+      dbc_(dbc),
+      statements_(std::make_unique<StatementCache>(options.statement_cache_size)),
+      target_(std::move(target)),
+      utf8_text_(utf8_text),
+      metrics_(std::move(metrics)) {}
+
+Session::~Session() {
+  statements_.reset();
+  SQLDisconnect(dbc_);
+  environment_->FreeConnection(dbc_);
+}
+
+std::unique_ptr<PreparedStatement> Session::Run(
+    const std::string& sql, const std::vector<SqlParameter>& params,
+    const StatementOptions& options, const CallErrors& errors,
+    ParameterBinder* binder, SQLRETURN* ret, SessionError* error) {
+  std::string error_message;
+  std::unique_ptr<PreparedStatement> statement =
+      PrepareStatement(dbc_, statements_.get(), sql, params, options.timeout, binder,
+                       options.trace, &error_message);
+  if (!statement) {
+    *error = SessionError{errors.code, errors.message, error_message};
+    return nullptr;
+  }
+  SQLHSTMT stmt = statement->handle();
+  RequestRegistry* requests = options.requests;
+  if (requests && !requests->Attach(options.request_id, stmt)) {
+    statements_->Return(sql, std::move(statement));
+    *error = SessionError{"Cancelled", errors.cancelled, ""};
+    return nullptr;
+  }
+
+  {
+    PhaseTimer timer(metrics(), Phase::kExecute);
+    ScopedSpan span(options.trace, "execute");
+    *ret = SQLExecute(stmt);
+  }
+  if (SQL_SUCCEEDED(*ret) || *ret == SQL_NO_DATA) {
+    return statement;
+  }
+  std::string sqlstate = GetOdbcSqlState(SQL_HANDLE_STMT, stmt);
+  error_message = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+  bool cancelled = requests && requests->Detach(options.request_id);
+  statements_->Return(sql, std::move(statement));
+  *error = ExecutionError(errors, sqlstate, std::move(error_message), cancelled);
+  return nullptr;
+}
+
+bool Session::Query(const std::string& sql, const std::vector<SqlParameter>& params,
+                    const StatementOptions& options, ResultSink* sink,
+                    SessionError* error) {
+  ParameterBinder binder;
+  SQLRETURN ret;
+  std::unique_ptr<PreparedStatement> statement =
+      Run(sql, params, options, kQueryErrors, &binder, &ret, error);
+  if (!statement) {
+    return false;
+  }
+  bool ok = FetchResult(statement.get(), utf8_text_, options, metrics(), sink, error);
+  statements_->Return(sql, std::move(statement));
+  return ok;
+}
+
+bool Session::Query(const std::string& sql, const std::vector<SqlParameter>& params,
+                    const StatementOptions& options, ColumnarResult* result,
+                    SessionError* error) {
+  ColumnarSink sink(result);
+  return Query(sql, params, options, &sink, error);
+}
+
+bool Session::Execute(const std::string& sql, const std::vector<SqlParameter>& params,
+                      const StatementOptions& options, int64_t* rows_affected,
+                      SessionError* error) {
+  ParameterBinder binder;
+  SQLRETURN ret;
+  std::unique_ptr<PreparedStatement> statement =
+      Run(sql, params, options, kExecuteErrors, &binder, &ret, error);
+  if (!statement) {
+    return false;
+  }
+  SQLLEN affected_rows = AffectedRows(statement->handle(), ret, sql);
+  if (options.requests) {
+    options.requests->Detach(options.request_id);
+  }
+  statements_->Return(sql, std::move(statement));
+  Metrics* metrics = this->metrics();
+  if (metrics && affected_rows > 0) {
+    metrics->AddRows((uint64_t)affected_rows);
+  }
+  *rows_affected = affected_rows;
+  return true;
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,219 @@
+#ifndef MSSQL_CONNECT_SESSION_H_
+#define MSSQL_CONNECT_SESSION_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "columnar_result.h"
+#include "metrics.h"
+#include "odbc_environment.h"
+#include "parameter_binder.h"
+#include "request_registry.h"
+#include "statement_cache.h"
+#include "tracer.h"
+
+namespace mssql_connect {
+
+// The arguments of a connect call, read from the platform's channel values
+// by its adapter.
+struct ConnectOptions {
+  std::string server;
+  std::string database;
+  std::string username;
+  std::string password;
+  // Seconds SQLDriverConnect waits for the login; zero keeps the driver's
+  // default.
+  SQLULEN login_timeout = 0;
+  // Fetch char and varchar columns as UTF-8 when the database collation
+  // allows it; see CanFetchUtf8Text.
+  bool utf8_text = false;
+  size_t statement_cache_size = StatementCache::kDefaultCapacity;
+};
+
+// The driver connection string for |options|.
+std::string BuildConnectionString(const ConnectOptions& options);
+
+// Rounds a millisecond argument such as "timeoutMs" up to the whole seconds
+// ODBC timeouts are set in. Zero when not positive.
+SQLULEN TimeoutSeconds(int64_t milliseconds);
+
+// Bounds how long SQLDriverConnect on |dbc| waits for the server to accept
+// the login. Zero keeps the driver's default.
+void SetLoginTimeout(SQLHDBC dbc, SQLULEN seconds);
+
+// Connects |dbc| to the UTF-8 |connection_string| without prompting.
+// Returns false and fills |error| with the driver's diagnostics on failure.
+bool DriverConnect(SQLHDBC dbc, const std::string& connection_string,
+                   SQLULEN login_timeout, std::string* error);
+
+// The error code of a statement that failed with |sqlstate|: "Timeout" when
+// it ran past its query timeout, "Cancelled" when a cancel interrupted it,
+// |fallback| otherwise.
+const char* ErrorCodeForState(const std::string& sqlstate, bool cancelled,
+                              const char* fallback);
+
+// The "columnTypes" name of cells of |type|; the Dart side turns int
+// datetime and time cells, guid bytes and decimals into its own types.
+const char* CellTypeName(CellType type);
+
+// Takes the cached statement for |sql|, or prepares one on |dbc|, then sets
+// its query timeout and binds |params| with |binder|, which must outlive the
+// execution. Records a "prepare" span of |trace|. Returns nullptr and fills
+// |error| on failure, having put the statement back in the cache.
+std::unique_ptr<PreparedStatement> PrepareStatement(
+    SQLHDBC dbc, StatementCache* statements, const std::string& sql,
+    const std::vector<SqlParameter>& params, SQLULEN timeout,
+    ParameterBinder* binder, const TraceCall& trace, std::string* error);
+
+// Binds |fetcher| to the result of |statement|, which has just run. A cached
+// statement reuses the column metadata of an earlier run while the number
+// of columns and each one's type, size and scale still match; otherwise
+// the result is described again. Callers clear |statement->described|
+// when a fetch fails, so a mismatch this misses, such as a truncation,
+// does not repeat. Records a "describe" span of |trace|.
+bool DescribeResult(PreparedStatement* statement, BlockFetcher* fetcher,
+                    const TraceCall& trace, std::string* error);
+
+// The rows affected by |sql|, which finished on |stmt| with |ret|: zero for
+// SQL_NO_DATA, a searched UPDATE or DELETE that matched nothing, and -1 when
+// the driver cannot tell, except for an INSERT, which is assumed to have
+// written one row.
+SQLLEN AffectedRows(SQLHSTMT stmt, SQLRETURN ret, const std::string& sql);
+
+// A failed call, as the platform channels report it.
+struct SessionError {
+  std::string code;
+  std::string message;
+  // The driver's diagnostics, if any.
+  std::string details;
+};
+
+// Per-call options of Session::Query() and Session::Execute().
+struct StatementOptions {
+  // Seconds; zero for no query timeout.
+  SQLULEN timeout = 0;
+  // Where the call can be cancelled from, if anywhere. The caller adds and
+  // removes |request_id|; the session attaches its statement while it runs.
+  RequestRegistry* requests = nullptr;
+  int request_id = 0;
+  TraceCall trace;
+};
+
+// The codes and messages a failed call of one kind is reported with.
+struct CallErrors {
+  const char* code;
+  const char* message;
+  // The message of a call cancelled before it started.
+  const char* cancelled;
+};
+
+extern const CallErrors kQueryErrors;
+extern const CallErrors kExecuteErrors;
+
+// The error of a statement whose execution failed with |sqlstate| and the
+// driver diagnostics |details|, which must be read before the statement
+// is used again.
+SessionError ExecutionError(const CallErrors& errors,
+                            const std::string& sqlstate, std::string details,
+                            bool cancelled);
+
+// Streams the result |statement| has just produced into |sink|, a rowset at
+// a time: binds it (see DescribeResult), then hands every fetched row to
+// |sink| before fetching the next rowset. Records "fetch" spans inside an
+// "encode" span of |options.trace|, and when |metrics| is not null the time
+// spent fetching, the time spent in |sink| and the rows read. Detaches
+// the statement from the request of |options| once done.
+//
+// This is the one fetch loop behind every query reply; the platforms only
+// differ in how they run the statement and which sink encodes the rows.
+// Returns false and fills |error| on failure, having cleared
+// |statement->described|.
+bool FetchResult(PreparedStatement* statement, bool utf8_text,
+                 const StatementOptions& options, Metrics* metrics,
+                 ResultSink* sink, SessionError* error);
+
+// One open connection and its prepared statements: the connect, query and
+// execute path shared by the platform plugins, which only translate their
+// channel values to and from these types.
+//
+// Query() streams the first result set into a ResultSink with FetchResult(),
+// so the adapters encode each reply shape as the rows arrive. Not
+// thread safe; calls on one session must be serialized, which the plugins
+// do by posting them to their WorkerPool keyed by connection id.
+class Session {
+ public:
+  // Connects to the target of |options|. Counts and times the connect in
+  // |metrics| (which may be null), and keeps it as the session's
+  // statistics. Returns nullptr and fills |error| on failure.
+  static std::unique_ptr<Session> Open(const ConnectOptions& options,
+                                       std::shared_ptr<Metrics> metrics,
+                                       SessionError* error);
+
+  // Frees the statements, then disconnects.
+  ~Session();
+
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  SQLHDBC handle() const { return dbc_; }
+  // The normalized connection string; see NormalizeConnectionString.
+  const std::string& target() const { return target_; }
+  bool utf8_text() const { return utf8_text_; }
+  StatementCache* statements() { return statements_.get(); }
+
+  // The session's statistics while they are being collected, else null.
+  Metrics* metrics() const {
+    return Metrics::enabled() ? metrics_.get() : nullptr;
+  }
+
+  // Runs |sql| with |params| and streams its first result set into |sink|;
+  // see FetchResult(). Returns false and fills |error| on failure.
+  bool Query(const std::string& sql, const std::vector<SqlParameter>& params,
+             const StatementOptions& options, ResultSink* sink,
+             SessionError* error);
+
+  // Like the above, reading the result set into |result|.
+  bool Query(const std::string& sql, const std::vector<SqlParameter>& params,
+             const StatementOptions& options, ColumnarResult* result,
+             SessionError* error);
+
+  // Runs the command |sql| with |params| and sets |rows_affected|; see
+  // AffectedRows(). Returns false and fills |error| on failure.
+  bool Execute(const std::string& sql, const std::vector<SqlParameter>& params,
+               const StatementOptions& options, int64_t* rows_affected,
+               SessionError* error);
+
+ private:
+  Session(std::shared_ptr<OdbcEnvironment> environment, SQLHDBC dbc,
+          const ConnectOptions& options, std::string target, bool utf8_text,
+          std::shared_ptr<Metrics> metrics);
+
+  // Prepares, binds and runs |sql|. Returns the statement once it has run,
+  // still attached to the request of |options|, or nullptr after filling
+  // |error| and putting the statement back in the cache.
+  std::unique_ptr<PreparedStatement> Run(
+      const std::string& sql, const std::vector<SqlParameter>& params,
+      const StatementOptions& options, const CallErrors& errors,
+      ParameterBinder* binder, SQLRETURN* ret, SessionError* error);
+
+  std::shared_ptr<OdbcEnvironment> environment_;
+  SQLHDBC dbc_;
+  std::unique_ptr<StatementCache> statements_;
+  const std::string target_;
+  const bool utf8_text_;
+  const std::shared_ptr<Metrics> metrics_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_SESSION_H_
@@ -0,0 +1,79 @@
+#include "statement_cache.h"
+
+#include <sqlucode.h>
+
+#include "odbc_error.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+
+const size_t StatementCache::kDefaultCapacity;
+std::atomic<uint64_t> StatementCache::hits_(0);
+std::atomic<uint64_t> StatementCache::misses_(0);
+std::atomic<uint64_t> StatementCache::evictions_(0);
+
+PreparedStatement::~PreparedStatement() {
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt_);
+}
+
+bool PreparedStatement::SetQueryTimeout(SQLULEN seconds, std::string* error) {
+  if (seconds == query_timeout_) {
+    return true;
+  }
+  if (!SQL_SUCCEEDED(SQLSetStmtAttr(stmt_, SQL_ATTR_QUERY_TIMEOUT,
+                                    (SQLPOINTER)seconds, SQL_IS_UINTEGER))) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt_);
+    return false;
+  }
+  query_timeout_ = seconds;
+  return true;
+}
+
+StatementCache::StatementCache(size_t capacity) : entries_(capacity) {}
+
+std::unique_ptr<PreparedStatement> StatementCache::Take(SQLHDBC dbc,
+                                                        const std::string& sql,
+                                                        std::string* error) {
+  std::unique_ptr<PreparedStatement> statement;
+  if (entries_.Take(sql, &statement)) {
+    ++hits_;
+    return statement;
+  }
+  ++misses_;
+
+  SQLHSTMT stmt = SQL_NULL_HSTMT;
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt))) {
+    *error = "Failed to allocate statement handle: " +
+             GetOdbcDiagnostics(SQL_HANDLE_DBC, dbc);
+    return nullptr;
+  }
+  statement.reset(new PreparedStatement(stmt));
+
+  std::vector<SQLWCHAR> wide = Utf8ToUtf16(sql);
+  if (!SQL_SUCCEEDED(SQLPrepareW(stmt, wide.data(), (SQLINTEGER)wide.size()))) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+    return nullptr;
+  }
+  return statement;
+}
+
+void StatementCache::Return(const std::string& sql,
+                            std::unique_ptr<PreparedStatement> statement) {
+  SQLHSTMT stmt = statement->handle();
+  SQLFreeStmt(stmt, SQL_CLOSE);
+  SQLFreeStmt(stmt, SQL_RESET_PARAMS);
+  if (entries_.capacity() == 0) {
+    return;
+  }
+  evictions_ += entries_.Put(sql, std::move(statement));
+}
+
+StatementCacheStats StatementCache::stats() {
+  StatementCacheStats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.evictions = evictions_;
+  return stats;
+}
+
+}  // namespace mssql_connect
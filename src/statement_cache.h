@@ -0,0 +1,96 @@
+#ifndef MSSQL_CONNECT_STATEMENT_CACHE_H_
+#define MSSQL_CONNECT_STATEMENT_CACHE_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "lru_cache.h"
+
+namespace mssql_connect {
+
+// A statement handle prepared with SQLPrepare, plus the result metadata
+// recorded after its first execution.
+class PreparedStatement {
+ public:
+  explicit PreparedStatement(SQLHSTMT stmt) : stmt_(stmt) {}
+  ~PreparedStatement();
+
+  PreparedStatement(const PreparedStatement&) = delete;
+  PreparedStatement& operator=(const PreparedStatement&) = delete;
+
+  SQLHSTMT handle() const { return stmt_; }
+
+  // Sets SQL_ATTR_QUERY_TIMEOUT to |seconds|, zero for none, unless the
+  // statement already has that timeout. Returns false and fills |error| if
+  // the driver rejects it.
+  bool SetQueryTimeout(SQLULEN seconds, std::string* error);
+
+  // Result columns, valid once |described| is set.
+  bool described = false;
+  std::vector<ColumnDescription> columns;
+
+ private:
+  SQLHSTMT stmt_;
+  SQLULEN query_timeout_ = 0;
+};
+
+struct StatementCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+// Prepared statements of one connection, keyed by SQL text and evicted in
+// least recently used order.
+//
+// A statement is taken out of the cache while it runs and put back
+// afterwards, so an eviction can never free a statement that is in use.
+// Not thread safe; calls for one connection are serialized.
+class StatementCache {
+ public:
+  static const size_t kDefaultCapacity = 32;
+
+  // A capacity of zero disables caching: every Take() prepares a new
+  // statement and Return() frees it.
+  explicit StatementCache(size_t capacity);
+
+  // Takes the cached statement for |sql|, or prepares a new one on |dbc|.
+  // Returns nullptr and fills |error| on failure.
+  std::unique_ptr<PreparedStatement> Take(SQLHDBC dbc, const std::string& sql,
+                                          std::string* error);
+
+  // Closes any open cursor and resets the parameters of |statement|, then
+  // caches it for |sql|, evicting the least recently used statement if full.
+  void Return(const std::string& sql,
+              std::unique_ptr<PreparedStatement> statement);
+
+  // Frees every cached statement.
+  void Clear() { entries_.Clear(); }
+
+  size_t size() const { return entries_.size(); }
+
+  // Totals across every cache in the process.
+  static StatementCacheStats stats();
+
+ private:
+  LruCache<std::string, std::unique_ptr<PreparedStatement>> entries_;
+
+  static std::atomic<uint64_t> hits_;
+  static std::atomic<uint64_t> misses_;
+  static std::atomic<uint64_t> evictions_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_STATEMENT_CACHE_H_
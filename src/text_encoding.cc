@@ -0,0 +1,197 @@
+#include "text_encoding.h"
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MSSQL_CONNECT_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MSSQL_CONNECT_NEON
+#include <arm_neon.h>
+#endif
+
+namespace mssql_connect {
+
+namespace {
+
+const uint32_t kReplacementCharacter = 0xFFFD;
+
+// Units per step of the vectorized ASCII scan.
+#if defined(__AVX2__)
+const size_t kAsciiBlock = 32;
+#elif defined(MSSQL_CONNECT_SSE2) || defined(MSSQL_CONNECT_NEON)
+const size_t kAsciiBlock = 16;
+#else
+const size_t kAsciiBlock = 0;
+#endif
+
+// If the |kAsciiBlock| units at |text| are all ASCII, writes them to |out|
+// as bytes and returns true.
+inline bool CopyAsciiBlock(const SQLWCHAR* text, char* out) {
+#if defined(__AVX2__)
+  __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text));
+  __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + 16));
+  if (!_mm256_testz_si256(_mm256_or_si256(a, b),
+                          _mm256_set1_epi16(static_cast<short>(0xFF80)))) {
+    return false;
+  }
+  // packus interleaves the 128-bit lanes of a and b; put them back in order.
+  __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), bytes);
+  return true;
+#elif defined(MSSQL_CONNECT_SSE2)
+  __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+  __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 8));
+  __m128i high = _mm_and_si128(_mm_or_si128(a, b),
+                               _mm_set1_epi16(static_cast<short>(0xFF80)));
+  if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF) {
+    return false;
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(a, b));
+  return true;
+#elif defined(MSSQL_CONNECT_NEON)
+  uint16x8_t a = vld1q_u16(reinterpret_cast<const uint16_t*>(text));
+  uint16x8_t b = vld1q_u16(reinterpret_cast<const uint16_t*>(text + 8));
+  if (vmaxvq_u16(vorrq_u16(a, b)) >= 0x80) {
+    return false;
+  }
+  vst1q_u8(reinterpret_cast<uint8_t*>(out),
+           vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+  return true;
+#else
+  (void)text;
+  (void)out;
+  return false;
+#endif
+}
+
+inline char* WriteCodePoint(uint32_t code_point, char* out) {
+  if (code_point < 0x80) {
+    *out++ = static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  } else if (code_point < 0x10000) {
+    *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  } else {
+    *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+  return out;
+}
+
+// Converts units [*i, end) one code point at a time. A surrogate pair may
+// read the unit at |end| if it is before |length|.
+inline char* ConvertScalar(const SQLWCHAR* text, size_t* i, size_t end,
+                           size_t length, char* out) {
+  while (*i < end) {
+    uint32_t unit = static_cast<uint16_t>(text[*i]);
+    ++*i;
+    if (unit < 0x80) {
+      *out++ = static_cast<char>(unit);
+      continue;
+    }
+    if (unit >= 0xD800 && unit <= 0xDBFF && *i < length) {
+      uint32_t low = static_cast<uint16_t>(text[*i]);
+      if (low >= 0xDC00 && low <= 0xDFFF) {
+        out = WriteCodePoint(0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00),
+                             out);
+        ++*i;
+        continue;
+      }
+    }
+    if (unit >= 0xD800 && unit <= 0xDFFF) {
+      unit = kReplacementCharacter;
+    }
+    out = WriteCodePoint(unit, out);
+  }
+  return out;
+}
+
+}  // namespace
+
+void AppendUtf16AsUtf8(const SQLWCHAR* text, size_t length, std::string* out) {
+  // Every unit takes at most three bytes (a surrogate pair takes four for
+  // two units), so the output is written in place into a buffer grown once
+  // and trimmed afterwards.
+  size_t start = out->size();
+  out->resize(start + 3 * length);
+  char* begin = &(*out)[0] + start;
+  char* cursor = begin;
+  size_t i = 0;
+  if (kAsciiBlock != 0) {
+    while (i + kAsciiBlock <= length) {
+      if (CopyAsciiBlock(text + i, cursor)) {
+        i += kAsciiBlock;
+        cursor += kAsciiBlock;
+      } else {
+        // Convert this block one unit at a time, then go back to the
+        // vectorized scan.
+        cursor = ConvertScalar(text, &i, i + kAsciiBlock, length, cursor);
+      }
+    }
+  }
+  cursor = ConvertScalar(text, &i, length, length, cursor);
+  out->resize(start + (cursor - begin));
+}
+
+void AppendUtf8AsUtf16(const char* text, size_t length,
+                       std::vector<SQLWCHAR>* out) {
+  out->reserve(out->size() + length);
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+  size_t i = 0;
+  while (i < length) {
+    uint32_t lead = bytes[i];
+    if (lead < 0x80) {
+      out->push_back(static_cast<SQLWCHAR>(lead));
+      ++i;
+      continue;
+    }
+    size_t extra;
+    uint32_t code_point;
+    uint32_t minimum;
+    if ((lead & 0xE0) == 0xC0) {
+      extra = 1;
+      code_point = lead & 0x1F;
+      minimum = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+      extra = 2;
+      code_point = lead & 0x0F;
+      minimum = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+      extra = 3;
+      code_point = lead & 0x07;
+      minimum = 0x10000;
+    } else {
+      out->push_back(static_cast<SQLWCHAR>(kReplacementCharacter));
+      ++i;
+      continue;
+    }
+    size_t consumed = 1;
+    while (consumed <= extra && i + consumed < length &&
+           (bytes[i + consumed] & 0xC0) == 0x80) {
+      code_point = (code_point << 6) | (bytes[i + consumed] & 0x3F);
+      ++consumed;
+    }
+    i += consumed;
+    if (consumed <= extra || code_point < minimum || code_point > 0x10FFFF ||
+        (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+      out->push_back(static_cast<SQLWCHAR>(kReplacementCharacter));
+    } else if (code_point >= 0x10000) {
+      code_point -= 0x10000;
+      out->push_back(static_cast<SQLWCHAR>(0xD800 + (code_point >> 10)));
+      out->push_back(static_cast<SQLWCHAR>(0xDC00 + (code_point & 0x3FF)));
+    } else {
+      out->push_back(static_cast<SQLWCHAR>(code_point));
+    }
+  }
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,43 @@
+#ifndef MSSQL_CONNECT_TEXT_ENCODING_H_
+#define MSSQL_CONNECT_TEXT_ENCODING_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mssql_connect {
+
+// ODBC wide strings are UTF-16 on every platform we support, including
+// Linux where wchar_t is 32-bit but unixODBC's SQLWCHAR is 16-bit.
+static_assert(sizeof(SQLWCHAR) == 2, "SQLWCHAR must be a UTF-16 code unit");
+
+// Appends the UTF-8 encoding of |length| UTF-16 code units to |out|.
+// Unpaired surrogates are replaced with U+FFFD. Runs of ASCII are converted
+// with SSE2, AVX2 or NEON where the target has them.
+void AppendUtf16AsUtf8(const SQLWCHAR* text, size_t length, std::string* out);
+
+inline std::string Utf16ToUtf8(const SQLWCHAR* text, size_t length) {
+  std::string out;
+  AppendUtf16AsUtf8(text, length, &out);
+  return out;
+}
+
+// Appends the UTF-16 encoding of |length| bytes of UTF-8 to |out|. Invalid
+// sequences are replaced with U+FFFD.
+void AppendUtf8AsUtf16(const char* text, size_t length,
+                       std::vector<SQLWCHAR>* out);
+
+inline std::vector<SQLWCHAR> Utf8ToUtf16(const std::string& text) {
+  std::vector<SQLWCHAR> out;
+  AppendUtf8AsUtf16(text.data(), text.size(), &out);
+  return out;
+}
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_TEXT_ENCODING_H_
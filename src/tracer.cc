@@ -0,0 +1,196 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <utility>
+
+namespace mssql_connect {
+
+namespace {
+
+thread_local TraceCall current_call;
+
+// Nanoseconds as the microseconds trace events are timed in.
+void WriteMicros(std::ostream* out, int64_t ns) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3f", ns / 1000.0);
+  *out << buffer;
+}
+
+// Writes |text| as a JSON string.
+void WriteString(std::ostream* out, const char* text) {
+  *out << '"';
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      *out << '\\' << *c;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+      *out << escaped;
+    } else {
+      *out << *c;
+    }
+  }
+  *out << '"';
+}
+
+}  // namespace
+
+constexpr size_t Tracer::kCapacity;
+constexpr size_t TraceSpan::kMaxNameLength;
+std::atomic<bool> Tracer::enabled_{false};
+std::atomic<uint64_t> Tracer::next_call_id_{1};
+
+Tracer::Tracer() : epoch_(Clock::now()), slots_(new Slot[kCapacity]) {}
+
+void Tracer::set_enabled(bool enabled) {
+  if (enabled) {
+    // Allocates the buffer before any call can be traced.
+    Global();
+  }
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+Tracer& Tracer::Global() {
+  static Tracer* global = new Tracer();
+  return *global;
+}
+
+TraceCall Tracer::BeginCall(int connection_id, int request_id) {
+  TraceCall call;
+  call.connection_id = connection_id;
+  call.request_id = request_id;
+  if (enabled()) {
+    call.call_id = next_call_id_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return call;
+}
+
+const TraceCall& Tracer::Current() { return current_call; }
+
+void Tracer::Record(const TraceCall& call, const char* name,
+                    Clock::time_point start, Clock::time_point end,
+                    int64_t rows) {
+  if (!call.traced()) {
+    return;
+  }
+  uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[index % kCapacity];
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  TraceSpan& span = slot.span;
+  size_t length = std::min(std::strlen(name), TraceSpan::kMaxNameLength);
+  std::memcpy(span.name, name, length);
+  span.name[length] = '\0';
+  span.connection_id = call.connection_id;
+  span.request_id = call.request_id;
+  span.call_id = call.call_id;
+  span.start_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch_)
+          .count();
+  span.duration_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  span.rows = rows;
+
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+std::vector<TraceSpan> Tracer::Snapshot() const {
+  uint64_t end = next_.load(std::memory_order_acquire);
+  uint64_t begin = first_.load(std::memory_order_relaxed);
+  if (end - std::min(begin, end) > kCapacity) {
+    begin = end - kCapacity;
+  }
+  std::vector<TraceSpan> spans;
+  spans.reserve(static_cast<size_t>(end - std::min(begin, end)));
+  for (uint64_t index = begin; index < end; ++index) {
+    const Slot& slot = slots_[index % kCapacity];
+    // Skips slots still being written, or already reused by a later span.
+    if (slot.sequence.load(std::memory_order_acquire) != 2 * index + 2) {
+      continue;
+    }
+    TraceSpan span = slot.span;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != 2 * index + 2) {
+      continue;
+    }
+    spans.push_back(span);
+  }
+  return spans;
+}
+
+void Tracer::Clear() {
+  first_.store(next_.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+}
+
+void Tracer::WriteChromeTrace(const std::vector<TraceSpan>& spans,
+                              std::ostream* out) {
+  *out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  auto separate = [&]() {
+    if (!first) {
+      *out << ",\n";
+    }
+    first = false;
+  };
+
+  // Names for the tracks: connection ids as processes (0 for calls made
+  // without one) and calls as their threads.
+  std::set<int> connections;
+  std::set<std::pair<int, uint64_t>> calls;
+  for (const TraceSpan& span : spans) {
+    int pid = span.connection_id < 0 ? 0 : span.connection_id;
+    if (connections.insert(pid).second) {
+      separate();
+      *out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+           << ",\"args\":{\"name\":";
+      std::string name = pid == 0 ? std::string("no connection")
+                                  : "connection " + std::to_string(pid);
+      WriteString(out, name.c_str());
+      *out << "}}";
+    }
+    if (calls.insert(std::make_pair(pid, span.call_id)).second) {
+      separate();
+      *out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+           << ",\"tid\":" << span.call_id << ",\"args\":{\"name\":";
+      std::string name = "call " + std::to_string(span.call_id);
+      if (span.request_id != 0) {
+        name += " (request " + std::to_string(span.request_id) + ")";
+      }
+      WriteString(out, name.c_str());
+      *out << "}}";
+    }
+  }
+
+  for (const TraceSpan& span : spans) {
+    separate();
+    *out << "{\"name\":";
+    WriteString(out, span.name);
+    *out << ",\"cat\":\"mssql_connect\",\"ph\":\"X\",\"ts\":";
+    WriteMicros(out, span.start_ns);
+    *out << ",\"dur\":";
+    WriteMicros(out, span.duration_ns);
+    *out << ",\"pid\":" << (span.connection_id < 0 ? 0 : span.connection_id)
+         << ",\"tid\":" << span.call_id << ",\"args\":{\"requestId\":"
+         << span.request_id;
+    if (span.rows >= 0) {
+      *out << ",\"rows\":" << span.rows;
+    }
+    *out << "}}";
+  }
+  *out << "]}\n";
+}
+
+ScopedTraceCall::ScopedTraceCall(const TraceCall& call)
+    : previous_(current_call) {
+  current_call = call;
+}
+
+ScopedTraceCall::~ScopedTraceCall() { current_call = previous_; }
+
+}  // namespace mssql_connect
@@ -0,0 +1,145 @@
+#ifndef MSSQL_CONNECT_TRACER_H_
+#define MSSQL_CONNECT_TRACER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace mssql_connect {
+
+// The method call spans are recorded for. A zero |call_id| means the call
+// is not traced, and recording its spans does nothing.
+struct TraceCall {
+  int connection_id = -1;
+  int request_id = 0;
+  uint64_t call_id = 0;
+
+  bool traced() const { return call_id != 0; }
+};
+
+// One recorded span. Times are in nanoseconds since the tracer started.
+struct TraceSpan {
+  static constexpr size_t kMaxNameLength = 31;
+
+  char name[kMaxNameLength + 1] = {};
+  int connection_id = -1;
+  int request_id = 0;
+  uint64_t call_id = 0;
+  int64_t start_ns = 0;
+  int64_t duration_ns = 0;
+  // Rows read, for a fetch block; -1 for other spans.
+  int64_t rows = -1;
+};
+
+// Records timed spans of method calls in a fixed ring buffer, for export as
+// Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Tracing is off until set_enabled(true). While it is off BeginCall()
+// returns an untraced call after one relaxed atomic load, and the spans of
+// untraced calls cost a branch. Recording claims a slot with one atomic
+// increment and never locks or allocates; once the buffer is full the
+// oldest spans are overwritten. Each slot is guarded by a sequence number,
+// so Snapshot() skips spans that are being written rather than return torn
+// ones. Thread safe.
+class Tracer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Spans kept; the buffer takes about 5 MB once tracing is first enabled.
+  static constexpr size_t kCapacity = 65536;
+
+  Tracer();
+
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+  static void set_enabled(bool enabled);
+
+  static Tracer& Global();
+
+  // Starts tracing a call on |connection_id| (-1 for none) carrying
+  // |request_id| (0 for none). Untraced while tracing is off.
+  static TraceCall BeginCall(int connection_id, int request_id);
+
+  // The call the current thread is working on; see ScopedTraceCall.
+  static const TraceCall& Current();
+
+  // Records a span of |call| named |name|, which is cut to kMaxNameLength
+  // bytes.
+  void Record(const TraceCall& call, const char* name, Clock::time_point start,
+              Clock::time_point end, int64_t rows = -1);
+
+  // The spans in the buffer, oldest first.
+  std::vector<TraceSpan> Snapshot() const;
+  void Clear();
+
+  // Writes |spans| as a trace-event JSON object. Each connection is a
+  // process and each call a thread of it, so concurrent calls get their own
+  // tracks, with their spans nested by time.
+  static void WriteChromeTrace(const std::vector<TraceSpan>& spans,
+                               std::ostream* out);
+
+ private:
+  struct Slot {
+    // 2n + 1 while span n is written to the slot, 2n + 2 once it is.
+    std::atomic<uint64_t> sequence{0};
+    TraceSpan span;
+  };
+
+  static std::atomic<bool> enabled_;
+  static std::atomic<uint64_t> next_call_id_;
+
+  const Clock::time_point epoch_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<uint64_t> next_{0};
+  // Spans before this index were cleared.
+  std::atomic<uint64_t> first_{0};
+};
+
+// Makes |call| the current thread's call until destroyed.
+class ScopedTraceCall {
+ public:
+  explicit ScopedTraceCall(const TraceCall& call);
+  ~ScopedTraceCall();
+
+  ScopedTraceCall(const ScopedTraceCall&) = delete;
+  ScopedTraceCall& operator=(const ScopedTraceCall&) = delete;
+
+ private:
+  TraceCall previous_;
+};
+
+// Records a span of |call| from construction to destruction. |name| must
+// outlive it. Does nothing for an untraced call.
+class ScopedSpan {
+ public:
+  ScopedSpan(const TraceCall& call, const char* name)
+      : call_(call), name_(name) {
+    if (call_.traced()) {
+      start_ = Tracer::Clock::now();
+    }
+  }
+
+  ~ScopedSpan() {
+    if (call_.traced()) {
+      Tracer::Global().Record(call_, name_, start_, Tracer::Clock::now());
+    }
+  }
+
+  ScopedSpan(const ScopedSpan&) = delete;
+  ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+ private:
+  TraceCall call_;
+  const char* name_;
+  Tracer::Clock::time_point start_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_TRACER_H_
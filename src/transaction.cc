@@ -0,0 +1,238 @@
+#include "transaction.h"
+
+#include <cctype>
+
+#include "odbc_error.h"
+#include "text_encoding.h"
+
+namespace mssql_connect {
+
+namespace {
+
+// From msodbcsql.h: snapshot isolation is set through the driver's own
+// connection attribute.
+constexpr SQLINTEGER kCoptSsTxnIsolation = 1227;
+constexpr SQLUINTEGER kTxnSsSnapshot = 0x20;
+
+SQLUINTEGER IsolationValue(IsolationLevel level) {
+  switch (level) {
+    case IsolationLevel::kReadUncommitted:
+      return SQL_TXN_READ_UNCOMMITTED;
+    case IsolationLevel::kReadCommitted:
+      return SQL_TXN_READ_COMMITTED;
+    case IsolationLevel::kRepeatableRead:
+      return SQL_TXN_REPEATABLE_READ;
+    case IsolationLevel::kSerializable:
+      return SQL_TXN_SERIALIZABLE;
+    case IsolationLevel::kSnapshot:
+      return kTxnSsSnapshot;
+    default:
+      return 0;
+  }
+}
+
+SQLRETURN SetIsolation(SQLHDBC dbc, SQLUINTEGER value) {
+  SQLINTEGER attribute =
+      value == kTxnSsSnapshot ? kCoptSsTxnIsolation : SQL_ATTR_TXN_ISOLATION;
+  return SQLSetConnectAttr(dbc, attribute, (SQLPOINTER)(SQLULEN)value,
+                           SQL_IS_UINTEGER);
+}
+
+SQLRETURN SetAutocommit(SQLHDBC dbc, SQLULEN value) {
+  return SQLSetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)value,
+                           SQL_IS_UINTEGER);
+}
+
+}  // namespace
+
+bool ParseIsolationLevel(const std::string& name, IsolationLevel* level) {
+  static const struct {
+    const char* name;
+    IsolationLevel level;
+  } kLevels[] = {
+      {"", IsolationLevel::kDefault},
+      {"readUncommitted", IsolationLevel::kReadUncommitted},
+      {"readCommitted", IsolationLevel::kReadCommitted},
+      {"repeatableRead", IsolationLevel::kRepeatableRead},
+      {"serializable", IsolationLevel::kSerializable},
+      {"snapshot", IsolationLevel::kSnapshot},
+  };
+  for (const auto& entry : kLevels) {
+    if (name == entry.name) {
+      *level = entry.level;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IsValidSavepointName(const std::string& name) {
+  if (name.empty() || name.size() > 32) {
+    return false;
+  }
+  for (size_t i = 0; i < name.size(); ++i) {
+    unsigned char c = static_cast<unsigned char>(name[i]);
+    bool letter = std::isalpha(c) || c == '_';
+    if (!letter && (i == 0 || !std::isdigit(c))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> Transaction::savepoints() const {
+  std::vector<std::string> names;
+  for (const SavepointEntry& savepoint : savepoints_) {
+    names.push_back(savepoint.name);
+  }
+  return names;
+}
+
+bool Transaction::Begin(IsolationLevel level, std::string* error) {
+  if (active_) {
+    *error = "A transaction is already active on this connection";
+    return false;
+  }
+  restore_isolation_ = false;
+  if (level != IsolationLevel::kDefault) {
+    // Only settable while no transaction is open, so before autocommit goes
+    // off.
+    restore_isolation_ = SQL_SUCCEEDED(
+        SQLGetConnectAttr(dbc_, SQL_ATTR_TXN_ISOLATION, &previous_isolation_,
+                          SQL_IS_UINTEGER, NULL));
+    if (!SQL_SUCCEEDED(SetIsolation(dbc_, IsolationValue(level)))) {
+      *error = GetOdbcDiagnostics(SQL_HANDLE_DBC, dbc_);
+      restore_isolation_ = false;
+      return false;
+    }
+  }
+  if (!SQL_SUCCEEDED(SetAutocommit(dbc_, SQL_AUTOCOMMIT_OFF))) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_DBC, dbc_);
+    if (restore_isolation_) {
+      SetIsolation(dbc_, previous_isolation_);
+      restore_isolation_ = false;
+    }
+    return false;
+  }
+  active_ = true;
+  savepoints_.clear();
+  return true;
+}
+
+bool Transaction::Commit(std::string* error) {
+  return End(SQL_COMMIT, false, error);
+}
+
+bool Transaction::Rollback(std::string* error) {
+  return End(SQL_ROLLBACK, false, error);
+}
+
+bool Transaction::Savepoint(const std::string& name, std::string* error) {
+  if (!active_) {
+    *error = "No transaction is active on this connection";
+    return false;
+  }
+  if (!IsValidSavepointName(name)) {
+    *error = "Invalid savepoint name";
+    return false;
+  }
+  // SAVE TRANSACTION does not start the driver's implicit transaction, so
+  // it is skipped if nothing has started one yet.
+  SQLINTEGER open_transactions = 0;
+  if (!Run("IF @@TRANCOUNT > 0 SAVE TRANSACTION " + name +
+               "; SELECT @@TRANCOUNT",
+           &open_transactions, error)) {
+    return false;
+  }
+  savepoints_.push_back(SavepointEntry{name, open_transactions == 0});
+  return true;
+}
+
+bool Transaction::RollbackTo(const std::string& name, std::string* error) {
+  if (!active_) {
+    *error = "No transaction is active on this connection";
+    return false;
+  }
+  size_t index = savepoints_.size();
+  while (index > 0 && savepoints_[index - 1].name != name) {
+    --index;
+  }
+  if (index == 0) {
+    *error = "Unknown savepoint: " + name;
+    return false;
+  }
+  const SavepointEntry& savepoint = savepoints_[index - 1];
+  bool ok = savepoint.at_start
+                ? End(SQL_ROLLBACK, true, error)
+                : Run("ROLLBACK TRANSACTION " + name, nullptr, error);
+  if (ok) {
+    savepoints_.resize(index);
+  }
+  return ok;
+}
+
+bool Transaction::Abandon() {
+  if (!active_) {
+    return true;
+  }
+  std::string error;
+  return End(SQL_ROLLBACK, false, &error);
+}
+
+bool Transaction::End(SQLSMALLINT completion, bool keep_open,
+                      std::string* error) {
+  if (!active_) {
+    *error = "No transaction is active on this connection";
+    return false;
+  }
+  if (!SQL_SUCCEEDED(SQLEndTran(SQL_HANDLE_DBC, dbc_, completion))) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_DBC, dbc_);
+    return false;
+  }
+  if (keep_open) {
+    return true;
+  }
+  active_ = false;
+  savepoints_.clear();
+  bool ok = SQL_SUCCEEDED(SetAutocommit(dbc_, SQL_AUTOCOMMIT_ON));
+  if (!ok) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_DBC, dbc_);
+  }
+  if (restore_isolation_) {
+    SetIsolation(dbc_, previous_isolation_);
+    restore_isolation_ = false;
+  }
+  return ok;
+}
+
+bool Transaction::Run(const std::string& sql, SQLINTEGER* count,
+                      std::string* error) {
+  SQLHSTMT stmt = SQL_NULL_HSTMT;
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc_, &stmt))) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_DBC, dbc_);
+    return false;
+  }
+  std::vector<SQLWCHAR> text = Utf8ToUtf16(sql);
+  SQLRETURN ret = SQLExecDirectW(stmt, text.data(), (SQLINTEGER)text.size());
+  bool ok = SQL_SUCCEEDED(ret) || ret == SQL_NO_DATA;
+  if (ok && count) {
+    // Skip to the batch's result set.
+    SQLSMALLINT columns = 0;
+    while (SQL_SUCCEEDED(SQLNumResultCols(stmt, &columns)) && columns == 0 &&
+           SQL_SUCCEEDED(SQLMoreResults(stmt))) {
+    }
+    SQLLEN indicator = 0;
+    if (columns > 0 && SQL_SUCCEEDED(SQLFetch(stmt)) &&
+        SQL_SUCCEEDED(SQLGetData(stmt, 1, SQL_C_SLONG, count, 0, &indicator)) &&
+        indicator == SQL_NULL_DATA) {
+      *count = 0;
+    }
+  }
+  if (!ok) {
+    *error = GetOdbcDiagnostics(SQL_HANDLE_STMT, stmt);
+  }
+  SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+  return ok;
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,104 @@
+#ifndef MSSQL_CONNECT_TRANSACTION_H_
+#define MSSQL_CONNECT_TRANSACTION_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqlext.h>
+
+#include <string>
+#include <vector>
+
+namespace mssql_connect {
+
+enum class IsolationLevel {
+  // Whatever the connection already uses.
+  kDefault,
+  kReadUncommitted,
+  kReadCommitted,
+  kRepeatableRead,
+  kSerializable,
+  // SQL Server snapshot isolation; the database must allow it.
+  kSnapshot,
+};
+
+// Parses the isolation level names the Dart API sends: "readUncommitted",
+// "readCommitted", "repeatableRead", "serializable" or "snapshot". An empty
+// name is kDefault. Returns false for anything else.
+bool ParseIsolationLevel(const std::string& name, IsolationLevel* level);
+
+// Whether |name| can name a savepoint: a regular identifier of at most 32
+// characters, which is as long as SQL Server keeps them. Savepoint names are
+// spliced into T-SQL, so nothing else is accepted.
+bool IsValidSavepointName(const std::string& name);
+
+// An explicit transaction on one connection.
+//
+// Begin() sets the isolation level and turns SQL_ATTR_AUTOCOMMIT off, so
+// that every statement until Commit() or Rollback() runs in one transaction
+// and the server flushes its log once for all of them. Commit() and
+// Rollback() end it with SQLEndTran, then turn autocommit back on and
+// restore the connection's previous isolation level.
+//
+// ODBC has no savepoints, so Savepoint() and RollbackTo() use T-SQL SAVE
+// TRANSACTION and ROLLBACK TRANSACTION. The driver only starts the
+// transaction with the first statement that needs one; a savepoint taken
+// before that marks the start of the transaction, and rolling back to it
+// rolls back everything while keeping the transaction open.
+//
+// Not thread safe; the plugin serializes a connection's calls.
+class Transaction {
+ public:
+  explicit Transaction(SQLHDBC dbc) : dbc_(dbc) {}
+
+  Transaction(const Transaction&) = delete;
+  Transaction& operator=(const Transaction&) = delete;
+
+  bool active() const { return active_; }
+
+  // Names of the savepoints that can still be rolled back to, oldest first.
+  std::vector<std::string> savepoints() const;
+
+  // Each returns false and fills |error| on failure. A failed Commit()
+  // leaves the transaction open so that it can be rolled back.
+  bool Begin(IsolationLevel level, std::string* error);
+  bool Commit(std::string* error);
+  bool Rollback(std::string* error);
+  bool Savepoint(const std::string& name, std::string* error);
+  // Undoes everything since the last savepoint called |name| and forgets
+  // the savepoints taken after it. The transaction stays open.
+  bool RollbackTo(const std::string& name, std::string* error);
+
+  // Rolls back a transaction that is still open, e.g. before its connection
+  // goes back to a pool or is closed. Returns false if that failed, in
+  // which case the connection should not be reused.
+  bool Abandon();
+
+ private:
+  struct SavepointEntry {
+    std::string name;
+    // Taken before the transaction had started on the server.
+    bool at_start;
+  };
+
+  // Ends the transaction with |completion| and restores autocommit unless
+  // |keep_open| is set.
+  bool End(SQLSMALLINT completion, bool keep_open, std::string* error);
+
+  // Runs |sql| on a temporary statement. Fills |count| with the first
+  // column of its first row if it is non-null.
+  bool Run(const std::string& sql, SQLINTEGER* count, std::string* error);
+
+  SQLHDBC dbc_;
+  bool active_ = false;
+  // The isolation level to restore once the transaction ends, if Begin()
+  // changed it.
+  bool restore_isolation_ = false;
+  SQLUINTEGER previous_isolation_ = 0;
+  std::vector<SavepointEntry> savepoints_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_TRANSACTION_H_
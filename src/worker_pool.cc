@@ -0,0 +1,129 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace mssql_connect {
+
+WorkerPool::WorkerPool(size_t thread_count) {
+  thread_count = std::max<size_t>(1, thread_count);
+  threads_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+WorkerPool::~WorkerPool() { Stop(); }
+
+void WorkerPool::Stop() {
+  std::deque<Job> dropped;
+  std::unordered_map<int64_t, Strand> dropped_strands;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    dropped.swap(ready_);
+    dropped_strands.swap(strands_);
+  }
+  ready_cv_.notify_all();
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  // |dropped| and |dropped_strands| are destroyed here, outside the lock, so
+  // that anything the tasks own (e.g. pending method results) is released
+  // without holding |mutex_|.
+}
+
+void WorkerPool::Post(Task task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    ready_.push_back(Job{false, 0, std::move(task), false});
+  }
+  ready_cv_.notify_one();
+}
+
+void WorkerPool::Post(int64_t key, Task task) {
+  PostKeyed(Job{true, key, std::move(task), false});
+}
+
+void WorkerPool::PostAsync(int64_t key, AsyncTask task) {
+  PostKeyed(Job{true, key,
+                [this, key, task]() {
+                  task([this, key]() {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    AdvanceLocked(key);
+                  });
+                },
+                true});
+}
+
+void WorkerPool::PostKeyed(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    auto it = strands_.find(job.key);
+    if (it != strands_.end()) {
+      // A task for this key is already queued or running; it re-queues the
+      // next one when it finishes.
+      it->second.pending.push_back(std::move(job));
+      return;
+    }
+    strands_.emplace(job.key, Strand());
+    ready_.push_back(std::move(job));
+  }
+  ready_cv_.notify_one();
+}
+
+size_t WorkerPool::DefaultThreadCount() {
+  size_t hardware = std::thread::hardware_concurrency();
+  return std::min<size_t>(8, std::max<size_t>(2, hardware));
+}
+
+void WorkerPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_cv_.wait(lock, [this]() { return stopping_ || !ready_.empty(); });
+    if (stopping_) {
+      return;
+    }
+
+    Job job = std::move(ready_.front());
+    ready_.pop_front();
+
+    lock.unlock();
+    job.task();
+    job.task = nullptr;
+    lock.lock();
+
+    if (job.keyed && !job.held) {
+      AdvanceLocked(job.key);
+    }
+  }
+}
+
+void WorkerPool::AdvanceLocked(int64_t key) {
+  if (stopping_) {
+    return;
+  }
+  auto it = strands_.find(key);
+  if (it == strands_.end()) {
+    return;
+  }
+  if (it->second.pending.empty()) {
+    strands_.erase(it);
+    return;
+  }
+  // Hand the next task for this key to the back of the ready queue rather
+  // than running it inline, so one busy connection cannot starve others.
+  ready_.push_back(std::move(it->second.pending.front()));
+  it->second.pending.pop_front();
+  ready_cv_.notify_one();
+}
+
+}  // namespace mssql_connect
@@ -0,0 +1,93 @@
+#ifndef MSSQL_CONNECT_WORKER_POOL_H_
+#define MSSQL_CONNECT_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mssql_connect {
+
+// A fixed-size pool of worker threads that runs blocking ODBC work off the
+// platform thread.
+//
+// Tasks posted with a key are serialized: at most one task per key runs at a
+// time, in the order they were posted. Tasks with different keys (and unkeyed
+// tasks) run in parallel on whichever worker is free. The plugin uses the
+// connection id as the key, so a connection's calls never overlap while calls
+// on different connections do.
+class WorkerPool {
+ public:
+  using Task = std::function<void()>;
+
+  // A keyed task that finishes asynchronously: it receives a |release|
+  // callback and its key stays busy until that is called, from any thread.
+  using AsyncTask = std::function<void(Task release)>;
+
+  explicit WorkerPool(size_t thread_count);
+
+  // Stops the pool; see Stop().
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Runs |task| on any free worker.
+  void Post(Task task);
+
+  // Runs |task| after every task previously posted with |key| has finished.
+  void Post(int64_t key, Task task);
+
+  // Runs |task| like Post(key, task) but holds back the next task for |key|
+  // until |task| calls its release callback, which it must do exactly once
+  // and before the pool is destroyed.
+  void PostAsync(int64_t key, AsyncTask task);
+
+  // Stops accepting work, discards queued tasks that have not started and
+  // joins the workers once their current task returns. Later posts are
+  // ignored, so the pool can be stopped before the things that post to it
+  // are torn down.
+  void Stop();
+
+  size_t thread_count() const { return threads_.size(); }
+
+  // A reasonable default size for the plugin's pool.
+  static size_t DefaultThreadCount();
+
+ private:
+  struct Job {
+    bool keyed;
+    int64_t key;
+    Task task;
+    // The task releases its key itself.
+    bool held;
+  };
+
+  // Tasks waiting behind the one currently queued or running for a key.
+  struct Strand {
+    std::deque<Job> pending;
+  };
+
+  void PostKeyed(Job job);
+  void WorkerLoop();
+
+  // Queues the next task for |key|, or forgets the key if there is none.
+  // Requires |mutex_|.
+  void AdvanceLocked(int64_t key);
+
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  std::deque<Job> ready_;
+  std::unordered_map<int64_t, Strand> strands_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace mssql_connect
+
+#endif  // MSSQL_CONNECT_WORKER_POOL_H_
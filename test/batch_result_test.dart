@@ -0,0 +1,42 @@
+import 'dart:typed_data';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+void main() {
+  test('decodes per-row statuses', () {
+    final result = BatchResult.fromJson({
+      'rowsAffected': 3,
+      'statuses': Int32List.fromList([0, 1, 2, 0]),
+    });
+
+    expect(result.rowsAffected, 3);
+    expect(result.statuses, [
+      BatchRowStatus.success,
+      BatchRowStatus.successWithInfo,
+      BatchRowStatus.error,
+      BatchRowStatus.success,
+    ]);
+    expect(result.failedRows, [2]);
+    expect(result.succeeded, isFalse);
+    expect(result.error, isNull);
+  });
+
+  test('reports a failed batch', () {
+    final result = BatchResult.fromJson({
+      'rowsAffected': 2,
+      'statuses': Int32List.fromList([0, 0, 2, 2, 3]),
+      'error': 'deadlock',
+    });
+
+    expect(result.failedRows, [2, 3, 4]);
+    expect(result.succeeded, isFalse);
+    expect(result.error, 'deadlock');
+  });
+
+  test('an empty batch succeeds', () {
+    final result = BatchResult.fromJson({'rowsAffected': 0, 'statuses': Int32List(0)});
+    expect(result.succeeded, isTrue);
+    expect(result.statuses, isEmpty);
+  });
+}
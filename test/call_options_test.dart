@@ -0,0 +1,108 @@
+import 'dart:async';
+
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  const MethodChannel channel = MethodChannel('mssql_connect');
+  final calls = <MethodCall>[];
+  // Completes the running query with the error a cancelled statement gets.
+  Completer<void>? running;
+
+  setUp(() {
+    calls.clear();
+    running = null;
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      channel,
+      (MethodCall call) async {
+        calls.add(call);
+        switch (call.method) {
+          case 'connect':
+            return {'success': true, 'connectionId': 1};
+          case 'query':
+            final args = call.arguments as Map;
+            if (args['sql'] == 'slow') {
+              running = Completer<void>();
+              await running!.future;
+              throw PlatformException(code: 'Cancelled', details: 'HY008');
+            }
+            if (args['sql'] == 'late') {
+              throw PlatformException(code: 'Timeout', details: 'HYT00');
+            }
+            return {'rowCount': 0, 'columns': [], 'rows': []};
+          case 'cancel':
+            running?.complete();
+            return true;
+        }
+        return null;
+      },
+    );
+  });
+
+  tearDown(() {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(channel, null);
+  });
+
+  Future<MsSqlConnection> connect() async {
+    final connection = MsSqlConnection(server: 'host', database: 'db');
+    await connection.connect();
+    return connection;
+  }
+
+  test('sends the login timeout with connect', () async {
+    await connect();
+
+    expect((calls.single.arguments as Map)['loginTimeoutMs'], 15000);
+  });
+
+  test('sends a timeout and maps timeouts to QueryTimeoutException', () async {
+    final connection = await connect();
+
+    await connection.query('fast', [], const CallOptions(timeout: Duration(seconds: 2)));
+    final args = calls.last.arguments as Map;
+    expect(args['timeoutMs'], 2000);
+    expect(args.containsKey('requestId'), isFalse);
+
+    await expectLater(connection.query('late'), throwsA(isA<QueryTimeoutException>()));
+  });
+
+  test('sends the cache ttl only when one is set', () async {
+    final connection = await connect();
+
+    await connection.query('fast');
+    expect((calls.last.arguments as Map).containsKey('cacheTtlMs'), isFalse);
+
+    await connection.query('fast', [], const CallOptions(cacheTtl: Duration(seconds: 30)));
+    expect((calls.last.arguments as Map)['cacheTtlMs'], 30000);
+  });
+
+  test('cancels a running query by its request id', () async {
+    final connection = await connect();
+    final token = CancelToken();
+
+    final query = connection.query('slow', [], CallOptions(cancelToken: token));
+    await pumpEventQueue();
+    final requestId = (calls.last.arguments as Map)['requestId'];
+    expect(requestId, isA<int>());
+
+    await token.cancel();
+    expect(calls.last.method, 'cancel');
+    expect((calls.last.arguments as Map)['requestId'], requestId);
+    await expectLater(query, throwsA(isA<QueryCancelledException>()));
+  });
+
+  test('fails calls made with a cancelled token without sending them', () async {
+    final connection = await connect();
+    final token = CancelToken();
+    await token.cancel();
+
+    await expectLater(
+      connection.query('fast', [], CallOptions(cancelToken: token)),
+      throwsA(isA<QueryCancelledException>()),
+    );
+    expect(calls.where((call) => call.method == 'query'), isEmpty);
+  });
+}
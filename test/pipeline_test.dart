@@ -0,0 +1,91 @@
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  const MethodChannel channel = MethodChannel('mssql_connect');
+  final calls = <MethodCall>[];
+
+  setUp(() {
+    calls.clear();
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      channel,
+      (MethodCall call) async {
+        calls.add(call);
+        switch (call.method) {
+          case 'connect':
+            return {'success': true, 'connectionId': 1};
+          case 'pipeline':
+            final operations = (call.arguments as Map)['operations'] as List;
+            if ((operations.last as Map)['sql'] == 'bad') {
+              return {
+                'results': [
+                  {'rowsAffected': 2},
+                ],
+                'failedIndex': 1,
+                'errorCode': 'QueryError',
+                'error': 'Invalid object name',
+              };
+            }
+            return {
+              'results': [
+                {
+                  'rowCount': 1,
+                  'columns': ['id'],
+                  'rows': [
+                    {'id': 7},
+                  ],
+                },
+                {'rowsAffected': 3},
+              ],
+            };
+        }
+        return null;
+      },
+    );
+  });
+
+  tearDown(() {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(channel, null);
+  });
+
+  Future<MsSqlConnection> connect() async {
+    final connection = MsSqlConnection(server: 'host', database: 'db');
+    await connection.connect();
+    return connection;
+  }
+
+  test('sends every operation in one call', () async {
+    final connection = await connect();
+
+    final results = await connection.pipeline([
+      const PipelineOp.query('SELECT id FROM t WHERE id = ?', [7]),
+      const PipelineOp.execute('UPDATE t SET x = 1'),
+    ]);
+
+    expect(calls.where((call) => call.method == 'pipeline').length, 1);
+    expect((calls.last.arguments as Map)['operations'], [
+      {'op': 'query', 'sql': 'SELECT id FROM t WHERE id = ?', 'parameters': [7]},
+      {'op': 'execute', 'sql': 'UPDATE t SET x = 1', 'parameters': []},
+    ]);
+    expect(results[0].rows.single['id'], 7);
+    expect(results[1].rowsAffected, 3);
+  });
+
+  test('reports the failed operation with the results before it', () async {
+    final connection = await connect();
+
+    await expectLater(
+      connection.pipeline([
+        const PipelineOp.execute('DELETE FROM t'),
+        const PipelineOp.query('bad'),
+      ]),
+      throwsA(isA<PipelineException>()
+          .having((e) => e.index, 'index', 1)
+          .having((e) => e.completed.single.rowsAffected, 'completed', 2)
+          .having((e) => e.details, 'details', 'Invalid object name')),
+    );
+  });
+}
@@ -0,0 +1,61 @@
+import 'dart:typed_data';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+void main() {
+  test('decodes every part of a procedure result', () {
+    final result = ProcedureResult.fromJson({
+      'returnValue': 7,
+      'resultSets': [
+        {
+          'rowCount': 1,
+          'columns': ['id'],
+          'rows': [
+            {'id': 1},
+          ],
+        },
+        {
+          'format': 'columnar',
+          'rowCount': 2,
+          'columns': ['total'],
+          'columnTypes': ['int'],
+          'columnData': [
+            Int64List.fromList([10, 20]),
+          ],
+          'nulls': [null],
+        },
+      ],
+      'rowCounts': [3],
+      'outputParameters': {'total': 30, 'label': 'ok'},
+    });
+
+    expect(result.returnValue, 7);
+    expect(result.resultSets.length, 2);
+    expect(result.firstResultSet!.rows[0]['id'], 1);
+    expect(result.resultSets[1].column('total').ints, [10, 20]);
+    expect(result.rowCounts, [3]);
+    expect(result.outputParameters, {'total': 30, 'label': 'ok'});
+  });
+
+  test('an empty procedure result has no result sets', () {
+    final result = ProcedureResult.fromJson({'returnValue': 0});
+    expect(result.firstResultSet, isNull);
+    expect(result.outputParameters, isEmpty);
+  });
+
+  test('encodes output parameters', () {
+    expect(const OutputParameter(ColumnType.integer).toJson('count'), {
+      'name': 'count',
+      'direction': 'out',
+      'type': 'int',
+      'value': null,
+      'size': 4000,
+    });
+    expect(
+      const OutputParameter(ColumnType.string, value: 'a', size: 50)
+          .toJson('label')['direction'],
+      'inout',
+    );
+  });
+}
@@ -0,0 +1,247 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+void main() {
+  test('decodes a columnar result', () {
+    final result = QueryResult.fromJson({
+      'format': 'columnar',
+      'rowCount': 3,
+      'columns': ['id', 'score', 'active', 'name'],
+      'columnTypes': ['int', 'double', 'bool', 'string'],
+      'columnData': [
+        Int64List.fromList([1, 2, 3]),
+        Float64List.fromList([0.5, 0, 2.5]),
+        Uint8List.fromList([1, 0, 1]),
+        ['a', '', 'c'],
+      ],
+      'nulls': [
+        null,
+        Uint8List.fromList([0x02]),
+        null,
+        Uint8List.fromList([0x02]),
+      ],
+    });
+
+    expect(result.isColumnar, isTrue);
+    expect(result.column('id').ints, [1, 2, 3]);
+    expect(result.column('score')[1], isNull);
+    expect(result.column('active')[0], isTrue);
+    expect(result.rows.length, 3);
+    expect(result.rows[0], {'id': 1, 'score': 0.5, 'active': true, 'name': 'a'});
+    expect(result.rows[1]['name'], isNull);
+    expect(result.rows[2]['name'], 'c');
+  });
+
+  test('decodes a binary column', () {
+    final result = QueryResult.fromJson({
+      'format': 'columnar',
+      'rowCount': 2,
+      'columns': ['payload'],
+      'columnTypes': ['binary'],
+      'columnData': [
+        [Uint8List.fromList([1, 2, 3]), Uint8List(0)],
+      ],
+      'nulls': [
+        Uint8List.fromList([0x02]),
+      ],
+    });
+
+    expect(result.column('payload').type, ColumnType.binary);
+    expect(result.column('payload').binaries[0], [1, 2, 3]);
+    expect(result.rows[0]['payload'], isA<Uint8List>());
+    expect(result.rows[1]['payload'], isNull);
+  });
+
+  test('decodes typed columns', () {
+    final result = QueryResult.fromJson({
+      'format': 'columnar',
+      'rowCount': 2,
+      'columns': ['price', 'big', 'at', 'during', 'id'],
+      'columnTypes': ['decimal', 'decimal', 'datetime', 'time', 'guid'],
+      'columnData': [
+        Int64List.fromList([-123400, 12]),
+        ['12345678901234567890.1234', ''],
+        Int64List.fromList([1704067200000001, 0]),
+        Int64List.fromList([3723000000, 0]),
+        [
+          Uint8List.fromList(
+              [for (var i = 0; i < 16; i++) i * 16 + 15 - i]),
+          Uint8List(0),
+        ],
+      ],
+      'nulls': [
+        null,
+        Uint8List.fromList([0x02]),
+        null,
+        null,
+        Uint8List.fromList([0x02]),
+      ],
+      'scales': [4, 4, 0, 0, 0],
+    });
+
+    final first = result.rows[0];
+    expect(first['price'], '-12.3400');
+    expect(result.rows[1]['price'], '0.0012');
+    expect(first['big'], '12345678901234567890.1234');
+    expect(result.rows[1]['big'], isNull);
+    expect(first['at'], DateTime.utc(2024, 1, 1, 0, 0, 0, 0, 1));
+    expect(first['during'], const Duration(hours: 1, minutes: 2, seconds: 3));
+    expect(first['id'], '0F1E2D3C-4B5A-6978-8796-A5B4C3D2E1F0');
+    expect(result.rows[1]['id'], isNull);
+  });
+
+  test('decodes typed cells of the row shape', () {
+    final result = QueryResult.fromJson({
+      'rowCount': 1,
+      'columns': ['price', 'at', 'id'],
+      'columnTypes': ['decimal', 'datetime', 'guid'],
+      'rows': [
+        {
+          'price': '-0.50',
+          'at': 0,
+          'id': Uint8List(16),
+        },
+      ],
+    });
+
+    final row = result.rows.single;
+    expect(row['price'], '-0.50');
+    expect(row['at'], DateTime.utc(1970));
+    expect(row['id'], '00000000-0000-0000-0000-000000000000');
+  });
+
+  test('decodes a binary result message', () {
+    final message = _binaryMessage(3, [
+      _BinaryColumn('id', 1, Int64List.fromList([1, 2, 3]).buffer.asUint8List()),
+      _BinaryColumn('score', 2,
+          Float64List.fromList([0.5, 0, 2.5]).buffer.asUint8List(),
+          nulls: 0x02),
+      _BinaryColumn('price', 3, Int64List.fromList([-50, 0, 1234]).buffer.asUint8List(),
+          scale: 2),
+      _BinaryColumn.text('name', ['a', '', 'ünï']),
+    ]);
+
+    for (final shift in [0, 4]) {
+      // A message that does not start 8-byte aligned in its buffer.
+      final buffer = Uint8List(message.length + shift)..setAll(shift, message);
+      final result = QueryResult.fromBinary(buffer.buffer.asByteData(shift));
+
+      expect(result.isColumnar, isTrue);
+      expect(result.rowCount, 3);
+      expect(result.columnNames, ['id', 'score', 'price', 'name']);
+      expect(result.column('id').ints, [1, 2, 3]);
+      expect(result.column('score')[1], isNull);
+      expect(result.column('score')[2], 2.5);
+      expect(result.column('price')[0], '-0.50');
+      expect(result.column('name').strings, ['a', '', 'ünï']);
+      expect(result.rows[0], {'id': 1, 'score': 0.5, 'price': '-0.50', 'name': 'a'});
+    }
+  });
+
+  test('rejects a message that is not a binary result', () {
+    expect(() => QueryResult.fromBinary(ByteData(16)), throwsFormatException);
+  });
+
+  test('recognizes LOB references', () {
+    final lob = LobRef.fromCell({'lobToken': 7}, 1, 2);
+    expect(lob?.token, 7);
+    expect(lob?.cursorId, 2);
+    expect(LobRef.fromCell('text', 1, 2), isNull);
+
+    final chunk = LobChunk.fromJson({'data': 'abc', 'units': 3, 'end': true});
+    expect(chunk.text, 'abc');
+    expect(chunk.isEnd, isTrue);
+  });
+
+  test('decodes the row shape', () {
+    final result = QueryResult.fromJson({
+      'rowCount': 1,
+      'columns': ['id'],
+      'rows': [
+        {'id': 7},
+      ],
+    });
+
+    expect(result.isColumnar, isFalse);
+    expect(result.rows.single['id'], 7);
+    expect(() => result.columns, throwsStateError);
+    expect(result.isRowCount, isFalse);
+  });
+
+  test('decodes a row count entry', () {
+    final result = QueryResult.fromJson({'rowsAffected': 4});
+
+    expect(result.isRowCount, isTrue);
+    expect(result.rowsAffected, 4);
+    expect(result.rows, isEmpty);
+    expect(result.columnNames, isEmpty);
+  });
+}
+
+class _BinaryColumn {
+  final String name;
+  final int type;
+  final Uint8List? fixed;
+  final List<String>? text;
+  final int scale;
+  final int? nulls;
+
+  _BinaryColumn(this.name, this.type, Uint8List this.fixed,
+      {this.scale = 0, this.nulls})
+      : text = null;
+
+  _BinaryColumn.text(this.name, List<String> this.text)
+      : type = 7,
+        fixed = null,
+        scale = 0,
+        nulls = null;
+}
+
+/// A message in the layout of `src/binary_result.h`.
+Uint8List _binaryMessage(int rows, List<_BinaryColumn> columns) {
+  final out = BytesBuilder();
+  void u32(int value) =>
+      out.add((ByteData(4)..setUint32(0, value, Endian.little)).buffer.asUint8List());
+  void pad() => out.add(Uint8List((8 - out.length % 8) % 8));
+
+  out.add('MSR1'.codeUnits);
+  u32(rows);
+  u32(columns.length);
+  u32(0);
+  for (final column in columns) {
+    final name = utf8.encode(column.name);
+    out.add([
+      column.type,
+      (column.nulls != null ? 1 : 0) | (column.text != null ? 2 : 0),
+    ]);
+    out.add((ByteData(2)..setInt16(0, column.scale, Endian.little))
+        .buffer
+        .asUint8List());
+    u32(name.length);
+    out.add(name);
+    pad();
+  }
+  for (final column in columns) {
+    if (column.nulls != null) {
+      out.add([column.nulls!]);
+      pad();
+    }
+    if (column.text != null) {
+      final heap = BytesBuilder();
+      u32(0);
+      for (final value in column.text!) {
+        heap.add(utf8.encode(value));
+        u32(heap.length);
+      }
+      pad();
+      out.add(heap.takeBytes());
+    } else {
+      out.add(column.fixed!);
+    }
+    pad();
+  }
+  return out.takeBytes();
+}
@@ -0,0 +1,75 @@
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  const MethodChannel channel = MethodChannel('mssql_connect');
+  final calls = <MethodCall>[];
+
+  Map<String, Object> metrics(int queries) => {
+        'calls': {'connect': 1, 'query': queries, 'execute': 0},
+        'errors': {'connect': 0, 'query': 1, 'execute': 0},
+        'rows': 12,
+        'bytes': 4096,
+        'phases': {
+          'fetch': {
+            'count': queries,
+            'totalNs': 9000000,
+            'maxNs': 5000000,
+            'p50Ns': 2000000,
+            'p90Ns': 4000000,
+            'p99Ns': 5000000,
+            'p999Ns': 5000000,
+          },
+        },
+      };
+
+  setUp(() {
+    calls.clear();
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      channel,
+      (MethodCall call) async {
+        calls.add(call);
+        switch (call.method) {
+          case 'configureStats':
+            return true;
+          case 'getStats':
+            return {
+              'enabled': true,
+              'global': metrics(4),
+              'connections': {3: metrics(3)},
+            };
+        }
+        return null;
+      },
+    );
+  });
+
+  tearDown(() {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(channel, null);
+  });
+
+  test('configureStats sends the switch', () async {
+    await MsSqlConnection.configureStats(enabled: true);
+    expect(calls.single.method, 'configureStats');
+    expect(calls.single.arguments, {'enabled': true});
+  });
+
+  test('stats decodes global and per-connection counters', () async {
+    final report = await MsSqlConnection.stats(reset: true);
+
+    expect((calls.single.arguments as Map)['reset'], true);
+    expect(report.enabled, isTrue);
+    expect(report.global.calls['query'], 4);
+    expect(report.global.errors['query'], 1);
+    expect(report.global.rows, 12);
+    expect(report.global.bytes, 4096);
+    final fetch = report.connections[3]!.phases['fetch']!;
+    expect(fetch.count, 3);
+    expect(fetch.p50, const Duration(milliseconds: 2));
+    expect(fetch.p99, const Duration(milliseconds: 5));
+    expect(fetch.mean, const Duration(milliseconds: 3));
+  });
+}
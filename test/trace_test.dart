@@ -0,0 +1,53 @@
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  const MethodChannel channel = MethodChannel('mssql_connect');
+  final calls = <MethodCall>[];
+
+  setUp(() {
+    calls.clear();
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      channel,
+      (MethodCall call) async {
+        calls.add(call);
+        switch (call.method) {
+          case 'configureTrace':
+            return true;
+          case 'dumpTrace':
+            if ((call.arguments as Map)['path'] == '/readonly/trace.json') {
+              throw PlatformException(code: 'TraceError', message: 'Failed to write trace');
+            }
+            return 128;
+        }
+        return null;
+      },
+    );
+  });
+
+  tearDown(() {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(channel, null);
+  });
+
+  test('configureTrace sends the switch', () async {
+    await MsSqlConnection.configureTrace(enabled: true, clear: true);
+    expect(calls.single.method, 'configureTrace');
+    expect(calls.single.arguments, {'enabled': true, 'clear': true});
+  });
+
+  test('dumpTrace returns the spans written', () async {
+    final count = await MsSqlConnection.dumpTrace('/tmp/trace.json');
+    expect(count, 128);
+    expect(calls.single.arguments, {'path': '/tmp/trace.json', 'clear': false});
+  });
+
+  test('dumpTrace reports a file that cannot be written', () async {
+    await expectLater(
+      MsSqlConnection.dumpTrace('/readonly/trace.json'),
+      throwsA(isA<PlatformException>().having((e) => e.code, 'code', 'TraceError')),
+    );
+  });
+}
@@ -0,0 +1,110 @@
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:mssql_connect/mssql_connect.dart';
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  const MethodChannel channel = MethodChannel('mssql_connect');
+  final calls = <MethodCall>[];
+  // Transaction calls the mock fails.
+  final failing = <String>{};
+
+  setUp(() {
+    calls.clear();
+    failing.clear();
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      channel,
+      (MethodCall call) async {
+        calls.add(call);
+        if (failing.contains(call.method)) {
+          throw PlatformException(code: 'TransactionError', details: '${call.method} failed');
+        }
+        switch (call.method) {
+          case 'connect':
+            return {'success': true, 'connectionId': 1};
+          case 'rollbackTo':
+            throw PlatformException(
+              code: 'TransactionError',
+              message: 'Transaction call failed',
+              details: 'Unknown savepoint: missing',
+            );
+          case 'execute':
+            if ((call.arguments as Map)['sql'] == 'bad') {
+              throw PlatformException(code: 'QueryError');
+            }
+            return 1;
+        }
+        return true;
+      },
+    );
+  });
+
+  tearDown(() {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(channel, null);
+  });
+
+  Future<MsSqlConnection> connect() async {
+    final connection = MsSqlConnection(server: 'host', database: 'db');
+    await connection.connect();
+    calls.clear();
+    return connection;
+  }
+
+  test('sends transaction calls for the connection', () async {
+    final connection = await connect();
+
+    await connection.beginTransaction(IsolationLevel.snapshot);
+    await connection.savepoint('s1');
+    await connection.commit();
+
+    expect(calls.map((call) => call.method), ['beginTransaction', 'savepoint', 'commit']);
+    expect(calls[0].arguments, {'connectionId': 1, 'isolationLevel': 'snapshot'});
+    expect(calls[1].arguments, {'connectionId': 1, 'name': 's1'});
+  });
+
+  test('maps failures to TransactionException', () async {
+    final connection = await connect();
+
+    await expectLater(
+      connection.rollbackTo('missing'),
+      throwsA(isA<TransactionException>().having((e) => e.details, 'details', 'Unknown savepoint: missing')),
+    );
+  });
+
+  test('commits a successful action and rolls back a failed one', () async {
+    final connection = await connect();
+
+    expect(await connection.transaction(() => connection.execute('ok')), 1);
+    expect(calls.map((call) => call.method), ['beginTransaction', 'execute', 'commit']);
+
+    calls.clear();
+    await expectLater(
+      connection.transaction(() => connection.execute('bad')),
+      throwsA(isA<QueryException>()),
+    );
+    expect(calls.map((call) => call.method), ['beginTransaction', 'execute', 'rollback']);
+  });
+
+  test('rolls back when the commit fails', () async {
+    final connection = await connect();
+    failing.add('commit');
+
+    await expectLater(
+      connection.transaction(() => connection.execute('ok')),
+      throwsA(isA<TransactionException>().having((e) => e.details, 'details', 'commit failed')),
+    );
+    expect(calls.map((call) => call.method), ['beginTransaction', 'execute', 'commit', 'rollback']);
+  });
+
+  test('rethrows the original error when the rollback fails too', () async {
+    final connection = await connect();
+    failing.add('rollback');
+
+    await expectLater(
+      connection.transaction(() => connection.execute('bad')),
+      throwsA(isA<QueryException>()),
+    );
+    expect(calls.map((call) => call.method), ['beginTransaction', 'execute', 'rollback']);
+  });
+}
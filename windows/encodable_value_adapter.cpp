@@ -0,0 +1,387 @@
+#include "encodable_value_adapter.h"
+
+#include <utility>
+
+#include "scratch_pool.h"
+
+namespace mssql_connect {
+
+// Helper function to get string from map
+std::string GetStringFromMap(const flutter::EncodableMap& map, const char* key) {
+    std::string key_str(key);
+    flutter::EncodableValue key_value(key_str);
+    
+    auto it = map.find(key_value);
+    if (it != map.end() && std::holds_alternative<std::string>(it->second)) {
+        return std::get<std::string>(it->second);
+    }
+    return "";
+}
+
+// Helper function to get int from map
+int GetIntFromMap(const flutter::EncodableMap& map, const char* key, int default_value) {
+    std::string key_str(key);
+    flutter::EncodableValue key_value(key_str);
+    
+    auto it = map.find(key_value);
+    if (it != map.end() && std::holds_alternative<int>(it->second)) {
+        return std::get<int>(it->second);
+    }
+    return default_value;
+}
+
+// Helper function to get bool from map
+bool GetBoolFromMap(const flutter::EncodableMap& map, const char* key, bool default_value) {
+    std::string key_str(key);
+    flutter::EncodableValue key_value(key_str);
+    
+    auto it = map.find(key_value);
+    if (it != map.end() && std::holds_alternative<bool>(it->second)) {
+        return std::get<bool>(it->second);
+    }
+    return default_value;
+}
+
+// Converts the "parameters" list into values for SQLBindParameter.
+bool ReadParameters(const flutter::EncodableMap& args,
+                    std::vector<SqlParameter>* params,
+                    std::string* error) {
+  params->clear();
+  auto it = args.find(flutter::EncodableValue("parameters"));
+  if (it == args.end() || it->second.IsNull()) {
+    return true;
+  }
+  const auto* list = std::get_if<flutter::EncodableList>(&it->second);
+  if (!list) {
+    *error = "parameters must be a list";
+    return false;
+  }
+  return ReadParameterList(*list, params, error);
+}
+
+bool ReadParameterList(const flutter::EncodableList& list,
+                       std::vector<SqlParameter>* params,
+                       std::string* error) {
+  params->clear();
+  params->reserve(list.size());
+  for (size_t i = 0; i < list.size(); ++i) {
+    const flutter::EncodableValue& value = list[i];
+    if (value.IsNull()) {
+      params->push_back(SqlParameter::Null());
+    } else if (const auto* b = std::get_if<bool>(&value)) {
+      params->push_back(SqlParameter::Bool(*b));
+    } else if (const auto* i32 = std::get_if<int32_t>(&value)) {
+      params->push_back(SqlParameter::Int64(*i32));
+    } else if (const auto* i64 = std::get_if<int64_t>(&value)) {
+      params->push_back(SqlParameter::Int64(*i64));
+    } else if (const auto* d = std::get_if<double>(&value)) {
+      params->push_back(SqlParameter::Double(*d));
+    } else if (const auto* str = std::get_if<std::string>(&value)) {
+      params->push_back(SqlParameter::Text(*str));
+    } else if (const auto* bytes = std::get_if<std::vector<uint8_t>>(&value)) {
+      params->push_back(SqlParameter::Binary(*bytes));
+    } else {
+      *error = "Unsupported type for parameter " + std::to_string(i + 1);
+      return false;
+    }
+  }
+  return true;
+}
+
+SQLULEN GetSecondsFromMap(const flutter::EncodableMap& map, const char* key) {
+    return TimeoutSeconds(GetIntFromMap(map, key, 0));
+}
+
+// Reads the arguments of connect, testConnection and acquire.
+ConnectOptions ReadConnectOptions(const flutter::EncodableMap& args) {
+  ConnectOptions options;
+  options.server = GetStringFromMap(args, "server");
+  options.database = GetStringFromMap(args, "database");
+  options.username = GetStringFromMap(args, "username");
+  options.password = GetStringFromMap(args, "password");
+  options.login_timeout = GetSecondsFromMap(args, "loginTimeoutMs");
+  options.utf8_text = GetBoolFromMap(args, "utf8Text", false);
+  int capacity = GetIntFromMap(args, "statementCacheSize",
+                               (int)StatementCache::kDefaultCapacity);
+  options.statement_cache_size = capacity < 0 ? 0 : (size_t)capacity;
+  return options;
+}
+
+flutter::EncodableValue EncodeParameter(const SqlParameter& value) {
+  switch (value.type) {
+    case SqlParameter::Type::kBool:
+      return flutter::EncodableValue(value.bool_value);
+    case SqlParameter::Type::kInt64:
+      return flutter::EncodableValue(value.int_value);
+    case SqlParameter::Type::kDouble:
+      return flutter::EncodableValue(value.double_value);
+    case SqlParameter::Type::kText:
+      return flutter::EncodableValue(value.text);
+    case SqlParameter::Type::kBinary:
+      return flutter::EncodableValue(value.bytes);
+    default:
+      return flutter::EncodableValue();
+  }
+}
+
+// The default result shape: one map per row, keyed by column name.
+void RowsSink::Start(const BlockFetcher& fetcher) {
+    const std::vector<ColumnDescription>& columns = fetcher.columns();
+    columnNames_.clear();
+    columnTypes_.clear();
+    rows_.clear();
+    for (size_t i = 0; i < columns.size(); ++i) {
+        columnNames_.push_back(flutter::EncodableValue(columns[i].name));
+        columnTypes_.push_back(flutter::EncodableValue(CellTypeName(fetcher.cell_type(i))));
+    }
+}
+
+void RowsSink::AddRow(const BlockFetcher& fetcher, size_t r) {
+    std::string* scratch = ScratchPool::ForThisThread().text();
+    flutter::EncodableMap row;
+    for (size_t i = 0; i < columnNames_.size(); ++i) {
+        flutter::EncodableValue value;
+        if (!fetcher.IsNull(i, r)) {
+            switch (fetcher.cell_type(i)) {
+                case CellType::kBool:
+                    value = flutter::EncodableValue(fetcher.GetBool(i, r));
+                    break;
+                case CellType::kInt32:
+                    value = flutter::EncodableValue(static_cast<int>(fetcher.GetInt32(i, r)));
+                    break;
+                case CellType::kInt64:
+                    value = flutter::EncodableValue(fetcher.GetInt64(i, r));
+                    break;
+                case CellType::kDouble:
+                    value = flutter::EncodableValue(fetcher.GetDouble(i, r));
+                    break;
+                case CellType::kDecimal:
+                    scratch->clear();
+                    fetcher.AppendDecimal(i, r, scratch);
+                    value = flutter::EncodableValue(*scratch);
+                    break;
+                case CellType::kDateTime:
+                case CellType::kTime:
+                    value = flutter::EncodableValue(fetcher.GetMicros(i, r));
+                    break;
+                case CellType::kGuid: {
+                    std::vector<uint8_t> guid(16);
+                    fetcher.GetGuid(i, r, guid.data());
+                    value = flutter::EncodableValue(std::move(guid));
+                    break;
+                }
+                case CellType::kText:
+                    // Copied out of the scratch string at its final
+                    // size; see ScratchPool::text().
+                    scratch->clear();
+                    fetcher.AppendText(i, r, scratch);
+                    value = flutter::EncodableValue(*scratch);
+                    break;
+                case CellType::kBinary: {
+                    size_t size = 0;
+                    const uint8_t* bytes = fetcher.GetBinary(i, r, &size);
+                    value = flutter::EncodableValue(std::vector<uint8_t>(bytes, bytes + size));
+                    break;
+                }
+            }
+        }
+        row[columnNames_[i]] = std::move(value);
+    }
+    rows_.push_back(flutter::EncodableValue(std::move(row)));
+}
+
+void RowsSink::Finish() {
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("rowCount")] = (int)rows_.size();
+    map[flutter::EncodableValue("rows")] = std::move(rows_);
+    map[flutter::EncodableValue("columns")] = std::move(columnNames_);
+    map[flutter::EncodableValue("columnTypes")] = std::move(columnTypes_);
+    reply_ = flutter::EncodableValue(std::move(map));
+}
+
+// A cell left in the driver by a cursor's LOB threshold, to be read with
+// readLob.
+static flutter::EncodableValue LobReference(int lob_token) {
+    flutter::EncodableMap reference;
+    reference[flutter::EncodableValue("lobToken")] = flutter::EncodableValue(lob_token);
+    return flutter::EncodableValue(std::move(reference));
+}
+
+flutter::EncodableMap EncodeColumnar(ColumnarResult* columnar,
+                                     int lob_token) {
+    flutter::EncodableList names;
+    flutter::EncodableList types;
+    flutter::EncodableList data;
+    flutter::EncodableList nulls;
+    flutter::EncodableList scales;
+    for (ResultColumn& column : columnar->columns) {
+        names.push_back(flutter::EncodableValue(std::move(column.name)));
+        types.push_back(flutter::EncodableValue(CellTypeName(column.type)));
+        scales.push_back(flutter::EncodableValue(column.scale));
+        switch (column.type) {
+            case CellType::kBool:
+                data.push_back(flutter::EncodableValue(std::move(column.bools)));
+                break;
+            case CellType::kInt32:
+            case CellType::kInt64:
+            case CellType::kDateTime:
+            case CellType::kTime:
+                data.push_back(flutter::EncodableValue(std::move(column.ints)));
+                break;
+            case CellType::kDouble:
+                data.push_back(flutter::EncodableValue(std::move(column.doubles)));
+                break;
+            case CellType::kDecimal: {
+                if (!column.decimal_text) {
+                    data.push_back(flutter::EncodableValue(std::move(column.ints)));
+                    break;
+                }
+                flutter::EncodableList strings;
+                strings.reserve(column.strings.size());
+                for (std::string& text : column.strings) {
+                    strings.push_back(flutter::EncodableValue(std::move(text)));
+                }
+                data.push_back(flutter::EncodableValue(std::move(strings)));
+                break;
+            }
+            case CellType::kText: {
+                flutter::EncodableList strings;
+                strings.reserve(column.strings.size());
+                for (std::string& text : column.strings) {
+                    strings.push_back(flutter::EncodableValue(std::move(text)));
+                }
+                for (size_t row : column.lob_rows) {
+                    strings[row] = LobReference(lob_token);
+                }
+                data.push_back(flutter::EncodableValue(std::move(strings)));
+                break;
+            }
+            case CellType::kGuid:
+            case CellType::kBinary: {
+                flutter::EncodableList binaries;
+                binaries.reserve(column.binaries.size());
+                for (std::vector<uint8_t>& bytes : column.binaries) {
+                    binaries.push_back(flutter::EncodableValue(std::move(bytes)));
+                }
+                for (size_t row : column.lob_rows) {
+                    binaries[row] = LobReference(lob_token);
+                }
+                data.push_back(flutter::EncodableValue(std::move(binaries)));
+                break;
+            }
+        }
+        nulls.push_back(column.null_bitmap.empty()
+                            ? flutter::EncodableValue()
+                            : flutter::EncodableValue(std::move(column.null_bitmap)));
+    }
+
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("format")] = flutter::EncodableValue("columnar");
+    map[flutter::EncodableValue("rowCount")] = (int)columnar->row_count;
+    map[flutter::EncodableValue("columns")] = std::move(names);
+    map[flutter::EncodableValue("columnTypes")] = std::move(types);
+    map[flutter::EncodableValue("columnData")] = std::move(data);
+    map[flutter::EncodableValue("nulls")] = std::move(nulls);
+    map[flutter::EncodableValue("scales")] = std::move(scales);
+    return map;
+}
+
+flutter::EncodableMap EncodeRows(const ColumnarResult& columnar,
+                                 int lob_token) {
+    flutter::EncodableList columnNames;
+    flutter::EncodableList columnTypes;
+    for (const ResultColumn& column : columnar.columns) {
+        columnNames.push_back(flutter::EncodableValue(column.name));
+        columnTypes.push_back(flutter::EncodableValue(CellTypeName(column.type)));
+    }
+
+    flutter::EncodableList rows;
+    rows.reserve(columnar.row_count);
+    for (size_t r = 0; r < columnar.row_count; ++r) {
+        flutter::EncodableMap row;
+        for (size_t i = 0; i < columnar.columns.size(); ++i) {
+            const ResultColumn& column = columnar.columns[i];
+            flutter::EncodableValue value;
+            if (!column.IsNull(r)) {
+                switch (column.type) {
+                    case CellType::kBool:
+                        value = flutter::EncodableValue(column.bools[r] != 0);
+                        break;
+                    case CellType::kInt32:
+                        value = flutter::EncodableValue(static_cast<int>(column.ints[r]));
+                        break;
+                    case CellType::kInt64:
+                    case CellType::kDateTime:
+                    case CellType::kTime:
+                        value = flutter::EncodableValue(column.ints[r]);
+                        break;
+                    case CellType::kDouble:
+                        value = flutter::EncodableValue(column.doubles[r]);
+                        break;
+                    case CellType::kDecimal: {
+                        std::string text;
+                        if (column.decimal_text) {
+                            text = column.strings[r];
+                        } else {
+                            AppendScaledDecimal(column.ints[r], column.scale, &text);
+                        }
+                        value = flutter::EncodableValue(std::move(text));
+                        break;
+                    }
+                    case CellType::kText:
+                        value = flutter::EncodableValue(column.strings[r]);
+                        break;
+                    case CellType::kGuid:
+                    case CellType::kBinary:
+                        value = flutter::EncodableValue(column.binaries[r]);
+                        break;
+                }
+            }
+            row[columnNames[i]] = std::move(value);
+        }
+        for (size_t i = 0; i < columnar.columns.size(); ++i) {
+            for (size_t lob_row : columnar.columns[i].lob_rows) {
+                if (lob_row == r) {
+                    row[columnNames[i]] = LobReference(lob_token);
+                }
+            }
+        }
+        rows.push_back(flutter::EncodableValue(std::move(row)));
+    }
+
+    flutter::EncodableMap map;
+    map[flutter::EncodableValue("rows")] = std::move(rows);
+    map[flutter::EncodableValue("rowCount")] = (int)columnar.row_count;
+    map[flutter::EncodableValue("columns")] = std::move(columnNames);
+    map[flutter::EncodableValue("columnTypes")] = std::move(columnTypes);
+    return map;
+}
+
+
+// Approximate memory held by |value|, which is what a cached reply counts
+// against the result cache budget.
+size_t ApproximateSize(const flutter::EncodableValue& value) {
+  size_t size = sizeof(flutter::EncodableValue);
+  if (const auto* text = std::get_if<std::string>(&value)) {
+    size += text->size();
+  } else if (const auto* bytes = std::get_if<std::vector<uint8_t>>(&value)) {
+    size += bytes->size();
+  } else if (const auto* ints = std::get_if<std::vector<int32_t>>(&value)) {
+    size += ints->size() * sizeof(int32_t);
+  } else if (const auto* longs = std::get_if<std::vector<int64_t>>(&value)) {
+    size += longs->size() * sizeof(int64_t);
+  } else if (const auto* doubles = std::get_if<std::vector<double>>(&value)) {
+    size += doubles->size() * sizeof(double);
+  } else if (const auto* list = std::get_if<flutter::EncodableList>(&value)) {
+    for (const auto& item : *list) {
+      size += ApproximateSize(item);
+    }
+  } else if (const auto* map = std::get_if<flutter::EncodableMap>(&value)) {
+    for (const auto& entry : *map) {
+      size += ApproximateSize(entry.first) + ApproximateSize(entry.second);
+    }
+  }
+  return size;
+}
+
+}  // namespace mssql_connect
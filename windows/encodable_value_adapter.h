@@ -0,0 +1,75 @@
+#ifndef FLUTTER_PLUGIN_ENCODABLE_VALUE_ADAPTER_H_
+#define FLUTTER_PLUGIN_ENCODABLE_VALUE_ADAPTER_H_
+
+#include <flutter/encodable_value.h>
+#include <windows.h>
+#include <sql.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "block_fetcher.h"
+#include "columnar_result.h"
+#include "parameter_binder.h"
+#include "session.h"
+
+namespace mssql_connect {
+
+// Translates between the Windows channel's EncodableValues and the types of
+// the shared core (see session.h). linux/fl_value_adapter.h does the same
+// for FlValues, so both plugins send and accept identical shapes.
+
+// Map arguments, or |default_value| when absent or of another type.
+std::string GetStringFromMap(const flutter::EncodableMap& map, const char* key);
+int GetIntFromMap(const flutter::EncodableMap& map, const char* key, int default_value);
+bool GetBoolFromMap(const flutter::EncodableMap& map, const char* key, bool default_value);
+// A millisecond argument such as "timeoutMs" in whole seconds; see
+// TimeoutSeconds().
+SQLULEN GetSecondsFromMap(const flutter::EncodableMap& map, const char* key);
+
+// The arguments of connect, testConnection and acquire.
+ConnectOptions ReadConnectOptions(const flutter::EncodableMap& args);
+
+// Converts the "parameters" list of |args|, or |list|, into values for
+// SQLBindParameter. Returns false and fills |error| on an unsupported value.
+bool ReadParameters(const flutter::EncodableMap& args,
+                    std::vector<SqlParameter>* params, std::string* error);
+bool ReadParameterList(const flutter::EncodableList& list,
+                       std::vector<SqlParameter>* params, std::string* error);
+flutter::EncodableValue EncodeParameter(const SqlParameter& value);
+
+// Builds the default reply to Query, one map per row, while the result is
+// fetched; see Session::Query() and FetchResult(). resultFormat 'columnar'
+// reads a ColumnarResult for EncodeColumnar(), and 'binary' uses
+// BinaryResultSink.
+class RowsSink : public ResultSink {
+public:
+    void Start(const BlockFetcher& fetcher) override;
+    void AddRow(const BlockFetcher& fetcher, size_t row) override;
+    void Finish() override;
+
+    // The reply, once finished.
+    flutter::EncodableValue TakeReply() { return std::move(reply_); }
+
+private:
+    flutter::EncodableList columnNames_;
+    flutter::EncodableList columnTypes_;
+    flutter::EncodableList rows_;
+    flutter::EncodableValue reply_;
+};
+
+// Encode an already-read result in the columnar shape (moving its data
+// out) or the per-row shape. Cells a cursor left in the driver are
+// encoded as references to |lob_token|.
+flutter::EncodableMap EncodeColumnar(ColumnarResult* columnar, int lob_token = 0);
+flutter::EncodableMap EncodeRows(const ColumnarResult& columnar, int lob_token = 0);
+
+// Approximate memory held by |value|, which is what a cached reply counts
+// against the result cache budget.
+size_t ApproximateSize(const flutter::EncodableValue& value);
+
+}  // namespace mssql_connect
+
+#endif  // FLUTTER_PLUGIN_ENCODABLE_VALUE_ADAPTER_H_
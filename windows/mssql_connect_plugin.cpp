@@ -1,9 +1,32 @@
 #include "mssql_connect_plugin.h"
+
+#include "batch_executor.h"
+#include "binary_result.h"
+#include "block_fetcher.h"
+#include "client_encoding.h"
+#include "columnar_result.h"
+#include "encodable_value_adapter.h"
+#include "odbc_error.h"
+#include "parameter_binder.h"
+#include "procedure_call.h"
+#include "result_cursor.h"
+#include "result_sets.h"
+#include "session.h"
+#include "statement_cache.h"
+#include "text_encoding.h"
+#include "tracer.h"
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar_windows.h>
+#include <flutter/standard_message_codec.h>
 #include <flutter/standard_method_codec.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <memory>
-#include <sstream>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -14,68 +37,626 @@
 namespace mssql_connect {
 
 // Static member definitions
+std::mutex MssqlConnectPlugin::connections_mutex_;
 int MssqlConnectPlugin::next_connection_id_ = 0;
-std::unordered_map<int, void*> MssqlConnectPlugin::connections_;
-
-// Helper function to convert string to wide string
-std::wstring MssqlConnectPlugin::StringToWString(const std::string& str) {
-    if (str.empty()) return std::wstring();
-    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
-    std::wstring wstrTo(size_needed, 0);
-    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
-    return wstrTo;
-}
-
-// Helper function to convert wide string to string
-std::string MssqlConnectPlugin::WStringToString(const std::wstring& wstr) {
-    if (wstr.empty()) return std::string();
-    int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-    std::string strTo(size_needed, 0);
-    WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-    return strTo;
-}
-
-// Helper function to get string from map
-std::string MssqlConnectPlugin::GetStringFromMap(const flutter::EncodableMap& map, const char* key) {
-    std::string key_str(key);
-    flutter::EncodableValue key_value(key_str);
-    
-    auto it = map.find(key_value);
-    if (it != map.end() && std::holds_alternative<std::string>(it->second)) {
-        return std::get<std::string>(it->second);
+int MssqlConnectPlugin::next_cursor_id_ = 0;
+int MssqlConnectPlugin::next_lob_token_ = 0;
+std::unordered_map<int, MssqlConnectPlugin::CursorEntry>
+    MssqlConnectPlugin::cursors_;
+std::unordered_map<int, MssqlConnectPlugin::ConnectionEntry>
+    MssqlConnectPlugin::connections_;
+ConnectionPoolRegistry MssqlConnectPlugin::pools_;
+ResultCache<std::shared_ptr<const flutter::EncodableValue>> MssqlConnectPlugin::result_cache_;
+
+namespace {
+
+// A MethodResult handed to worker threads. Completing it copies the reply
+// and forwards it to the real result on the platform thread, since the
+// engine only accepts replies from there. |finished| runs when the handler
+// lets go of it, which marks the end of the call.
+class PlatformThreadResult
+    : public flutter::MethodResult<flutter::EncodableValue> {
+ public:
+  using Runner = std::function<void(std::function<void()>)>;
+  using Clock = std::chrono::steady_clock;
+
+  PlatformThreadResult(
+      Runner runner,
+      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+      std::function<void()> finished = nullptr)
+      : runner_(std::move(runner)),
+        result_(std::move(result)),
+        finished_(std::move(finished)) {}
+
+  ~PlatformThreadResult() override {
+    if (finished_) {
+      finished_();
     }
-    return "";
-}
+  }
 
-// Helper function to get int from map
-int MssqlConnectPlugin::GetIntFromMap(const flutter::EncodableMap& map, const char* key, int default_value) {
-    std::string key_str(key);
-    flutter::EncodableValue key_value(key_str);
-    
-    auto it = map.find(key_value);
-    if (it != map.end() && std::holds_alternative<int>(it->second)) {
-        return std::get<int>(it->second);
+  // Counts an error reply as a failed |kind| call in |metrics|, and times
+  // a successful one as its reply phase.
+  void set_metrics(std::shared_ptr<Metrics> metrics, CallKind kind) {
+    metrics_ = std::move(metrics);
+    kind_ = kind;
+  }
+
+  // Traces the reply, and the whole call as |method| from |queued| until
+  // its reply was delivered.
+  void set_trace(const TraceCall& trace, std::string method,
+                 Clock::time_point queued) {
+    trace_ = trace;
+    method_ = std::move(method);
+    queued_ = queued;
+  }
+
+ protected:
+  void SuccessInternal(const flutter::EncodableValue* result) override {
+    // The reply phase covers this copy, the wait for the platform thread
+    // and the codec encoding the value inside Success().
+    Clock::time_point start = Start();
+    auto value = std::make_shared<flutter::EncodableValue>(
+        result ? *result : flutter::EncodableValue());
+    auto target = std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>>(
+        std::move(result_));
+    Deliver([target, value]() { target->Success(*value); }, start,
+            std::move(metrics_));
+  }
+
+  void ErrorInternal(const std::string& error_code,
+                     const std::string& error_message,
+                     const flutter::EncodableValue* error_details) override {
+    if (metrics_) {
+      metrics_->CountError(kind_);
+    }
+    Clock::time_point start = Start();
+    auto details = error_details
+                       ? std::make_shared<flutter::EncodableValue>(*error_details)
+                       : nullptr;
+    auto target = std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>>(
+        std::move(result_));
+    Deliver([target, error_code, error_message, details]() {
+      if (details) {
+        target->Error(error_code, error_message, *details);
+      } else {
+        target->Error(error_code, error_message);
+      }
+    }, start, nullptr);
+  }
+
+  void NotImplementedInternal() override {
+    Clock::time_point start = Start();
+    auto target = std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>>(
+        std::move(result_));
+    Deliver([target]() { target->NotImplemented(); }, start, nullptr);
+  }
+
+ private:
+  // The start of the reply, read only when it is measured.
+  Clock::time_point Start() const {
+    return metrics_ || trace_.traced() ? Clock::now() : Clock::time_point();
+  }
+
+  // Runs |reply| on the platform thread and records how long it took from
+  // |start| in |metrics| and the trace.
+  void Deliver(std::function<void()> reply, Clock::time_point start,
+               std::shared_ptr<Metrics> metrics) {
+    if (!metrics && !trace_.traced()) {
+      runner_(std::move(reply));
+      return;
+    }
+    runner_([reply, start, metrics, trace = trace_, method = method_,
+             queued = queued_]() {
+      reply();
+      Clock::time_point end = Clock::now();
+      if (metrics) {
+        metrics->Record(Phase::kReply, end - start);
+      }
+      if (trace.traced()) {
+        Tracer::Global().Record(trace, "reply", start, end);
+        Tracer::Global().Record(trace, method.c_str(), queued, end);
+      }
+    });
+  }
+
+  Runner runner_;
+  std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result_;
+  std::function<void()> finished_;
+  std::shared_ptr<Metrics> metrics_;
+  CallKind kind_ = CallKind::kQuery;
+  TraceCall trace_;
+  std::string method_;
+  Clock::time_point queued_;
+};
+
+// Answers a call on the binary channel: the byte list a handler succeeds
+// with is sent as the raw reply, and errors as an error frame.
+class BinaryChannelResult
+    : public flutter::MethodResult<flutter::EncodableValue> {
+ public:
+  explicit BinaryChannelResult(flutter::BinaryReply reply)
+      : reply_(std::move(reply)) {}
+
+ protected:
+  void SuccessInternal(const flutter::EncodableValue* result) override {
+    const std::vector<uint8_t>* bytes =
+        result ? std::get_if<std::vector<uint8_t>>(result) : nullptr;
+    if (!bytes) {
+      ErrorInternal("InvalidResult", "Expected a binary result", nullptr);
+      return;
+    }
+    reply_(bytes->data(), bytes->size());
+  }
+
+  void ErrorInternal(const std::string& error_code,
+                     const std::string& error_message,
+                     const flutter::EncodableValue* error_details) override {
+    // The details carry the driver's message when there is one.
+    const std::string* details =
+        error_details ? std::get_if<std::string>(error_details) : nullptr;
+    std::vector<uint8_t> frame;
+    EncodeBinaryError(error_code, details ? *details : error_message, &frame);
+    reply_(frame.data(), frame.size());
+  }
+
+  void NotImplementedInternal() override { reply_(nullptr, 0); }
+
+ private:
+  flutter::BinaryReply reply_;
+};
+
+}  // namespace
+
+// A pooled connection handed to an acquire call that has not yet given it
+// a connection id. If the call is dropped before then, e.g. by a worker
+// pool shutting down, the connection goes back to |pool|.
+struct MssqlConnectPlugin::PendingLease {
+  PendingLease(std::shared_ptr<ConnectionPool> pool, void* handle)
+      : pool(std::move(pool)), handle(handle) {}
+
+  ~PendingLease() {
+    if (handle) {
+      pool->Release(handle);
+    }
+  }
+
+  std::shared_ptr<ConnectionPool> pool;
+  void* handle;
+};
+
+// Opens pooled connections to one target. The factory keeps the shared
+// environment alive for as long as the pool exists.
+class MssqlConnectPlugin::OdbcConnectionFactory : public ConnectionPool::Factory {
+ public:
+  OdbcConnectionFactory(std::string connection_string, SQLULEN login_timeout)
+      : connection_string_(std::move(connection_string)),
+        login_timeout_(login_timeout),
+        environment_(OdbcEnvironment::Get(nullptr)) {}
+
+  ConnectionPool::Handle Open(std::string* error) override {
+    if (!environment_) {
+      *error = "Failed to allocate environment handle";
+      return nullptr;
+    }
+
+    SQLHDBC hDbc = environment_->AllocConnection(error);
+    if (hDbc == SQL_NULL_HDBC) {
+      return nullptr;
     }
-    return default_value;
+    if (!DriverConnect(hDbc, connection_string_, login_timeout_, error)) {
+      environment_->FreeConnection(hDbc);
+      return nullptr;
+    }
+    return hDbc;
+  }
+
+  // SQL_ATTR_CONNECTION_DEAD reports the driver's last known state without
+  // a round trip. Drivers that do not support it are assumed alive.
+  bool IsAlive(ConnectionPool::Handle handle) override {
+    SQLUINTEGER dead = SQL_CD_FALSE;
+    SQLRETURN ret = SQLGetConnectAttr((SQLHDBC)handle, SQL_ATTR_CONNECTION_DEAD,
+                                      &dead, SQL_IS_UINTEGER, NULL);
+    return !SQL_SUCCEEDED(ret) || dead != SQL_CD_TRUE;
+  }
+
+  void Close(ConnectionPool::Handle handle) override {
+    SQLDisconnect((SQLHDBC)handle);
+    environment_->FreeConnection((SQLHDBC)handle);
+  }
+
+ private:
+  std::string connection_string_;
+  SQLULEN login_timeout_;
+  std::shared_ptr<OdbcEnvironment> environment_;
+};
+
+// Helper function to collect the diagnostic records of a handle
+std::string MssqlConnectPlugin::GetDiagnostics(SQLSMALLINT handle_type, SQLHANDLE handle) {
+    return GetOdbcDiagnostics(handle_type, handle);
 }
 
-// Helper function to get bool from map
-bool MssqlConnectPlugin::GetBoolFromMap(const flutter::EncodableMap& map, const char* key, bool default_value) {
-    std::string key_str(key);
-    flutter::EncodableValue key_value(key_str);
-    
-    auto it = map.find(key_value);
-    if (it != map.end() && std::holds_alternative<bool>(it->second)) {
-        return std::get<bool>(it->second);
+// Reads the "parameters" list of executeStoredProcedure. Each entry is a
+// map with "name", "direction" ("in", "out" or "inout"), "value", and for
+// output parameters "type" and "size".
+bool MssqlConnectPlugin::ReadProcedureParameters(
+    const flutter::EncodableMap& args,
+    std::vector<ProcedureParameter>* params,
+    std::string* error) {
+  params->clear();
+  auto it = args.find(flutter::EncodableValue("parameters"));
+  if (it == args.end() || it->second.IsNull()) {
+    return true;
+  }
+  const auto* list = std::get_if<flutter::EncodableList>(&it->second);
+  if (!list) {
+    *error = "parameters must be a list";
+    return false;
+  }
+
+  for (size_t i = 0; i < list->size(); ++i) {
+    const auto* entry = std::get_if<flutter::EncodableMap>(&(*list)[i]);
+    if (!entry) {
+      *error = "Parameter " + std::to_string(i + 1) + " must be a map";
+      return false;
+    }
+    ProcedureParameter param;
+    param.name = GetStringFromMap(*entry, "name");
+    std::string direction = GetStringFromMap(*entry, "direction");
+    if (direction == "out") {
+      param.direction = ProcedureParameter::Direction::kOutput;
+    } else if (direction == "inout") {
+      param.direction = ProcedureParameter::Direction::kInputOutput;
+    } else if (direction.empty() || direction == "in") {
+      param.direction = ProcedureParameter::Direction::kInput;
+    } else {
+      *error = "Unknown direction for parameter " + param.name + ": " + direction;
+      return false;
+    }
+
+    flutter::EncodableList value_list;
+    auto value = entry->find(flutter::EncodableValue("value"));
+    value_list.push_back(value == entry->end() ? flutter::EncodableValue() : value->second);
+    std::vector<SqlParameter> values;
+    if (!ReadParameterList(value_list, &values, error)) {
+      *error = "Unsupported value for parameter " + param.name;
+      return false;
     }
-    return default_value;
+    param.value = values[0];
+    param.type = param.value.type;
+
+    if (param.direction != ProcedureParameter::Direction::kInput) {
+      std::string type = GetStringFromMap(*entry, "type");
+      if (type == "bool") {
+        param.type = SqlParameter::Type::kBool;
+      } else if (type == "int") {
+        param.type = SqlParameter::Type::kInt64;
+      } else if (type == "double") {
+        param.type = SqlParameter::Type::kDouble;
+      } else if (type == "string") {
+        param.type = SqlParameter::Type::kText;
+      } else if (type == "binary") {
+        param.type = SqlParameter::Type::kBinary;
+      } else {
+        *error = "Unknown type for output parameter " + param.name + ": " + type;
+        return false;
+      }
+      if (param.value.type != SqlParameter::Type::kNull &&
+          param.value.type != param.type) {
+        *error = "Value of parameter " + param.name + " does not match its type";
+        return false;
+      }
+      int size = GetIntFromMap(*entry, "size", 4000);
+      param.output_size = size < 1 ? 1 : (size_t)size;
+    }
+    params->push_back(std::move(param));
+  }
+  return true;
+}
+
+bool MssqlConnectPlugin::DetectUtf8Text(SQLHDBC dbc, const flutter::EncodableMap& args) {
+  if (!GetBoolFromMap(args, "utf8Text", false)) {
+    return false;
+  }
+  // Falls back to UTF-16 if the collation cannot be read.
+  bool utf8_text = false;
+  std::string error;
+  return CanFetchUtf8Text(dbc, &utf8_text, &error) && utf8_text;
+}
+
+std::unique_ptr<StatementCache> MssqlConnectPlugin::CreateStatementCache(
+    const flutter::EncodableMap& args) {
+  int capacity = GetIntFromMap(args, "statementCacheSize",
+                               (int)StatementCache::kDefaultCapacity);
+  return std::make_unique<StatementCache>(capacity < 0 ? 0 : (size_t)capacity);
 }
 
 // Constructor
-MssqlConnectPlugin::MssqlConnectPlugin() {}
+MssqlConnectPlugin::MssqlConnectPlugin()
+    : workers_(std::make_unique<WorkerPool>(WorkerPool::DefaultThreadCount())) {}
+
+MssqlConnectPlugin::MssqlConnectPlugin(flutter::PluginRegistrarWindows* registrar)
+    : registrar_(registrar),
+      workers_(std::make_unique<WorkerPool>(WorkerPool::DefaultThreadCount())) {
+  dispatch_message_ = RegisterWindowMessage(L"MssqlConnectPluginDispatch");
+  window_proc_id_ = registrar_->RegisterTopLevelWindowProcDelegate(
+      [this](HWND hwnd, UINT message, WPARAM wparam,
+             LPARAM lparam) -> std::optional<LRESULT> {
+        if (message != dispatch_message_) {
+          return std::nullopt;
+        }
+        DrainPlatformTasks();
+        return 0;
+      });
+}
 
 // Destructor
-MssqlConnectPlugin::~MssqlConnectPlugin() {}
+MssqlConnectPlugin::~MssqlConnectPlugin() {
+  // Acquires still queued on the shared connection pools would complete
+  // into this plugin; fail them while it can still reply.
+  for (const auto& entry : pools_.Snapshot()) {
+    entry.second->CancelWaiters(this);
+  }
+  // Join the workers first so nothing posts to a plugin that is going away.
+  // The pool itself outlives the reactor: executions it cancels post their
+  // completions to the stopped pool, which drops them.
+  workers_->Stop();
+  reactor_.reset();
+  workers_.reset();
+  if (registrar_ && window_proc_id_) {
+    registrar_->UnregisterTopLevelWindowProcDelegate(*window_proc_id_);
+  }
+}
+
+// Runs a task on the platform thread by posting a message to the top-level
+// window; the window proc delegate drains the queue.
+void MssqlConnectPlugin::RunOnPlatformThread(std::function<void()> task) {
+  HWND window = nullptr;
+  if (registrar_ && registrar_->GetView()) {
+    window = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+  }
+  if (!window) {
+    task();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(platform_tasks_mutex_);
+    platform_tasks_.push_back(std::move(task));
+  }
+  PostMessage(window, dispatch_message_, 0, 0);
+}
+
+void MssqlConnectPlugin::DrainPlatformTasks() {
+  std::deque<std::function<void()>> tasks;
+  {
+    std::lock_guard<std::mutex> lock(platform_tasks_mutex_);
+    tasks.swap(platform_tasks_);
+  }
+  for (auto& task : tasks) {
+    task();
+  }
+}
+
+// Copies the call so it outlives this handler and queues it on the worker
+// pool. Calls carrying a connection id are serialized per connection: the
+// next one starts once the handler has dropped its result, so a handler
+// that finishes on another thread (see RunExecution) keeps the connection
+// to itself until it replies.
+void MssqlConnectPlugin::RunOnWorker(
+    MethodHandler handler,
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  auto call = std::make_shared<flutter::MethodCall<flutter::EncodableValue>>(
+      method_call.method_name(),
+      method_call.arguments()
+          ? std::make_unique<flutter::EncodableValue>(*method_call.arguments())
+          : nullptr);
+  auto reply = std::make_shared<
+      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>>>(
+      std::move(result));
+
+  int connection_id = -1;
+  int request_id = 0;
+  if (call->arguments() &&
+      std::holds_alternative<flutter::EncodableMap>(*call->arguments())) {
+    const auto& args = std::get<flutter::EncodableMap>(*call->arguments());
+    connection_id = GetIntFromMap(args, "connectionId", -1);
+    request_id = GetIntFromMap(args, "requestId", 0);
+  }
+  // A call with a request id can be cancelled from the time it is queued.
+  requests_.Add(request_id);
+  TraceCall trace = Tracer::BeginCall(connection_id, request_id);
+  Tracer::Clock::time_point queued;
+  if (trace.traced()) {
+    queued = Tracer::Clock::now();
+  }
+  auto task = [this, handler, call, reply, connection_id, request_id, trace,
+               queued](WorkerPool::Task release) {
+    if (trace.traced()) {
+      Tracer::Global().Record(trace, "queue", queued, Tracer::Clock::now());
+    }
+    auto result = std::make_unique<PlatformThreadResult>(
+        [this](std::function<void()> task) {
+          RunOnPlatformThread(std::move(task));
+        },
+        std::move(*reply),
+        [this, request_id, release]() {
+          requests_.Remove(request_id);
+          if (release) {
+            release();
+          }
+        });
+    // Query and execute calls are counted here, on any connection, cached
+    // or not; Connect and Acquire count themselves.
+    const std::string& method = call->method_name();
+    if (Metrics::enabled() && (method == "query" || method == "execute")) {
+      if (std::shared_ptr<Metrics> metrics = FindMetrics(connection_id)) {
+        CallKind kind = method == "query" ? CallKind::kQuery : CallKind::kExecute;
+        metrics->CountCall(kind);
+        result->set_metrics(std::move(metrics), kind);
+      }
+    }
+    // The handler's spans go to the current call; see Tracer::Current().
+    if (trace.traced()) {
+      result->set_trace(trace, method, queued);
+    }
+    ScopedTraceCall scope(trace);
+    (this->*handler)(*call, std::move(result));
+  };
+
+  if (connection_id >= 0) {
+    workers_->PostAsync(connection_id, std::move(task));
+  } else {
+    workers_->Post([task]() { task(nullptr); });
+  }
+}
+
+struct MssqlConnectPlugin::Execution {
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result;
+    StatementCache* statements = nullptr;
+    std::string sql;
+    std::string target;
+    std::unique_ptr<PreparedStatement> statement;
+    // Owns the bound parameter buffers, which must outlive the execution.
+    ParameterBinder binder;
+    int request_id = 0;
+    // The connection's statistics while they are being collected.
+    std::shared_ptr<Metrics> metrics;
+    // The call being traced, if any.
+    TraceCall trace;
+    // Filled in once SQLExecute has finished. The diagnostics of a failure
+    // are read straight away, since switching the statement out of
+    // asynchronous mode clears them.
+    SQLRETURN ret = SQL_ERROR;
+    std::string sqlstate;
+    std::string diagnostics;
+};
+
+void MssqlConnectPlugin::RunExecution(std::shared_ptr<Execution> execution,
+                                      std::function<void(Execution*)> finish) {
+    SQLHSTMT hStmt = execution->statement->handle();
+    Metrics::Clock::time_point started;
+    if (execution->metrics || execution->trace.traced()) {
+        started = Metrics::Clock::now();
+    }
+    auto completed = [execution, hStmt, started](SQLRETURN ret) {
+        if (execution->metrics || execution->trace.traced()) {
+            Metrics::Clock::time_point ended = Metrics::Clock::now();
+            if (execution->metrics) {
+                execution->metrics->Record(Phase::kExecute, ended - started);
+            }
+            Tracer::Global().Record(execution->trace, "execute", started, ended);
+        }
+        execution->ret = ret;
+        if (!SQL_SUCCEEDED(ret) && ret != SQL_NO_DATA) {
+            execution->sqlstate = GetOdbcSqlState(SQL_HANDLE_STMT, hStmt);
+            execution->diagnostics = GetDiagnostics(SQL_HANDLE_STMT, hStmt);
+        }
+    };
+    if (!async_execution_) {
+        completed(SQLExecute(hStmt));
+        finish(execution.get());
+        return;
+    }
+    // The reactor's threads only wait; reading the results is handed back
+    // to the workers.
+    reactor_->Submit(
+        hStmt, [hStmt]() { return SQLExecute(hStmt); },
+        [this, execution, hStmt, completed, finish](SQLRETURN ret) {
+            completed(ret);
+            AsyncReactor::EndAsync(hStmt);
+            workers_->Post([execution, finish]() { finish(execution.get()); });
+        });
+}
+
+SQLHDBC MssqlConnectPlugin::FindConnection(int connection_id,
+                                           StatementCache** statements,
+                                           bool* utf8_text,
+                                           std::string* target) {
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  auto it = connections_.find(connection_id);
+  if (it == connections_.end()) {
+    return SQL_NULL_HDBC;
+  }
+  if (statements) {
+    *statements = it->second.statements.get();
+  }
+  if (utf8_text) {
+    *utf8_text = it->second.utf8_text;
+  }
+  if (target) {
+    *target = it->second.target;
+  }
+  return (SQLHDBC)it->second.handle;
+}
+
+Transaction* MssqlConnectPlugin::FindTransaction(int connection_id) {
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  auto it = connections_.find(connection_id);
+  return it == connections_.end() ? nullptr : it->second.transaction.get();
+}
+
+std::shared_ptr<Metrics> MssqlConnectPlugin::FindMetrics(int connection_id) {
+  if (!Metrics::enabled()) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  auto it = connections_.find(connection_id);
+  return it == connections_.end() ? nullptr : it->second.metrics;
+}
+
+bool MssqlConnectPlugin::CloseConnection(int connection_id) {
+  ConnectionEntry entry;
+  std::vector<std::unique_ptr<ResultCursor>> cursors;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+      return false;
+    }
+    entry = std::move(it->second);
+    connections_.erase(it);
+
+    for (auto cursor = cursors_.begin(); cursor != cursors_.end();) {
+      if (cursor->second.connection_id == connection_id) {
+        cursors.push_back(std::move(cursor->second.cursor));
+        cursor = cursors_.erase(cursor);
+      } else {
+        ++cursor;
+      }
+    }
+  }
+  // Statements must be freed before their connection is reused or closed.
+  cursors.clear();
+  entry.statements.reset();
+
+  // An open transaction is rolled back rather than left for the next user
+  // of a pooled connection; if even that fails the connection is dropped.
+  bool clean = !entry.transaction || entry.transaction->Abandon();
+  if (entry.pool) {
+    if (clean) {
+      entry.pool->Release(entry.handle);
+    } else {
+      entry.pool->Discard(entry.handle);
+    }
+  } else {
+    SQLDisconnect((SQLHDBC)entry.handle);
+    entry.environment->FreeConnection((SQLHDBC)entry.handle);
+  }
+  return true;
+}
+
+void MssqlConnectPlugin::DiscardCursor(int cursor_id) {
+  std::unique_ptr<ResultCursor> cursor;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    auto it = cursors_.find(cursor_id);
+    if (it == cursors_.end()) {
+      return;
+    }
+    cursor = std::move(it->second.cursor);
+    cursors_.erase(it);
+  }
+}
 
 // Static method to register the plugin
 void MssqlConnectPlugin::RegisterWithRegistrar(
@@ -85,16 +666,43 @@ void MssqlConnectPlugin::RegisterWithRegistrar(
           registrar->messenger(), "mssql_connect",  // Make sure this matches
           &flutter::StandardMethodCodec::GetInstance());
 
-  auto plugin = std::make_unique<MssqlConnectPlugin>();
+  auto plugin = std::make_unique<MssqlConnectPlugin>(registrar);
 
   channel->SetMethodCallHandler(
       [plugin_pointer = plugin.get()](const auto &call, auto result) {
         plugin_pointer->HandleMethodCall(call, std::move(result));
       });
 
+  registrar->messenger()->SetMessageHandler(
+      "mssql_connect/binary",
+      [plugin_pointer = plugin.get()](const uint8_t* message, size_t message_size,
+                                      flutter::BinaryReply reply) {
+        plugin_pointer->HandleBinaryMessage(message, message_size, std::move(reply));
+      });
+
   registrar->AddPlugin(std::move(plugin));
 }
 
+void MssqlConnectPlugin::HandleBinaryMessage(const uint8_t* message,
+                                             size_t message_size,
+                                             flutter::BinaryReply reply) {
+  auto result = std::make_unique<BinaryChannelResult>(std::move(reply));
+  std::unique_ptr<flutter::EncodableValue> args =
+      flutter::StandardMessageCodec::GetInstance().DecodeMessage(message, message_size);
+  if (!args || !std::holds_alternative<flutter::EncodableMap>(*args)) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+  flutter::EncodableMap& map = std::get<flutter::EncodableMap>(*args);
+  if (GetStringFromMap(map, "method") != "query") {
+    result->NotImplemented();
+    return;
+  }
+  map[flutter::EncodableValue("resultFormat")] = flutter::EncodableValue("binary");
+  flutter::MethodCall<flutter::EncodableValue> call("query", std::move(args));
+  RunOnWorker(&MssqlConnectPlugin::Query, call, std::move(result));
+}
+
 // Method call handler
 void MssqlConnectPlugin::HandleMethodCall(
     const flutter::MethodCall<flutter::EncodableValue> &method_call,
@@ -106,15 +714,69 @@ void MssqlConnectPlugin::HandleMethodCall(
     // Handle the platform version request
     result->Success(flutter::EncodableValue("Windows"));
   } else if (method_name == "connect") {
-    Connect(method_call, std::move(result));
+    RunOnWorker(&MssqlConnectPlugin::Connect, method_call, std::move(result));
   } else if (method_name == "disconnect") {
-    Disconnect(method_call, std::move(result));
+    RunOnWorker(&MssqlConnectPlugin::Disconnect, method_call, std::move(result));
   } else if (method_name == "query") {
-    Query(method_call, std::move(result));
+    RunOnWorker(&MssqlConnectPlugin::Query, method_call, std::move(result));
   } else if (method_name == "execute") {
-    Execute(method_call, std::move(result));
+    RunOnWorker(&MssqlConnectPlugin::Execute, method_call, std::move(result));
+  } else if (method_name == "queryMulti") {
+    RunOnWorker(&MssqlConnectPlugin::QueryMulti, method_call, std::move(result));
+  } else if (method_name == "executeStoredProcedure") {
+    RunOnWorker(&MssqlConnectPlugin::ExecuteStoredProcedure, method_call, std::move(result));
+  } else if (method_name == "executeBatch") {
+    RunOnWorker(&MssqlConnectPlugin::ExecuteBatch, method_call, std::move(result));
+  } else if (method_name == "pipeline") {
+    RunOnWorker(&MssqlConnectPlugin::Pipeline, method_call, std::move(result));
   } else if (method_name == "testConnection") {
-    TestConnection(method_call, std::move(result));
+    RunOnWorker(&MssqlConnectPlugin::TestConnection, method_call, std::move(result));
+  } else if (method_name == "acquire") {
+    RunOnWorker(&MssqlConnectPlugin::Acquire, method_call, std::move(result));
+  } else if (method_name == "openCursor") {
+    RunOnWorker(&MssqlConnectPlugin::OpenCursor, method_call, std::move(result));
+  } else if (method_name == "fetchNext") {
+    RunOnWorker(&MssqlConnectPlugin::FetchNext, method_call, std::move(result));
+  } else if (method_name == "readLob") {
+    RunOnWorker(&MssqlConnectPlugin::ReadLob, method_call, std::move(result));
+  } else if (method_name == "closeCursor") {
+    RunOnWorker(&MssqlConnectPlugin::CloseCursor, method_call, std::move(result));
+  } else if (method_name == "release") {
+    RunOnWorker(&MssqlConnectPlugin::Release, method_call, std::move(result));
+  } else if (method_name == "beginTransaction") {
+    RunOnWorker(&MssqlConnectPlugin::BeginTransaction, method_call, std::move(result));
+  } else if (method_name == "commit") {
+    RunOnWorker(&MssqlConnectPlugin::Commit, method_call, std::move(result));
+  } else if (method_name == "rollback") {
+    RunOnWorker(&MssqlConnectPlugin::Rollback, method_call, std::move(result));
+  } else if (method_name == "savepoint") {
+    RunOnWorker(&MssqlConnectPlugin::Savepoint, method_call, std::move(result));
+  } else if (method_name == "rollbackTo") {
+    RunOnWorker(&MssqlConnectPlugin::RollbackTo, method_call, std::move(result));
+  } else if (method_name == "cancel") {
+    // Not queued: the call to cancel holds its connection's worker.
+    Cancel(method_call, std::move(result));
+  } else if (method_name == "configureEnvironment") {
+    ConfigureEnvironment(method_call, std::move(result));
+  } else if (method_name == "getStatementCacheStats") {
+    GetStatementCacheStats(method_call, std::move(result));
+  } else if (method_name == "getPoolStats") {
+    GetPoolStats(method_call, std::move(result));
+  } else if (method_name == "configureResultCache") {
+    ConfigureResultCache(method_call, std::move(result));
+  } else if (method_name == "invalidateResultCache") {
+    InvalidateResultCache(method_call, std::move(result));
+  } else if (method_name == "getResultCacheStats") {
+    GetResultCacheStats(method_call, std::move(result));
+  } else if (method_name == "configureStats") {
+    ConfigureStats(method_call, std::move(result));
+  } else if (method_name == "getStats") {
+    GetStats(method_call, std::move(result));
+  } else if (method_name == "configureTrace") {
+    ConfigureTrace(method_call, std::move(result));
+  } else if (method_name == "dumpTrace") {
+    // Writing the file may take a while.
+    RunOnWorker(&MssqlConnectPlugin::DumpTrace, method_call, std::move(result));
   } else {
     result->NotImplemented();
   }
@@ -131,78 +793,53 @@ void MssqlConnectPlugin::Connect(
   }
 
   const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
-  
-  std::string server = GetStringFromMap(args, "server");
-  std::string database = GetStringFromMap(args, "database");
-  std::string username = GetStringFromMap(args, "username");
-  std::string password = GetStringFromMap(args, "password");
 
-  SQLHENV hEnv = SQL_NULL_HENV;
-  SQLHDBC hDbc = SQL_NULL_HDBC;
-  SQLRETURN ret;
+  // Counted in the new connection's statistics, which also feed the
+  // process-wide ones; a failed connect only shows up in the latter.
+  auto metrics = std::make_shared<Metrics>(&Metrics::Global());
+  metrics->CountCall(CallKind::kConnect);
 
-  ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &hEnv);
-  if (!SQL_SUCCEEDED(ret)) {
-      result->Error("ConnectionError", "Failed to allocate environment handle");
+  std::string error_message;
+  std::shared_ptr<OdbcEnvironment> environment = OdbcEnvironment::Get(&error_message);
+  if (!environment) {
+      metrics->CountError(CallKind::kConnect);
+      result->Error("ConnectionError", error_message);
       return;
   }
 
-  ret = SQLSetEnvAttr(hEnv, SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
-  if (!SQL_SUCCEEDED(ret)) {
-      SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
-      result->Error("ConnectionError", "Failed to set ODBC version");
+  SQLHDBC hDbc = environment->AllocConnection(&error_message);
+  if (hDbc == SQL_NULL_HDBC) {
+      metrics->CountError(CallKind::kConnect);
+      result->Error("ConnectionError", error_message);
       return;
   }
-
-  ret = SQLAllocHandle(SQL_HANDLE_DBC, hEnv, &hDbc);
-  if (!SQL_SUCCEEDED(ret)) {
-      SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
-      result->Error("ConnectionError", "Failed to allocate connection handle");
-      return;
+  ConnectOptions options = ReadConnectOptions(args);
+  std::string target = BuildConnectionString(options);
+  bool connected;
+  {
+      PhaseTimer connect_timer(metrics.get(), Phase::kConnect);
+      connected = DriverConnect(hDbc, target, options.login_timeout, &error_message);
   }
 
-  std::wstringstream conn_str_ss;
-  conn_str_ss << L"DRIVER={ODBC Driver 18 for SQL Server};SERVER=" << StringToWString(server)
-              << L";DATABASE=" << StringToWString(database)
-              << L";UID=" << StringToWString(username)
-              << L";PWD=" << StringToWString(password)
-              << L";TrustServerCertificate=Yes;";
-  std::wstring conn_str = conn_str_ss.str();
-
-  wchar_t out_conn_str[1024];
-  SQLSMALLINT out_conn_str_len;
-
-  ret = SQLDriverConnect(hDbc, NULL, (SQLWCHAR*)conn_str.c_str(), SQL_NTS,
-                         out_conn_str, sizeof(out_conn_str) / sizeof(wchar_t),
-                         &out_conn_str_len, SQL_DRIVER_NOPROMPT);
-
-  if (SQL_SUCCEEDED(ret)) {
-      int connection_id = ++next_connection_id_;
-      connections_[connection_id] = hDbc;
+  if (connected) {
+      bool utf8_text = DetectUtf8Text(hDbc, args);
+      int connection_id;
+      {
+          std::lock_guard<std::mutex> lock(connections_mutex_);
+          connection_id = ++next_connection_id_;
+          connections_[connection_id] = ConnectionEntry{
+              hDbc, nullptr, environment, CreateStatementCache(args), utf8_text,
+              NormalizeConnectionString(target), std::make_unique<Transaction>(hDbc),
+              metrics};
+      }
 
       flutter::EncodableMap response;
       response[flutter::EncodableValue("connectionId")] = flutter::EncodableValue(connection_id);
       response[flutter::EncodableValue("success")] = flutter::EncodableValue(true);
       result->Success(flutter::EncodableValue(response));
   } else {
-      std::wstringstream wss;
-      SQLSMALLINT i = 1;
-      SQLWCHAR sqlstate[6];
-      SQLINTEGER native_error;
-      SQLWCHAR message_text[SQL_MAX_MESSAGE_LENGTH];
-      SQLSMALLINT text_length;
-
-      while (SQLGetDiagRec(SQL_HANDLE_DBC, hDbc, i, sqlstate, &native_error, message_text, SQL_MAX_MESSAGE_LENGTH, &text_length) == SQL_SUCCESS) {
-          wss << L"Message " << i << L": " << message_text << L" (SQLSTATE: " << sqlstate << L", Native error: " << native_error << L")" << std::endl;
-          i++;
-      }
-      std::string error_message = WStringToString(wss.str());
-      if (error_message.empty()) {
-         error_message = "Failed to connect to database, but no diagnostic message was returned.";
-      }
-
-      SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
-      SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
+      environment->FreeConnection(hDbc);
+      metrics->CountError(CallKind::kConnect);
       result->Error("ConnectionError", "Failed to connect to database", flutter::EncodableValue(error_message));
   }
 }
@@ -219,16 +856,11 @@ void MssqlConnectPlugin::Disconnect(
   const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
   int connectionId = GetIntFromMap(args, "connectionId", -1);
 
-  if (connectionId < 0 || connections_.find(connectionId) == connections_.end()) {
+  // Pooled connections go back to their pool instead of being closed.
+  if (!CloseConnection(connectionId)) {
     result->Error("InvalidConnection", "Invalid connection ID");
     return;
   }
-
-  SQLHDBC hDbc = (SQLHDBC)connections_[connectionId];
-  SQLDisconnect(hDbc);
-  SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
-
-  connections_.erase(connectionId);
   
   flutter::EncodableMap response;
   response[flutter::EncodableValue("success")] = flutter::EncodableValue(true);
@@ -249,7 +881,11 @@ void MssqlConnectPlugin::Query(
     int connectionId = GetIntFromMap(args, "connectionId", -1);
     std::string sql = GetStringFromMap(args, "sql");
 
-    if (connectionId < 0 || connections_.find(connectionId) == connections_.end()) {
+    StatementCache* statements = nullptr;
+    bool utf8Text = false;
+    std::string target;
+    SQLHDBC hDbc = FindConnection(connectionId, &statements, &utf8Text, &target);
+    if (hDbc == SQL_NULL_HDBC) {
         result->Error("InvalidConnection", "Invalid connection ID");
         return;
     }
@@ -259,149 +895,163 @@ void MssqlConnectPlugin::Query(
         return;
     }
 
-    SQLHDBC hDbc = (SQLHDBC)connections_[connectionId];
-    SQLHSTMT hStmt = SQL_NULL_HSTMT;
-    SQLRETURN ret;
+    // Only queries that ask for it with "cacheTtlMs" use the result cache,
+    // and not inside a transaction, which may see its own uncommitted
+    // writes and must not see anything newer.
+    int cacheTtlMs = GetIntFromMap(args, "cacheTtlMs", 0);
+    std::string cacheKey;
+    Transaction* transaction = FindTransaction(connectionId);
+    if (transaction && transaction->active()) {
+        cacheTtlMs = 0;
+    }
+    if (cacheTtlMs > 0 && result_cache_.enabled()) {
+        cacheKey = ResultCacheKey(target, args);
+        std::shared_ptr<const flutter::EncodableValue> cached;
+        if (result_cache_.Get(cacheKey, &cached)) {
+            result->Success(*cached);
+            return;
+        }
+    }
 
-    ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt);
-    if (!SQL_SUCCEEDED(ret)) {
-        result->Error("QueryError", "Failed to allocate statement handle");
+    std::vector<SqlParameter> params;
+    std::string error_message;
+    if (!ReadParameters(args, &params, &error_message)) {
+        result->Error("InvalidArguments", error_message);
         return;
     }
 
-    std::wstring wsql = StringToWString(sql);
-    ret = SQLExecDirect(hStmt, (SQLWCHAR*)wsql.c_str(), SQL_NTS);
-
-    if (SQL_SUCCEEDED(ret)) {
-        SQLSMALLINT num_cols;
-        SQLNumResultCols(hStmt, &num_cols);
-
-        flutter::EncodableList columnNames;
-        std::vector<SQLWCHAR> col_name_buffer(256);
-        std::vector<SQLSMALLINT> col_types(num_cols);
-        
-        for (SQLSMALLINT i = 1; i <= num_cols; ++i) {
-            col_name_buffer.assign(256, 0);
-            SQLSMALLINT col_type;
-            SQLRETURN desc_ret = SQLDescribeCol(hStmt, i, col_name_buffer.data(), (SQLSMALLINT)col_name_buffer.size(), NULL, &col_type, NULL, NULL, NULL);
-            if (!SQL_SUCCEEDED(desc_ret)) {
-                result->Error("QueryError", "SQLDescribeCol failed.", nullptr);
-                SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
-                return;
-            }
-            columnNames.push_back(flutter::EncodableValue(WStringToString(col_name_buffer.data())));
-            col_types[i-1] = col_type;
-        }
+    auto execution = std::make_shared<Execution>();
+    std::unique_ptr<PreparedStatement> statement = PrepareStatement(
+        hDbc, statements, sql, params, GetSecondsFromMap(args, "timeoutMs"),
+        &execution->binder, Tracer::Current(), &error_message);
+    if (!statement) {
+        result->Error("QueryError", "Query execution failed", flutter::EncodableValue(error_message));
+        return;
+    }
+    SQLHSTMT hStmt = statement->handle();
 
-        flutter::EncodableList rows;
-        SQLLEN row_count = 0;
-
-        while (SQL_SUCCEEDED(SQLFetch(hStmt))) {
-            row_count++;
-            flutter::EncodableMap row;
-            for (SQLSMALLINT i = 1; i <= num_cols; ++i) {
-                SQLLEN bytes_read;
-                flutter::EncodableValue value;
-
-                // Get column type for proper data handling
-                SQLSMALLINT col_type = col_types[i-1];
-                
-                switch (col_type) {
-                    case SQL_BIT: {
-                        SQLCHAR bit_value;
-                        ret = SQLGetData(hStmt, i, SQL_C_BIT, &bit_value, sizeof(bit_value), &bytes_read);
-                        if (SQL_SUCCEEDED(ret) && bytes_read != SQL_NULL_DATA) {
-                            value = flutter::EncodableValue(static_cast<bool>(bit_value));
-                        }
-                        break;
-                    }
-                    case SQL_INTEGER:
-                    case SQL_SMALLINT:
-                    case SQL_TINYINT: {
-                        SQLINTEGER int_value;
-                        ret = SQLGetData(hStmt, i, SQL_C_SLONG, &int_value, sizeof(int_value), &bytes_read);
-                        if (SQL_SUCCEEDED(ret) && bytes_read != SQL_NULL_DATA) {
-                            value = flutter::EncodableValue(static_cast<int>(int_value));
-                        }
-                        break;
-                    }
-                    case SQL_DECIMAL:
-                    case SQL_NUMERIC:
-                    case SQL_FLOAT:
-                    case SQL_REAL:
-                    case SQL_DOUBLE: {
-                        SQLDOUBLE double_value;
-                        ret = SQLGetData(hStmt, i, SQL_C_DOUBLE, &double_value, sizeof(double_value), &bytes_read);
-                        if (SQL_SUCCEEDED(ret) && bytes_read != SQL_NULL_DATA) {
-                            value = flutter::EncodableValue(double_value);
-                        }
-                        break;
-                    }
-                    default: {
-                        // Handle as string for other types (including VARCHAR, NVARCHAR, etc.)
-                        std::vector<SQLWCHAR> buffer(4000);
-                        std::wstring accumulated_str;
-                        while ((ret = SQLGetData(hStmt, i, SQL_C_WCHAR, buffer.data(), buffer.size() * sizeof(SQLWCHAR), &bytes_read)) != SQL_NO_DATA) {
-                            if (!SQL_SUCCEEDED(ret)) {
-                                break;
-                            }
-                            if (bytes_read == SQL_NULL_DATA) {
-                                accumulated_str.clear();
-                                break;
-                            }
-                            
-                            size_t chars_read = bytes_read / sizeof(SQLWCHAR);
-                            accumulated_str.append(buffer.data(), chars_read);
-                            
-                            if (ret == SQL_SUCCESS) {
-                                break;
-                            }
-                        }
-                        if (bytes_read != SQL_NULL_DATA) {
-                           value = flutter::EncodableValue(WStringToString(accumulated_str));
-                        }
-                        break;
-                    }
-                }
-                
-                row[columnNames[i - 1]] = value;
-            }
-            rows.push_back(flutter::EncodableValue(row));
-        }
+    int requestId = GetIntFromMap(args, "requestId", 0);
+    if (!requests_.Attach(requestId, hStmt)) {
+        statements->Return(sql, std::move(statement));
+        result->Error("Cancelled", "Query was cancelled");
+        return;
+    }
+    execution->result = std::move(result);
+    execution->statements = statements;
+    execution->sql = sql;
+    execution->target = target;
+    execution->statement = std::move(statement);
+    execution->request_id = requestId;
+    execution->metrics = FindMetrics(connectionId);
+    execution->trace = Tracer::Current();
+    RunExecution(execution, [this, utf8Text, format = GetStringFromMap(args, "resultFormat"),
+                             cacheKey, cacheTtlMs](Execution* execution) {
+        FinishQuery(execution, utf8Text, format, cacheKey, cacheTtlMs);
+    });
+}
 
-        flutter::EncodableMap response;
-        response[flutter::EncodableValue("rows")] = rows;
-        response[flutter::EncodableValue("rowCount")] = (int)row_count;
-        response[flutter::EncodableValue("columns")] = columnNames;
+// Fetches the result of a query once it has executed, and replies. The rows
+// go through the same FetchResult() engine as Session::Query().
+void MssqlConnectPlugin::FinishQuery(Execution* execution, bool utf8Text,
+                                     const std::string& format,
+                                     const std::string& cacheKey, int cacheTtlMs) {
+    SessionError error;
+    if (!SQL_SUCCEEDED(execution->ret)) {
+        error = ExecutionError(kQueryErrors, execution->sqlstate,
+                               std::move(execution->diagnostics),
+                               requests_.Detach(execution->request_id));
+        execution->statements->Return(execution->sql, std::move(execution->statement));
+        execution->result->Error(error.code, error.message, flutter::EncodableValue(error.details));
+        return;
+    }
 
-        result->Success(flutter::EncodableValue(response));
+    StatementOptions options;
+    options.requests = &requests_;
+    options.request_id = execution->request_id;
+    options.trace = execution->trace;
+    // The columnar shape is column-major, so its typed lists are built once
+    // the whole result is in; the other shapes are encoded as the rows are
+    // fetched.
+    std::vector<uint8_t> bytes;
+    BinaryResultSink binarySink(&bytes);
+    ColumnarResult columnar;
+    ColumnarSink columnarSink(&columnar);
+    RowsSink rowsSink;
+    ResultSink* sink = &rowsSink;
+    if (format == "binary") {
+        sink = &binarySink;
+    } else if (format == "columnar") {
+        sink = &columnarSink;
+    }
+    Metrics* metrics = execution->metrics.get();
+    bool ok = FetchResult(execution->statement.get(), utf8Text, options, metrics,
+                          sink, &error);
+    execution->statements->Return(execution->sql, std::move(execution->statement));
+    // A query can write too, e.g. SELECT ... INTO, OUTPUT clauses or a
+    // procedure returning rows, even if it failed part way.
+    result_cache_.InvalidateAfterWrite(execution->target, execution->sql);
+
+    if (!ok) {
+        execution->result->Error(error.code, error.message, flutter::EncodableValue(error.details));
+        return;
+    }
+    flutter::EncodableValue response;
+    if (format == "binary") {
+        response = flutter::EncodableValue(std::move(bytes));
+    } else if (format == "columnar") {
+        PhaseTimer encodeTimer(metrics, Phase::kEncode);
+        response = flutter::EncodableValue(EncodeColumnar(&columnar));
     } else {
-        std::wstringstream wss;
-        SQLSMALLINT i = 1;
-        SQLWCHAR sqlstate[6];
-        SQLINTEGER native_error;
-        SQLWCHAR message_text[SQL_MAX_MESSAGE_LENGTH];
-        SQLSMALLINT text_length;
-
-        while (SQLGetDiagRec(SQL_HANDLE_STMT, hStmt, i, sqlstate, &native_error, message_text, SQL_MAX_MESSAGE_LENGTH, &text_length) == SQL_SUCCESS) {
-            wss << L"Message " << i << L": " << message_text << L" (SQLSTATE: " << sqlstate << L", Native error: " << native_error << L")" << std::endl;
-            i++;
-        }
-        std::string error_message = WStringToString(wss.str());
-        if (error_message.empty()) {
-            error_message = "Query execution failed, but no diagnostic message was returned.";
-        }
-        result->Error("QueryError", "Query execution failed", flutter::EncodableValue(error_message));
+        response = rowsSink.TakeReply();
+    }
+    if (metrics) {
+        metrics->AddBytes(ApproximateSize(response));
+    }
+    if (!cacheKey.empty()) {
+        auto cached = std::make_shared<const flutter::EncodableValue>(std::move(response));
+        result_cache_.Put(cacheKey, execution->target, execution->sql, cached,
+                          ApproximateSize(*cached), std::chrono::milliseconds(cacheTtlMs));
+        execution->result->Success(*cached);
+        return;
     }
+    execution->result->Success(response);
+}
 
-    SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+std::string MssqlConnectPlugin::ResultCacheKey(const std::string& target,
+                                               const flutter::EncodableMap& args) {
+    // Fields are separated by NUL, which none of them contains; parameters
+    // are keyed by their standard codec encoding.
+    std::string key = target;
+    key.push_back('\0');
+    key += GetStringFromMap(args, "resultFormat");
+    key.push_back('\0');
+    key += GetStringFromMap(args, "sql");
+    key.push_back('\0');
+    auto it = args.find(flutter::EncodableValue("parameters"));
+    if (it != args.end()) {
+        std::unique_ptr<std::vector<uint8_t>> encoded =
+            flutter::StandardMessageCodec::GetInstance().EncodeMessage(it->second);
+        key.append(encoded->begin(), encoded->end());
+    }
+    return key;
 }
 
-// Execute method implementation
-void MssqlConnectPlugin::Execute(
+// The error code of a statement that failed: "Timeout" when it ran past its
+// query timeout, "Cancelled" when cancel() interrupted it, |fallback|
+// otherwise. The statement's diagnostics must still be those of the
+// failure.
+const char* MssqlConnectPlugin::StatementErrorCode(SQLHSTMT stmt, bool cancelled,
+                                                   const char* fallback) {
+    return ErrorCodeForState(GetOdbcSqlState(SQL_HANDLE_STMT, stmt), cancelled, fallback);
+}
+
+// Calls a stored procedure with named input, output and input/output
+// parameters and replies with its return value, output parameters and every
+// result set; see ProcedureCall.
+void MssqlConnectPlugin::ExecuteStoredProcedure(
     const flutter::MethodCall<flutter::EncodableValue>& method_call,
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-    
+
   if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
     result->Error("InvalidArguments", "Arguments must be a map");
     return;
@@ -409,141 +1059,1250 @@ void MssqlConnectPlugin::Execute(
 
   const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
   int connectionId = GetIntFromMap(args, "connectionId", -1);
-  std::string sql = GetStringFromMap(args, "sql");
+  std::string procedureName = GetStringFromMap(args, "procedureName");
 
-  if (connectionId < 0 || connections_.find(connectionId) == connections_.end()) {
+  bool utf8Text = false;
+  std::string target;
+  SQLHDBC hDbc = FindConnection(connectionId, nullptr, &utf8Text, &target);
+  if (hDbc == SQL_NULL_HDBC) {
     result->Error("InvalidConnection", "Invalid connection ID");
     return;
   }
 
-  if (sql.empty()) {
-    result->Error("InvalidCommand", "SQL command cannot be empty");
+  if (!ProcedureCall::IsValidName(procedureName)) {
+    result->Error("InvalidArguments", "Invalid procedure name");
     return;
   }
 
-  SQLHDBC hDbc = (SQLHDBC)connections_[connectionId];
-  SQLHSTMT hStmt = SQL_NULL_HSTMT;
-  SQLRETURN ret;
-
-  ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt);
-  if (!SQL_SUCCEEDED(ret)) {
-      result->Error("ExecuteError", "Failed to allocate statement handle");
-      return;
+  std::vector<ProcedureParameter> params;
+  std::string error_message;
+  if (!ReadProcedureParameters(args, &params, &error_message)) {
+    result->Error("InvalidArguments", error_message);
+    return;
   }
 
-  std::wstring wsql = StringToWString(sql);
-  ret = SQLExecDirect(hStmt, (SQLWCHAR*)wsql.c_str(), SQL_NTS);
+  SQLHSTMT hStmt = SQL_NULL_HSTMT;
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt))) {
+    result->Error("ProcedureError", "Failed to allocate statement handle");
+    return;
+  }
 
-  if (SQL_SUCCEEDED(ret)) {
-      SQLLEN affected_rows = -1; // Default to -1 (not available)
-      ret = SQLRowCount(hStmt, &affected_rows);
+  ProcedureResult procedure;
+  bool ok;
+  {
+    ProcedureCall call(hStmt);
+    call.set_utf8_text(utf8Text);
+    ok = call.Execute(procedureName, params, &procedure, &error_message);
+  }
+  SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+  // A procedure can write any table, so drop everything cached for its
+  // target.
+  result_cache_.InvalidateTarget(target);
+  if (!ok) {
+    result->Error("ProcedureError", "Stored procedure execution failed",
+                  flutter::EncodableValue(error_message));
+    return;
+  }
 
-      if (!SQL_SUCCEEDED(ret)) {
-          // If SQLRowCount fails, we can't be sure of the number of affected rows.
-          // However, the command itself succeeded. We can return 0 or 1 based on the statement type,
-          // but returning the potentially negative value from SQLRowCount is also an option.
-          // For simplicity and to indicate success, we'll return 1 for INSERTs if rowcount is unavailable.
-          if (sql.rfind("INSERT", 0) == 0 || sql.rfind("insert", 0) == 0) {
-              affected_rows = 1; // Assume 1 row for a successful insert if count is not available
-          }
-      }
-      result->Success(flutter::EncodableValue((int)affected_rows));
-  } else {
-      std::wstringstream wss;
-      SQLSMALLINT i = 1;
-      SQLWCHAR sqlstate[6];
-      SQLINTEGER native_error;
-      SQLWCHAR message_text[SQL_MAX_MESSAGE_LENGTH];
-      SQLSMALLINT text_length;
-
-      while (SQLGetDiagRec(SQL_HANDLE_STMT, hStmt, i, sqlstate, &native_error, message_text, SQL_MAX_MESSAGE_LENGTH, &text_length) == SQL_SUCCESS) {
-          wss << L"Message " << i << L": " << message_text << L" (SQLSTATE: " << sqlstate << L", Native error: " << native_error << L")" << std::endl;
-          i++;
-      }
-      std::string error_message = WStringToString(wss.str());
-      if (error_message.empty()) {
-         error_message = "Command execution failed, but no diagnostic message was returned.";
-      }
-      result->Error("ExecuteError", "Command execution failed", flutter::EncodableValue(error_message));
+  bool columnar = GetStringFromMap(args, "resultFormat") == "columnar";
+  flutter::EncodableList result_sets;
+  for (ColumnarResult& set : procedure.result_sets) {
+    result_sets.push_back(flutter::EncodableValue(
+        columnar ? EncodeColumnar(&set) : EncodeRows(set)));
+  }
+  flutter::EncodableList row_counts;
+  for (int64_t count : procedure.row_counts) {
+    row_counts.push_back(flutter::EncodableValue(count));
+  }
+  flutter::EncodableMap outputs;
+  for (const auto& output : procedure.outputs) {
+    outputs[flutter::EncodableValue(output.first)] = EncodeParameter(output.second);
   }
 
-  SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("returnValue")] = flutter::EncodableValue(procedure.return_value);
+  response[flutter::EncodableValue("resultSets")] = flutter::EncodableValue(result_sets);
+  response[flutter::EncodableValue("rowCounts")] = flutter::EncodableValue(row_counts);
+  response[flutter::EncodableValue("outputParameters")] = flutter::EncodableValue(outputs);
+  result->Success(flutter::EncodableValue(response));
 }
 
-// Test connection method implementation
-void MssqlConnectPlugin::TestConnection(
+// Runs a query and keeps its statement open as a cursor that Dart pages
+// through with fetchNext.
+void MssqlConnectPlugin::OpenCursor(
     const flutter::MethodCall<flutter::EncodableValue>& method_call,
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-    
+
   if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
     result->Error("InvalidArguments", "Arguments must be a map");
     return;
   }
 
   const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
-  
-  std::string server = GetStringFromMap(args, "server");
-  std::string database = GetStringFromMap(args, "database");
-  std::string username = GetStringFromMap(args, "username");
-  std::string password = GetStringFromMap(args, "password");
+  int connectionId = GetIntFromMap(args, "connectionId", -1);
+  std::string sql = GetStringFromMap(args, "sql");
+
+  bool utf8Text = false;
+  SQLHDBC hDbc = FindConnection(connectionId, nullptr, &utf8Text);
+  if (hDbc == SQL_NULL_HDBC) {
+    result->Error("InvalidConnection", "Invalid connection ID");
+    return;
+  }
 
-  SQLHENV hEnv = SQL_NULL_HENV;
-  SQLHDBC hDbc = SQL_NULL_HDBC;
-  SQLRETURN ret;
+  if (sql.empty()) {
+    result->Error("InvalidQuery", "SQL query cannot be empty");
+    return;
+  }
 
-  ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &hEnv);
-  if (!SQL_SUCCEEDED(ret)) {
-      result->Success(flutter::EncodableValue(false));
-      return;
+  std::vector<SqlParameter> params;
+  std::string error_message;
+  if (!ReadParameters(args, &params, &error_message)) {
+    result->Error("InvalidArguments", error_message);
+    return;
   }
 
-  ret = SQLSetEnvAttr(hEnv, SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
-  if (!SQL_SUCCEEDED(ret)) {
-      SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
-      result->Success(flutter::EncodableValue(false));
-      return;
+  // Cursors hold their statement for as long as Dart pages through them, so
+  // they get their own statement rather than a cached one.
+  SQLHSTMT hStmt = SQL_NULL_HSTMT;
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt))) {
+    result->Error("QueryError", "Failed to allocate statement handle");
+    return;
+  }
+
+  ParameterBinder binder;
+  if (!binder.Bind(hStmt, params, &error_message)) {
+    SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+    result->Error("QueryError", "Query execution failed", flutter::EncodableValue(error_message));
+    return;
   }
 
-  ret = SQLAllocHandle(SQL_HANDLE_DBC, hEnv, &hDbc);
+  std::vector<SQLWCHAR> wsql = Utf8ToUtf16(sql);
+  SQLRETURN ret = SQLExecDirectW(hStmt, wsql.data(), (SQLINTEGER)wsql.size());
   if (!SQL_SUCCEEDED(ret)) {
-      SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
-      result->Success(flutter::EncodableValue(false));
-      return;
+    error_message = GetDiagnostics(SQL_HANDLE_STMT, hStmt);
+    SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+    result->Error("QueryError", "Query execution failed", flutter::EncodableValue(error_message));
+    return;
   }
 
-  std::wstringstream conn_str_ss;
-  conn_str_ss << L"DRIVER={ODBC Driver 18 for SQL Server};SERVER=" << StringToWString(server)
-              << L";DATABASE=" << StringToWString(database)
-              << L";UID=" << StringToWString(username)
-              << L";PWD=" << StringToWString(password)
-              << L";TrustServerCertificate=Yes;";
-  std::wstring conn_str = conn_str_ss.str();
+  // The cursor owns the statement from here on.
+  auto cursor = std::make_unique<ResultCursor>(hStmt);
+  cursor->set_utf8_text(utf8Text);
+  int lobThreshold = GetIntFromMap(args, "lobThreshold", 0);
+  if (lobThreshold > 0) {
+    cursor->set_lob_threshold(lobThreshold);
+  }
+  if (!cursor->Bind(&error_message)) {
+    result->Error("QueryError", "Failed to bind result columns", flutter::EncodableValue(error_message));
+    return;
+  }
 
-  ret = SQLDriverConnect(hDbc, NULL, (SQLWCHAR*)conn_str.c_str(), SQL_NTS, NULL, 0, NULL, SQL_DRIVER_NOPROMPT);
+  flutter::EncodableList columnNames;
+  for (const ColumnDescription& column : cursor->columns()) {
+    columnNames.push_back(flutter::EncodableValue(column.name));
+  }
 
-  if (SQL_SUCCEEDED(ret)) {
-      SQLDisconnect(hDbc);
-      SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
-      SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
-      result->Success(flutter::EncodableValue(true));
-  } else {
-      std::wstringstream wss;
-      SQLSMALLINT i = 1;
-      SQLWCHAR sqlstate[6];
-      SQLINTEGER native_error;
-      SQLWCHAR message_text[SQL_MAX_MESSAGE_LENGTH];
-      SQLSMALLINT text_length;
-
-      while (SQLGetDiagRec(SQL_HANDLE_DBC, hDbc, i, sqlstate, &native_error, message_text, SQL_MAX_MESSAGE_LENGTH, &text_length) == SQL_SUCCESS) {
-          wss << L"Message " << i << L": " << message_text << L" (SQLSTATE: " << sqlstate << L", Native error: " << native_error << L")" << std::endl;
-          i++;
-      }
-      std::string error_message = WStringToString(wss.str());
-      if (error_message.empty()) {
-         error_message = "Connection test failed, but no diagnostic message was returned.";
-      }
-      result->Error("ConnectionError", "Connection test failed", flutter::EncodableValue(error_message));
+  int cursorId;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    cursorId = ++next_cursor_id_;
+    cursors_[cursorId] = CursorEntry{connectionId, std::move(cursor)};
   }
+
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("cursorId")] = cursorId;
+  response[flutter::EncodableValue("columns")] = std::move(columnNames);
+  result->Success(flutter::EncodableValue(response));
+}
+
+// Returns the next chunk of a cursor, bounded by maxRows and/or maxBytes.
+// The cursor is closed once its last chunk has been returned.
+void MssqlConnectPlugin::FetchNext(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int cursorId = GetIntFromMap(args, "cursorId", -1);
+  int maxRows = GetIntFromMap(args, "maxRows", 0);
+  int maxBytes = GetIntFromMap(args, "maxBytes", 0);
+
+  ResultCursor* cursor = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    auto it = cursors_.find(cursorId);
+    if (it != cursors_.end()) {
+      cursor = it->second.cursor.get();
+    }
+  }
+  if (!cursor) {
+    result->Error("InvalidCursor", "Invalid cursor ID");
+    return;
+  }
+  if (maxRows <= 0 && maxBytes <= 0) {
+    maxRows = kDefaultCursorChunkRows;
+  }
+
+  // Calls for one connection are serialized, so the cursor cannot be closed
+  // while this runs.
+  ColumnarResult chunk;
+  std::string error_message;
+  if (!cursor->Fetch(std::max(maxRows, 0), std::max(maxBytes, 0), &chunk, &error_message)) {
+    DiscardCursor(cursorId);
+    result->Error("QueryError", "Failed to fetch rows", flutter::EncodableValue(error_message));
+    return;
+  }
+  bool done = cursor->done();
+  if (done) {
+    DiscardCursor(cursorId);
+  }
+
+  // A chunk ends at the row of a LOB left in the driver. Its token stays
+  // valid until the cursor moves on.
+  bool ends_on_lob = false;
+  for (const ResultColumn& column : chunk.columns) {
+    ends_on_lob = ends_on_lob || !column.lob_rows.empty();
+  }
+  int lobToken = 0;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    auto it = cursors_.find(cursorId);
+    if (it != cursors_.end()) {
+      it->second.lob_token = ends_on_lob ? ++next_lob_token_ : 0;
+      lobToken = it->second.lob_token;
+    }
+  }
+
+  flutter::EncodableMap response = GetStringFromMap(args, "resultFormat") == "columnar"
+                                       ? EncodeColumnar(&chunk, lobToken)
+                                       : EncodeRows(chunk, lobToken);
+  response[flutter::EncodableValue("done")] = done;
+  result->Success(flutter::EncodableValue(std::move(response)));
+}
+
+// Reads part of the LOB a cursor's last chunk ended on: bytes for binary
+// columns, UTF-16 code units for text columns. Reads must move forward.
+void MssqlConnectPlugin::ReadLob(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int cursorId = GetIntFromMap(args, "cursorId", -1);
+  int lobToken = GetIntFromMap(args, "lobToken", 0);
+  int offset = GetIntFromMap(args, "offset", 0);
+  int length = GetIntFromMap(args, "length", 0);
+  if (offset < 0 || length <= 0) {
+    result->Error("InvalidArguments", "offset must not be negative and length must be positive");
+    return;
+  }
+
+  ResultCursor* cursor = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    auto it = cursors_.find(cursorId);
+    if (it != cursors_.end() && lobToken != 0 && it->second.lob_token == lobToken) {
+      cursor = it->second.cursor.get();
+    }
+  }
+  if (!cursor) {
+    result->Error("InvalidLob", "The value is no longer available; LOBs must be read before the next fetchNext");
+    return;
+  }
+
+  BlockFetcher* lob = cursor->lob();
+  std::string error_message;
+  bool end = false;
+  flutter::EncodableMap response;
+  if (lob->cell_type(lob->columns().size() - 1) == CellType::kBinary) {
+    std::vector<uint8_t> bytes;
+    if (!lob->ReadLobBytes(offset, length, &bytes, &end, &error_message)) {
+      result->Error("QueryError", "Failed to read LOB", flutter::EncodableValue(error_message));
+      return;
+    }
+    response[flutter::EncodableValue("units")] = static_cast<int>(bytes.size());
+    response[flutter::EncodableValue("data")] = flutter::EncodableValue(std::move(bytes));
+  } else {
+    std::string text;
+    size_t units = 0;
+    if (!lob->ReadLobText(offset, length, &text, &units, &end, &error_message)) {
+      result->Error("QueryError", "Failed to read LOB", flutter::EncodableValue(error_message));
+      return;
+    }
+    response[flutter::EncodableValue("units")] = static_cast<int>(units);
+    response[flutter::EncodableValue("data")] = flutter::EncodableValue(std::move(text));
+  }
+  response[flutter::EncodableValue("end")] = end;
+  result->Success(flutter::EncodableValue(std::move(response)));
+}
+
+void MssqlConnectPlugin::CloseCursor(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  // Closing an exhausted (already closed) cursor is not an error.
+  DiscardCursor(GetIntFromMap(args, "cursorId", -1));
+  result->Success();
+}
+
+// Execute method implementation
+void MssqlConnectPlugin::Execute(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int connectionId = GetIntFromMap(args, "connectionId", -1);
+  std::string sql = GetStringFromMap(args, "sql");
+
+  StatementCache* statements = nullptr;
+  std::string target;
+  SQLHDBC hDbc = FindConnection(connectionId, &statements, nullptr, &target);
+  if (hDbc == SQL_NULL_HDBC) {
+    result->Error("InvalidConnection", "Invalid connection ID");
+    return;
+  }
+
+  if (sql.empty()) {
+    result->Error("InvalidCommand", "SQL command cannot be empty");
+    return;
+  }
+
+  std::vector<SqlParameter> params;
+  std::string error_message;
+  if (!ReadParameters(args, &params, &error_message)) {
+    result->Error("InvalidArguments", error_message);
+    return;
+  }
+
+  auto execution = std::make_shared<Execution>();
+  std::unique_ptr<PreparedStatement> statement = PrepareStatement(
+      hDbc, statements, sql, params, GetSecondsFromMap(args, "timeoutMs"),
+      &execution->binder, Tracer::Current(), &error_message);
+  if (!statement) {
+    result->Error("ExecuteError", "Command execution failed", flutter::EncodableValue(error_message));
+    return;
+  }
+  SQLHSTMT hStmt = statement->handle();
+
+  int requestId = GetIntFromMap(args, "requestId", 0);
+  if (!requests_.Attach(requestId, hStmt)) {
+    statements->Return(sql, std::move(statement));
+    result->Error("Cancelled", "Command was cancelled");
+    return;
+  }
+  execution->result = std::move(result);
+  execution->statements = statements;
+  execution->sql = sql;
+  execution->target = target;
+  execution->statement = std::move(statement);
+  execution->request_id = requestId;
+  execution->metrics = FindMetrics(connectionId);
+  execution->trace = Tracer::Current();
+  RunExecution(execution, [this](Execution* execution) { FinishExecute(execution); });
+}
+
+// Replies with the affected row count of a command once it has executed.
+void MssqlConnectPlugin::FinishExecute(Execution* execution) {
+  SQLHSTMT hStmt = execution->statement->handle();
+  const std::string& sql = execution->sql;
+  SQLRETURN ret = execution->ret;
+  bool cancelled = requests_.Detach(execution->request_id);
+  // Even a failed command may have written before it stopped.
+  result_cache_.InvalidateAfterWrite(execution->target, sql);
+
+  if (SQL_SUCCEEDED(ret) || ret == SQL_NO_DATA) {
+      SQLLEN affected_rows = AffectedRows(hStmt, ret, sql);
+      if (execution->metrics && affected_rows > 0) {
+          execution->metrics->AddRows((uint64_t)affected_rows);
+      }
+      execution->statements->Return(sql, std::move(execution->statement));
+      execution->result->Success(flutter::EncodableValue((int)affected_rows));
+  } else {
+      SessionError error = ExecutionError(kExecuteErrors, execution->sqlstate,
+                                          std::move(execution->diagnostics), cancelled);
+      execution->statements->Return(sql, std::move(execution->statement));
+      execution->result->Error(error.code, error.message, flutter::EncodableValue(error.details));
+  }
+}
+
+// Runs a batch of statements and replies with every result in order: each
+// result set in the Query reply shape, and {"rowsAffected": n} for each
+// statement that returned no rows.
+void MssqlConnectPlugin::QueryMulti(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int connectionId = GetIntFromMap(args, "connectionId", -1);
+  std::string sql = GetStringFromMap(args, "sql");
+
+  StatementCache* statements = nullptr;
+  bool utf8Text = false;
+  std::string target;
+  SQLHDBC hDbc = FindConnection(connectionId, &statements, &utf8Text, &target);
+  if (hDbc == SQL_NULL_HDBC) {
+    result->Error("InvalidConnection", "Invalid connection ID");
+    return;
+  }
+
+  if (sql.empty()) {
+    result->Error("InvalidQuery", "SQL query cannot be empty");
+    return;
+  }
+
+  std::vector<SqlParameter> params;
+  std::string error_message;
+  if (!ReadParameters(args, &params, &error_message)) {
+    result->Error("InvalidArguments", error_message);
+    return;
+  }
+
+  std::unique_ptr<PreparedStatement> statement = statements->Take(hDbc, sql, &error_message);
+  if (!statement) {
+    result->Error("QueryError", "Query execution failed", flutter::EncodableValue(error_message));
+    return;
+  }
+  SQLHSTMT hStmt = statement->handle();
+
+  ParameterBinder binder;
+  std::vector<StatementResult> results;
+  bool ok = statement->SetQueryTimeout(GetSecondsFromMap(args, "timeoutMs"), &error_message) &&
+            binder.Bind(hStmt, params, &error_message);
+  int requestId = GetIntFromMap(args, "requestId", 0);
+  if (ok && !requests_.Attach(requestId, hStmt)) {
+    statements->Return(sql, std::move(statement));
+    result->Error("Cancelled", "Query was cancelled");
+    return;
+  }
+  if (ok) {
+    // SQL_NO_DATA only means the first statement touched no rows; later
+    // statements may still have results.
+    SQLRETURN ret = SQLExecute(hStmt);
+    if (ret != SQL_NO_DATA && !SQL_SUCCEEDED(ret)) {
+      error_message = GetDiagnostics(SQL_HANDLE_STMT, hStmt);
+      if (error_message.empty()) {
+        error_message = "Query execution failed, but no diagnostic message was returned.";
+      }
+      ok = false;
+    }
+    ok = ok && ReadStatementResults(hStmt, utf8Text, &results, &error_message);
+  }
+  const char* code = "QueryError";
+  bool cancelled = requests_.Detach(requestId);
+  if (!ok) {
+    code = StatementErrorCode(hStmt, cancelled, code);
+  }
+  statements->Return(sql, std::move(statement));
+  result_cache_.InvalidateAfterWrite(target, sql);
+  if (!ok) {
+    result->Error(code, "Query execution failed", flutter::EncodableValue(error_message));
+    return;
+  }
+
+  bool columnar = GetStringFromMap(args, "resultFormat") == "columnar";
+  flutter::EncodableList encoded;
+  encoded.reserve(results.size());
+  for (StatementResult& item : results) {
+    if (item.has_result_set) {
+      encoded.push_back(flutter::EncodableValue(
+          columnar ? EncodeColumnar(&item.result_set) : EncodeRows(item.result_set)));
+    } else {
+      flutter::EncodableMap count;
+      count[flutter::EncodableValue("rowsAffected")] = flutter::EncodableValue(item.row_count);
+      encoded.push_back(flutter::EncodableValue(count));
+    }
+  }
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("results")] = flutter::EncodableValue(encoded);
+  result->Success(flutter::EncodableValue(response));
+}
+
+// Runs the "operations" list, each {"op": "query" | "execute", "sql",
+// "parameters"}, in order in one call; see PlanPipeline for which of them
+// share a round trip. Replies with {"results": [...]}, one per operation in
+// the QueryMulti result shapes. If an operation fails the rest are skipped
+// and the reply also carries "failedIndex", "errorCode" and "error", with
+// the results of the operations before it.
+void MssqlConnectPlugin::Pipeline(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int connectionId = GetIntFromMap(args, "connectionId", -1);
+
+  StatementCache* statements = nullptr;
+  bool utf8Text = false;
+  std::string target;
+  SQLHDBC hDbc = FindConnection(connectionId, &statements, &utf8Text, &target);
+  if (hDbc == SQL_NULL_HDBC) {
+    result->Error("InvalidConnection", "Invalid connection ID");
+    return;
+  }
+
+  auto ops_it = args.find(flutter::EncodableValue("operations"));
+  const auto* op_list = ops_it == args.end()
+                            ? nullptr
+                            : std::get_if<flutter::EncodableList>(&ops_it->second);
+  if (!op_list) {
+    result->Error("InvalidArguments", "operations must be a list");
+    return;
+  }
+
+  std::vector<PipelineOperation> operations(op_list->size());
+  std::string error_message;
+  for (size_t i = 0; i < op_list->size(); ++i) {
+    const auto* op = std::get_if<flutter::EncodableMap>(&(*op_list)[i]);
+    std::string kind = op ? GetStringFromMap(*op, "op") : "";
+    if (kind != "query" && kind != "execute") {
+      result->Error("InvalidArguments",
+                    "operation " + std::to_string(i) + " must have op 'query' or 'execute'");
+      return;
+    }
+    operations[i].kind = kind == "query" ? PipelineOperation::Kind::kQuery
+                                         : PipelineOperation::Kind::kExecute;
+    operations[i].sql = GetStringFromMap(*op, "sql");
+    if (operations[i].sql.empty()) {
+      result->Error("InvalidArguments", "operation " + std::to_string(i) + " has no SQL");
+      return;
+    }
+    if (!ReadParameters(*op, &operations[i].params, &error_message)) {
+      result->Error("InvalidArguments",
+                    "operation " + std::to_string(i) + ": " + error_message);
+      return;
+    }
+  }
+
+  SQLULEN timeout = GetSecondsFromMap(args, "timeoutMs");
+  int requestId = GetIntFromMap(args, "requestId", 0);
+  std::vector<StatementResult> outcomes;
+  outcomes.reserve(operations.size());
+  size_t failed_index = operations.size();
+  const char* code = "QueryError";
+  for (const PipelineStep& step : PlanPipeline(operations)) {
+    std::unique_ptr<PreparedStatement> statement = statements->Take(hDbc, step.sql, &error_message);
+    if (!statement) {
+      failed_index = step.first;
+      break;
+    }
+    SQLHSTMT hStmt = statement->handle();
+    ParameterBinder binder;
+    std::vector<StatementResult> results;
+    bool ok = statement->SetQueryTimeout(timeout, &error_message) &&
+              binder.Bind(hStmt, step.params, &error_message);
+    if (ok && !requests_.Attach(requestId, hStmt)) {
+      statements->Return(step.sql, std::move(statement));
+      error_message = "Pipeline was cancelled";
+      code = "Cancelled";
+      failed_index = step.first;
+      break;
+    }
+    if (ok) {
+      SQLRETURN ret = SQLExecute(hStmt);
+      if (ret != SQL_NO_DATA && !SQL_SUCCEEDED(ret)) {
+        error_message = GetDiagnostics(SQL_HANDLE_STMT, hStmt);
+        if (error_message.empty()) {
+          error_message = "Statement execution failed, but no diagnostic message was returned.";
+        }
+        ok = false;
+      }
+      ok = ok && ReadStatementResults(hStmt, utf8Text, &results, &error_message);
+      bool cancelled = requests_.Detach(requestId);
+      if (!ok) {
+        code = StatementErrorCode(hStmt, cancelled, "QueryError");
+      }
+    }
+    statements->Return(step.sql, std::move(statement));
+    for (size_t i = step.first; i < step.first + step.count; ++i) {
+      if (operations[i].kind == PipelineOperation::Kind::kExecute) {
+        result_cache_.InvalidateAfterWrite(target, operations[i].sql);
+      }
+    }
+    if (!ok || !SplitStepResults(step, operations, std::move(results), &outcomes, &error_message)) {
+      failed_index = step.first;
+      break;
+    }
+  }
+
+  bool columnar = GetStringFromMap(args, "resultFormat") == "columnar";
+  flutter::EncodableList encoded;
+  encoded.reserve(outcomes.size());
+  for (StatementResult& item : outcomes) {
+    if (item.has_result_set) {
+      encoded.push_back(flutter::EncodableValue(
+          columnar ? EncodeColumnar(&item.result_set) : EncodeRows(item.result_set)));
+    } else {
+      flutter::EncodableMap count;
+      count[flutter::EncodableValue("rowsAffected")] = flutter::EncodableValue(item.row_count);
+      encoded.push_back(flutter::EncodableValue(count));
+    }
+  }
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("results")] = flutter::EncodableValue(encoded);
+  if (failed_index < operations.size()) {
+    response[flutter::EncodableValue("failedIndex")] = flutter::EncodableValue((int)failed_index);
+    response[flutter::EncodableValue("errorCode")] = flutter::EncodableValue(std::string(code));
+    response[flutter::EncodableValue("error")] = flutter::EncodableValue(error_message);
+  }
+  result->Success(flutter::EncodableValue(response));
+}
+
+// Runs one statement for every row of "rows", sending the rows as parameter
+// arrays of up to "batchSize" rows per round trip; see BatchExecutor.
+void MssqlConnectPlugin::ExecuteBatch(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int connectionId = GetIntFromMap(args, "connectionId", -1);
+  std::string sql = GetStringFromMap(args, "sql");
+  int batchSize = GetIntFromMap(args, "batchSize", (int)BatchExecutor::kDefaultBatchSize);
+
+  StatementCache* statements = nullptr;
+  std::string target;
+  SQLHDBC hDbc = FindConnection(connectionId, &statements, nullptr, &target);
+  if (hDbc == SQL_NULL_HDBC) {
+    result->Error("InvalidConnection", "Invalid connection ID");
+    return;
+  }
+
+  if (sql.empty()) {
+    result->Error("InvalidCommand", "SQL command cannot be empty");
+    return;
+  }
+
+  auto rows_it = args.find(flutter::EncodableValue("rows"));
+  const auto* row_list = rows_it == args.end()
+                             ? nullptr
+                             : std::get_if<flutter::EncodableList>(&rows_it->second);
+  if (!row_list) {
+    result->Error("InvalidArguments", "rows must be a list");
+    return;
+  }
+
+  std::vector<std::vector<SqlParameter>> rows(row_list->size());
+  std::string error_message;
+  for (size_t i = 0; i < row_list->size(); ++i) {
+    const auto* values = std::get_if<flutter::EncodableList>(&(*row_list)[i]);
+    if (!values) {
+      result->Error("InvalidArguments", "Row " + std::to_string(i + 1) + " must be a list");
+      return;
+    }
+    if (!ReadParameterList(*values, &rows[i], &error_message)) {
+      result->Error("InvalidArguments", "Row " + std::to_string(i + 1) + ": " + error_message);
+      return;
+    }
+  }
+
+  std::unique_ptr<PreparedStatement> statement = statements->Take(hDbc, sql, &error_message);
+  if (!statement) {
+    result->Error("ExecuteError", "Batch execution failed", flutter::EncodableValue(error_message));
+    return;
+  }
+
+  BatchResult batch;
+  BatchExecutor executor(statement->handle(), batchSize < 1 ? 1 : (size_t)batchSize);
+  bool ok = executor.Execute(rows, &batch, &error_message);
+  statements->Return(sql, std::move(statement));
+  result_cache_.InvalidateAfterWrite(target, sql);
+  if (!ok) {
+    result->Error("ExecuteError", "Batch execution failed", flutter::EncodableValue(error_message));
+    return;
+  }
+
+  std::vector<int32_t> statuses;
+  statuses.reserve(batch.statuses.size());
+  for (BatchRowStatus status : batch.statuses) {
+    statuses.push_back((int32_t)status);
+  }
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("rowsAffected")] = flutter::EncodableValue(batch.rows_affected);
+  response[flutter::EncodableValue("statuses")] = flutter::EncodableValue(std::move(statuses));
+  if (!batch.error.empty()) {
+    response[flutter::EncodableValue("error")] = flutter::EncodableValue(batch.error);
+  }
+  result->Success(flutter::EncodableValue(response));
+}
+
+// Test connection method implementation
+void MssqlConnectPlugin::TestConnection(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  
+  std::shared_ptr<OdbcEnvironment> environment = OdbcEnvironment::Get(nullptr);
+  if (!environment) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+  }
+
+  SQLHDBC hDbc = environment->AllocConnection(nullptr);
+  if (hDbc == SQL_NULL_HDBC) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+  }
+  ConnectOptions options = ReadConnectOptions(args);
+  std::string error_message;
+  if (DriverConnect(hDbc, BuildConnectionString(options), options.login_timeout,
+                    &error_message)) {
+      SQLDisconnect(hDbc);
+      environment->FreeConnection(hDbc);
+      result->Success(flutter::EncodableValue(true));
+  } else {
+      environment->FreeConnection(hDbc);
+      result->Error("ConnectionError", "Connection test failed", flutter::EncodableValue(error_message));
+  }
+}
+
+// Acquire method implementation
+void MssqlConnectPlugin::Acquire(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  ConnectOptions connect_options = ReadConnectOptions(args);
+  std::string conn_str = BuildConnectionString(connect_options);
+  std::string label = GetStringFromMap(args, "username") + "@" +
+                      GetStringFromMap(args, "server") + "/" +
+                      GetStringFromMap(args, "database");
+
+  // Options only take effect when the first acquire creates the pool.
+  std::shared_ptr<ConnectionPool> pool = pools_.GetOrCreate(
+      NormalizeConnectionString(conn_str), label, [&]() {
+        ConnectionPoolOptions options;
+        options.min_size = GetIntFromMap(args, "minPoolSize", (int)options.min_size);
+        options.max_size = GetIntFromMap(args, "maxPoolSize", (int)options.max_size);
+        options.idle_timeout = std::chrono::milliseconds(
+            GetIntFromMap(args, "idleTimeoutMs", (int)options.idle_timeout.count()));
+        options.max_lifetime = std::chrono::milliseconds(
+            GetIntFromMap(args, "maxLifetimeMs", (int)options.max_lifetime.count()));
+        options.acquire_timeout = std::chrono::milliseconds(
+            GetIntFromMap(args, "acquireTimeoutMs", (int)options.acquire_timeout.count()));
+        auto created = std::make_shared<ConnectionPool>(
+            std::make_unique<OdbcConnectionFactory>(conn_str, connect_options.login_timeout),
+            options);
+        // Opens the |min_size| connections off this call; the first
+        // acquires open their own meanwhile.
+        workers_->Post([created]() { created->Prewarm(); });
+        return created;
+      });
+
+  auto metrics = std::make_shared<Metrics>(&Metrics::Global());
+  metrics->CountCall(CallKind::kConnect);
+  auto connect_timer = std::make_shared<PhaseTimer>(metrics.get(), Phase::kConnect);
+  auto reply = std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>>(
+      std::move(result));
+  auto settings = std::make_shared<flutter::EncodableMap>(args);
+  std::string target = NormalizeConnectionString(conn_str);
+
+  // Adopts the connection as a new connection id and replies.
+  auto finish = [this, pool, reply, settings, target, metrics](
+                    std::shared_ptr<PendingLease> lease) {
+    void* handle = lease->handle;
+    bool utf8_text = DetectUtf8Text((SQLHDBC)handle, *settings);
+    int connection_id;
+    {
+      std::lock_guard<std::mutex> lock(connections_mutex_);
+      connection_id = ++next_connection_id_;
+      connections_[connection_id] = ConnectionEntry{
+          handle, pool, nullptr, CreateStatementCache(*settings), utf8_text,
+          target, std::make_unique<Transaction>((SQLHDBC)handle), metrics};
+    }
+    lease->handle = nullptr;
+
+    flutter::EncodableMap response;
+    response[flutter::EncodableValue("connectionId")] = flutter::EncodableValue(connection_id);
+    response[flutter::EncodableValue("success")] = flutter::EncodableValue(true);
+    response[flutter::EncodableValue("pooled")] = flutter::EncodableValue(true);
+    reply->Success(flutter::EncodableValue(response));
+  };
+
+  // An exhausted pool queues the acquire instead of parking this worker,
+  // whose siblings may be needed to run the release that frees a
+  // connection. That release then completes it, and the rest moves back
+  // to a worker; a connection available now is adopted right here.
+  auto returned = std::make_shared<std::atomic<bool>>(false);
+  std::thread::id caller = std::this_thread::get_id();
+  pool->AcquireAsync(this, [this, pool, reply, metrics, connect_timer, finish,
+                            returned, caller](void* handle, const std::string& error) {
+    connect_timer->Stop();
+    if (!handle) {
+      metrics->CountError(CallKind::kConnect);
+      reply->Error("ConnectionError", "Failed to acquire pooled connection",
+                   flutter::EncodableValue(error));
+      return;
+    }
+    auto lease = std::make_shared<PendingLease>(pool, handle);
+    if (!returned->load() && std::this_thread::get_id() == caller) {
+      finish(lease);
+    } else {
+      workers_->Post([finish, lease]() { finish(lease); });
+    }
+  });
+  returned->store(true);
+}
+
+// Transaction control. Each call runs |operation| on the connection's
+// Transaction and replies true, or fails with "TransactionError".
+void MssqlConnectPlugin::RunTransactionCall(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+    const std::function<bool(Transaction*, const flutter::EncodableMap&, std::string*)>& operation) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int connectionId = GetIntFromMap(args, "connectionId", -1);
+  Transaction* transaction = FindTransaction(connectionId);
+  if (!transaction) {
+    result->Error("InvalidConnection", "Invalid connection ID");
+    return;
+  }
+
+  std::string error_message;
+  if (!operation(transaction, args, &error_message)) {
+    result->Error("TransactionError", "Transaction call failed",
+                  flutter::EncodableValue(error_message));
+    return;
+  }
+  result->Success(flutter::EncodableValue(true));
+}
+
+void MssqlConnectPlugin::BeginTransaction(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  RunTransactionCall(method_call, std::move(result),
+                     [](Transaction* transaction, const flutter::EncodableMap& args,
+                        std::string* error) {
+    IsolationLevel level;
+    if (!ParseIsolationLevel(GetStringFromMap(args, "isolationLevel"), &level)) {
+      *error = "Unknown isolation level";
+      return false;
+    }
+    return transaction->Begin(level, error);
+  });
+}
+
+void MssqlConnectPlugin::Commit(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  RunTransactionCall(method_call, std::move(result),
+                     [](Transaction* transaction, const flutter::EncodableMap& args,
+                        std::string* error) {
+    if (!transaction->Commit(error)) {
+      return false;
+    }
+    // Writes in the transaction dropped the results they touched when they
+    // ran, but other connections may have cached the old rows again since.
+    std::string target;
+    FindConnection(GetIntFromMap(args, "connectionId", -1), nullptr, nullptr, &target);
+    if (!target.empty()) {
+      result_cache_.InvalidateTarget(target);
+    }
+    return true;
+  });
+}
+
+void MssqlConnectPlugin::Rollback(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  RunTransactionCall(method_call, std::move(result),
+                     [](Transaction* transaction, const flutter::EncodableMap& args,
+                        std::string* error) {
+    return transaction->Rollback(error);
+  });
+}
+
+void MssqlConnectPlugin::Savepoint(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  RunTransactionCall(method_call, std::move(result),
+                     [](Transaction* transaction, const flutter::EncodableMap& args,
+                        std::string* error) {
+    return transaction->Savepoint(GetStringFromMap(args, "name"), error);
+  });
+}
+
+void MssqlConnectPlugin::RollbackTo(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  RunTransactionCall(method_call, std::move(result),
+                     [](Transaction* transaction, const flutter::EncodableMap& args,
+                        std::string* error) {
+    return transaction->RollbackTo(GetStringFromMap(args, "name"), error);
+  });
+}
+
+// Cancels the call made with "requestId"; see RequestRegistry. Replies
+// whether the call was still in flight.
+void MssqlConnectPlugin::Cancel(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int requestId = GetIntFromMap(args, "requestId", 0);
+  result->Success(flutter::EncodableValue(requests_.Cancel(requestId)));
+}
+
+// Release method implementation
+void MssqlConnectPlugin::Release(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  int connectionId = GetIntFromMap(args, "connectionId", -1);
+
+  if (!CloseConnection(connectionId)) {
+    result->Error("InvalidConnection", "Invalid connection ID");
+    return;
+  }
+  result->Success(flutter::EncodableValue(true));
+}
+
+// Environment configuration. Takes effect for the next environment handle,
+// i.e. once every connection on the current one has been closed.
+void MssqlConnectPlugin::ConfigureEnvironment(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  if (!method_call.arguments() || !std::holds_alternative<flutter::EncodableMap>(*method_call.arguments())) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+
+  const flutter::EncodableMap& args = std::get<flutter::EncodableMap>(*method_call.arguments());
+  std::string match = GetStringFromMap(args, "poolMatch");
+  if (!match.empty() && match != "strict" && match != "relaxed") {
+    result->Error("InvalidArguments", "poolMatch must be 'strict' or 'relaxed'");
+    return;
+  }
+
+  OdbcEnvironmentOptions options;
+  options.connection_pooling = GetBoolFromMap(args, "connectionPooling", false);
+  options.relaxed_match = match == "relaxed";
+  OdbcEnvironment::Configure(options);
+
+  bool async_execution = GetBoolFromMap(args, "asyncExecution", false);
+  if (async_execution) {
+    std::lock_guard<std::mutex> lock(reactor_mutex_);
+    if (!reactor_) {
+      reactor_ = std::make_unique<AsyncReactor>(AsyncReactor::Options());
+    }
+  }
+  async_execution_ = async_execution;
+  result->Success(flutter::EncodableValue(true));
+}
+
+// Pool statistics. Only reads counters, so it answers on the platform thread.
+// Process-wide prepared statement cache counters.
+void MssqlConnectPlugin::GetStatementCacheStats(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  StatementCacheStats stats = StatementCache::stats();
+  uint64_t lookups = stats.hits + stats.misses;
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("hits")] = flutter::EncodableValue((int64_t)stats.hits);
+  response[flutter::EncodableValue("misses")] = flutter::EncodableValue((int64_t)stats.misses);
+  response[flutter::EncodableValue("evictions")] = flutter::EncodableValue((int64_t)stats.evictions);
+  response[flutter::EncodableValue("hitRate")] =
+      flutter::EncodableValue(lookups == 0 ? 0.0 : (double)stats.hits / lookups);
+  result->Success(flutter::EncodableValue(response));
+}
+
+void MssqlConnectPlugin::GetPoolStats(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  flutter::EncodableList pools;
+  for (const auto& entry : pools_.Snapshot()) {
+    ConnectionPoolStats stats = entry.second->stats();
+    flutter::EncodableMap pool;
+    pool[flutter::EncodableValue("target")] = flutter::EncodableValue(entry.first);
+    pool[flutter::EncodableValue("hits")] = flutter::EncodableValue((int64_t)stats.hits);
+    pool[flutter::EncodableValue("waits")] = flutter::EncodableValue((int64_t)stats.waits);
+    pool[flutter::EncodableValue("timeouts")] = flutter::EncodableValue((int64_t)stats.timeouts);
+    pool[flutter::EncodableValue("creations")] = flutter::EncodableValue((int64_t)stats.creations);
+    pool[flutter::EncodableValue("creationFailures")] = flutter::EncodableValue((int64_t)stats.creation_failures);
+    pool[flutter::EncodableValue("idleEvictions")] = flutter::EncodableValue((int64_t)stats.idle_evictions);
+    pool[flutter::EncodableValue("lifetimeEvictions")] = flutter::EncodableValue((int64_t)stats.lifetime_evictions);
+    pool[flutter::EncodableValue("deadEvictions")] = flutter::EncodableValue((int64_t)stats.dead_evictions);
+    pool[flutter::EncodableValue("idle")] = flutter::EncodableValue((int)stats.idle);
+    pool[flutter::EncodableValue("inUse")] = flutter::EncodableValue((int)stats.in_use);
+    pools.push_back(flutter::EncodableValue(pool));
+  }
+  result->Success(flutter::EncodableValue(pools));
+}
+
+// Sets the result cache budget; zero turns the cache off and empties it.
+void MssqlConnectPlugin::ConfigureResultCache(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+  if (!args) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+  auto it = args->find(flutter::EncodableValue("maxBytes"));
+  int64_t max_bytes = -1;
+  if (it != args->end()) {
+    if (const auto* value = std::get_if<int32_t>(&it->second)) {
+      max_bytes = *value;
+    } else if (const auto* value = std::get_if<int64_t>(&it->second)) {
+      max_bytes = *value;
+    }
+  }
+  if (max_bytes < 0) {
+    result->Error("InvalidArguments", "maxBytes must be a non-negative integer");
+    return;
+  }
+  result_cache_.SetMaxBytes(static_cast<size_t>(max_bytes));
+  result->Success(flutter::EncodableValue(true));
+}
+
+// Drops cached results whose SQL matches "pattern" or that read one of
+// "tables"; with neither, drops them all. Replies with the number dropped.
+void MssqlConnectPlugin::InvalidateResultCache(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+  size_t dropped = 0;
+  std::string pattern = args ? GetStringFromMap(*args, "pattern") : "";
+  const flutter::EncodableList* tables = nullptr;
+  if (args) {
+    auto it = args->find(flutter::EncodableValue("tables"));
+    if (it != args->end()) {
+      tables = std::get_if<flutter::EncodableList>(&it->second);
+    }
+  }
+  if (!pattern.empty()) {
+    dropped += result_cache_.InvalidatePattern(pattern);
+  }
+  if (tables) {
+    std::vector<std::string> names;
+    for (const auto& table : *tables) {
+      if (const auto* name = std::get_if<std::string>(&table)) {
+        names.push_back(*name);
+      }
+    }
+    dropped += result_cache_.InvalidateTables("", names);
+  }
+  if (pattern.empty() && !tables) {
+    dropped = result_cache_.InvalidateTarget("");
+  }
+  result->Success(flutter::EncodableValue((int64_t)dropped));
+}
+
+// Process-wide result cache counters.
+void MssqlConnectPlugin::GetResultCacheStats(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  ResultCacheStats stats = result_cache_.stats();
+  uint64_t lookups = stats.hits + stats.misses;
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("hits")] = flutter::EncodableValue((int64_t)stats.hits);
+  response[flutter::EncodableValue("misses")] = flutter::EncodableValue((int64_t)stats.misses);
+  response[flutter::EncodableValue("evictions")] = flutter::EncodableValue((int64_t)stats.evictions);
+  response[flutter::EncodableValue("expirations")] = flutter::EncodableValue((int64_t)stats.expirations);
+  response[flutter::EncodableValue("invalidations")] = flutter::EncodableValue((int64_t)stats.invalidations);
+  response[flutter::EncodableValue("entries")] = flutter::EncodableValue((int64_t)stats.entries);
+  response[flutter::EncodableValue("bytes")] = flutter::EncodableValue((int64_t)stats.bytes);
+  response[flutter::EncodableValue("maxBytes")] = flutter::EncodableValue((int64_t)stats.max_bytes);
+  response[flutter::EncodableValue("hitRate")] =
+      flutter::EncodableValue(lookups == 0 ? 0.0 : (double)stats.hits / lookups);
+  result->Success(flutter::EncodableValue(response));
+}
+
+// Turns statistics collection on or off. Counters keep their values while
+// it is off.
+void MssqlConnectPlugin::ConfigureStats(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+  if (!args) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+  Metrics::set_enabled(GetBoolFromMap(*args, "enabled", Metrics::enabled()));
+  result->Success(flutter::EncodableValue(true));
+}
+
+// Replies with the process-wide statistics and those of every open
+// connection, by connection id. With "reset" they all start over.
+void MssqlConnectPlugin::GetStats(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+  bool reset = args && GetBoolFromMap(*args, "reset", false);
+
+  std::vector<std::pair<int, std::shared_ptr<Metrics>>> entries;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    for (const auto& entry : connections_) {
+      entries.emplace_back(entry.first, entry.second.metrics);
+    }
+  }
+
+  flutter::EncodableMap connections;
+  for (const auto& entry : entries) {
+    connections[flutter::EncodableValue(entry.first)] =
+        flutter::EncodableValue(EncodeMetrics(entry.second->Snapshot()));
+    if (reset) {
+      entry.second->Reset();
+    }
+  }
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("enabled")] = flutter::EncodableValue(Metrics::enabled());
+  response[flutter::EncodableValue("global")] =
+      flutter::EncodableValue(EncodeMetrics(Metrics::Global().Snapshot()));
+  response[flutter::EncodableValue("connections")] = flutter::EncodableValue(connections);
+  if (reset) {
+    Metrics::Global().Reset();
+  }
+  result->Success(flutter::EncodableValue(response));
+}
+
+// Turns tracing on or off; "clear" drops the spans recorded so far.
+void MssqlConnectPlugin::ConfigureTrace(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+  if (!args) {
+    result->Error("InvalidArguments", "Arguments must be a map");
+    return;
+  }
+  Tracer::set_enabled(GetBoolFromMap(*args, "enabled", Tracer::enabled()));
+  if (GetBoolFromMap(*args, "clear", false)) {
+    Tracer::Global().Clear();
+  }
+  result->Success(flutter::EncodableValue(true));
+}
+
+// Writes the recorded spans to "path" as Chrome trace-event JSON and
+// replies with their number. The spans are kept unless "clear" is set.
+void MssqlConnectPlugin::DumpTrace(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+  const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+  std::string path = args ? GetStringFromMap(*args, "path") : "";
+  if (path.empty()) {
+    result->Error("InvalidArguments", "path must not be empty");
+    return;
+  }
+
+  std::vector<TraceSpan> spans = Tracer::Global().Snapshot();
+  std::ofstream out(std::filesystem::u8path(path), std::ios::binary | std::ios::trunc);
+  if (out) {
+    Tracer::WriteChromeTrace(spans, &out);
+    out.close();
+  }
+  if (!out) {
+    result->Error("TraceError", "Failed to write trace", flutter::EncodableValue(path));
+    return;
+  }
+  if (GetBoolFromMap(*args, "clear", false)) {
+    Tracer::Global().Clear();
+  }
+  result->Success(flutter::EncodableValue((int64_t)spans.size()));
+}
+
+flutter::EncodableMap MssqlConnectPlugin::EncodeMetrics(const MetricsSnapshot& snapshot) {
+  flutter::EncodableMap calls;
+  flutter::EncodableMap errors;
+  for (size_t i = 0; i < kCallKindCount; ++i) {
+    flutter::EncodableValue kind(CallKindName(static_cast<CallKind>(i)));
+    calls[kind] = flutter::EncodableValue((int64_t)snapshot.calls[i]);
+    errors[kind] = flutter::EncodableValue((int64_t)snapshot.errors[i]);
+  }
+  flutter::EncodableMap phases;
+  for (size_t i = 0; i < kPhaseCount; ++i) {
+    const HistogramSnapshot& histogram = snapshot.phases[i];
+    flutter::EncodableMap phase;
+    phase[flutter::EncodableValue("count")] = flutter::EncodableValue((int64_t)histogram.count);
+    phase[flutter::EncodableValue("totalNs")] = flutter::EncodableValue((int64_t)histogram.total_ns);
+    phase[flutter::EncodableValue("maxNs")] = flutter::EncodableValue((int64_t)histogram.max_ns);
+    phase[flutter::EncodableValue("p50Ns")] =
+        flutter::EncodableValue((int64_t)histogram.ValueAtPercentile(50));
+    phase[flutter::EncodableValue("p90Ns")] =
+        flutter::EncodableValue((int64_t)histogram.ValueAtPercentile(90));
+    phase[flutter::EncodableValue("p99Ns")] =
+        flutter::EncodableValue((int64_t)histogram.ValueAtPercentile(99));
+    phase[flutter::EncodableValue("p999Ns")] =
+        flutter::EncodableValue((int64_t)histogram.ValueAtPercentile(99.9));
+    phases[flutter::EncodableValue(PhaseName(static_cast<Phase>(i)))] =
+        flutter::EncodableValue(phase);
+  }
+  flutter::EncodableMap response;
+  response[flutter::EncodableValue("calls")] = flutter::EncodableValue(calls);
+  response[flutter::EncodableValue("errors")] = flutter::EncodableValue(errors);
+  response[flutter::EncodableValue("rows")] = flutter::EncodableValue((int64_t)snapshot.rows);
+  response[flutter::EncodableValue("bytes")] = flutter::EncodableValue((int64_t)snapshot.bytes);
+  response[flutter::EncodableValue("phases")] = flutter::EncodableValue(phases);
+  return response;
 }
 
 }  // namespace mssql_connect
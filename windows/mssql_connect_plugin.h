@@ -9,9 +9,36 @@
 #include <sql.h>
 #include <sqlext.h>
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+#include "async_reactor.h"
+#include "batch_executor.h"
+#include "block_fetcher.h"
+#include "columnar_result.h"
+#include "connection_pool.h"
+#include "encodable_value_adapter.h"
+#include "metrics.h"
+#include "odbc_environment.h"
+#include "parameter_binder.h"
+#include "pipeline.h"
+#include "procedure_call.h"
+#include "request_registry.h"
+#include "result_cache.h"
+#include "result_cursor.h"
+#include "result_sets.h"
+#include "session.h"
+#include "statement_cache.h"
+#include "tracer.h"
+#include "transaction.h"
+#include "worker_pool.h"
 
 namespace mssql_connect {
 
@@ -19,24 +46,38 @@ class MssqlConnectPlugin : public flutter::Plugin {
  public:
   static void RegisterWithRegistrar(flutter::PluginRegistrarWindows *registrar);
 
+  // Replies are completed inline on the calling thread. Used by tests.
   MssqlConnectPlugin();
 
+  // Replies are marshalled back to the platform thread through the top-level
+  // window owned by |registrar|.
+  explicit MssqlConnectPlugin(flutter::PluginRegistrarWindows* registrar);
+
   virtual ~MssqlConnectPlugin();
 
  private:
+  using MethodHandler = void (MssqlConnectPlugin::*)(
+      const flutter::MethodCall<flutter::EncodableValue>& method_call,
+      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
   // Called when a method is called on this plugin's channel from Dart.
   void HandleMethodCall(
       const flutter::MethodCall<flutter::EncodableValue> &method_call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
+  // Called for a message on the "mssql_connect/binary" channel: a query
+  // whose arguments are encoded with the standard message codec, answered
+  // with the raw bytes of the binary result encoding (see binary_result.h).
+  void HandleBinaryMessage(const uint8_t* message, size_t message_size,
+                           flutter::BinaryReply reply);
+
   // Helper methods
-  static std::string GetStringFromMap(const flutter::EncodableMap& map, const char* key);
-  static int GetIntFromMap(const flutter::EncodableMap& map, const char* key, int default_value);
-  static bool GetBoolFromMap(const flutter::EncodableMap& map, const char* key, bool default_value);
-  
-  // Connection management
-  static std::wstring StringToWString(const std::string& str);
-  static std::string WStringToString(const std::wstring& wstr);
+  static const char* StatementErrorCode(SQLHSTMT stmt, bool cancelled, const char* fallback);
+  static bool ReadProcedureParameters(const flutter::EncodableMap& args,
+                                      std::vector<ProcedureParameter>* params,
+                                      std::string* error);
+  static std::unique_ptr<StatementCache> CreateStatementCache(const flutter::EncodableMap& args);
+  static std::string GetDiagnostics(SQLSMALLINT handle_type, SQLHANDLE handle);
 
   // Method implementations
   void Connect(const flutter::MethodCall<flutter::EncodableValue>& method_call,
@@ -47,12 +88,220 @@ class MssqlConnectPlugin : public flutter::Plugin {
              std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
   void Execute(const flutter::MethodCall<flutter::EncodableValue>& method_call,
                std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void QueryMulti(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                  std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void ExecuteBatch(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void Pipeline(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void ExecuteStoredProcedure(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                              std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
   void TestConnection(const flutter::MethodCall<flutter::EncodableValue>& method_call,
                       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
-  // Connection tracking
+  // Server-side cursors. "openCursor" executes a query and keeps the
+  // statement open; "fetchNext" returns the next bounded chunk of rows and
+  // "closeCursor" frees it early. "readLob" streams a value that a cursor
+  // with a LOB threshold left in the driver. Cursor calls carry their
+  // connection id so they are serialized with the connection's other calls.
+  void OpenCursor(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                  std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void FetchNext(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                 std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void ReadLob(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+               std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void CloseCursor(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                   std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  // Pooled connections. "acquire" hands out a connection id backed by a
+  // pooled connection; "release" (or "disconnect") returns it to the pool.
+  // An acquire from an exhausted pool waits without holding a worker.
+  void Acquire(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+               std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void Release(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+               std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  // Explicit transactions; see Transaction. "beginTransaction" takes an
+  // optional "isolationLevel", "savepoint" and "rollbackTo" a "name".
+  // Releasing or disconnecting a connection rolls back its open
+  // transaction.
+  void BeginTransaction(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                        std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void Commit(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+              std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void Rollback(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void Savepoint(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                 std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void RollbackTo(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                  std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  static void RunTransactionCall(
+      const flutter::MethodCall<flutter::EncodableValue>& method_call,
+      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+      const std::function<bool(Transaction*, const flutter::EncodableMap&, std::string*)>& operation);
+
+  void ConfigureEnvironment(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                            std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void GetStatementCacheStats(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                              std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void GetPoolStats(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  // Query result cache; see ResultCache. "configureResultCache" sets its
+  // byte budget, "invalidateResultCache" drops entries by SQL pattern or
+  // table, and "getResultCacheStats" reports its counters. Queries opt in
+  // with "cacheTtlMs".
+  void ConfigureResultCache(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                            std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void InvalidateResultCache(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                             std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void GetResultCacheStats(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                           std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Call statistics; see Metrics. "configureStats" turns collection on or
+  // off, and "getStats" reports the process-wide and per-connection
+  // counters and latency percentiles, clearing them with "reset".
+  void ConfigureStats(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void GetStats(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  static flutter::EncodableMap EncodeMetrics(const MetricsSnapshot& snapshot);
+
+  // Call tracing; see Tracer. "configureTrace" turns it on or off and
+  // "dumpTrace" writes the recorded spans to a file as Chrome trace-event
+  // JSON.
+  void ConfigureTrace(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void DumpTrace(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                 std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // The result cache key of a query on |target|: its SQL, parameters and
+  // result format.
+  static std::string ResultCacheKey(const std::string& target, const flutter::EncodableMap& args);
+
+  // Cancellation. Query, execute and queryMulti calls may carry a
+  // "requestId" and a "timeoutMs"; "cancel" interrupts the call with that
+  // request id, which then fails with the "Cancelled" error code, and a
+  // call that runs past its timeout fails with "Timeout".
+  void Cancel(const flutter::MethodCall<flutter::EncodableValue>& method_call,
+              std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  // Worker dispatch. Runs |handler| on the worker pool, serialized with any
+  // other call for the same "connectionId" argument, and completes |result|
+  // on the platform thread.
+  void RunOnWorker(MethodHandler handler,
+                   const flutter::MethodCall<flutter::EncodableValue>& method_call,
+                   std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void RunOnPlatformThread(std::function<void()> task);
+  void DrainPlatformTasks();
+
+  // A bound statement ready to execute and what its handler needs once
+  // SQLExecute has returned.
+  struct Execution;
+
+  // Runs SQLExecute on |execution|'s statement, then |finish| on a worker.
+  // With "asyncExecution" configured the statement executes on |reactor_|
+  // and no worker waits for it meanwhile.
+  void RunExecution(std::shared_ptr<Execution> execution,
+                    std::function<void(Execution*)> finish);
+  // The parts of Query and Execute that run after SQLExecute.
+  void FinishQuery(Execution* execution, bool utf8Text, const std::string& format,
+                   const std::string& cacheKey, int cacheTtlMs);
+  void FinishExecute(Execution* execution);
+
+  // Returns the connection handle for |connection_id|, or SQL_NULL_HDBC.
+  // Also returns the connection's statement cache through |statements|,
+  // its text fetch mode through |utf8_text| and its target through
+  // |target|.
+  static SQLHDBC FindConnection(int connection_id,
+                                StatementCache** statements = nullptr,
+                                bool* utf8_text = nullptr,
+                                std::string* target = nullptr);
+
+  // Returns the transaction state of |connection_id|, or nullptr for an
+  // unknown id. Only touched by the connection's own calls, which are
+  // serialized.
+  static Transaction* FindTransaction(int connection_id);
+
+  // Returns the statistics of |connection_id|, or nullptr for an unknown id
+  // and whenever collection is off.
+  static std::shared_ptr<Metrics> FindMetrics(int connection_id);
+
+  // Whether a connection opened with |args| fetches text as UTF-8: only if
+  // the "utf8Text" option is set and the client and database both use
+  // UTF-8.
+  static bool DetectUtf8Text(SQLHDBC dbc, const flutter::EncodableMap& args);
+
+  flutter::PluginRegistrarWindows* registrar_ = nullptr;
+  std::optional<int> window_proc_id_;
+  UINT dispatch_message_ = 0;
+  std::mutex platform_tasks_mutex_;
+  std::deque<std::function<void()>> platform_tasks_;
+  RequestRegistry requests_;
+
+  // Created the first time configureEnvironment enables "asyncExecution"
+  // and kept until the plugin goes away; |async_execution_| says whether
+  // new executions use it.
+  std::mutex reactor_mutex_;
+  std::unique_ptr<AsyncReactor> reactor_;
+  std::atomic<bool> async_execution_{false};
+
+  // Declared last so that it is destroyed (and its threads joined) before the
+  // members above that in-flight tasks may still touch.
+  std::unique_ptr<WorkerPool> workers_;
+
+  // Opens, checks and closes the ODBC connections of one pool.
+  class OdbcConnectionFactory;
+  struct PendingLease;
+
+  // An open connection handed out to Dart. |pool| is set when the handle
+  // belongs to a pool and must be returned to it rather than freed;
+  // otherwise |environment| is the environment it was allocated on.
+  struct ConnectionEntry {
+    void* handle;
+    std::shared_ptr<ConnectionPool> pool;
+    std::shared_ptr<OdbcEnvironment> environment;
+    // Prepared statements of this connection; freed before it is released.
+    std::unique_ptr<StatementCache> statements;
+    // Text is fetched as UTF-8 instead of being transcoded from UTF-16.
+    bool utf8_text = false;
+    // The normalized connection string, which scopes the connection's
+    // entries in the result cache.
+    std::string target;
+    std::unique_ptr<Transaction> transaction;
+    // Shared with calls in flight, which may finish after a disconnect.
+    std::shared_ptr<Metrics> metrics;
+  };
+
+  // An open cursor and the connection its statement belongs to.
+  struct CursorEntry {
+    int connection_id;
+    std::unique_ptr<ResultCursor> cursor;
+    // Token of the LOB the last chunk ended on, or zero.
+    int lob_token = 0;
+  };
+
+  // Rows per fetchNext chunk when the caller sets no limit.
+  static constexpr int kDefaultCursorChunkRows = 1000;
+
+  // Removes |connection_id| from the table, closes its cursors and hands its
+  // handle back to its pool, or disconnects and frees it. Returns false for
+  // an unknown id.
+  static bool CloseConnection(int connection_id);
+
+  // Removes and frees a cursor. Unknown ids are ignored.
+  static void DiscardCursor(int cursor_id);
+
+  // Connection and cursor tracking. Guarded by |connections_mutex_| since calls for
+  // different connections run concurrently on the worker pool.
+  static std::mutex connections_mutex_;
   static int next_connection_id_;
-  static std::unordered_map<int, void*> connections_;
+  static std::unordered_map<int, ConnectionEntry> connections_;
+  static int next_cursor_id_;
+  static int next_lob_token_;
+  static std::unordered_map<int, CursorEntry> cursors_;
+  static ConnectionPoolRegistry pools_;
+
+  // Replies of queries made with "cacheTtlMs", shared by every connection.
+  static ResultCache<std::shared_ptr<const flutter::EncodableValue>> result_cache_;
 };
 
 }  // namespace mssql_connect